@@ -1,4 +1,12 @@
+#include <algorithm>
+#include <atomic>
 #include "CAstWrapper.h"
+#include "CAstPipeline.h"
+#include "CAstDeferredBody.h"
+#include "CAstConstantFolder.h"
+#include "CAstExporter.h"
+#include "CAstScopeAnalysis.h"
+#include "CAstProfiler.h"
 #include "com_ibm_wala_cast_test_TestNativeTranslator.h"
 
 JNIEXPORT jobject JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_inventAst
@@ -18,3 +26,788 @@ JNIEXPORT jobject JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_inven
   CATCH()
   return NULL;
 }
+
+static void inventSum(CAstPipeline::Producer &p, jobject op, int n, CAstPipeline::Handle *result) {
+  CAstPipeline::Handle sum = p.makeConstant(0);
+  CAstPipeline::Handle add = p.makeReference(op);
+  for(int i = 1; i <= n && ! p.isCancelled(); i++) {
+    sum = p.makeNode(CAstWrapper::BINARY_EXPR, add, sum, p.makeConstant(i));
+  }
+  *result = sum;
+}
+
+JNIEXPORT jobject JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_inventAstPipelined
+  (JNIEnv *java_env, jclass cls, jobject ast, jint n)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAstPipeline pipeline(CAst, 2);
+  CAstPipeline::Handle left, right;
+  jobject op = CAst.OP_ADD;
+  pipeline.start(0, [op, n, &left](CAstPipeline::Producer &p) { inventSum(p, op, n, &left); });
+  pipeline.start(1, [op, n, &right](CAstPipeline::Producer &p) { inventSum(p, op, n, &right); });
+  pipeline.drain();
+
+  return
+    CAst.makeNode(CAst.BINARY_EXPR,
+      CAst.OP_ADD,
+      pipeline.resolve(left),
+      pipeline.resolve(right));
+  
+  CATCH()
+  return NULL;
+}
+
+static std::atomic<int> finishedProducers(0);
+
+/**
+ *  One producer refers to a handle no producer made, which makes the
+ * consumer throw while the other producer is still busy.
+ */
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_inventBrokenPipeline
+  (JNIEnv *java_env, jclass cls, jobject ast, jint n)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAstPipeline pipeline(CAst, 2);
+  jobject op = CAst.OP_ADD;
+  pipeline.start(0, [](CAstPipeline::Producer &p) {
+    p.makeNode(CAstWrapper::EMPTY, (CAstPipeline::Handle) 7 << 32);
+    finishedProducers++;
+  });
+  pipeline.start(1, [op, n](CAstPipeline::Producer &p) {
+    CAstPipeline::Handle sum;
+    inventSum(p, op, n, &sum);
+    finishedProducers++;
+  });
+  pipeline.drain();
+
+  CATCH()
+}
+
+JNIEXPORT jint JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_finishedProducers
+  (JNIEnv *java_env, jclass cls)
+{
+  return finishedProducers;
+}
+
+JNIEXPORT jlong JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_fingerprintConstant
+  (JNIEnv *java_env, jclass cls, jobject ast, jobject value, jint line)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAst.beginFingerprint();
+  CAst.makeConstant(value);
+  CAst.makeLocation(line, 1, line, 10);
+  return CAst.endFingerprint();
+
+  CATCH()
+  return 0;
+}
+
+JNIEXPORT jlong JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_fingerprintTree
+  (JNIEnv *java_env, jclass cls, jobject ast, jboolean swapped)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  // the same nodes are built in the same order either way; only the
+  // order they are given as children differs
+  CAst.beginFingerprint();
+  jobject a = CAst.makeNode(CAst.VAR, CAst.makeConstant("a"));
+  jobject b = CAst.makeNode(CAst.VAR, CAst.makeConstant("b"));
+  jobject x = swapped? b: a;
+  jobject y = swapped? a: b;
+  CAst.makeNode(CAst.BINARY_EXPR, CAst.OP_ADD, x, y);
+  return CAst.endFingerprint();
+
+  CATCH()
+  return 0;
+}
+
+JNIEXPORT jlong JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_fingerprintArrayTree
+  (JNIEnv *java_env, jclass cls, jobject ast, jboolean swapped)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAst.beginFingerprint();
+  jobject e = CAst.makeNode(CAst.EMPTY);
+  jobject c = CAst.makeNode(CAst.VAR, CAst.makeConstant("c"));
+  jobject d = CAst.makeNode(CAst.VAR, CAst.makeConstant("d"));
+  jobject stmts[] = { swapped? d: c, swapped? c: d };
+  CAst.makeNode(CAst.BLOCK_STMT, e, CAst.makeArray(2, stmts));
+  return CAst.endFingerprint();
+
+  CATCH()
+  return 0;
+}
+
+JNIEXPORT jobject JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_cachedEntity
+  (JNIEnv *java_env, jclass cls, jobject ast, jstring key, jint line, jobject fresh)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  // fingerprint "1 + 2" at the given line as a front end would, from
+  // its own parse tree, before building anything
+  CAstFingerprint fp;
+  fp.constant((jlong)1);
+  fp.node(CAst.CONSTANT, 0);
+  fp.constant((jlong)2);
+  fp.node(CAst.CONSTANT, 0);
+  fp.node(CAst.BINARY_EXPR, 3);
+  fp.position(line, 1, line, 6);
+
+  const char *k = java_env->GetStringUTFChars(key, NULL);
+  jobject entity = CAst.getCachedEntity(k, fp.value());
+  if (entity == NULL) {
+    entity = fresh;
+    CAst.cacheEntity(k, fp.value(), entity);
+  }
+  java_env->ReleaseStringUTFChars(key, k);
+
+  return entity;
+
+  CATCH()
+  return NULL;
+}
+
+JNIEXPORT jobject JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_streamEntities
+  (JNIEnv *java_env, jclass cls, jobject ast, jobject outer, jobjectArray entities)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAstArithmeticEvaluator arithmetic;
+  CAst.setConstantEvaluator(&arithmetic);
+
+  // one recording of calls spans all the streamed frames
+  CAst.beginCallSites();
+  int n = java_env->GetArrayLength(entities);
+  for(int i = 0; i < n; i++) {
+    jobject entity = java_env->GetObjectArrayElement(entities, i);
+    CAst.beginStreamedEntity(32);
+    jobject call =
+      CAst.makeNode(CAst.CALL,
+	CAst.makeNode(CAst.VAR, CAst.makeConstant("f")),
+	CAst.makeConstant("do"),
+	CAst.makeConstant(i));
+    CAst.setEntityAst(entity, CAst.makeNode(CAst.BLOCK_STMT, call));
+    CAst.endStreamedEntity(entity);
+    java_env->DeleteLocalRef(entity);
+  }
+  CAst.endCallSites(outer);
+
+  // references made now may reuse those of constants in popped frames
+  jobject x = CAst.makeNode(CAst.VAR, CAst.makeConstant("x"));
+  return CAst.makeNode(CAst.BINARY_EXPR, CAst.OP_ADD, x, CAst.makeConstant(1));
+
+  CATCH()
+  return NULL;
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_foldConstants
+  (JNIEnv *java_env, jclass cls, jobject ast, jobject entity, jobject child)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAstArithmeticEvaluator arithmetic;
+  CAst.setConstantEvaluator(&arithmetic);
+
+  jobject sum = CAst.makeNode(CAst.BINARY_EXPR, CAst.OP_ADD, CAst.makeConstant(1), CAst.makeConstant(2));
+
+  // the else branch is folded away, along with its side tables
+  jobject kept = CAst.makeNode(CAst.RETURN, CAst.makeConstant(1));
+  jobject dead = CAst.makeNode(CAst.FUNCTION_STMT, CAst.makeConstant(child));
+  CAst.setAstNodeLocation(entity, dead, CAst.makeLocation(1, 1, 1, 5));
+  CAst.setGotoTarget(entity, dead, kept);
+  CAst.addChildEntity(entity, dead, child);
+  jobject branch = CAst.makeNode(CAst.IF_STMT, CAst.makeConstant(true), kept, dead);
+  CAst.setAstNodeLocation(entity, branch, CAst.makeLocation(2, 1, 2, 5));
+
+  // an operand whose reference was that of a deleted constant
+  jobject five = CAst.makeConstant(5);
+  java_env->DeleteLocalRef(five);
+  jobject x = CAst.makeNode(CAst.VAR, CAst.makeConstant("x"));
+  jobject notFolded = CAst.makeNode(CAst.BINARY_EXPR, CAst.OP_ADD, x, CAst.makeConstant(1));
+
+  CAst.setEntityAst(entity, CAst.makeNode(CAst.BLOCK_STMT, sum, branch, notFolded));
+
+  CATCH()
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_foldEntities
+  (JNIEnv *java_env, jclass cls, jobject ast, jobject clean, jobject folded, jobject after)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAstArithmeticEvaluator arithmetic;
+  CAst.setConstantEvaluator(&arithmetic);
+
+  // folds that leave out nothing side tables mention; a shift has the
+  // width of its left operand
+  jobject shift = CAst.makeNode(CAst.BINARY_EXPR, CAst.OP_LSH, CAst.makeConstant(1), CAst.makeConstant(40L));
+  jobject branch =
+    CAst.makeNode(CAst.IF_STMT,
+      CAst.makeConstant(true),
+      CAst.makeNode(CAst.RETURN, CAst.makeConstant(1)),
+      CAst.makeNode(CAst.RETURN, CAst.makeConstant(2)));
+  CAst.setEntityAst(clean, CAst.makeNode(CAst.BLOCK_STMT, shift, branch));
+
+  // a fold that leaves out a positioned node
+  jobject dead = CAst.makeNode(CAst.RETURN, CAst.makeConstant(3));
+  CAst.setAstNodeLocation(folded, dead, CAst.makeLocation(1, 1, 1, 5));
+  CAst.setEntityAst(folded, CAst.makeNode(CAst.IF_STMT, CAst.makeConstant(false), dead, CAst.makeNode(CAst.EMPTY)));
+
+  // a later entity without folds
+  jobject x = CAst.makeNode(CAst.VAR, CAst.makeConstant("x"));
+  CAst.setAstNodeLocation(after, x, CAst.makeLocation(2, 1, 2, 5));
+  CAst.setEntityAst(after, x);
+
+  CATCH()
+}
+
+JNIEXPORT jint JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_arenaScopes
+  (JNIEnv *java_env, jclass cls, jobject ast, jint n)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  // a container of the arena grows while scopes come and go, and the
+  // temporaries of later scopes must not overwrite it
+  CAstArena &arena = CAst.getArena();
+  CAstArenaVector<jint> kept((CAstArenaAllocator<jint>(arena)));
+  for(int i = 0; i < n; i++) {
+    CAstArena::Scope scope(arena);
+    jint *scratch = (jint *)scope.getArena().allocate(64 * sizeof(jint), alignof(jint));
+    std::fill(scratch, scratch + 64, -1);
+    kept.push_back(i);
+  }
+
+  jint sum = 0;
+  for(CAstArenaVector<jint>::iterator k = kept.begin(); k != kept.end(); k++) {
+    sum += *k;
+  }
+  return sum;
+
+  CATCH()
+  return -1;
+}
+
+JNIEXPORT jstring JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_readSource
+  (JNIEnv *java_env, jclass cls, jstring file)
+{
+  const char *path = java_env->GetStringUTFChars(file, NULL);
+  if (path == NULL) {
+    return NULL;
+  }
+  CAstSourceBuffer *source = CAstSourceBuffer::acquire(java_env, path);
+  java_env->ReleaseStringUTFChars(file, path);
+  if (source == NULL) {
+    return NULL;
+  }
+
+  std::string text(source->getData(), source->getLength());
+  source->release(java_env);
+  return java_env->NewStringUTF(text.c_str());
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_exportAst
+  (JNIEnv *java_env, jclass cls, jobject ast, jstring file, jint format, jint copies)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  // the name holds a NUL and a supplementary character, which modified
+  // UTF-8 would garble
+  jobject tree =
+    CAst.makeNode(CAst.BLOCK_STMT,
+      CAst.makeConstant(1),
+      CAst.makeNode(CAst.RETURN,
+	CAst.makeNode(CAst.VAR, CAst.makeConstant("x\0\xF0\x9F\x98\x80", 6))));
+
+  const char *path = java_env->GetStringUTFChars(file, NULL);
+  THROW_ANY_EXCEPTION(exp);
+  FILE *out = fopen(path, "w");
+  java_env->ReleaseStringUTFChars(file, path);
+  if (out == NULL) {
+    THROW(exp, "cannot open export file");
+  }
+
+  // one exporter writes every copy, looking each kind name up once
+  CAstExporter exporter(CAst, out, (CAstExporter::Format)format);
+  for(int i = 0; i < copies; i++) {
+    exporter.exportTree(tree);
+  }
+  fclose(out);
+
+  CATCH()
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_typeNodes
+  (JNIEnv *java_env, jclass cls, jobject ast, jobject entity, jobject child, jobjectArray types, jint n)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  static const char *keys[] = { "int", "string", "object" };
+  int kinds = std::min(3, (int)java_env->GetArrayLength(types));
+  jobject *nodes = (jobject *)CAst.getArena().allocate(n * sizeof(jobject), alignof(jobject));
+  for(int i = 0; i < n; i++) {
+    nodes[i] = CAst.makeConstant(i);
+    jobject type = java_env->GetObjectArrayElement(types, i % kinds);
+    CAst.setAstNodeType(entity, nodes[i], CAst.internType(keys[i % kinds], type));
+    java_env->DeleteLocalRef(type);
+    if (i % 7 == 0) {
+      CAst.addChildEntity(entity, nodes[i], child);
+    }
+  }
+  CAst.setEntityAst(entity, CAst.makeNode(CAst.BLOCK_STMT, CAst.makeArray(n, nodes)));
+
+  // whatever is still buffered is passed on by the destructor
+
+  CATCH()
+}
+
+JNIEXPORT jobject JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_holdReferences
+  (JNIEnv *java_env, jclass cls, jobject ast, jobject qualifier, jobject arg, jboolean fail)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  // a qualifier set and a recording of calls never ended, both of which
+  // the wrapper holds through global references
+  CAstArenaVector<jobject> modifiers((CAstArenaAllocator<jobject>(CAst.getArena())));
+  modifiers.push_back(qualifier);
+  jobject global = CAst.makeGlobalEntity((char *)"g", NULL, modifiers);
+  CAst.beginCallSites();
+  CAst.makeNode(CAst.CALL, CAst.makeNode(CAst.VAR, CAst.makeConstant("f")), CAst.makeConstant("do"), arg);
+
+  if (fail) {
+    THROW(exp, "failed holding references");
+  }
+  return global;
+
+  CATCH()
+  return NULL;
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_analyzeScopes
+  (JNIEnv *java_env, jclass cls, jobject ast, jintArray events, jobjectArray names, jobjectArray entities)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  int nameCount = java_env->GetArrayLength(names);
+  const char **ns = (const char **)CAst.getArena().allocate(nameCount * sizeof(const char *), alignof(const char *));
+  for(int i = 0; i < nameCount; i++) {
+    jstring name = (jstring)java_env->GetObjectArrayElement(names, i);
+    const char *chars = java_env->GetStringUTFChars(name, NULL);
+    ns[i] = CAst.getArena().strdup(chars);
+    java_env->ReleaseStringUTFChars(name, chars);
+    java_env->DeleteLocalRef(name);
+  }
+
+  // each event is an operation and its operand, a name or an entity,
+  // replayed as a front end would report them
+  int length = java_env->GetArrayLength(events);
+  jint *es = java_env->GetIntArrayElements(events, NULL);
+  CAstScopeAnalysis scopes(CAst);
+  for(int i = 0; i + 1 < length; i += 2) {
+    switch (es[i]) {
+    case 0: scopes.beginScope(); break;
+    case 1: scopes.declare(ns[es[i+1]]); break;
+    case 2: scopes.read(ns[es[i+1]]); break;
+    case 3: scopes.write(ns[es[i+1]]); break;
+    default: {
+      jobject entity = java_env->GetObjectArrayElement(entities, es[i+1]);
+      scopes.endScope(entity);
+      java_env->DeleteLocalRef(entity);
+    }
+    }
+  }
+  java_env->ReleaseIntArrayElements(events, es, JNI_ABORT);
+
+  CATCH()
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_profileSections
+  (JNIEnv *java_env, jclass cls, jobject ast, jstring report, jint n, jboolean fail)
+{
+  TRY(exp, java_env)
+
+  // count sections as the agent would, without its allocation events
+  CAstProfiler::enabled = true;
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  if (fail) {
+    CAstProfiler::Scope section(CAstProfiler::SIDE_TABLES);
+    CAstProfiler::enabled = false;
+    THROW(exp, "failed in a section");
+  }
+
+  for(int i = 0; i < n; i++) {
+    CAst.makeNode(CAst.EMPTY);
+  }
+
+  const char *path = java_env->GetStringUTFChars(report, NULL);
+  FILE *out = fopen(path, "w");
+  java_env->ReleaseStringUTFChars(report, path);
+  CAstProfiler::enabled = false;
+  if (out == NULL) {
+    THROW(exp, "cannot write profile");
+  }
+  CAstProfiler::report(out);
+  fclose(out);
+
+  CATCH()
+}
+
+/**
+ *  Each string constant, and then the name of entity, read into UTF-8
+ * by the wrapper and made into a string again.
+ */
+JNIEXPORT jobjectArray JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_roundTripStrings
+  (JNIEnv *java_env, jclass cls, jobject ast, jobjectArray constants, jobject entity)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAstStringBatch batch;
+  jsize n = java_env->GetArrayLength(constants);
+  for(jsize i = 0; i < n; i++) {
+    jobject constant = java_env->GetObjectArrayElement(constants, i);
+    THROW_ANY_EXCEPTION(exp);
+    if (batch.add(CAst.getStringConstantValue(constant)) < 0) {
+      THROW(exp, "string constant read as invalid UTF-8");
+    }
+  }
+  if (batch.add(CAst.getEntityName(entity)) < 0) {
+    THROW(exp, "entity name read as invalid UTF-8");
+  }
+  return CAst.makeStrings(batch);
+
+  CATCH()
+  return NULL;
+}
+
+/**
+ *  The string that bytes decode to, or null if they are not valid
+ * UTF-8.
+ */
+JNIEXPORT jstring JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_decodeUtf8
+  (JNIEnv *java_env, jclass cls, jbyteArray bytes)
+{
+  TRY(exp, java_env)
+
+  char in[256];
+  jchar out[256];
+  jsize len = java_env->GetArrayLength(bytes);
+  if (len > 256) {
+    THROW(exp, "too many bytes");
+  }
+  java_env->GetByteArrayRegion(bytes, 0, len, (jbyte *)in);
+
+  int n = CAstUtf8::toUtf16(in, len, out);
+  if ((n >= 0) != CAstUtf8::isValid(in, len)) {
+    THROW(exp, "decoding and checking disagree");
+  }
+  return n < 0 ? NULL : java_env->NewString(out, n);
+
+  CATCH()
+  return NULL;
+}
+
+static jobject inventTree(JNIEnv *java_env, CAstWrapper &CAst, int depth, int *leaf) {
+  if (depth == 0) {
+    switch ((*leaf)++ % 3) {
+    case 0:
+      return CAst.makeConstant(*leaf);
+    case 1: {
+      jobject name = CAst.makeConstant("x");
+      jobject var = CAst.makeNode(CAst.VAR, name);
+      java_env->DeleteLocalRef(name);
+      return var;
+    }
+    default:
+      return CAst.makeNode(CAst.EMPTY);
+    }
+  } else {
+    jobject left = inventTree(java_env, CAst, depth-1, leaf);
+    jobject right = inventTree(java_env, CAst, depth-1, leaf);
+    jobject sum = CAst.makeNode(CAst.BINARY_EXPR, CAst.OP_ADD, left, right);
+    java_env->DeleteLocalRef(left);
+    java_env->DeleteLocalRef(right);
+    return sum;
+  }
+}
+
+JNIEXPORT jobject JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_inventLargeAst
+  (JNIEnv *java_env, jclass cls, jobject ast, jint depth)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  int leaf = 0;
+  return inventTree(java_env, CAst, depth, &leaf);
+  
+  CATCH()
+  return NULL;
+}
+
+static int builtBodies = 0;
+
+/**
+ *  A body that is the text of its range as one string constant; an
+ * empty range cannot be built.
+ */
+class InventedBody : public CAstDeferredBody {
+public:
+  InventedBody(CAstSourceBuffer *source, jint begin, jint end)
+    : CAstDeferredBody(source, begin, end)
+  {
+
+  }
+
+  virtual void build(CAstWrapper &CAst, jobject entity) {
+    builtBodies++;
+    if (getLength() == 0) {
+      THROW(CAst.getExceptions(), "empty body");
+    }
+    CAst.setEntityAst(entity,
+      CAst.makeNode(CAst.BLOCK_STMT, CAst.makeConstant(getText(), getLength())));
+  }
+};
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_deferInventedBody
+  (JNIEnv *java_env, jclass cls, jobject ast, jobject entity, jstring file, jint begin, jint end)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  const char *path = java_env->GetStringUTFChars(file, NULL);
+  THROW_ANY_EXCEPTION(exp);
+  CAstSourceBuffer *source = CAstSourceBuffer::acquire(java_env, path);
+  java_env->ReleaseStringUTFChars(file, path);
+  if (source == NULL) {
+    THROW(exp, "cannot read source file");
+  }
+
+  CAst.deferEntityBody(entity, new InventedBody(source, begin, end));
+
+  CATCH()
+}
+
+JNIEXPORT jint JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_builtBodies
+  (JNIEnv *java_env, jclass cls)
+{
+  return builtBodies;
+}
+
+JNIEXPORT jobjectArray JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_inventStrings
+  (JNIEnv *java_env, jclass cls, jobject ast)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  // modified UTF-8 spells NUL as C0 80, which is not UTF-8
+  if (CAstUtf8::isValid("\xc0\x80", 2)) {
+    THROW(exp, "overlong NUL accepted");
+  }
+
+  CAstStringBatch batch;
+  batch.add("plain");
+  batch.add("caf\xc3\xa9");
+  batch.add("\xf0\x9d\x84\x9e clef");
+  batch.add("a\0b", 3);
+  return CAst.makeStrings(batch);
+
+  CATCH()
+  return NULL;
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_inventCallSites
+  (JNIEnv *java_env, jclass cls, jobject ast, jobject outer, jobject inner)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAst.beginCallSites();
+  jobject first =
+    CAst.makeNode(CAst.CALL,
+      CAst.makeNode(CAst.VAR, CAst.makeConstant("f")),
+      CAst.makeConstant("do"),
+      CAst.makeConstant(1));
+
+  // the calls of a nested function go to its own table
+  CAst.beginCallSites();
+  jobject method =
+    CAst.makeNode(CAst.CALL,
+      CAst.makeNode(CAst.OBJECT_REF, CAst.makeNode(CAst.VAR, CAst.makeConstant("o")), CAst.makeConstant("m")),
+      CAst.makeConstant("do"));
+  CAst.setEntityAst(inner, CAst.makeNode(CAst.BLOCK_STMT, method));
+  CAst.endCallSites(inner);
+
+  jobject second =
+    CAst.makeNode(CAst.CALL,
+      CAst.makeNode(CAst.VAR, CAst.makeConstant("g")),
+      CAst.makeConstant("do"),
+      CAst.makeConstant(1),
+      CAst.makeConstant(2),
+      CAst.makeConstant(3));
+  CAst.setEntityAst(outer, CAst.makeNode(CAst.BLOCK_STMT, first, second));
+  CAst.endCallSites(outer);
+
+  CATCH()
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_foldCallSites
+  (JNIEnv *java_env, jclass cls, jobject ast, jobject entity)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAstArithmeticEvaluator arithmetic;
+  CAst.setConstantEvaluator(&arithmetic);
+
+  CAst.beginCallSites();
+
+  // f(g(h()), 1): calls in arguments are built, and recorded, first
+  jobject h =
+    CAst.makeNode(CAst.CALL,
+      CAst.makeNode(CAst.VAR, CAst.makeConstant("h")),
+      CAst.makeConstant("do"));
+  jobject g =
+    CAst.makeNode(CAst.CALL,
+      CAst.makeNode(CAst.VAR, CAst.makeConstant("g")),
+      CAst.makeConstant("do"),
+      h);
+  jobject f =
+    CAst.makeNode(CAst.CALL,
+      CAst.makeNode(CAst.VAR, CAst.makeConstant("f")),
+      CAst.makeConstant("do"),
+      g,
+      CAst.makeConstant(1));
+
+  // the call in the else branch is recorded, then folded away
+  jobject kept =
+    CAst.makeNode(CAst.CALL,
+      CAst.makeNode(CAst.VAR, CAst.makeConstant("k")),
+      CAst.makeConstant("do"));
+  jobject dead =
+    CAst.makeNode(CAst.CALL,
+      CAst.makeNode(CAst.VAR, CAst.makeConstant("d")),
+      CAst.makeConstant("do"));
+  jobject branch = CAst.makeNode(CAst.IF_STMT, CAst.makeConstant(true), kept, dead);
+
+  CAst.setEntityAst(entity, CAst.makeNode(CAst.BLOCK_STMT, f, branch));
+  CAst.endCallSites(entity);
+
+  CATCH()
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_inventSizes
+  (JNIEnv *java_env, jclass cls, jobject ast, jobject entity)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAst.beginSizeSummary();
+  jobject test = CAst.makeNode(CAst.VAR, CAst.makeConstant("x"));
+  jobject jump = CAst.makeNode(CAst.GOTO);
+  jobject target = CAst.makeNode(CAst.LABEL_STMT, CAst.makeConstant("l"));
+
+  // a node is known by any reference to it, not just the one it was
+  // returned as, and the depth of children given as an array is that
+  // of the deepest
+  jobject again = java_env->NewLocalRef(test);
+  java_env->DeleteLocalRef(test);
+  jobject stmts[] = { CAst.makeNode(CAst.IF_STMT, again, jump), target };
+  jobject body = CAst.makeNode(CAst.BLOCK_STMT, CAst.makeArray(2, stmts));
+  CAst.setGotoTarget(entity, jump, target);
+  CAst.setEntityAst(entity, body);
+  CAst.endSizeSummary(entity);
+
+  CATCH()
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_test_TestNativeTranslator_foldSizes
+  (JNIEnv *java_env, jclass cls, jobject ast, jobject entity)
+{
+  TRY(exp, java_env)
+
+  CAstWrapper CAst(java_env, exp, ast);
+  THROW_ANY_EXCEPTION(exp);
+
+  CAstArithmeticEvaluator arithmetic;
+  CAst.setConstantEvaluator(&arithmetic);
+
+  CAst.beginSizeSummary();
+
+  // the else branch, deeper than the rest and with a goto, is counted
+  // natively and then folded away
+  jobject deep = CAst.makeNode(CAst.VAR, CAst.makeConstant("x"));
+  for(int i = 0; i < 3; i++) {
+    deep = CAst.makeNode(CAst.BLOCK_STMT, deep);
+  }
+  jobject jump = CAst.makeNode(CAst.GOTO);
+  jobject stmts[] = { deep, jump };
+  jobject dead = CAst.makeNode(CAst.BLOCK_STMT, CAst.makeArray(2, stmts));
+
+  jobject kept = CAst.makeNode(CAst.RETURN, CAst.makeConstant(1));
+  CAst.setGotoTarget(entity, jump, kept);
+  jobject branch = CAst.makeNode(CAst.IF_STMT, CAst.makeConstant(true), kept, dead);
+  CAst.setEntityAst(entity, CAst.makeNode(CAst.BLOCK_STMT, branch));
+  CAst.endSizeSummary(entity);
+
+  CATCH()
+}
@@ -0,0 +1,175 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.test;
+
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.Collections;
+import java.util.IdentityHashMap;
+import java.util.List;
+import java.util.Random;
+import java.util.Set;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import com.ibm.wala.cast.ir.translator.AbstractScriptEntity;
+import com.ibm.wala.cast.tree.CAstControlFlowMap;
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.CAstType;
+import com.ibm.wala.cast.tree.impl.CAstControlFlowRecorder;
+import com.ibm.wala.cast.tree.impl.CAstControlFlowTable;
+import com.ibm.wala.cast.tree.impl.CAstImpl;
+import com.ibm.wala.cast.tree.impl.CAstSourcePositionRecorder;
+
+/**
+ * checks {@link CAstControlFlowTable} against {@link CAstControlFlowRecorder}
+ * on random edges, with labels repeated so that later edges replace earlier
+ * ones
+ */
+public class TestCAstControlFlowTable {
+
+  private static final Object[] labels = { null, Boolean.TRUE, Boolean.FALSE, "case 1", "case 2", CAstControlFlowMap.SWITCH_DEFAULT };
+
+  private final CAstImpl Ast = new CAstImpl();
+
+  private final Random random = new Random(1729);
+
+  private List<CAstNode> nodes(int count) {
+    List<CAstNode> nodes = new ArrayList<>();
+    for (int i = 0; i < count; i++) {
+      nodes.add(Ast.makeNode(CAstNode.GOTO, Ast.makeConstant(i)));
+    }
+    return nodes;
+  }
+
+  private static Set<Object> set(Collection<?> c) {
+    Set<Object> s = Collections.newSetFromMap(new IdentityHashMap<Object, Boolean>());
+    s.addAll(c);
+    return s;
+  }
+
+  private static void assertSameMap(Collection<CAstNode> nodes, CAstControlFlowMap expected, CAstControlFlowMap actual) {
+    Assert.assertEquals(set(expected.getMappedNodes()), set(actual.getMappedNodes()));
+    for (CAstNode n : nodes) {
+      Assert.assertEquals(new ArrayList<>(expected.getTargetLabels(n)), new ArrayList<>(actual.getTargetLabels(n)));
+      for (Object l : expected.getTargetLabels(n)) {
+        Assert.assertSame(expected.getTarget(n, l), actual.getTarget(n, l));
+      }
+      Assert.assertEquals(new ArrayList<>(expected.getSourceNodes(n)), new ArrayList<>(actual.getSourceNodes(n)));
+    }
+  }
+
+  private static CAstControlFlowRecorder recorder(List<CAstNode[]> edges, List<Object> ls) {
+    CAstControlFlowRecorder r = new CAstControlFlowRecorder(new CAstSourcePositionRecorder());
+    for (int i = 0; i < edges.size(); i++) {
+      CAstNode[] e = edges.get(i);
+      if (!r.isMapped(e[0])) {
+        r.map(e[0], e[0]);
+      }
+      if (!r.isMapped(e[1])) {
+        r.map(e[1], e[1]);
+      }
+      r.add(e[0], e[1], ls.get(i));
+    }
+    return r;
+  }
+
+  @Test
+  public void testTableMatchesRecorder() {
+    List<CAstNode> nodes = nodes(300);
+    List<CAstNode[]> edges = new ArrayList<>();
+    List<Object> ls = new ArrayList<>();
+    CAstControlFlowTable.Builder b = new CAstControlFlowTable.Builder();
+    for (int i = 0; i < 2000; i++) {
+      CAstNode from = nodes.get(random.nextInt(nodes.size()));
+      CAstNode to = nodes.get(random.nextInt(nodes.size()));
+      Object label = labels[random.nextInt(labels.length)];
+      edges.add(new CAstNode[] { from, to });
+      ls.add(label);
+      b.add(from, to, label);
+    }
+
+    CAstControlFlowTable table = b.build();
+    assertSameMap(nodes, recorder(edges, ls), table);
+
+    // nodes and labels it has never seen
+    CAstNode stranger = Ast.makeNode(CAstNode.GOTO);
+    Assert.assertNull(table.getTarget(stranger, null));
+    Assert.assertTrue(table.getTargetLabels(stranger).isEmpty());
+    Assert.assertTrue(table.getSourceNodes(stranger).isEmpty());
+    Assert.assertNull(table.getTarget(nodes.get(0), "no such label"));
+    Assert.assertTrue(new CAstControlFlowTable.Builder().build().getMappedNodes().isEmpty());
+
+    // dropping the edges from half the nodes is as if they were never added
+    Set<CAstNode> live = Collections.newSetFromMap(new IdentityHashMap<CAstNode, Boolean>());
+    live.addAll(nodes.subList(0, nodes.size() / 2));
+    List<CAstNode[]> kept = new ArrayList<>();
+    List<Object> keptLabels = new ArrayList<>();
+    for (int i = 0; i < edges.size(); i++) {
+      if (live.contains(edges.get(i)[0])) {
+        kept.add(edges.get(i));
+        keptLabels.add(ls.get(i));
+      }
+    }
+    b.retainNodes(live);
+    Assert.assertEquals(kept.size(), b.size());
+    assertSameMap(nodes, recorder(kept, keptLabels), b.build());
+
+    b.clear();
+    Assert.assertEquals(0, b.size());
+    Assert.assertTrue(b.build().getMappedNodes().isEmpty());
+  }
+
+  private static class Script extends AbstractScriptEntity {
+    Script() {
+      super("test.js", CAstType.DYNAMIC);
+    }
+
+    void record(CAstNode from, CAstNode to, Object label) {
+      if (!cfg.isMapped(from)) {
+        cfg.map(from, from);
+      }
+      if (!cfg.isMapped(to)) {
+        cfg.map(to, to);
+      }
+      cfg.add(from, to, label);
+    }
+  }
+
+  @Test
+  public void testRecorderStillServesSubclasses() {
+    List<CAstNode> nodes = nodes(4);
+    Script plain = new Script();
+    plain.setAst(Ast.makeNode(CAstNode.BLOCK_STMT, nodes.toArray(new CAstNode[nodes.size()])));
+    plain.setGotoTarget(nodes.get(0), nodes.get(1));
+    plain.setLabelledGotoTarget(nodes.get(1), nodes.get(2), Boolean.TRUE);
+    CAstControlFlowMap map = plain.getControlFlow();
+    Assert.assertTrue(map instanceof CAstControlFlowTable);
+    Assert.assertSame(nodes.get(2), map.getTarget(nodes.get(1), Boolean.TRUE));
+
+    // a subclass that records into cfg itself, as before the compact table,
+    // sees its own edges and those set through the entity in one map
+    Script mixed = new Script();
+    mixed.setAst(Ast.makeNode(CAstNode.BLOCK_STMT, nodes.toArray(new CAstNode[nodes.size()])));
+    mixed.record(nodes.get(2), nodes.get(3), null);
+    mixed.setGotoTarget(nodes.get(0), nodes.get(1));
+    map = mixed.getControlFlow();
+    Assert.assertTrue(map instanceof CAstControlFlowRecorder);
+    Assert.assertSame(nodes.get(3), map.getTarget(nodes.get(2), null));
+    Assert.assertSame(nodes.get(1), map.getTarget(nodes.get(0), null));
+
+    mixed.setLabelledGotoTarget(nodes.get(3), nodes.get(0), Boolean.FALSE);
+    map = mixed.getControlFlow();
+    Assert.assertSame(nodes.get(0), map.getTarget(nodes.get(3), Boolean.FALSE));
+    Assert.assertEquals(set(nodes), set(map.getMappedNodes()));
+  }
+}
@@ -0,0 +1,248 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.test;
+
+import java.io.IOException;
+import java.net.URL;
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.Collections;
+import java.util.Iterator;
+import java.util.List;
+import java.util.Map;
+import java.util.Random;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import com.ibm.wala.cast.ir.translator.AbstractScriptEntity;
+import com.ibm.wala.cast.tree.CAst;
+import com.ibm.wala.cast.tree.CAstControlFlowMap;
+import com.ibm.wala.cast.tree.CAstEntity;
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap.Position;
+import com.ibm.wala.cast.tree.CAstType;
+import com.ibm.wala.cast.tree.impl.CAstControlFlowRecorder;
+import com.ibm.wala.cast.tree.impl.CAstImpl;
+import com.ibm.wala.cast.tree.impl.CAstNodeTypeMapRecorder;
+import com.ibm.wala.cast.tree.impl.CAstSourcePositionRecorder;
+import com.ibm.wala.cast.tree.impl.RangePosition;
+import com.ibm.wala.cast.tree.rewrite.CAstFlatRewriter;
+import com.ibm.wala.cast.tree.rewrite.CAstRewriter.Rewrite;
+import com.ibm.wala.cast.util.CAstPrinter;
+import com.ibm.wala.cast.util.NativeLinkage;
+
+/**
+ * checks the native copy-on-write rewriter against the same rewrites done
+ * directly in Java, on a random tree
+ */
+public class TestCAstFlatRewriter {
+
+  static {
+    System.loadLibrary("xlator_test");
+    NativeLinkage.libraryLoaded();
+  }
+
+  private final CAstImpl Ast = new CAstImpl();
+
+  private final Random random = new Random(1729);
+
+  private CAstNode expr(int depth) {
+    switch (depth <= 0 ? random.nextInt(2) : random.nextInt(3)) {
+    case 0:
+      return Ast.makeConstant(random.nextInt(10));
+    case 1:
+      return Ast.makeNode(CAstNode.VAR, Ast.makeConstant(random.nextBoolean() ? "x" : "y"));
+    default:
+      return Ast.makeNode(CAstNode.BINARY_EXPR, Ast.makeConstant("+"), expr(depth - 1), expr(depth - 1));
+    }
+  }
+
+  private CAstNode tree(int size) {
+    CAstNode[] stmts = new CAstNode[size];
+    for (int i = 0; i < size; i++) {
+      stmts[i] = Ast.makeNode(CAstNode.ASSIGN, Ast.makeNode(CAstNode.VAR, Ast.makeConstant("z")), expr(4));
+    }
+    return Ast.makeNode(CAstNode.BLOCK_STMT, stmts);
+  }
+
+  private static boolean isSum(CAstNode n, CAstNode[] children) {
+    return children[1].getKind() == CAstNode.CONSTANT && children[2].getKind() == CAstNode.CONSTANT
+        && children[1].getValue() instanceof Integer && children[2].getValue() instanceof Integer;
+  }
+
+  private static CAstNode sum(CAst Ast, CAstNode[] children) {
+    return Ast.makeConstant((Integer) children[1].getValue() + (Integer) children[2].getValue());
+  }
+
+  private static class Folder extends CAstFlatRewriter {
+    private Folder(CAst Ast, Chain chain) {
+      super(Ast, false, chain, CAstNode.BINARY_EXPR);
+    }
+
+    @Override
+    protected CAstNode rewrite(CAstNode node, CAstNode[] children) {
+      return isSum(node, children) ? sum(Ast, children) : null;
+    }
+  }
+
+  private static class Renamer extends CAstFlatRewriter {
+    private Renamer(CAst Ast, Chain chain) {
+      super(Ast, false, chain, CAstNode.VAR);
+    }
+
+    @Override
+    protected CAstNode rewrite(CAstNode node, CAstNode[] children) {
+      return "x".equals(children[0].getValue()) ? Ast.makeNode(CAstNode.VAR, Ast.makeConstant("w")) : null;
+    }
+  }
+
+  private CAstNode javaFold(CAstNode n) {
+    if (n.getKind() == CAstNode.CONSTANT) {
+      return n;
+    }
+    CAstNode[] cs = new CAstNode[n.getChildCount()];
+    for (int i = 0; i < cs.length; i++) {
+      cs[i] = javaFold(n.getChild(i));
+    }
+    if (n.getKind() == CAstNode.BINARY_EXPR && isSum(n, cs)) {
+      return sum(Ast, cs);
+    } else if (n.getKind() == CAstNode.VAR && "x".equals(cs[0].getValue())) {
+      return Ast.makeNode(CAstNode.VAR, Ast.makeConstant("w"));
+    }
+    return Ast.makeNode(n.getKind(), cs);
+  }
+
+  @Test
+  public void testMatchesJava() {
+    CAstNode t = tree(200);
+    CAstNode expected = javaFold(t);
+
+    CAstFlatRewriter.Chain chain = new CAstFlatRewriter.Chain();
+    CAstNode folded = new Folder(Ast, chain).rewrite(t, null, null, null, null).newRoot();
+    CAstNode renamed = new Renamer(Ast, chain).rewrite(folded, null, null, null, null).newRoot();
+    Assert.assertEquals(CAstPrinter.print(expected), CAstPrinter.print(renamed));
+  }
+
+  @Test
+  public void testSharesUnchangedSubtrees() {
+    CAstNode kept = Ast.makeNode(CAstNode.VAR, Ast.makeConstant("y"));
+    CAstNode t = Ast.makeNode(CAstNode.BLOCK_STMT, kept,
+        Ast.makeNode(CAstNode.BINARY_EXPR, Ast.makeConstant("+"), Ast.makeConstant(1), Ast.makeConstant(2)));
+
+    CAstNode folded = new Folder(Ast, null).rewrite(t, null, null, null, null).newRoot();
+    Assert.assertNotSame(t, folded);
+    Assert.assertSame(kept, folded.getChild(0));
+    Assert.assertEquals(3, folded.getChild(1).getValue());
+
+    // nothing to do leaves the tree as it is
+    Assert.assertSame(folded, new Folder(Ast, null).rewrite(folded, null, null, null, null).newRoot());
+  }
+
+  private static CAstType type(final String name) {
+    return new CAstType() {
+      @Override
+      public String getName() {
+        return name;
+      }
+
+      @Override
+      public Collection<CAstType> getSupertypes() {
+        return Collections.emptySet();
+      }
+    };
+  }
+
+  private static <T> List<T> list(Iterator<T> ts) {
+    List<T> l = new ArrayList<>();
+    while (ts.hasNext()) {
+      l.add(ts.next());
+    }
+    return l;
+  }
+
+  @Test
+  public void testRemapsSideTables() throws IOException {
+    // the sum is folded, so the return holding it is copied; the rest of the
+    // block is kept, and only the block itself is copied to hold the new return
+    CAstNode sum = Ast.makeNode(CAstNode.BINARY_EXPR, Ast.makeConstant("+"), Ast.makeConstant(1), Ast.makeConstant(2));
+    CAstNode ret = Ast.makeNode(CAstNode.RETURN, sum);
+    CAstNode kept = Ast.makeNode(CAstNode.VAR, Ast.makeConstant("y"));
+    CAstNode jump = Ast.makeNode(CAstNode.GOTO);
+    CAstNode block = Ast.makeNode(CAstNode.BLOCK_STMT, kept, ret, jump);
+
+    URL url = new URL("file:///flat.js");
+    Position sumPos = new RangePosition(url, 1, 10, 15);
+    Position retPos = new RangePosition(url, 1, 3, 15);
+    Position keptPos = new RangePosition(url, 2, 20, 21);
+    CAstSourcePositionRecorder pos = new CAstSourcePositionRecorder();
+    pos.setPosition(sum, sumPos);
+    pos.setPosition(ret, retPos);
+    pos.setPosition(kept, keptPos);
+
+    CAstControlFlowRecorder cfg = new CAstControlFlowRecorder(pos);
+    for (CAstNode n : new CAstNode[] { ret, kept, jump }) {
+      cfg.map(n, n);
+    }
+    cfg.add(jump, ret, null);
+    cfg.add(kept, jump, Boolean.TRUE);
+    cfg.add(ret, kept, "x");
+
+    CAstType number = type("number");
+    CAstType any = CAstType.DYNAMIC;
+    CAstNodeTypeMapRecorder types = new CAstNodeTypeMapRecorder();
+    types.add(sum, number);
+    types.add(ret, any);
+    types.add(kept, number);
+
+    CAstEntity nested = new AbstractScriptEntity("nested.js", null);
+    Map<CAstNode, Collection<CAstEntity>> children = Collections.<CAstNode, Collection<CAstEntity>> singletonMap(ret,
+        Collections.singleton(nested));
+
+    Rewrite r = new Folder(Ast, null).rewrite(block, cfg, pos, types, children);
+    CAstNode newBlock = r.newRoot();
+    CAstNode newRet = newBlock.getChild(1);
+    CAstNode three = newRet.getChild(0);
+    Assert.assertNotSame(ret, newRet);
+    Assert.assertEquals(3, three.getValue());
+    Assert.assertSame(kept, newBlock.getChild(0));
+    Assert.assertSame(jump, newBlock.getChild(2));
+
+    // edges to and from the return now go to and from its copy
+    CAstControlFlowMap newCfg = r.newCfg();
+    Assert.assertSame(newRet, newCfg.getTarget(jump, null));
+    Assert.assertSame(jump, newCfg.getTarget(kept, Boolean.TRUE));
+    Assert.assertSame(kept, newCfg.getTarget(newRet, "x"));
+    Assert.assertTrue(newCfg.getMappedNodes().contains(newRet));
+    Assert.assertFalse(newCfg.getMappedNodes().contains(ret));
+
+    // positions and types move to the replacements, and shared nodes keep theirs
+    CAstSourcePositionMap newPos = r.newPos();
+    Assert.assertSame(sumPos, newPos.getPosition(three));
+    Assert.assertSame(retPos, newPos.getPosition(newRet));
+    Assert.assertSame(keptPos, newPos.getPosition(kept));
+    List<CAstNode> positioned = list(newPos.getMappedNodes());
+    Assert.assertTrue(positioned.contains(three) && positioned.contains(newRet) && positioned.contains(kept));
+    Assert.assertFalse(positioned.contains(sum) || positioned.contains(ret));
+
+    Assert.assertSame(number, r.newTypes().getNodeType(three));
+    Assert.assertSame(any, r.newTypes().getNodeType(newRet));
+    Assert.assertSame(number, r.newTypes().getNodeType(kept));
+    Collection<CAstNode> typed = r.newTypes().getMappedNodes();
+    Assert.assertEquals(3, typed.size());
+    Assert.assertFalse(typed.contains(sum) || typed.contains(ret));
+
+    // and the scoped entities of the return hang off its copy
+    Assert.assertEquals(Collections.singleton(newRet), r.newChildren().keySet());
+    Assert.assertSame(nested, r.newChildren().get(newRet).iterator().next());
+  }
+}
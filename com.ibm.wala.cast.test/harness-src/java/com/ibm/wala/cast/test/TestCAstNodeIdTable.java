@@ -0,0 +1,180 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.test;
+
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.IdentityHashMap;
+import java.util.Iterator;
+import java.util.List;
+import java.util.Map;
+import java.util.Random;
+import java.util.Set;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.CAstType;
+import com.ibm.wala.cast.tree.impl.CAstImpl;
+import com.ibm.wala.cast.tree.impl.CAstNodeIdTable;
+import com.ibm.wala.cast.tree.impl.CAstNodeTypeMapRecorder;
+import com.ibm.wala.cast.tree.impl.CAstNumberedNode;
+import com.ibm.wala.cast.tree.impl.CAstValueImpl;
+
+/**
+ * checks {@link CAstNodeIdTable} against an identity map, for nodes numbered
+ * by two factories, nodes with no number and ids far apart
+ */
+public class TestCAstNodeIdTable {
+
+  private final Random random = new Random(1729);
+
+  private static int id(CAstNode n) {
+    return ((CAstNumberedNode) n).getNodeId();
+  }
+
+  private static Set<CAstNode> set(Iterator<CAstNode> ns) {
+    Set<CAstNode> s = Collections.newSetFromMap(new IdentityHashMap<CAstNode, Boolean>());
+    while (ns.hasNext()) {
+      Assert.assertTrue("node seen twice", s.add(ns.next()));
+    }
+    return s;
+  }
+
+  private static void assertSameTable(Map<CAstNode, Integer> expected, CAstNodeIdTable<Integer> actual, List<CAstNode> all) {
+    Assert.assertEquals(expected.size(), actual.size());
+    Assert.assertEquals(expected.keySet(), set(actual.nodes()));
+    for (CAstNode n : all) {
+      Assert.assertEquals(expected.containsKey(n), actual.containsKey(n));
+      Assert.assertEquals(expected.get(n), actual.get(n));
+    }
+  }
+
+  @Test
+  public void testFactoryNumbersNodes() {
+    CAstImpl Ast = new CAstImpl();
+    CAstNode c = Ast.makeConstant(1);
+    CAstNode v = Ast.makeConstant("x");
+    CAstNode n = Ast.makeNode(CAstNode.BINARY_EXPR, c, v);
+    CAstNode w = Ast.makeNode(CAstNode.BLOCK_STMT, new CAstNode[] { n, n, n, n, n });
+    Assert.assertEquals(0, id(c));
+    Assert.assertEquals(1, id(v));
+    Assert.assertEquals(2, id(n));
+    Assert.assertEquals(3, id(w));
+
+    // each factory numbers its own nodes
+    Assert.assertEquals(0, id(new CAstImpl().makeNode(CAstNode.EMPTY)));
+    Assert.assertEquals(-1, id(new CAstValueImpl().makeConstant(1)));
+  }
+
+  @Test
+  public void testTableMatchesMap() {
+    CAstImpl first = new CAstImpl();
+    CAstImpl second = new CAstImpl();
+    CAstValueImpl unnumbered = new CAstValueImpl();
+    List<CAstNode> all = new ArrayList<>();
+    for (int i = 0; i < 3000; i++) {
+      switch (random.nextInt(4)) {
+      case 0:
+      case 1:
+        all.add(first.makeConstant(i));
+        break;
+      case 2:
+        all.add(second.makeConstant(i));
+        break;
+      default:
+        all.add(unnumbered.makeConstant(i));
+      }
+    }
+
+    Map<CAstNode, Integer> expected = new IdentityHashMap<>();
+    CAstNodeIdTable<Integer> actual = new CAstNodeIdTable<>();
+    for (int i = 0; i < 10000; i++) {
+      CAstNode n = all.get(random.nextInt(all.size()));
+      expected.put(n, i);
+      actual.put(n, i);
+    }
+    assertSameTable(expected, actual, all);
+
+    Set<CAstNode> live = Collections.newSetFromMap(new IdentityHashMap<CAstNode, Boolean>());
+    for (CAstNode n : all) {
+      if (random.nextBoolean()) {
+        live.add(n);
+      }
+    }
+    expected.keySet().retainAll(live);
+    actual.retainNodes(live);
+    assertSameTable(expected, actual, all);
+  }
+
+  @Test
+  public void testNodeMovesIntoWindow() {
+    CAstImpl Ast = new CAstImpl();
+    List<CAstNode> all = new ArrayList<>();
+    for (int i = 0; i < 16000; i++) {
+      all.add(Ast.makeConstant(i));
+    }
+
+    // a far id goes to the hash map while the window is small, and into the
+    // window once it has grown to cover it, leaving the table as if it had
+    // been there all along
+    Map<CAstNode, Integer> expected = new IdentityHashMap<>();
+    CAstNodeIdTable<Integer> actual = new CAstNodeIdTable<>();
+    CAstNode far = all.get(15000);
+    expected.put(all.get(0), 0);
+    actual.put(all.get(0), 0);
+    expected.put(far, -1);
+    actual.put(far, -1);
+    for (int i = 1; i <= 2000; i++) {
+      expected.put(all.get(i), i);
+      actual.put(all.get(i), i);
+    }
+    expected.put(far, -2);
+    actual.put(far, -2);
+    assertSameTable(expected, actual, all);
+  }
+
+  @Test
+  public void testTypeMapRecorder() {
+    CAstImpl Ast = new CAstImpl();
+    CAstNode numbered = Ast.makeConstant(1);
+    CAstNode other = new CAstValueImpl().makeConstant(2);
+    CAstNodeTypeMapRecorder types = new CAstNodeTypeMapRecorder();
+    types.add(numbered, CAstType.DYNAMIC);
+    types.add(other, CAstType.DYNAMIC);
+    Assert.assertEquals(2, types.size());
+    Assert.assertSame(CAstType.DYNAMIC, types.getNodeType(numbered));
+    Assert.assertSame(CAstType.DYNAMIC, types.getNodeType(other));
+    Assert.assertEquals(2, types.getMappedNodes().size());
+
+    // pruning sees both kinds of node, as do the mapped nodes after it
+    types.retainNodes(Collections.singleton(numbered));
+    Assert.assertEquals(1, types.size());
+    Assert.assertNull(types.getNodeType(other));
+    Assert.assertEquals(Collections.singletonList(numbered), new ArrayList<>(types.getMappedNodes()));
+
+    CAstNodeTypeMapRecorder copy = new CAstNodeTypeMapRecorder();
+    copy.addAll(types);
+    Assert.assertSame(CAstType.DYNAMIC, copy.getNodeType(numbered));
+
+    // the Map view reads and writes the same table
+    Map<CAstNode, CAstType> map = copy;
+    Assert.assertSame(CAstType.DYNAMIC, map.get(numbered));
+    Assert.assertNull(map.put(other, CAstType.DYNAMIC));
+    Assert.assertSame(CAstType.DYNAMIC, copy.getNodeType(other));
+    Assert.assertTrue(map.keySet().remove(numbered));
+    Assert.assertNull(copy.getNodeType(numbered));
+    Assert.assertEquals(Collections.singletonMap(other, CAstType.DYNAMIC), map);
+    map.clear();
+    Assert.assertEquals(0, copy.size());
+  }
+}
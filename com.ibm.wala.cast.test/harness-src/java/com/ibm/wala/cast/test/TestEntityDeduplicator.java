@@ -0,0 +1,153 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.test;
+
+import java.net.MalformedURLException;
+import java.net.URL;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.List;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import com.ibm.wala.cast.ir.translator.AbstractScriptEntity;
+import com.ibm.wala.cast.ir.translator.EntityDeduplicator;
+import com.ibm.wala.cast.tree.CAstEntity;
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap.Position;
+import com.ibm.wala.cast.tree.impl.CAstImpl;
+import com.ibm.wala.cast.util.SharedSourceBuffer;
+import com.ibm.wala.cast.util.SharedSourceBuffer.SharedPosition;
+
+/**
+ * checks that copies found by an {@link EntityDeduplicator} share the
+ * canonical AST, have names and positions of their own, and are only found
+ * for the same source
+ */
+public class TestEntityDeduplicator {
+
+  private static final String lib = "function lib() {\n  f(1);\n  function nested() {}\n}";
+
+  private final CAstImpl Ast = new CAstImpl();
+
+  private static SharedSourceBuffer buffer(String url, String text) throws MalformedURLException {
+    byte[] bytes = text.getBytes(StandardCharsets.UTF_8);
+    List<Integer> starts = new ArrayList<>();
+    starts.add(0);
+    for (int i = 0; i < bytes.length; i++) {
+      if (bytes[i] == '\n') {
+        starts.add(i + 1);
+      }
+    }
+    ByteBuffer lineStarts = ByteBuffer.allocate(4 * starts.size()).order(ByteOrder.nativeOrder());
+    for (int i = 0; i < starts.size(); i++) {
+      lineStarts.putInt(4 * i, starts.get(i));
+    }
+    return new SharedSourceBuffer(new URL(url), ByteBuffer.wrap(bytes), lineStarts);
+  }
+
+  /**
+   * the position of the first occurrence of text in buffer
+   */
+  private static SharedPosition find(SharedSourceBuffer buffer, String text) {
+    String all = buffer.getText(0, buffer.getLength());
+    int first = all.substring(0, all.indexOf(text)).getBytes(StandardCharsets.UTF_8).length;
+    return buffer.makeRangePosition(first, first + text.getBytes(StandardCharsets.UTF_8).length);
+  }
+
+  private static String text(Position p) {
+    return ((SharedPosition) p).getText();
+  }
+
+  private AbstractScriptEntity script(SharedSourceBuffer a, CAstNode call) {
+    AbstractScriptEntity nested = new AbstractScriptEntity("a/lib.js/nested", null);
+    nested.setPosition(find(a, "function nested() {}"));
+    AbstractScriptEntity script = new AbstractScriptEntity("a/lib.js", null);
+    script.setAst(Ast.makeNode(CAstNode.BLOCK_STMT, call));
+    script.setNodePosition(call, find(a, "f(1)"));
+    script.setPosition(find(a, lib));
+    script.addScopedEntity(call, nested);
+    return script;
+  }
+
+  @Test
+  public void testCopy() throws MalformedURLException {
+    SharedSourceBuffer a = buffer("file:/a/lib.js", "// a\n" + lib + "\n");
+    SharedSourceBuffer b = buffer("file:/b/lib.js", "// b, with\n// more lines änd €\n\n   " + lib + "\n");
+
+    CAstNode call = Ast.makeNode(CAstNode.CALL, Ast.makeNode(CAstNode.VAR, Ast.makeConstant("f")), Ast.makeConstant(1));
+    AbstractScriptEntity script = script(a, call);
+
+    EntityDeduplicator dedup = new EntityDeduplicator();
+    Assert.assertNull(dedup.lookup(42, "a/lib.js", script.getPosition()));
+    dedup.record(42, script);
+
+    CAstEntity copy = dedup.lookup(42, "b/lib.js", find(b, lib));
+    Assert.assertNotNull(copy);
+    Assert.assertEquals("b/lib.js", copy.getName());
+    Assert.assertSame(script.getAST(), copy.getAST());
+    Assert.assertEquals(4, copy.getPosition().getFirstLine());
+    Assert.assertEquals(3, copy.getPosition().getFirstCol());
+
+    // positions are found in the copy's own file, whatever comes before it
+    Position p = copy.getSourceMap().getPosition(call);
+    Assert.assertEquals(b.getURL(), p.getURL());
+    Assert.assertEquals("f(1)", text(p));
+    Assert.assertEquals(5, p.getFirstLine());
+    Assert.assertEquals(2, p.getFirstCol());
+
+    // nested copies are made once, with names and positions of their own
+    CAstEntity nestedCopy = copy.getScopedEntities(call).next();
+    Assert.assertSame(nestedCopy, copy.getScopedEntities(call).next());
+    Assert.assertEquals("b/lib.js/nested", nestedCopy.getName());
+    Assert.assertEquals("a/lib.js/nested", script.getScopedEntities(call).next().getName());
+    Assert.assertEquals(6, nestedCopy.getPosition().getFirstLine());
+    Assert.assertEquals("function nested() {}", text(nestedCopy.getPosition()));
+    Assert.assertEquals(b.getURL(), nestedCopy.getPosition().getURL());
+
+    Assert.assertEquals(1, dedup.getCanonicalCount());
+    Assert.assertEquals(1, dedup.getDuplicateCount());
+    Assert.assertEquals(lib.length(), dedup.getBytesSaved());
+  }
+
+  @Test
+  public void testCollision() throws MalformedURLException {
+    SharedSourceBuffer a = buffer("file:/a/lib.js", lib);
+    SharedSourceBuffer c = buffer("file:/c/lib.js", lib.replace("f(1)", "g(2)"));
+    CAstNode call = Ast.makeNode(CAstNode.CALL, Ast.makeNode(CAstNode.VAR, Ast.makeConstant("f")), Ast.makeConstant(1));
+
+    // a fingerprint that matches different source shares nothing
+    EntityDeduplicator dedup = new EntityDeduplicator();
+    dedup.record(42, script(a, call));
+    Assert.assertNull(dedup.lookup(42, "c/lib.js", find(c, lib.replace("f(1)", "g(2)"))));
+    Assert.assertEquals(0, dedup.getDuplicateCount());
+    Assert.assertEquals(0, dedup.getBytesSaved());
+  }
+
+  private void recordUnused(EntityDeduplicator dedup, SharedSourceBuffer a) {
+    CAstNode call = Ast.makeNode(CAstNode.CALL, Ast.makeNode(CAstNode.VAR, Ast.makeConstant("f")), Ast.makeConstant(1));
+    dedup.record(42, script(a, call));
+  }
+
+  @Test
+  public void testCanonicalEntitiesAreNotKept() throws Exception {
+    EntityDeduplicator dedup = new EntityDeduplicator();
+    recordUnused(dedup, buffer("file:/a/lib.js", lib));
+    for (int i = 0; i < 100 && dedup.getCanonicalCount() > 0; i++) {
+      System.gc();
+      Thread.sleep(10);
+    }
+    Assert.assertEquals(0, dedup.getCanonicalCount());
+  }
+}
@@ -0,0 +1,184 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.test;
+
+import java.util.Collection;
+import java.util.List;
+import java.util.Random;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.impl.CAstImpl;
+import com.ibm.wala.cast.util.CAstFlatTree;
+import com.ibm.wala.cast.util.CAstPattern;
+import com.ibm.wala.cast.util.CAstPattern.Segments;
+import com.ibm.wala.cast.util.NativeCAstPattern;
+import com.ibm.wala.cast.util.NativeLinkage;
+import com.ibm.wala.util.collections.HashSetFactory;
+
+/**
+ * checks the native pattern matcher against {@link CAstPattern#match} on a
+ * random tree; {@link #main} times both on the same pattern set
+ */
+public class TestNativeCAstPattern {
+
+  static {
+    System.loadLibrary("xlator_test");
+    NativeLinkage.libraryLoaded();
+  }
+
+  private static final String[] patterns = {
+    "<top>BINARY_EXPR(\"+\",<left>*,<right>*)",
+    "BINARY_EXPR(|(\"==\"||\"!=\")|,<v>VAR(*),CONSTANT())",
+    "<call>CALL(VAR(/exec|eval|system/),\"do\",<args>**)",
+    "BLOCK_STMT(<stmts>@(ASSIGN(VAR(*),*))@,**)",
+    "IF_STMT(*,<then>*,?(<else>*)?)",
+    "|({leaf}|(<const>CONSTANT()||VAR(<vars>*))|||{node}BINARY_EXPR(\"+\",`leaf`,|(`leaf`||`node`)|))|"
+  };
+
+  private static final String[] names = { "x", "y", "exec", "eval", "system", "print" };
+
+  private static final String[] operators = { "+", "-", "==", "!=" };
+
+  private final CAstImpl Ast = new CAstImpl();
+
+  private final Random random = new Random(1729);
+
+  private CAstNode expr(int depth) {
+    switch (depth <= 0 ? random.nextInt(2) : random.nextInt(4)) {
+    case 0:
+      return Ast.makeConstant(random.nextInt(10));
+    case 1:
+      return Ast.makeNode(CAstNode.VAR, Ast.makeConstant(names[random.nextInt(names.length)]));
+    case 2:
+      return Ast.makeNode(CAstNode.BINARY_EXPR, Ast.makeConstant(operators[random.nextInt(operators.length)]), expr(depth - 1),
+          expr(depth - 1));
+    default:
+      CAstNode[] args = new CAstNode[2 + random.nextInt(3)];
+      args[0] = Ast.makeNode(CAstNode.VAR, Ast.makeConstant(names[random.nextInt(names.length)]));
+      args[1] = Ast.makeConstant("do");
+      for (int i = 2; i < args.length; i++) {
+        args[i] = expr(depth - 1);
+      }
+      return Ast.makeNode(CAstNode.CALL, args);
+    }
+  }
+
+  private CAstNode stmt(int depth) {
+    switch (depth <= 0 ? 0 : random.nextInt(3)) {
+    case 0:
+      return Ast.makeNode(CAstNode.ASSIGN, Ast.makeNode(CAstNode.VAR, Ast.makeConstant(names[random.nextInt(names.length)])),
+          expr(3));
+    case 1:
+      return random.nextBoolean() ? Ast.makeNode(CAstNode.IF_STMT, expr(2), stmt(depth - 1)) : Ast.makeNode(CAstNode.IF_STMT,
+          expr(2), stmt(depth - 1), stmt(depth - 1));
+    default:
+      CAstNode[] stmts = new CAstNode[1 + random.nextInt(6)];
+      for (int i = 0; i < stmts.length; i++) {
+        stmts[i] = stmt(depth - 1);
+      }
+      return Ast.makeNode(CAstNode.BLOCK_STMT, stmts);
+    }
+  }
+
+  private CAstNode tree(int size) {
+    CAstNode[] stmts = new CAstNode[size];
+    for (int i = 0; i < size; i++) {
+      stmts[i] = stmt(4);
+    }
+    return Ast.makeNode(CAstNode.BLOCK_STMT, stmts);
+  }
+
+  private static Collection<Segments> javaFindAll(CAstPattern p, CAstFlatTree t) {
+    Collection<Segments> result = HashSetFactory.make();
+    for (int i = 0; i < t.getRootCount(); i++) {
+      Segments s = CAstPattern.match(p, t.getNode(t.getRoot(i)));
+      if (s != null) {
+        result.add(s);
+      }
+    }
+    return result;
+  }
+
+  @Test
+  public void testNativeMatchesJava() {
+    Assert.assertTrue(NativeCAstPattern.isAvailable());
+
+    CAstFlatTree t = new CAstFlatTree(tree(200));
+    for (String pattern : patterns) {
+      CAstPattern p = CAstPattern.parse(pattern);
+      Collection<Segments> expected = javaFindAll(p, t);
+      Collection<Segments> actual = new NativeCAstPattern(p).findAll(t);
+      Assert.assertEquals(pattern, expected, actual);
+    }
+  }
+
+  @Test
+  public void testWideChildList() {
+    Assert.assertTrue(NativeCAstPattern.isAvailable());
+
+    CAstNode[] stmts = new CAstNode[200000];
+    for (int i = 0; i < stmts.length; i++) {
+      stmts[i] = Ast.makeConstant(i);
+    }
+    CAstFlatTree t = new CAstFlatTree(Ast.makeNode(CAstNode.BLOCK_STMT, stmts));
+
+    // a child list this wide is matched without a frame per child
+    NativeCAstPattern p = new NativeCAstPattern(CAstPattern.parse("BLOCK_STMT(<stmts>@(CONSTANT())@)"));
+    Collection<Segments> matches = p.findAll(t);
+    Assert.assertEquals(1, matches.size());
+    Assert.assertEquals(stmts.length, ((List<?>) matches.iterator().next().get("stmts")).size());
+
+    Collection<Segments> tails = new NativeCAstPattern(CAstPattern.parse("BLOCK_STMT(**,<last>\"199999\")")).findAll(t);
+    Assert.assertEquals(1, tails.size());
+    Assert.assertSame(stmts[stmts.length - 1], tails.iterator().next().getSingle("last"));
+
+    // the same flat tree serves any number of patterns, and growing it
+    // leaves earlier ids and matches as they were
+    t.add(Ast.makeNode(CAstNode.BLOCK_STMT, Ast.makeConstant(-1)));
+    Assert.assertEquals(matches, p.findAll(t));
+  }
+
+  /**
+   * times the native matcher against the Java one; not part of the suite
+   */
+  public static void main(String[] args) {
+    TestNativeCAstPattern test = new TestNativeCAstPattern();
+    CAstFlatTree t = new CAstFlatTree(test.tree(5000));
+    CAstPattern[] ps = new CAstPattern[patterns.length];
+    NativeCAstPattern[] nps = new NativeCAstPattern[patterns.length];
+    for (int i = 0; i < patterns.length; i++) {
+      ps[i] = CAstPattern.parse(patterns[i]);
+      nps[i] = new NativeCAstPattern(ps[i]);
+    }
+
+    int javaMatches = 0, nativeMatches = 0;
+    long javaTime = 0, nativeTime = 0;
+    for (int round = 0; round < 5; round++) {
+      long start = System.nanoTime();
+      for (CAstPattern p : ps) {
+        javaMatches += javaFindAll(p, t).size();
+      }
+      javaTime += System.nanoTime() - start;
+
+      start = System.nanoTime();
+      for (NativeCAstPattern p : nps) {
+        nativeMatches += p.findAll(t).size();
+      }
+      nativeTime += System.nanoTime() - start;
+    }
+
+    System.err.println(t.getNodeCount() + " nodes, " + patterns.length + " patterns: java " + javaTime / 1000000 + "ms, native "
+        + nativeTime / 1000000 + "ms, " + javaMatches + " and " + nativeMatches + " matches");
+  }
+}
@@ -0,0 +1,118 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.test;
+
+import java.util.ArrayList;
+import java.util.Iterator;
+import java.util.List;
+import java.util.Random;
+import java.util.Set;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import com.ibm.wala.cast.ir.ssa.NativeDominance;
+import com.ibm.wala.cast.util.NativeLinkage;
+import com.ibm.wala.util.collections.HashSetFactory;
+import com.ibm.wala.util.graph.NumberedGraph;
+import com.ibm.wala.util.graph.dominators.DominanceFrontiers;
+import com.ibm.wala.util.graph.impl.SlowSparseNumberedGraph;
+
+/**
+ * checks native dominance against {@link DominanceFrontiers} on a random
+ * graph with loops and unreachable nodes
+ */
+public class TestNativeDominance {
+
+  static {
+    System.loadLibrary("xlator_test");
+    NativeLinkage.libraryLoaded();
+  }
+
+  private final Random random = new Random(1729);
+
+  private NumberedGraph<Integer> graph(int size) {
+    NumberedGraph<Integer> G = SlowSparseNumberedGraph.make();
+    for (int i = 0; i < size; i++) {
+      G.addNode(i);
+    }
+    for (int i = 0; i + 1 < size; i++) {
+      if (random.nextInt(20) != 0) {
+        G.addEdge(i, i + 1);
+      }
+      if (random.nextInt(3) == 0) {
+        G.addEdge(i, random.nextInt(size));
+      }
+    }
+    return G;
+  }
+
+  private static <T> List<T> list(Iterator<T> ts) {
+    List<T> result = new ArrayList<>();
+    while (ts.hasNext()) {
+      result.add(ts.next());
+    }
+    return result;
+  }
+
+  private static <T> Set<T> set(Iterator<T> ts) {
+    return HashSetFactory.make(list(ts));
+  }
+
+  private static Set<Integer> iteratedFrontier(DominanceFrontiers<Integer> DF, int... defs) {
+    Set<Integer> result = HashSetFactory.make();
+    List<Integer> work = new ArrayList<>();
+    for (int def : defs) {
+      work.add(def);
+    }
+    while (!work.isEmpty()) {
+      for (Integer y : list(DF.getDominanceFrontier(work.remove(work.size() - 1)))) {
+        if (result.add(y)) {
+          work.add(y);
+        }
+      }
+    }
+    return result;
+  }
+
+  @Test
+  public void testMatchesJava() {
+    NumberedGraph<Integer> G = graph(600);
+    DominanceFrontiers<Integer> DF = new DominanceFrontiers<>(G, 0);
+    NativeDominance<Integer> nat = new NativeDominance<>(G, 0);
+
+    // the Java frontiers are only defined for reachable nodes
+    List<Integer> reachable = new ArrayList<>();
+    for (Integer n : G) {
+      if (n == 0 || nat.getIdom(n) != null) {
+        reachable.add(n);
+        Assert.assertEquals(set(DF.getDominanceFrontier(n)), set(nat.getDominanceFrontier(n)));
+        Assert.assertEquals(list(DF.dominatorTree().getSuccNodes(n)), list(nat.getDominatorTreeChildren(n)));
+      }
+    }
+
+    int a = reachable.get(reachable.size() / 3), b = reachable.get(reachable.size() / 2), c = reachable.get(reachable.size() - 1);
+    int[] defStart = { 0, 1, 3, 3 };
+    int[] defs = { a, b, c };
+    int[][] phis = nat.placePhis(defStart, defs);
+    Assert.assertEquals(iteratedFrontier(DF, a), HashSetFactory.make(list(phis[1], phis[0][0], phis[0][1])));
+    Assert.assertEquals(iteratedFrontier(DF, b, c), HashSetFactory.make(list(phis[1], phis[0][1], phis[0][2])));
+    Assert.assertEquals(phis[0][2], phis[0][3]);
+  }
+
+  private static List<Integer> list(int[] row, int from, int to) {
+    List<Integer> result = new ArrayList<>();
+    for (int i = from; i < to; i++) {
+      result.add(row[i]);
+    }
+    return result;
+  }
+}
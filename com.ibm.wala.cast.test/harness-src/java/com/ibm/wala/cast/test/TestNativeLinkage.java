@@ -0,0 +1,57 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.test;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import com.ibm.wala.cast.util.NativeLinkage;
+
+/**
+ * checks that {@link NativeLinkage} probes once per library load while the
+ * natives are missing, and never again once they are found
+ */
+public class TestNativeLinkage {
+
+  private int probes = 0;
+
+  private boolean loaded = false;
+
+  private boolean probe() {
+    probes++;
+    if (!loaded) {
+      throw new UnsatisfiedLinkError("probe");
+    }
+    return true;
+  }
+
+  @Test
+  public void testAnswersAreRemembered() {
+    NativeLinkage linkage = new NativeLinkage(this::probe);
+
+    Assert.assertFalse(linkage.isAvailable());
+    Assert.assertFalse(linkage.isAvailable());
+    Assert.assertEquals(1, probes);
+
+    // a load of some other library asks again, and is again remembered
+    NativeLinkage.libraryLoaded();
+    Assert.assertFalse(linkage.isAvailable());
+    Assert.assertFalse(linkage.isAvailable());
+    Assert.assertEquals(2, probes);
+
+    loaded = true;
+    NativeLinkage.libraryLoaded();
+    Assert.assertTrue(linkage.isAvailable());
+    NativeLinkage.libraryLoaded();
+    Assert.assertTrue(linkage.isAvailable());
+    Assert.assertEquals(3, probes);
+  }
+}
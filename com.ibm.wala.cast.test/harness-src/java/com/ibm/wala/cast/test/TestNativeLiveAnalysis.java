@@ -0,0 +1,89 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.test;
+
+import java.io.IOException;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import com.ibm.wala.cast.ir.ssa.analysis.LiveAnalysis;
+import com.ibm.wala.cast.ir.ssa.analysis.NativeLiveAnalysis;
+import com.ibm.wala.cast.util.NativeLinkage;
+import com.ibm.wala.classLoader.IClass;
+import com.ibm.wala.classLoader.IMethod;
+import com.ibm.wala.core.tests.util.WalaTestCase;
+import com.ibm.wala.ipa.callgraph.AnalysisCacheImpl;
+import com.ibm.wala.ipa.callgraph.impl.Everywhere;
+import com.ibm.wala.ipa.cha.ClassHierarchyException;
+import com.ibm.wala.ipa.cha.IClassHierarchy;
+import com.ibm.wala.ssa.IR;
+import com.ibm.wala.ssa.ISSABasicBlock;
+import com.ibm.wala.ssa.SSACFG;
+import com.ibm.wala.ssa.SSAOptions;
+import com.ibm.wala.types.ClassLoaderReference;
+import com.ibm.wala.types.TypeReference;
+import com.ibm.wala.util.intset.BitVector;
+
+/**
+ * checks the native liveness solver against the Java one on the methods of a
+ * library class
+ */
+public class TestNativeLiveAnalysis {
+
+  static {
+    System.loadLibrary("xlator_test");
+    NativeLinkage.libraryLoaded();
+  }
+
+  private static void check(IR ir, BitVector liveAtExit) {
+    SSACFG cfg = ir.getControlFlowGraph();
+    LiveAnalysis.Result java = LiveAnalysis.perform(cfg, ir.getSymbolTable(), liveAtExit);
+    LiveAnalysis.Result nat = NativeLiveAnalysis.perform(cfg, ir.getSymbolTable(), liveAtExit);
+
+    for (ISSABasicBlock bb : cfg) {
+      for (int v = 1; v <= ir.getSymbolTable().getMaxValueNumber(); v++) {
+        Assert.assertEquals(java.isLiveEntry(bb, v), nat.isLiveEntry(bb, v));
+        Assert.assertEquals(java.isLiveExit(bb, v), nat.isLiveExit(bb, v));
+      }
+    }
+    for (int i = 0; i < ir.getInstructions().length; i++) {
+      if (ir.getInstructions()[i] != null) {
+        Assert.assertEquals(java.getLiveBefore(i), nat.getLiveBefore(i));
+      }
+    }
+  }
+
+  @Test
+  public void testMatchesJava() throws ClassHierarchyException, IOException {
+    IClassHierarchy cha = WalaTestCase.makeCHA();
+    IClass klass = cha.lookupClass(TypeReference.findOrCreate(ClassLoaderReference.Primordial, "Ljava/util/HashMap"));
+    Assert.assertNotNull(klass);
+
+    AnalysisCacheImpl cache = new AnalysisCacheImpl();
+    int checked = 0;
+    for (IMethod m : klass.getDeclaredMethods()) {
+      if (m.isAbstract() || m.isNative()) {
+        continue;
+      }
+      IR ir = cache.getIRFactory().makeIR(m, Everywhere.EVERYWHERE, SSAOptions.defaultOptions());
+      // larger CFGs would take the native path in LiveAnalysis too
+      if (ir.getControlFlowGraph().getNumberOfNodes() < NativeLiveAnalysis.MIN_BLOCKS) {
+        BitVector exit = new BitVector();
+        check(ir, exit);
+        exit.set(1);
+        check(ir, exit);
+        checked++;
+      }
+    }
+    Assert.assertTrue(checked > 0);
+  }
+}
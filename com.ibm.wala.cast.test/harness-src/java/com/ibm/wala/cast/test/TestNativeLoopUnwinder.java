@@ -0,0 +1,160 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.test;
+
+import java.net.MalformedURLException;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.Deque;
+import java.util.IdentityHashMap;
+import java.util.List;
+import java.util.Map;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import com.ibm.wala.cast.tree.CAstControlFlowMap;
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.impl.CAstControlFlowRecorder;
+import com.ibm.wala.cast.tree.impl.CAstImpl;
+import com.ibm.wala.cast.tree.impl.CAstOperator;
+import com.ibm.wala.cast.tree.impl.CAstSourcePositionRecorder;
+import com.ibm.wala.cast.tree.rewrite.AstLoopUnwinder;
+import com.ibm.wala.cast.tree.rewrite.CAstRewriter.Rewrite;
+import com.ibm.wala.cast.tree.rewrite.NativeLoopUnwinder;
+import com.ibm.wala.cast.util.CAstPrinter;
+import com.ibm.wala.cast.util.NativeLinkage;
+
+/**
+ * checks the native loop unwinder against {@link AstLoopUnwinder} on nested
+ * loops with a break out of the inner one, and on a tree too deep to walk
+ * recursively
+ */
+public class TestNativeLoopUnwinder {
+
+  static {
+    System.loadLibrary("xlator_test");
+    NativeLinkage.libraryLoaded();
+  }
+
+  private final CAstImpl Ast = new CAstImpl();
+
+  private final CAstSourcePositionRecorder pos = new CAstSourcePositionRecorder();
+
+  private final CAstControlFlowRecorder cfg = new CAstControlFlowRecorder(pos);
+
+  private CAstNode var(String name) {
+    return Ast.makeNode(CAstNode.VAR, Ast.makeConstant(name));
+  }
+
+  private CAstNode sum;
+
+  private CAstNode tree() throws MalformedURLException {
+    CAstNode after = Ast.makeNode(CAstNode.EMPTY);
+    CAstNode brk = Ast.makeNode(CAstNode.GOTO);
+    cfg.map(brk, brk);
+    cfg.map(after, after);
+    cfg.add(brk, after, null);
+    pos.setPosition(brk, 3, "file:/loops.js", "file:/loops.js");
+
+    sum = Ast.makeNode(CAstNode.BINARY_EXPR, Ast.makeConstant("+"), var("x"), var("y"));
+    CAstNode inner = Ast.makeNode(CAstNode.LOOP, var("q"),
+        Ast.makeNode(CAstNode.BLOCK_STMT,
+            Ast.makeNode(CAstNode.ASSIGN, var("x"), sum),
+            Ast.makeNode(CAstNode.IF_STMT, var("r"), brk)));
+    CAstNode outer = Ast.makeNode(CAstNode.LOOP, var("p"),
+        Ast.makeNode(CAstNode.BLOCK_STMT, Ast.makeNode(CAstNode.ASSIGN, var("y"), Ast.makeConstant(1)),
+            Ast.makeNode(CAstNode.BLOCK_STMT, inner, after)));
+    return Ast.makeNode(CAstNode.BLOCK_STMT, outer, Ast.makeNode(CAstNode.RETURN, var("x")));
+  }
+
+  private static int edgeCount(CAstControlFlowMap map) {
+    int edges = 0;
+    for (CAstNode n : map.getMappedNodes()) {
+      edges += map.getTargetLabels(n).size();
+    }
+    return edges;
+  }
+
+  @Test
+  public void testMatchesJava() throws MalformedURLException {
+    CAstNode t = tree();
+
+    Rewrite java = new AstLoopUnwinder(Ast, false, 3).rewrite(t, cfg, pos, null, Collections.emptyMap());
+    Rewrite nat = new NativeLoopUnwinder(Ast, false, 3).rewrite(t, cfg, pos, null, Collections.emptyMap());
+
+    Assert.assertEquals(CAstPrinter.print(java.newRoot()), CAstPrinter.print(nat.newRoot()));
+    Assert.assertEquals(edgeCount(java.newCfg()), edgeCount(nat.newCfg()));
+
+    // every copy of the break keeps its position
+    for (CAstNode n : nat.newCfg().getMappedNodes()) {
+      if (n.getKind() == CAstNode.GOTO) {
+        Assert.assertEquals(3, nat.newPos().getPosition(n).getFirstLine());
+      }
+    }
+  }
+
+  /**
+   * the nodes of a tree of the given kind, once for each place they appear
+   */
+  private static List<CAstNode> occurrences(CAstNode root, int kind) {
+    List<CAstNode> found = new ArrayList<>();
+    Deque<CAstNode> stack = new ArrayDeque<>();
+    stack.push(root);
+    while (!stack.isEmpty()) {
+      CAstNode n = stack.pop();
+      if (n.getKind() == kind && !(n instanceof CAstOperator)) {
+        found.add(n);
+      }
+      for (int i = 0; i < n.getChildCount(); i++) {
+        stack.push(n.getChild(i));
+      }
+    }
+    return found;
+  }
+
+  @Test
+  public void testCopiesEachIteration() throws MalformedURLException {
+    CAstNode t = tree();
+    pos.setPosition(sum, 5, "file:/loops.js", "file:/loops.js");
+
+    Rewrite java = new AstLoopUnwinder(Ast, false, 3).rewrite(t, cfg, pos, null, Collections.emptyMap());
+    Rewrite nat = new NativeLoopUnwinder(Ast, false, 3).rewrite(t, cfg, pos, null, Collections.emptyMap());
+
+    // the sum in the inner loop is neither pinned nor holds a loop, yet each
+    // iteration has its own copy, which has the position of the original
+    List<CAstNode> sums = occurrences(nat.newRoot(), CAstNode.BINARY_EXPR);
+    Assert.assertEquals(occurrences(java.newRoot(), CAstNode.BINARY_EXPR).size(), sums.size());
+    Map<CAstNode, CAstNode> distinct = new IdentityHashMap<>();
+    for (CAstNode n : sums) {
+      Assert.assertNotSame(sum, n);
+      Assert.assertNull("shared between iterations", distinct.put(n, n));
+      Assert.assertEquals(5, nat.newPos().getPosition(n).getFirstLine());
+    }
+  }
+
+  @Test
+  public void testDeepTree() {
+    CAstNode t = Ast.makeNode(CAstNode.LOOP, var("p"), var("x"));
+    int depth = 100000;
+    for (int i = 0; i < depth; i++) {
+      t = Ast.makeNode(CAstNode.BLOCK_STMT, t);
+    }
+
+    CAstNode n = new NativeLoopUnwinder(Ast, false, 2).rewrite(t, null, null, null, Collections.emptyMap()).newRoot();
+    for (int i = 0; i < depth; i++) {
+      Assert.assertEquals(CAstNode.BLOCK_STMT, n.getKind());
+      n = n.getChild(0);
+    }
+    Assert.assertEquals(CAstNode.IF_STMT, n.getKind());
+  }
+}
@@ -1,14 +1,39 @@
 package com.ibm.wala.cast.test;
 
+import java.io.File;
 import java.io.IOException;
+import java.lang.ref.WeakReference;
+import java.nio.ByteBuffer;
+import java.nio.charset.CharacterCodingException;
+import java.nio.charset.CodingErrorAction;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.nio.file.Paths;
 import java.net.URL;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.Arrays;
 import java.util.Collection;
 import java.util.Collections;
+import java.util.Deque;
 import java.util.Iterator;
+import java.util.List;
 import java.util.Map;
+import java.util.Objects;
+import java.util.Random;
+import java.util.Set;
+import java.util.concurrent.CompletableFuture;
+import java.util.concurrent.ExecutionException;
 
 import org.junit.Test;
 
+import com.ibm.wala.cast.ir.translator.AbstractCodeEntity;
+import com.ibm.wala.cast.ir.translator.AbstractScriptEntity;
+import com.ibm.wala.cast.ir.translator.CallSiteTable;
+import com.ibm.wala.cast.ir.translator.EntityFingerprintCache;
+import com.ibm.wala.cast.ir.translator.EntitySizeSummary;
+import com.ibm.wala.cast.ir.translator.ExposedNamesCollector;
 import com.ibm.wala.cast.ir.translator.NativeTranslatorToCAst;
 import com.ibm.wala.cast.tree.CAst;
 import com.ibm.wala.cast.tree.CAstAnnotation;
@@ -19,11 +44,19 @@ import com.ibm.wala.cast.tree.CAstNodeTypeMap;
 import com.ibm.wala.cast.tree.CAstQualifier;
 import com.ibm.wala.cast.tree.CAstSourcePositionMap;
 import com.ibm.wala.cast.tree.CAstSourcePositionMap.Position;
+import com.ibm.wala.cast.tree.CAstSymbol;
 import com.ibm.wala.cast.tree.CAstType;
 import com.ibm.wala.cast.tree.impl.CAstImpl;
+import com.ibm.wala.cast.tree.impl.CAstOperator;
+import com.ibm.wala.cast.tree.impl.CAstSymbolImpl;
+import com.ibm.wala.cast.tree.rewrite.CAstCloner;
 import com.ibm.wala.cast.tree.rewrite.CAstRewriter.CopyKey;
 import com.ibm.wala.cast.tree.rewrite.CAstRewriter.RewriteContext;
 import com.ibm.wala.cast.tree.rewrite.CAstRewriterFactory;
+import com.ibm.wala.cast.tree.visit.CAstVisitor;
+import com.ibm.wala.cast.util.NativeLinkage;
+import com.ibm.wala.cast.util.SharedSourceBuffer;
+import com.ibm.wala.cast.util.SourceBuffer;
 import com.ibm.wala.ssa.IR;
 import com.ibm.wala.util.io.TemporaryFile;
 
@@ -31,16 +64,90 @@ public class TestNativeTranslator {
   
   static {
     System.loadLibrary("xlator_test");
+    NativeLinkage.libraryLoaded();
   }
 
   private static native CAstNode inventAst(SmokeXlator ast);
 
+  private static native CAstNode inventAstPipelined(SmokeXlator ast, int n);
+
+  private static native void inventBrokenPipeline(SmokeXlator ast, int n);
+
+  private static native int finishedProducers();
+
+  private static native long fingerprintConstant(SmokeXlator ast, Object value, int line);
+
+  private static native long fingerprintTree(SmokeXlator ast, boolean swapped);
+
+  private static native long fingerprintArrayTree(SmokeXlator ast, boolean swapped);
+
+  private static native CAstEntity cachedEntity(SmokeXlator ast, String key, int line, CAstEntity fresh);
+
+  private static native CAstNode streamEntities(SmokeXlator ast, AbstractCodeEntity outer, AbstractCodeEntity[] entities);
+
+  private static native void foldConstants(SmokeXlator ast, AbstractCodeEntity entity, AbstractCodeEntity child);
+
+  private static native void foldEntities(SmokeXlator ast, AbstractCodeEntity clean, AbstractCodeEntity folded, AbstractCodeEntity after);
+
+  private static native int arenaScopes(SmokeXlator ast, int n);
+
+  private static native String readSource(String file);
+
+  private static native void exportAst(SmokeXlator ast, String file, int format, int copies);
+
+  private static native void typeNodes(SmokeXlator ast, AbstractCodeEntity entity, AbstractCodeEntity child, CAstType[] types,
+      int n);
+
+  private static native CAstEntity holdReferences(SmokeXlator ast, Object qualifier, CAstNode arg, boolean fail);
+
+  private static native void analyzeScopes(SmokeXlator ast, int[] events, String[] names, AbstractCodeEntity[] entities);
+
+  private static native void profileSections(SmokeXlator ast, String report, int n, boolean fail);
+
+  private static native String[] roundTripStrings(SmokeXlator ast, CAstNode[] constants, CAstEntity entity);
+
+  private static native String decodeUtf8(byte[] bytes);
+
+  private static native CAstNode inventLargeAst(SmokeXlator ast, int depth);
+
+  private static native void deferInventedBody(SmokeXlator ast, AbstractCodeEntity entity, String file, int begin, int end);
+
+  private static native int builtBodies();
+
+  private static native String[] inventStrings(SmokeXlator ast);
+
+  private static native void inventCallSites(SmokeXlator ast, AbstractCodeEntity outer, AbstractCodeEntity inner);
+
+  private static native void foldCallSites(SmokeXlator ast, AbstractCodeEntity entity);
+
+  private static native void inventSizes(SmokeXlator ast, AbstractCodeEntity entity);
+
+  private static native void foldSizes(SmokeXlator ast, AbstractCodeEntity entity);
+
   private static class SmokeXlator extends NativeTranslatorToCAst {
 
     private SmokeXlator(CAst Ast, URL sourceURL) throws IOException {
       super(Ast, sourceURL, TemporaryFile.urlToFile("temp", sourceURL).getAbsolutePath());
     }
 
+    private boolean failNodeTypes = false;
+
+    private String file() {
+      return getLocalFile();
+    }
+
+    @Override
+    protected void setNodeTypes(AbstractCodeEntity entity, CAstNode[] nodes, int[] typeIds, int count) {
+      if (failNodeTypes) {
+        throw new IllegalStateException("no types today");
+      }
+      super.setNodeTypes(entity, nodes, typeIds, count);
+    }
+
+    private Position position(int fl, int fc, int ll, int lc) {
+      return makeLocation(fl, fc, ll, lc);
+    }
+
     @Override
     public <C extends RewriteContext<K>, K extends CopyKey<K>> void addRewriter(CAstRewriterFactory<C, K> factory,
         boolean prepend) {
@@ -145,14 +252,21 @@ public class TestNativeTranslator {
       };
     }
   }
-    
+
+  /**
+   * a translator of the primordial file, which the smoke tests use only for
+   * its name and its text
+   */
+  private static SmokeXlator smokeXlator(CAst Ast) throws IOException {
+    URL junk = IR.class.getClassLoader().getResource("primordial.txt");
+    return new SmokeXlator(Ast, junk);
+  }
+
   @Test
   public void testNativeCAst() throws IOException {
     CAst Ast = new CAstImpl();
     
-    URL junk = IR.class.getClassLoader().getResource("primordial.txt");
-     
-    SmokeXlator xlator = new SmokeXlator(Ast, junk);
+    SmokeXlator xlator = smokeXlator(Ast);
     
     CAstNode ast = xlator.translateToCAst().getAST();    
   
@@ -160,4 +274,1042 @@ public class TestNativeTranslator {
     
     assert ast.getChildCount() == 3;
   }
+
+  @Test
+  public void testPipelinedNativeCAst() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    
+    // enough nodes that each producer has to hand over several batches
+    CAstNode ast = inventAstPipelined(xlator, 5000);
+  
+    assert ast.getKind() == CAstNode.BINARY_EXPR;
+    assert ast.getChildCount() == 3;
+    
+    int depth = 0;
+    for (CAstNode n = ast.getChild(1); n.getKind() == CAstNode.BINARY_EXPR; n = n.getChild(1)) {
+      depth++;
+    }
+    assert depth == 5000;
+  }
+
+  @Test
+  public void testPipelineFailure() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+
+    int finished = finishedProducers();
+    try {
+      // enough nodes that the busy producer fills its queue, and would wait
+      // forever for the consumer that gave up, were it not stopped
+      inventBrokenPipeline(xlator, 1000000);
+      assert false;
+    } catch (RuntimeException e) {
+      // expected: the handle made up by the other producer
+    }
+
+    // both producer threads were joined before the exception got here
+    assert finishedProducers() == finished + 2;
+
+    assert inventAstPipelined(xlator, 10).getKind() == CAstNode.BINARY_EXPR;
+  }
+
+  @Test
+  public void testAsyncNativeCAst() throws Exception {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    
+    CAstEntity entity = xlator.translateToCAstAsync(null).get();
+  
+    assert entity.getAST().getChildCount() == 3;
+  }
+
+  private static class BrokenXlator extends SmokeXlator {
+
+    private BrokenXlator(CAst Ast, URL sourceURL) throws IOException {
+      super(Ast, sourceURL);
+    }
+
+    @Override
+    public CAstEntity translateToCAst() {
+      throw new IllegalStateException("broken front end");
+    }
+  }
+
+  @Test
+  public void testAsyncFailure() throws Exception {
+    CAst Ast = new CAstImpl();
+    
+    URL junk = IR.class.getClassLoader().getResource("primordial.txt");
+     
+    BrokenXlator xlator = new BrokenXlator(Ast, junk);
+
+    // a failed translation completes its future, and does not block the next
+    for (int i = 0; i < 2; i++) {
+      CompletableFuture<CAstEntity> result = xlator.translateToCAstAsync(null);
+      try {
+        result.get();
+        assert false;
+      } catch (ExecutionException e) {
+        assert e.getCause() instanceof IllegalStateException;
+      }
+    }
+  }
+
+  @Test
+  public void testFingerprints() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+
+    // object constants are fingerprinted by value, and positions count
+    long fp = fingerprintConstant(xlator, "abc", 1);
+    assert fp == fingerprintConstant(xlator, new String("abc"), 1);
+    assert fp != fingerprintConstant(xlator, "abd", 1);
+    assert fp != fingerprintConstant(xlator, "abc", 2);
+    assert fingerprintConstant(xlator, 1, 1) != fingerprintConstant(xlator, 1L, 1);
+
+    xlator.setEntityCache(new EntityFingerprintCache());
+    CAstEntity first = xlator.translateToCAst();
+    assert cachedEntity(xlator, "f", 1, first) == first;
+    assert cachedEntity(xlator, "f", 1, xlator.translateToCAst()) == first;
+
+    // the same code moved to another line is built again
+    CAstEntity moved = xlator.translateToCAst();
+    assert cachedEntity(xlator, "f", 2, moved) == moved;
+    assert cachedEntity(xlator, "f", 2, xlator.translateToCAst()) == moved;
+    assert xlator.getEntityCache().getHits() == 2;
+  }
+
+  @Test
+  public void testPermutedTreeFingerprints() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+
+    // children are fingerprinted in order, whether passed directly or
+    // in an array, even when the nodes are built in the same order
+    assert fingerprintTree(xlator, false) == fingerprintTree(xlator, false);
+    assert fingerprintTree(xlator, false) != fingerprintTree(xlator, true);
+    assert fingerprintArrayTree(xlator, false) == fingerprintArrayTree(xlator, false);
+    assert fingerprintArrayTree(xlator, false) != fingerprintArrayTree(xlator, true);
+  }
+
+  @Test
+  public void testStreamedEntities() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    List<CAstEntity> streamed = new ArrayList<>();
+    xlator.setEntityStream(streamed::add);
+
+    AbstractScriptEntity outer = new AbstractScriptEntity(xlator.file(), null);
+    AbstractCodeEntity[] entities = new AbstractCodeEntity[50];
+    for (int i = 0; i < entities.length; i++) {
+      entities[i] = new AbstractScriptEntity(xlator.file(), null);
+    }
+
+    CAstNode sum = streamEntities(xlator, outer, entities);
+    assert streamed.equals(Arrays.asList(entities));
+
+    // calls recorded in popped frames are still there
+    CallSiteTable calls = outer.getCallSites();
+    assert calls.size() == entities.length;
+    for (int i = 0; i < entities.length; i++) {
+      assert calls.getCall(i) == entities[i].getAST().getChild(0);
+    }
+
+    // and constants of popped frames are not mistaken for later nodes
+    assert sum.getKind() == CAstNode.BINARY_EXPR;
+    assert sum.getChild(1).getKind() == CAstNode.VAR;
+  }
+
+  @Test
+  public void testFolding() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    AbstractScriptEntity entity = new AbstractScriptEntity(xlator.file(), null);
+    AbstractScriptEntity child = new AbstractScriptEntity(xlator.file(), null);
+    foldConstants(xlator, entity, child);
+
+    CAstNode block = entity.getAST();
+    assert block.getChild(0).getKind() == CAstNode.CONSTANT;
+    assert Integer.valueOf(3).equals(block.getChild(0).getValue());
+    assert block.getChild(1).getKind() == CAstNode.RETURN;
+    assert block.getChild(2).getKind() == CAstNode.BINARY_EXPR;
+
+    // nothing of the pruned branch is left in the side tables
+    assert entity.getControlFlow().getMappedNodes().isEmpty();
+    assert entity.getAllScopedEntities().isEmpty();
+    Iterator<CAstNode> positioned = entity.getSourceMap().getMappedNodes();
+    assert positioned.next() == block.getChild(1);
+    assert !positioned.hasNext();
+  }
+
+  private static class FoldCountingEntity extends AbstractScriptEntity {
+    private int folds;
+
+    FoldCountingEntity(String file) {
+      super(file, null);
+    }
+
+    @Override
+    public synchronized void astFolded() {
+      folds++;
+      super.astFolded();
+    }
+  }
+
+  @Test
+  public void testFoldingPerEntity() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    FoldCountingEntity clean = new FoldCountingEntity(xlator.file());
+    FoldCountingEntity folded = new FoldCountingEntity(xlator.file());
+    FoldCountingEntity after = new FoldCountingEntity(xlator.file());
+    foldEntities(xlator, clean, folded, after);
+
+    // only the entity that lost a node some side table mentions is pruned
+    assert clean.folds == 0;
+    assert folded.folds == 1;
+    assert after.folds == 0;
+
+    CAstNode block = clean.getAST();
+    assert Integer.valueOf(1 << 40).equals(block.getChild(0).getValue());
+    assert block.getChild(1).getKind() == CAstNode.RETURN;
+    assert folded.getAST().getKind() == CAstNode.EMPTY;
+    assert !folded.getSourceMap().getMappedNodes().hasNext();
+  }
+
+  @Test
+  public void testArenaScopes() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+
+    assert arenaScopes(xlator, 100000) == 100000 * 99999 / 2;
+  }
+
+  @Test
+  public void testSourceBuffer() throws IOException {
+    CAst Ast = new CAstImpl();
+
+    Path source = Files.createTempFile("source", ".txt");
+    try {
+      Files.write(source, "a\r\ncaf\u00e9 x\r\nend\r\n".getBytes(StandardCharsets.UTF_8));
+      SmokeXlator xlator = new SmokeXlator(Ast, source.toUri().toURL());
+
+      // columns are bytes, but offsets of positions are chars, and lines lose their \r
+      Position x = xlator.position(2, 6, 3, -1);
+      assert x instanceof SharedSourceBuffer.SharedPosition;
+      assert ((SharedSourceBuffer.SharedPosition) x).getFirstByteOffset() == 9;
+      assert x.getFirstOffset() == 8;
+      assert x.getLastOffset() == 16;
+      assert "x\nend\n".equals(new SourceBuffer(x).toString());
+
+      // a file rewritten within the same second, at the same size, is read afresh
+      File file = new File(xlator.file());
+      Files.write(file.toPath(), "first".getBytes(StandardCharsets.UTF_8));
+      long second = (System.currentTimeMillis() / 1000 - 10) * 1000;
+      assert file.setLastModified(second);
+      assert "first".equals(readSource(xlator.file()));
+      Files.write(file.toPath(), "again".getBytes(StandardCharsets.UTF_8));
+      assert file.setLastModified(second + 500);
+      assert "again".equals(readSource(xlator.file()));
+
+      // and one cut short is read as far as it goes
+      Files.write(file.toPath(), new byte[0]);
+      assert "".equals(readSource(xlator.file()));
+    } finally {
+      Files.delete(source);
+    }
+  }
+
+  private static String exported(SmokeXlator xlator, int format, int copies) throws IOException {
+    Path file = Files.createTempFile("export", ".txt");
+    try {
+      exportAst(xlator, file.toString(), format, copies);
+      return new String(Files.readAllBytes(file), StandardCharsets.UTF_8);
+    } finally {
+      Files.delete(file);
+    }
+  }
+
+  @Test
+  public void testExporter() throws IOException {
+    CAst Ast = new CAstImpl();
+
+    SmokeXlator xlator = smokeXlator(Ast);
+
+    // the formats of CAstExporter.h, in order
+    String text = "BLOCK\n  \"1\"\n  RETURN\n    VAR\n      \"x\u0000\uD83D\uDE00\"\n";
+    assert text.equals(exported(xlator, 0, 1));
+
+    String json = "{\"kind\":\"BLOCK\",\"children\":[{\"value\":\"1\"},"
+        + "{\"kind\":\"RETURN\",\"children\":[{\"kind\":\"VAR\",\"children\":[{\"value\":\"x\\u0000\uD83D\uDE00\"}]}]}]}\n";
+    assert json.equals(exported(xlator, 1, 1));
+
+    String dot = exported(xlator, 2, 1);
+    assert dot.startsWith("digraph CAst {\n");
+    assert dot.contains("  n0 [label=\"BLOCK\"];\n");
+    assert dot.contains("  n0 -> n1;\n");
+    assert dot.endsWith("}\n");
+
+    // an exporter writes one tree after another the same way
+    assert (json + json).equals(exported(xlator, 1, 2));
+    assert (dot + dot).equals(exported(xlator, 2, 2));
+  }
+
+  private static CAstType type(final String name) {
+    return new CAstType() {
+      @Override
+      public String getName() {
+        return name;
+      }
+
+      @Override
+      public Collection<CAstType> getSupertypes() {
+        return Collections.emptySet();
+      }
+    };
+  }
+
+  @Test
+  public void testBufferedSideTables() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    CAstType[] types = { type("int"), type("string"), type("object") };
+
+    // more than a batch of each, the last ones passed on by the destructor
+    AbstractScriptEntity entity = new AbstractScriptEntity(xlator.file(), null);
+    AbstractScriptEntity child = new AbstractScriptEntity(xlator.file(), null);
+    typeNodes(xlator, entity, child, types, 1000);
+    CAstNode block = entity.getAST();
+    assert block.getChildCount() == 1000;
+    for (int i = 0; i < block.getChildCount(); i++) {
+      CAstNode n = block.getChild(i);
+      assert entity.getNodeTypeMap().getNodeType(n) == types[i % types.length];
+      Iterator<CAstEntity> scoped = entity.getScopedEntities(n);
+      assert scoped.hasNext() == (i % 7 == 0);
+      assert !scoped.hasNext() || scoped.next() == child;
+    }
+
+    // a failure of the destructor's last batch reaches Java as an exception
+    // rather than a jump out of the destructor, and the next wrapper works
+    xlator.failNodeTypes = true;
+    AbstractScriptEntity failed = new AbstractScriptEntity(xlator.file(), null);
+    try {
+      typeNodes(xlator, failed, child, types, 10);
+      assert false;
+    } catch (IllegalStateException e) {
+      // expected
+    }
+    xlator.failNodeTypes = false;
+    AbstractScriptEntity again = new AbstractScriptEntity(xlator.file(), null);
+    typeNodes(xlator, again, child, types, 10);
+    assert again.getNodeTypeMap().getNodeType(again.getAST().getChild(4)) == types[1];
+  }
+
+  /**
+   * what a wrapper that THROWs, or not, leaves reachable of the objects it
+   * held through global references
+   */
+  private static List<WeakReference<Object>> heldReferences(SmokeXlator xlator, CAst Ast, boolean fail) {
+    Object qualifier = new Object();
+    CAstNode arg = Ast.makeConstant("held");
+    try {
+      CAstEntity global = holdReferences(xlator, qualifier, arg, fail);
+      assert !fail;
+      assert global.getQualifiers().size() == 1;
+    } catch (RuntimeException e) {
+      assert fail;
+    }
+    return Arrays.<WeakReference<Object>> asList(new WeakReference<Object>(qualifier), new WeakReference<Object>(arg));
+  }
+
+  @Test
+  public void testReferencesReleased() throws Exception {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+
+    for (boolean fail : new boolean[] { false, true }) {
+      List<WeakReference<Object>> held = heldReferences(xlator, Ast, fail);
+      for (int i = 0; i < 100 && (held.get(0).get() != null || held.get(1).get() != null); i++) {
+        System.gc();
+        Thread.sleep(10);
+      }
+      assert held.get(0).get() == null : "qualifier set kept, fail=" + fail;
+      assert held.get(1).get() == null : "call kept, fail=" + fail;
+    }
+  }
+
+  private static class Function extends AbstractScriptEntity {
+    private final String name;
+
+    private final String[] arguments;
+
+    private Function(String file, String name, String... arguments) {
+      super(file, null);
+      this.name = name;
+      this.arguments = arguments;
+    }
+
+    @Override
+    public int getKind() {
+      return CAstEntity.FUNCTION_ENTITY;
+    }
+
+    @Override
+    public String getName() {
+      return name;
+    }
+
+    @Override
+    public String[] getArgumentNames() {
+      return arguments;
+    }
+
+    @Override
+    public int getArgumentCount() {
+      return arguments.length;
+    }
+  }
+
+  private static class ScopeContext implements CAstVisitor.Context {
+    private final CAstEntity top;
+
+    private ScopeContext(CAstEntity top) {
+      this.top = top;
+    }
+
+    @Override
+    public CAstEntity top() {
+      return top;
+    }
+
+    @Override
+    public CAstSourcePositionMap getSourceMap() {
+      return top.getSourceMap();
+    }
+  }
+
+  /**
+   * reports the declarations and uses of an entity tree in the order in
+   * which a front end using CAstScopeAnalysis has to, which is that of
+   * ExposedNamesCollector
+   */
+  private static class ScopeEvents extends CAstVisitor<ScopeContext> {
+    private final List<Integer> events = new ArrayList<>();
+
+    private final List<String> names = new ArrayList<>();
+
+    private final List<AbstractCodeEntity> entities = new ArrayList<>();
+
+    private void event(int op, String name) {
+      if (!names.contains(name)) {
+        names.add(name);
+      }
+      events.add(op);
+      events.add(names.indexOf(name));
+    }
+
+    private void end(CAstEntity n) {
+      events.add(4);
+      events.add(entities.size());
+      entities.add((AbstractCodeEntity) n);
+    }
+
+    private void replay(SmokeXlator xlator) {
+      int[] es = new int[events.size()];
+      for (int i = 0; i < es.length; i++) {
+        es[i] = events.get(i);
+      }
+      analyzeScopes(xlator, es, names.toArray(new String[names.size()]), entities.toArray(new AbstractCodeEntity[entities.size()]));
+    }
+
+    @Override
+    protected ScopeContext makeCodeContext(ScopeContext context, CAstEntity n) {
+      events.add(0);
+      events.add(0);
+      if (n.getKind() == CAstEntity.FUNCTION_ENTITY) {
+        for (String arg : n.getArgumentNames()) {
+          event(1, arg);
+        }
+      }
+      return new ScopeContext(n);
+    }
+
+    @Override
+    protected void leaveFunctionEntity(CAstEntity n, ScopeContext context, ScopeContext codeContext, CAstVisitor<ScopeContext> visitor) {
+      end(n);
+    }
+
+    @Override
+    protected void leaveScriptEntity(CAstEntity n, ScopeContext context, ScopeContext codeContext, CAstVisitor<ScopeContext> visitor) {
+      end(n);
+    }
+
+    @Override
+    protected void leaveDeclStmt(CAstNode n, ScopeContext c, CAstVisitor<ScopeContext> visitor) {
+      event(1, ((CAstSymbol) n.getChild(0).getValue()).name());
+    }
+
+    @Override
+    protected void leaveFunctionStmt(CAstNode n, ScopeContext c, CAstVisitor<ScopeContext> visitor) {
+      event(1, ((CAstEntity) n.getChild(0).getValue()).getName());
+    }
+
+    @Override
+    protected void leaveVar(CAstNode n, ScopeContext c, CAstVisitor<ScopeContext> visitor) {
+      event(2, (String) n.getChild(0).getValue());
+    }
+
+    @Override
+    protected void leaveVarAssign(CAstNode n, CAstNode v, CAstNode a, ScopeContext c, CAstVisitor<ScopeContext> visitor) {
+      event(3, (String) n.getChild(0).getValue());
+    }
+
+    @Override
+    protected boolean doVisit(CAstNode n, ScopeContext context, CAstVisitor<ScopeContext> visitor) {
+      return true;
+    }
+  }
+
+  private static final String[] scopeNames = { "a", "b", "c", "d", "e" };
+
+  /**
+   * a random body for entity, of declarations, reads and writes of a few
+   * names, and functions declared by statements or nested as expressions
+   */
+  private static void inventScopes(CAst Ast, AbstractCodeEntity entity, String file, Random random, int depth) {
+    CAstNode[] stmts = new CAstNode[1 + random.nextInt(8)];
+    for (int i = 0; i < stmts.length; i++) {
+      String name = scopeNames[random.nextInt(scopeNames.length)];
+      switch (random.nextInt(depth > 0 ? 6 : 4)) {
+      case 0:
+        stmts[i] = Ast.makeNode(CAstNode.DECL_STMT, Ast.makeConstant(new CAstSymbolImpl(name, CAstType.DYNAMIC)),
+            Ast.makeNode(CAstNode.VAR, Ast.makeConstant(scopeNames[random.nextInt(scopeNames.length)])));
+        break;
+      case 1:
+        stmts[i] = Ast.makeNode(CAstNode.VAR, Ast.makeConstant(name));
+        break;
+      case 2:
+      case 3:
+        stmts[i] = Ast.makeNode(CAstNode.ASSIGN, Ast.makeNode(CAstNode.VAR, Ast.makeConstant(name)), Ast.makeConstant(i));
+        break;
+      case 4: {
+        Function f = new Function(file, name, scopeNames[random.nextInt(scopeNames.length)]);
+        inventScopes(Ast, f, file, random, depth - 1);
+        stmts[i] = Ast.makeNode(CAstNode.FUNCTION_STMT, Ast.makeConstant(f));
+        entity.addScopedEntity(stmts[i], f);
+        break;
+      }
+      default: {
+        Function f = new Function(file, "fn" + depth + "_" + i);
+        inventScopes(Ast, f, file, random, depth - 1);
+        stmts[i] = Ast.makeNode(CAstNode.EMPTY);
+        entity.addScopedEntity(null, f);
+      }
+      }
+    }
+    entity.setAst(Ast.makeNode(CAstNode.BLOCK_STMT, stmts));
+  }
+
+  private static Map<CAstEntity, Set<String>> exposedNames(CAstEntity root) {
+    ExposedNamesCollector c = new ExposedNamesCollector();
+    c.run(root);
+    return c.getEntity2ExposedNames();
+  }
+
+  @Test
+  public void testScopeAnalysis() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+
+    // a function that reads a name declared only after the statement that
+    // declares the function does not expose it
+    AbstractScriptEntity script = new AbstractScriptEntity(xlator.file(), null);
+    Function f = new Function(xlator.file(), "f");
+    f.setAst(Ast.makeNode(CAstNode.VAR, Ast.makeConstant("x")));
+    CAstNode fs = Ast.makeNode(CAstNode.FUNCTION_STMT, Ast.makeConstant(f));
+    script.addScopedEntity(fs, f);
+    script.setAst(Ast.makeNode(CAstNode.BLOCK_STMT, fs,
+        Ast.makeNode(CAstNode.DECL_STMT, Ast.makeConstant(new CAstSymbolImpl("x", CAstType.DYNAMIC)), Ast.makeConstant(1))));
+    ScopeEvents events = new ScopeEvents();
+    events.visitEntities(script, new ScopeContext(script), events);
+    events.replay(xlator);
+    assert script.hasExposedNames() && f.hasExposedNames();
+    assert script.getExposedReads().isEmpty();
+    assert exposedNames(script).isEmpty();
+
+    // on random trees, the names worked out natively are those found by
+    // walking the trees
+    Random random = new Random(1729);
+    for (int i = 0; i < 200; i++) {
+      AbstractScriptEntity root = new AbstractScriptEntity(xlator.file(), null);
+      inventScopes(Ast, root, xlator.file(), random, 3);
+      Map<CAstEntity, Set<String>> walked = exposedNames(root);
+      events = new ScopeEvents();
+      events.visitEntities(root, new ScopeContext(root), events);
+      events.replay(xlator);
+      assert root.hasExposedNames();
+      assert walked.equals(exposedNames(root)) : walked + " vs " + exposedNames(root);
+    }
+
+    // a child whose body is still deferred has not been analyzed, so its
+    // parent's names are found by walking
+    AbstractScriptEntity outer = new AbstractScriptEntity(xlator.file(), null);
+    final Function lazy = new Function(xlator.file(), "lazy");
+    outer.addScopedEntity(null, lazy);
+    outer.setAst(Ast.makeNode(CAstNode.DECL_STMT, Ast.makeConstant(new CAstSymbolImpl("y", CAstType.DYNAMIC)), Ast.makeConstant(1)));
+    events = new ScopeEvents();
+    events.visitEntities(outer, new ScopeContext(outer), events);
+    events.replay(xlator);
+    final CAstNode body = Ast.makeNode(CAstNode.VAR, Ast.makeConstant("y"));
+    lazy.deferBody(new Runnable() {
+      @Override
+      public void run() {
+        lazy.setAst(body);
+      }
+    });
+    assert exposedNames(outer).get(outer).equals(Collections.singleton("y"));
+  }
+
+  /**
+   * the calls charged to a section of a file in a profiler report
+   */
+  private static long profiledCalls(List<String> report, String file, String section) {
+    boolean inFile = false;
+    for (String line : report) {
+      if (line.startsWith("CAst profile of ")) {
+        inFile = line.equals("CAst profile of " + file);
+      } else if (inFile && line.trim().startsWith(section + " ")) {
+        return Long.parseLong(line.trim().substring(section.length()).trim().split(" +")[0]);
+      }
+    }
+    return 0;
+  }
+
+  @Test
+  public void testProfilerAfterThrow() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    Path report = Files.createTempFile("profile", ".txt");
+    try {
+      // a THROW out of a section leaves it behind on the thread, and
+      // unless it is reset the next wrapper's calls are charged to nothing
+      try {
+        profileSections(xlator, report.toString(), 0, true);
+        assert false;
+      } catch (RuntimeException e) {
+        // expected
+      }
+      profileSections(xlator, report.toString(), 10, false);
+      List<String> lines = Files.readAllLines(report, StandardCharsets.UTF_8);
+      assert profiledCalls(lines, xlator.file(), "makeNode") == 10 : lines;
+      assert profiledCalls(lines, xlator.file(), "side tables") == 1 : lines;
+    } finally {
+      Files.delete(report);
+    }
+  }
+
+  @Test
+  public void testDeferredBody() throws Exception {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    String text = new String(Files.readAllBytes(Paths.get(xlator.file())), StandardCharsets.UTF_8).substring(0, 10);
+    
+    int built = builtBodies();
+    AbstractScriptEntity entity = new AbstractScriptEntity(xlator.file(), null);
+    deferInventedBody(xlator, entity, xlator.file(), 0, 10);
+    assert entity.hasDeferredBody();
+    assert xlator.getDeferredBodyCount() == 1;
+    assert builtBodies() == built;
+
+    // the body is built on first use, from its range of the source, and only once
+    CAstNode ast = entity.getAST();
+    assert builtBodies() == built + 1;
+    assert text.equals(ast.getChild(0).getValue());
+    assert entity.getAST() == ast;
+    assert builtBodies() == built + 1;
+    assert xlator.getDeferredBodyCount() == 0;
+
+    // rewriting an entity leaves its body to be built when the copy needs it
+    AbstractScriptEntity rewritten = new AbstractScriptEntity(xlator.file(), null);
+    deferInventedBody(xlator, rewritten, xlator.file(), 0, 10);
+    CAstEntity copy = new CAstCloner(Ast, true).rewrite(rewritten);
+    assert rewritten.hasDeferredBody();
+    assert builtBodies() == built + 1;
+    assert text.equals(copy.getAST().getChild(0).getValue());
+    assert copy.getAST() != rewritten.getAST();
+    assert builtBodies() == built + 2;
+
+    // a body that cannot be built fails every use, not just the first
+    AbstractScriptEntity broken = new AbstractScriptEntity(xlator.file(), null);
+    deferInventedBody(xlator, broken, xlator.file(), 5, 5);
+    RuntimeException failure = null;
+    try {
+      broken.getAST();
+    } catch (RuntimeException e) {
+      failure = e;
+    }
+    assert failure != null;
+    try {
+      broken.getControlFlow();
+      assert false;
+    } catch (RuntimeException e) {
+      assert e == failure;
+    }
+    assert builtBodies() == built + 3;
+    assert xlator.getDeferredBodyCount() == 0;
+
+    // the bodies of entities that become unreachable are released unbuilt
+    deferInventedBody(xlator, new AbstractScriptEntity(xlator.file(), null), xlator.file(), 0, 10);
+    assert xlator.getDeferredBodyCount() == 1;
+    for (int i = 0; i < 100 && xlator.getDeferredBodyCount() > 0; i++) {
+      System.gc();
+      Thread.sleep(10);
+    }
+    assert xlator.getDeferredBodyCount() == 0;
+    assert builtBodies() == built + 3;
+
+    // bodies released before they are needed are never built
+    AbstractScriptEntity unreached = new AbstractScriptEntity(xlator.file(), null);
+    deferInventedBody(xlator, unreached, xlator.file(), 0, 10);
+    xlator.releaseDeferredBodies();
+    assert unreached.getAST() == null;
+    assert builtBodies() == built + 3;
+  }
+
+  @Test
+  public void testStrings() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+
+    String[] strings = inventStrings(xlator);
+    assert strings.length == 4;
+    assert "plain".equals(strings[0]);
+    assert "caf\u00e9".equals(strings[1]);
+    assert "\ud834\udd1e clef".equals(strings[2]);
+    assert "a\u0000b".equals(strings[3]);
+  }
+
+  @Test
+  public void testStringRoundTrip() throws IOException {
+    CAst Ast = new CAstImpl();
+
+    SmokeXlator xlator = smokeXlator(Ast);
+    String[] strings = { "plain", "caf\u00e9", "\u20ac and \u4e2d", "\ud834\udd1e clef", "" };
+    CAstNode[] constants = new CAstNode[strings.length];
+    for (int i = 0; i < strings.length; i++) {
+      constants[i] = Ast.makeConstant(strings[i]);
+    }
+    AbstractScriptEntity entity = new AbstractScriptEntity("\u00fcber\ud83d\ude00.js", null);
+
+    // standard UTF-8 both ways, supplementary characters included
+    String[] back = roundTripStrings(xlator, constants, entity);
+    assert back.length == strings.length + 1;
+    for (int i = 0; i < strings.length; i++) {
+      assert strings[i].equals(back[i]);
+    }
+    assert entity.getName().equals(back[strings.length]);
+
+    // a surrogate without its other half has no UTF-8, and reads as U+FFFD
+    back = roundTripStrings(xlator, new CAstNode[] { Ast.makeConstant("a\ud834b"), Ast.makeConstant("\udd1e") }, entity);
+    assert "a\ufffdb".equals(back[0]);
+    assert "\ufffd".equals(back[1]);
+  }
+
+  private static byte[] bytes(int... bs) {
+    byte[] result = new byte[bs.length];
+    for (int i = 0; i < bs.length; i++) {
+      result[i] = (byte) bs[i];
+    }
+    return result;
+  }
+
+  private static String strictUtf8(byte[] bytes) {
+    try {
+      return StandardCharsets.UTF_8.newDecoder().onMalformedInput(CodingErrorAction.REPORT)
+          .onUnmappableCharacter(CodingErrorAction.REPORT).decode(ByteBuffer.wrap(bytes)).toString();
+    } catch (CharacterCodingException e) {
+      return null;
+    }
+  }
+
+  @Test
+  public void testUtf8() {
+    byte[][] valid = { bytes(0xc3, 0xa9), bytes(0xe2, 0x82, 0xac), bytes(0xef, 0xbf, 0xbf), bytes(0xf0, 0x9d, 0x84, 0x9e),
+        bytes(0xf4, 0x8f, 0xbf, 0xbf), bytes(0x00) };
+    byte[][] invalid = {
+        // overlong
+        bytes(0xc0, 0x80), bytes(0xc1, 0xbf), bytes(0xe0, 0x80, 0x80), bytes(0xe0, 0x9f, 0xbf), bytes(0xf0, 0x8f, 0xbf, 0xbf),
+        // surrogates
+        bytes(0xed, 0xa0, 0x80), bytes(0xed, 0xbf, 0xbf),
+        // past U+10FFFF
+        bytes(0xf4, 0x90, 0x80, 0x80), bytes(0xf5, 0x80, 0x80, 0x80), bytes(0xff),
+        // truncated, or a continuation with nothing before it
+        bytes(0xc3), bytes(0xe2, 0x82), bytes(0xf0, 0x9d, 0x84), bytes(0x80) };
+
+    // every sequence at every position of buffers more than two vectors
+    // long, so that each lane of each vector, and the scalar tail, sees
+    // the first non-ASCII byte
+    for (int len : new int[] { 64, 65, 97 }) {
+      for (byte[][] seqs : new byte[][][] { valid, invalid }) {
+        for (byte[] seq : seqs) {
+          for (int at = 0; at + seq.length <= len; at++) {
+            byte[] bytes = new byte[len];
+            for (int i = 0; i < len; i++) {
+              bytes[i] = (byte) ('a' + i % 26);
+            }
+            System.arraycopy(seq, 0, bytes, at, seq.length);
+            String expected = strictUtf8(bytes);
+            assert (expected != null) == (seqs == valid);
+            assert Objects.equals(expected, decodeUtf8(bytes));
+          }
+        }
+      }
+    }
+  }
+
+  @Test
+  public void testCallSites() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    AbstractScriptEntity outer = new AbstractScriptEntity(xlator.file(), null);
+    AbstractScriptEntity inner = new AbstractScriptEntity(xlator.file(), null);
+    inventCallSites(xlator, outer, inner);
+
+    CallSiteTable calls = outer.getCallSites();
+    assert calls.size() == 2;
+    assert calls.getCalleeKind(0) == CAstNode.VAR && calls.getArgumentCount(0) == 1;
+    assert calls.getCalleeKind(1) == CAstNode.VAR && calls.getArgumentCount(1) == 3;
+    assert "do".equals(calls.getCallReference(1));
+    assert calls.getCall(1) == outer.getAST().getChild(1);
+
+    CallSiteTable nested = inner.getCallSites();
+    assert nested.size() == 1;
+    assert nested.getCalleeKind(0) == CAstNode.OBJECT_REF && nested.getArgumentCount(0) == 0;
+
+    // entities without a recorded table get one by walking the AST
+    AbstractScriptEntity copy = new AbstractScriptEntity(xlator.file(), null);
+    copy.setAst(outer.getAST());
+    CallSiteTable walked = CallSiteTable.of(copy);
+    assert walked.size() == 2;
+    for (int i = 0; i < 2; i++) {
+      assert walked.getCall(i) == calls.getCall(i);
+      assert walked.getCalleeKind(i) == calls.getCalleeKind(i);
+      assert walked.getArgumentCount(i) == calls.getArgumentCount(i);
+    }
+  }
+
+  @Test
+  public void testNestedAndFoldedCallSites() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    AbstractScriptEntity entity = new AbstractScriptEntity(xlator.file(), null);
+    foldCallSites(xlator, entity);
+
+    // inner calls come first, and the call folded away is gone
+    String[] callees = { "h", "g", "f", "k" };
+    int[] argumentCounts = { 0, 1, 2, 0 };
+    CallSiteTable calls = entity.getCallSites();
+    assert calls.size() == callees.length;
+    for (int i = 0; i < callees.length; i++) {
+      assert callees[i].equals(calls.getCall(i).getChild(0).getChild(0).getValue());
+      assert calls.getArgumentCount(i) == argumentCounts[i];
+    }
+    assert calls.getCall(3) == entity.getAST().getChild(1);
+
+    // walking the AST finds the same calls in the same order
+    AbstractScriptEntity copy = new AbstractScriptEntity(xlator.file(), null);
+    copy.setAst(entity.getAST());
+    CallSiteTable walked = CallSiteTable.of(copy);
+    assert walked.size() == calls.size();
+    for (int i = 0; i < calls.size(); i++) {
+      assert walked.getCall(i) == calls.getCall(i);
+    }
+  }
+
+  /**
+   * a factory making every node the way CAstImpl used to: an array of
+   * children, and boxed constants
+   */
+  private static class ArrayCAstImpl extends CAstImpl {
+    @Override
+    public CAstNode makeNode(int kind, CAstNode[] cs) {
+      return new CAstNodeImpl(kind, cs) { };
+    }
+
+    @Override
+    public CAstNode makeConstant(Object value) {
+      return super.makeConstant(value);
+    }
+  }
+
+  private static long usedMemory() {
+    Runtime rt = Runtime.getRuntime();
+    for (int i = 0; i < 3; i++) {
+      System.gc();
+    }
+    return rt.totalMemory() - rt.freeMemory();
+  }
+
+  private static int countNodes(CAstNode root) {
+    int count = 0;
+    Deque<CAstNode> stack = new ArrayDeque<>();
+    stack.push(root);
+    while (!stack.isEmpty()) {
+      CAstNode n = stack.pop();
+      count++;
+      for (int i = 0; i < n.getChildCount(); i++) {
+        stack.push(n.getChild(i));
+      }
+    }
+    return count;
+  }
+
+  private static void benchmarkLargeAst(String name, CAst Ast, int depth) throws IOException {
+    SmokeXlator xlator = smokeXlator(Ast);
+
+    long before = usedMemory();
+    CAstNode ast = inventLargeAst(xlator, depth);
+    long footprint = usedMemory() - before;
+
+    int nodes = 0;
+    long time = 0;
+    for (int round = 0; round < 5; round++) {
+      long start = System.nanoTime();
+      nodes = countNodes(ast);
+      time += System.nanoTime() - start;
+    }
+
+    System.err.println(name + ": " + nodes + " nodes, " + footprint / nodes + " bytes per node, " + time / 5000000
+        + "ms per traversal");
+  }
+
+  /**
+   * the leaves of a tree made by inventLargeAst, left to right
+   */
+  private static void leaves(CAstNode n, List<CAstNode> leaves) {
+    if (n.getKind() == CAstNode.BINARY_EXPR) {
+      assert n.getChildCount() == 3;
+      assert n.getChild(0) == CAstOperator.OP_ADD;
+      leaves(n.getChild(1), leaves);
+      leaves(n.getChild(2), leaves);
+    } else {
+      leaves.add(n);
+    }
+  }
+
+  @Test
+  public void testLargeNativeCAst() throws IOException {
+    CAst[] factories = { new ArrayCAstImpl(), new CAstImpl() };
+    for (CAst Ast : factories) {
+      SmokeXlator xlator = smokeXlator(Ast);
+      CAstNode ast = inventLargeAst(xlator, 10);
+
+      // 1023 sums, each with an operator, over 1024 leaves, a third of
+      // which are variables with a name
+      List<CAstNode> leaves = new ArrayList<>();
+      leaves(ast, leaves);
+      assert leaves.size() == 1024;
+      assert countNodes(ast) == 2 * 1023 + 1024 + 342;
+      for (int i = 0; i < leaves.size(); i++) {
+        CAstNode leaf = leaves.get(i);
+        switch (i % 3) {
+        case 0:
+          assert leaf.getKind() == CAstNode.CONSTANT && leaf.getChildCount() == 0;
+          assert Integer.valueOf(i + 1).equals(leaf.getValue());
+          // whether packed or not, a constant keeps one value object
+          assert leaf.getValue() == leaf.getValue();
+          break;
+        case 1:
+          assert leaf.getKind() == CAstNode.VAR && leaf.getChildCount() == 1;
+          assert "x".equals(leaf.getChild(0).getValue());
+          break;
+        default:
+          assert leaf.getKind() == CAstNode.EMPTY && leaf.getChildCount() == 0;
+        }
+      }
+    }
+  }
+
+  @Test
+  public void testPackedConstants() {
+    CAstImpl Ast = new CAstImpl();
+    CAstNode i = Ast.makeConstant(7);
+    CAstNode l = Ast.makeConstant(7L);
+    CAstNode d = Ast.makeConstant(7.5);
+    assert Integer.valueOf(7).equals(i.getValue()) && i.getValue() == i.getValue();
+    assert Long.valueOf(7).equals(l.getValue()) && l.getValue() == l.getValue();
+    assert Double.valueOf(7.5).equals(d.getValue()) && d.getValue() == d.getValue();
+    assert i.getKind() == CAstNode.CONSTANT && i.getChildCount() == 0;
+    assert "CAstValue: 7".equals(i.toString());
+
+    // a factory that boxes constants itself gets boxed constants
+    CAstNode boxed = new ArrayCAstImpl().makeConstant(7);
+    assert Integer.valueOf(7).equals(boxed.getValue());
+  }
+
+  /**
+   * times trees of array nodes against fixed-arity ones; not part of the
+   * suite
+   */
+  public static void main(String[] args) throws IOException {
+    for (int round = 0; round < 2; round++) {
+      benchmarkLargeAst("array nodes", new ArrayCAstImpl(), 20);
+      benchmarkLargeAst("fixed-arity nodes", new CAstImpl(), 20);
+    }
+  }
+
+  @Test
+  public void testSizeSummary() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    AbstractScriptEntity entity = new AbstractScriptEntity(xlator.file(), null);
+    inventSizes(xlator, entity);
+
+    EntitySizeSummary sizes = entity.getSizeSummary();
+    assert sizes.getNodeCount() == 7;
+    assert sizes.getNodeCount(CAstNode.CONSTANT) == 2;
+    assert sizes.getNodeCount(CAstNode.IF_STMT) == 1;
+    assert sizes.getMaxDepth() == 4;
+    assert sizes.getGotoEdgeCount() == 1;
+    assert sizes.getInstructionEstimate() == 5;
+    assert sizes.getBlockEstimate() == 2 * 2 + 1 + 2;
+  }
+
+  @Test
+  public void testFoldedSizeSummary() throws IOException {
+    CAst Ast = new CAstImpl();
+    
+    SmokeXlator xlator = smokeXlator(Ast);
+    AbstractScriptEntity entity = new AbstractScriptEntity(xlator.file(), null);
+    foldSizes(xlator, entity);
+
+    // only what is left of the AST is counted: BLOCK(RETURN(1))
+    EntitySizeSummary sizes = entity.getSizeSummary();
+    assert sizes.getNodeCount() == 3;
+    assert sizes.getNodeCount(CAstNode.CONSTANT) == 1;
+    assert sizes.getNodeCount(CAstNode.BLOCK_STMT) == 1;
+    assert sizes.getNodeCount(CAstNode.IF_STMT) == 0;
+    assert sizes.getNodeCount(CAstNode.GOTO) == 0;
+    assert sizes.getMaxDepth() == 3;
+    assert sizes.getGotoEdgeCount() == 0;
+  }
 }
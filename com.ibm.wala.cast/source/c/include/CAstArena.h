@@ -0,0 +1,138 @@
+#ifndef _CAST_ARENA_H
+#define _CAST_ARENA_H
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ *  A monotonic arena for the native memory of one translation.
+ * Allocation bumps a pointer within large blocks, freeing single
+ * objects does nothing, and everything goes away at once when the
+ * arena is reset or destroyed; blocks are kept across resets, so an
+ * arena that is reused stops calling malloc altogether.
+ *
+ *  Temporaries can be given back early with a Scope, which hands out
+ * memory from a scratch arena kept beside this one and rolls that back
+ * to where it was when the scope was opened.  Memory of the arena
+ * itself, e.g. of containers that grow while a scope is open, is never
+ * given back by a scope.
+ */
+#if __WIN32__
+class DLLEXPORT CAstArena {
+#else
+class CAstArena {
+#endif
+
+private:
+  struct Block {
+    Block *next;
+    size_t size;
+    size_t used;
+  };
+
+  const size_t blockSize;
+  Block *first;
+  Block *current;
+
+  size_t allocationCount;
+  size_t allocatedBytes;
+  size_t blockCount;
+
+  CAstArena *scratch;
+
+  static char *data(Block *);
+
+  Block *newBlock(size_t);
+
+  CAstArena &scratchArena();
+
+public:
+
+  class Scope {
+    CAstArena &scratch;
+    Block *block;
+    size_t used;
+
+  public:
+    Scope(CAstArena &);
+
+    ~Scope();
+
+    /**
+     *  The arena to take the temporaries of this scope from.  They
+     * must not grow while an inner scope of the same arena is open.
+     */
+    CAstArena &getArena();
+  };
+
+  CAstArena(size_t blockSize = 64 * 1024);
+
+  ~CAstArena();
+
+  void *allocate(size_t bytes, size_t alignment);
+
+  /**
+   *  A NUL-terminated copy of the first len bytes of str.
+   */
+  char *strndup(const char *str, size_t len);
+
+  char *strdup(const char *str);
+
+  /**
+   *  Make all memory of this arena available again; does not return
+   * any blocks to the system.
+   */
+  void reset();
+
+  /**
+   *  Give every block back to the system, e.g. when a THROW skips the
+   * destructor of the arena's owner; the arena is empty afterwards,
+   * but can still be used.
+   */
+  void release();
+
+  /** number of allocations served since this arena was created */
+  size_t allocations() const { return allocationCount; }
+
+  /** number of bytes requested since this arena was created */
+  size_t bytes() const { return allocatedBytes; }
+
+  /** number of blocks obtained from the system */
+  size_t blocks() const { return blockCount; }
+};
+
+/**
+ *  A standard allocator drawing from a CAstArena, so that containers
+ * of the bridge live in the arena too.  Deallocation is a no-op.
+ */
+template<class T> class CAstArenaAllocator {
+public:
+  typedef T value_type;
+
+  CAstArena *arena;
+
+  CAstArenaAllocator(CAstArena &arena) : arena(&arena) { }
+
+  template<class U> CAstArenaAllocator(const CAstArenaAllocator<U> &other)
+    : arena(other.arena) { }
+
+  T *allocate(size_t n) {
+    return (T *)arena->allocate(n * sizeof(T), alignof(T));
+  }
+
+  void deallocate(T *, size_t) { }
+};
+
+template<class T, class U>
+bool operator==(const CAstArenaAllocator<T> &l, const CAstArenaAllocator<U> &r) {
+  return l.arena == r.arena;
+}
+
+template<class T, class U>
+bool operator!=(const CAstArenaAllocator<T> &l, const CAstArenaAllocator<U> &r) {
+  return l.arena != r.arena;
+}
+
+template<class T> using CAstArenaVector = std::vector<T, CAstArenaAllocator<T> >;
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef _CAST_CONSTANT_FOLDER_H
+#define _CAST_CONSTANT_FOLDER_H
+
+#include "jni.h"
+#include "CAstArena.h"
+
+/**
+ *  The native value of a constant built through CAstWrapper.  The
+ * kind records which makeConstant overload built it, and hence which
+ * Java type the constant has.
+ */
+struct CAstConstantValue {
+  enum Kind {
+    BOOL_VALUE,
+    CHAR_VALUE,
+    SHORT_VALUE,
+    INT_VALUE,
+    LONG_VALUE,
+    FLOAT_VALUE,
+    DOUBLE_VALUE,
+    STRING_VALUE
+  } kind;
+
+  union {
+    bool b;
+    jlong l;
+    double d;
+    struct {
+      const char *chars;
+      int length;
+    } s;
+  } value;
+
+  bool isIntegral() const {
+    return kind == CHAR_VALUE || kind == SHORT_VALUE || kind == INT_VALUE || kind == LONG_VALUE;
+  }
+
+  bool isReal() const {
+    return kind == FLOAT_VALUE || kind == DOUBLE_VALUE;
+  }
+};
+
+/**
+ *  Language-specific semantics of binary operators over constants,
+ * used by CAstWrapper to fold BINARY_EXPR nodes natively as they are
+ * built; this is the native counterpart of
+ * ConstantFoldingRewriter.eval.  The operator is given by its index,
+ * one of the CAstWrapper::OP_*_INDEX values.  Strings in results
+ * must be allocated in the given arena.
+ */
+#if __WIN32__
+class DLLEXPORT CAstConstantEvaluator {
+#else
+class CAstConstantEvaluator {
+#endif
+
+public:
+
+  virtual ~CAstConstantEvaluator() { }
+
+  /**
+   *  Evaluate op over lhs and rhs into result, returning false if
+   * the expression should be left alone.
+   */
+  virtual bool eval(int op,
+		    const CAstConstantValue &lhs,
+		    const CAstConstantValue &rhs,
+		    CAstConstantValue &result,
+		    CAstArena &arena) = 0;
+};
+
+/**
+ *  Folding with the arithmetic of C-like languages: binary numeric
+ * promotion to int, long, float or double, 32-bit wrap-around for
+ * int, no folding of integer division by zero, and boolean logic on
+ * booleans.  Strings are left alone, since languages disagree about
+ * them.
+ */
+#if __WIN32__
+class DLLEXPORT CAstArithmeticEvaluator : public CAstConstantEvaluator {
+#else
+class CAstArithmeticEvaluator : public CAstConstantEvaluator {
+#endif
+
+public:
+
+  virtual bool eval(int op,
+		    const CAstConstantValue &lhs,
+		    const CAstConstantValue &rhs,
+		    CAstConstantValue &result,
+		    CAstArena &arena);
+};
+
+#endif
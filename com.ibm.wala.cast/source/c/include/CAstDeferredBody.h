@@ -0,0 +1,88 @@
+#ifndef _CAST_DEFERRED_BODY_H
+#define _CAST_DEFERRED_BODY_H
+
+#include <vector>
+#include "jni.h"
+#include "CAstSourceBuffer.h"
+
+class CAstWrapper;
+
+/**
+ *  The body of a code entity, built only when Java first asks the
+ * entity for its AST.  A front end that can find where a function body
+ * starts and ends without building it makes the entity as a shell, with
+ * its name, signature, arguments and position, and hands a subclass of
+ * this, holding the range of source to parse the body from, to
+ * CAstWrapper::deferEntityBody.  Functions that are never reached then
+ * cost no more than their shells.
+ *
+ *  build() is called at most once, with a fresh wrapper for the
+ * translator, on whatever thread Java asks on, perhaps while the
+ * translation that deferred it is still running on another.  The
+ * translator synchronizes the callbacks that share state between
+ * entities, such as interning types; any state the front end itself
+ * shares between bodies must be guarded likewise.  If build() throws,
+ * the entity throws the same exception whenever it is used again.
+ *
+ *  build() must set the AST of the entity with setEntityAst, along
+ * with the positions, types, control flow and scoped entities that go
+ * with it.  Shells for nested functions, made eagerly with their
+ * parent's, can be kept with addNested so that build() registers them
+ * under the constructs it makes for them.
+ *
+ *  The body takes over the reference to its source buffer that its
+ * maker got from CAstSourceBuffer::acquire, so the range stays valid until
+ * the body is released, which is once it is built, once its entity is
+ * unreachable, or when the translator releases the bodies it has not
+ * built.
+ */
+#if __WIN32__
+class DLLEXPORT CAstDeferredBody {
+#else
+class CAstDeferredBody {
+#endif
+
+private:
+  CAstSourceBuffer *source;
+  jint begin;
+  jint end;
+  std::vector<jobject> nested;
+
+protected:
+  virtual ~CAstDeferredBody();
+
+public:
+
+  CAstDeferredBody(CAstSourceBuffer *source, jint begin, jint end);
+
+  CAstSourceBuffer *getSource() const { return source; }
+
+  jint getBegin() const { return begin; }
+
+  jint getEnd() const { return end; }
+
+  /** the text of the body, which is not NUL terminated */
+  const char *getText() const { return source->getData() + begin; }
+
+  jint getLength() const { return end - begin; }
+
+  /**
+   *  Keep a shell for a nested entity, as a global reference, until
+   * the body is released.
+   */
+  void addNested(JNIEnv *, jobject);
+
+  int getNestedCount() const { return (int)nested.size(); }
+
+  jobject getNested(int i) const { return nested[i]; }
+
+  virtual void build(CAstWrapper &, jobject entity) = 0;
+
+  /**
+   *  Drop the nested shells and the source buffer, and delete this
+   * body.
+   */
+  void release(JNIEnv *);
+};
+
+#endif
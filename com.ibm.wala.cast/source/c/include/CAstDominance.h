@@ -0,0 +1,81 @@
+#ifndef _CAST_DOMINANCE_H
+#define _CAST_DOMINANCE_H
+
+#include <vector>
+#include "jni.h"
+
+/**
+ *  Dominators, dominance frontiers and phi placement over a control
+ * flow graph given as int arrays, for the Java class NativeDominance,
+ * which SSA conversion uses on large functions.  The successors of
+ * block b are succs[succStart[b]] up to succs[succStart[b+1]].
+ *
+ *  Dominators are found with the iterative algorithm of Cooper, Harvey
+ * and Kennedy over a reverse postorder, and frontiers by walking up
+ * from the predecessors of each block to its immediate dominator.
+ * The results match DominanceFrontiers: the entry has no immediate
+ * dominator, the children of each block in the dominator tree are in
+ * ascending order, and blocks unreachable from the entry have neither
+ * dominators nor frontiers.
+ *
+ *  All results are laid out the same way as the graph, as a start
+ * array with one more element than there are rows, and the rows.
+ */
+#if __WIN32__
+class DLLEXPORT CAstDominance {
+#else
+class CAstDominance {
+#endif
+
+private:
+  int blockCount;
+  int entry;
+
+  std::vector<jint> predStart;
+  std::vector<jint> preds;
+  std::vector<jint> rpoNumber;
+  std::vector<jint> idom;
+
+  std::vector<jint> treeStart;
+  std::vector<jint> tree;
+
+  std::vector<jint> frontierStart;
+  std::vector<jint> frontier;
+
+  void reversePostorder(const jint *succStart, const jint *succs, std::vector<jint> &order);
+
+  int intersect(int a, int b) const;
+
+  static void rows(int rowCount, const std::vector<jint> &from, const std::vector<jint> &to,
+		   std::vector<jint> &start, std::vector<jint> &result);
+
+public:
+
+  CAstDominance(int blockCount, int entry, const jint *succStart, const jint *succs);
+
+  const std::vector<jint> &getIdoms() const { return idom; }
+
+  const std::vector<jint> &getTreeStart() const { return treeStart; }
+
+  const std::vector<jint> &getTree() const { return tree; }
+
+  const std::vector<jint> &getFrontierStart() const { return frontierStart; }
+
+  const std::vector<jint> &getFrontier() const { return frontier; }
+
+  /**
+   *  The iterated dominance frontier of the defining blocks of each
+   * value, i.e. where it may need phis, given frontiers as computed
+   * here; values are rows of defs, and results rows of phis.
+   */
+  static void placePhis(int blockCount,
+			const jint *frontierStart,
+			const jint *frontier,
+			int valueCount,
+			const jint *defStart,
+			const jint *defs,
+			std::vector<jint> &phiStart,
+			std::vector<jint> &phis);
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef _CAST_EXPORTER_H
+#define _CAST_EXPORTER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "CAstWrapper.h"
+
+/**
+ *  Streams a CAst tree from Javaland to a file as it walks it, instead
+ * of building one String for the whole tree the way CAstPrinter.print
+ * does.  Memory use is bounded by the depth of the tree: the walk
+ * keeps one frame per open node, each holding the node and the index
+ * of its next child, and every other local reference is deleted as
+ * soon as it has been written.
+ *
+ *  TEXT is the format of CAstPrinter.printTo without positions.  JSON
+ * writes each node as an object with its kind and children, or its
+ * value for constants.  DOT writes a Graphviz digraph with one vertex
+ * per node occurrence.  Kind names come from CAstPrinter.kindAsString,
+ * so customized printers are respected; each is looked up once for the
+ * life of the exporter, however many trees it writes, and kept in
+ * memory of its own rather than in the arena of the wrapper.
+ */
+#if __WIN32__
+class DLLEXPORT CAstExporter {
+#else
+class CAstExporter {
+#endif
+
+public:
+  enum Format {
+    TEXT,
+    JSON,
+    DOT
+  };
+
+private:
+  struct Frame {
+    jobject node;
+    int childCount;
+    int nextChild;
+    long id;
+  };
+
+  CAstWrapper &CAst;
+  FILE *out;
+  Format format;
+  std::vector<Frame> stack;
+  std::vector<std::string> kindNames;
+  std::vector<bool> kindKnown;
+  std::string otherKindName;
+  std::vector<char> utf8;
+  long nextId;
+
+  /** the name of kind, valid until the next call */
+  const char *kindName(int kind);
+
+  /**
+   *  jstr as standard UTF-8, or "null" if jstr is NULL, valid until
+   * the next call.  Its length goes in length, as it may hold NULs.
+   */
+  const char *toUtf8(jstring jstr, size_t *length);
+
+  void writeString(const char *);
+
+  void writeEscaped(const char *);
+
+  void writeEscaped(const char *, size_t length);
+
+  void indent(size_t depth);
+
+  bool enter(jobject node);
+
+  void leave();
+
+public:
+
+  CAstExporter(CAstWrapper &CAst, FILE *out, Format format);
+
+  /**
+   *  Write the tree rooted at top; top is not deleted.  An exporter
+   * can write any number of trees, one after the other.
+   */
+  void exportTree(jobject top);
+};
+
+#endif
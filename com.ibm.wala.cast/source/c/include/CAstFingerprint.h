@@ -0,0 +1,72 @@
+#ifndef _CAST_FINGERPRINT_H
+#define _CAST_FINGERPRINT_H
+
+#include "jni.h"
+
+/**
+ *  A structural fingerprint of a CAst tree.  The tree is described
+ * in post order, i.e. children before parents, with each node given
+ * by its kind and number of children; that sequence determines the
+ * tree shape uniquely, and constants are mixed in with their values.
+ * A subtree whose fingerprint is known already can be given whole,
+ * with subtree(), in place of its description.
+ *
+ *  Front ends can compute fingerprints of an entity from their own
+ * parse trees, without crossing JNI, by describing each node as they
+ * would build it; CAstWrapper also fingerprints what it builds while
+ * a fingerprint is open (see CAstWrapper::beginFingerprint).  The two
+ * ways need not give the same values, so a front end should stick to
+ * one of them for a given entity.  Only the first can save building
+ * an unchanged entity, since CAstWrapper fingerprints nodes as they
+ * cross into Java.
+ *
+ *  Source positions are part of the fingerprint only as far as they
+ * are given to position(), which CAstWrapper does for every location
+ * it makes; an entity reused from a cache keyed on such fingerprints
+ * thus never carries stale positions.  Fingerprints meant to find
+ * copies of the same code at different places leave them out.
+ */
+#if __WIN32__
+class DLLEXPORT CAstFingerprint {
+#else
+class CAstFingerprint {
+#endif
+
+private:
+  jlong hash;
+
+  void mix(jlong);
+
+public:
+
+  CAstFingerprint();
+
+  void node(int kind, int childCount);
+
+  void constant(bool);
+
+  void constant(jlong);
+
+  void constant(double);
+
+  void constant(const char *);
+
+  void constant(const char *, int);
+
+  void position(int firstLine, int firstCol, int lastLine, int lastCol);
+
+  /**
+   *  Account for a subtree by its own fingerprint, e.g. a child of
+   * the node about to be described.
+   */
+  void subtree(jlong);
+
+  /**
+   *  Account for a nested entity, e.g. the function defined by a
+   * FUNCTION_EXPR, so that changes to it also change its parent.
+   */
+  void entity(const CAstFingerprint &);
+
+  jlong value() const;
+};
+#endif
@@ -0,0 +1,59 @@
+#ifndef _CAST_FLAT_TREE_H
+#define _CAST_FLAT_TREE_H
+
+#include "jni.h"
+
+/**
+ *  The arrays of a Java CAstFlatTree, read in place from the direct
+ * buffers that hold them, so that the native matcher and rewriters
+ * copy nothing however often they run over the same tree.  Nodes are
+ * ids; the children of node n are children[childStart[n]] up to
+ * children[childStart[n+1]], and valueIds[n] is the id of the distinct
+ * value of a constant, or -1.
+ *
+ *  attach() takes local references to the buffers, which keep them
+ * alive until the native method returns, even if Java replaces them
+ * while growing the tree in a callback; only the nodes there were when
+ * the tree was attached are seen.
+ */
+#if __WIN32__
+class DLLEXPORT CAstFlatTree {
+#else
+class CAstFlatTree {
+#endif
+
+private:
+  int nodeCount;
+  int rootCount;
+  const jint *kinds;
+  const jint *childStart;
+  const jint *children;
+  const jint *valueIds;
+  const jint *roots;
+
+public:
+
+  CAstFlatTree();
+
+  /**
+   *  Read the Java CAstFlatTree tree, answering false, with an
+   * exception pending, if its buffers cannot be found.
+   */
+  bool attach(JNIEnv *, jobject tree);
+
+  int getNodeCount() const { return nodeCount; }
+
+  int getRootCount() const { return rootCount; }
+
+  const jint *getKinds() const { return kinds; }
+
+  const jint *getChildStart() const { return childStart; }
+
+  const jint *getChildren() const { return children; }
+
+  const jint *getValueIds() const { return valueIds; }
+
+  const jint *getRoots() const { return roots; }
+};
+
+#endif
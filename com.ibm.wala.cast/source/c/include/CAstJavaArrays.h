@@ -0,0 +1,42 @@
+#ifndef _CAST_JAVA_ARRAYS_H
+#define _CAST_JAVA_ARRAYS_H
+
+#include <vector>
+#include "jni.h"
+
+/**
+ *  Copy the first length elements of a Java array into v, with the
+ * Get<Type>ArrayRegion function of JNIEnv that fits it, answering
+ * false, with an exception pending, if that fails.  The native
+ * analyses take their inputs through this, so that they run without
+ * holding on to Java arrays or calling back into the VM.
+ */
+template<class A, class T>
+static inline bool copyJavaArray(JNIEnv *env, A array, std::vector<T> &v, jsize length, void (JNIEnv::*get)(A, jsize, jsize, T *)) {
+  v.resize(length);
+  if (! v.empty()) {
+    (env->*get)(array, 0, length, v.data());
+  }
+  return ! env->ExceptionCheck();
+}
+
+/**
+ *  Copy the whole of a Java array into v.
+ */
+template<class A, class T>
+static inline bool copyJavaArray(JNIEnv *env, A array, std::vector<T> &v, void (JNIEnv::*get)(A, jsize, jsize, T *)) {
+  return copyJavaArray(env, array, v, env->GetArrayLength(array), get);
+}
+
+/**
+ *  A new Java int array holding v, or NULL with an exception pending.
+ */
+static inline jintArray toJavaArray(JNIEnv *env, const jint *v, size_t length) {
+  jintArray result = env->NewIntArray((jsize)length);
+  if (result != NULL && length > 0) {
+    env->SetIntArrayRegion(result, 0, (jsize)length, v);
+  }
+  return result;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef _CAST_LIVENESS_H
+#define _CAST_LIVENESS_H
+
+#include <vector>
+#include "jni.h"
+
+/**
+ *  Live values over a control flow graph given as int arrays, for the
+ * Java class NativeLiveAnalysis.  The successors of block b are
+ * succs[succStart[b]] up to succs[succStart[b+1]], and what b does to
+ * the values live after it is a sequence of ops, ops[opStart[b]] up to
+ * ops[opStart[b+1]], in the order LiveAnalysis applies them: v makes v
+ * live and ~v makes it dead.  The exit block makes only the values its
+ * ops set live, whatever is live after it.
+ *
+ *  Sets of values are dense rows of words words each, a multiple of 8
+ * so that rows are whole AVX2 vectors.  The ops of each block are first
+ * folded into a gen row and a kill row, and the solver then iterates in
+ * postorder, the reverse postorder of the inverted graph, recomputing
+ * only blocks with a successor whose live-in set changed.
+ */
+#if __WIN32__
+class DLLEXPORT CAstLiveness {
+#else
+class CAstLiveness {
+#endif
+
+public:
+  typedef unsigned int word;
+
+private:
+  int blockCount;
+  int exit;
+  int words;
+
+  std::vector<word> gen;
+  std::vector<word> kill;
+  std::vector<word> liveIn;
+  std::vector<word> liveOut;
+
+  void postorder(const jint *succStart, const jint *succs, std::vector<jint> &order);
+
+public:
+
+  CAstLiveness(int blockCount,
+	       int exit,
+	       int words,
+	       const jint *opStart,
+	       const jint *ops);
+
+  void solve(const jint *succStart, const jint *succs);
+
+  /** values live on entry to each block, one row per block */
+  const std::vector<word> &getLiveIn() const { return liveIn; }
+
+  /** values live on exit from each block, one row per block */
+  const std::vector<word> &getLiveOut() const { return liveOut; }
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef _CAST_LOOP_UNWINDER_H
+#define _CAST_LOOP_UNWINDER_H
+
+#include <vector>
+#include "jni.h"
+
+/**
+ *  Plans the unwinding that AstLoopUnwinder does, for the Java class
+ * NativeLoopUnwinder, over a tree flattened by CAstFlatTree.  Each
+ * LOOP becomes the same chain of IF_STMTs ending in an ASSERT as in
+ * AstLoopUnwinder, with the test and body copied once per iteration
+ * under a key naming the iteration and the keys of enclosing loops.
+ *
+ *  Everything under a LOOP is copied once per iteration, as it is by
+ * AstLoopUnwinder, so that every copy has its own nodes and its own
+ * entries in the node map.  Outside loops, only subtrees that hold a
+ * LOOP or a pinned node, i.e. one that the control-flow map or a
+ * scoped entity refers to, are copied; the rest appear once in the new
+ * tree as in the old, and are kept as they are.  Both walks use
+ * explicit stacks, since trees can be deep.
+ *
+ *  The plan is a flat list of ints: the reference to the new root, the
+ * number of keys and an (iteration, parent key) pair for each, and
+ * then records for the new nodes, each referring to nodes made by
+ * earlier records.  A reference is either the id of a shared node, or
+ * the complement of the index of a record.  The records are
+ *
+ *  COPY origin key childCount child...: a copy of origin
+ *  ASSERT_NOT test: ASSERT(UNARY_EXPR(OP_NOT, test), false)
+ *  ITERATION test body rest: IF_STMT(test, BLOCK_STMT(body, rest))
+ */
+#if __WIN32__
+class DLLEXPORT CAstLoopUnwinder {
+#else
+class CAstLoopUnwinder {
+#endif
+
+public:
+  static const int COPY = 0;
+  static const int ASSERT_NOT = 1;
+  static const int ITERATION = 2;
+
+private:
+  enum State {
+    UNKNOWN,
+    SHARED,
+    COPIED
+  };
+
+  /** a node being walked, and for a LOOP, where its unwinding is */
+  struct Frame {
+    int node;
+    int key;
+    int step;
+    int count;
+    int iterationKey;
+    jint code;
+  };
+
+  const jint *kinds;
+  const jint *childStart;
+  const jint *children;
+  const jbyte *pinned;
+  int loopKind;
+  int unwindFactor;
+
+  std::vector<unsigned char> state;
+  std::vector<jint> keys;
+  std::vector<jint> records;
+  int recordCount;
+  std::vector<Frame> stack;
+  std::vector<jint> values;
+  std::vector<jint> operands;
+
+  int childCount(int n) const { return childStart[n + 1] - childStart[n]; }
+  int child(int n, int i) const { return children[childStart[n] + i]; }
+
+  bool copied(int n);
+
+  int key(int iteration, int parent);
+
+  int record(int op, const jint *operands, int count);
+
+  void push(int n, int key);
+
+  void step();
+
+  int unwind(int n, int key);
+
+public:
+
+  CAstLoopUnwinder(const jint *kinds,
+		   const jint *childStart,
+		   const jint *children,
+		   const jbyte *pinned,
+		   int nodeCount,
+		   int loopKind,
+		   int unwindFactor);
+
+  /**
+   *  Plan the unwinding of the tree under root into result.
+   */
+  void unwind(int root, std::vector<jint> &result);
+};
+
+#endif
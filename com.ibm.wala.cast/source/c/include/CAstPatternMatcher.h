@@ -0,0 +1,88 @@
+#ifndef _CAST_PATTERN_MATCHER_H
+#define _CAST_PATTERN_MATCHER_H
+
+#include <vector>
+#include "jni.h"
+
+/**
+ *  Runs a CAstPattern, lowered to a flat program by the Java class
+ * NativeCAstPattern, over a flattened tree built by CAstFlatTree.
+ * The matcher mirrors CAstPattern.match exactly, including its
+ * backtracking, but works on int arrays only: nodes are ids, and
+ * constant values are tested by looking up the id of their distinct
+ * value in a table of predicate results computed on the Java side,
+ * so that literals and regular expressions keep their Java meaning.
+ *
+ *  A pattern at offset p of the program is laid out as its kind (a
+ * node kind, or one of the pseudo-kinds below), the id of its name or
+ * -1, a predicate or reference operand, its child count, and the
+ * offsets of its children.
+ *
+ *  Only the roots that match and their bound segments are reported,
+ * as a flat list of records: the root, the number of bindings, and a
+ * name id and node id for each binding.
+ */
+#if __WIN32__
+class DLLEXPORT CAstPatternMatcher {
+#else
+class CAstPatternMatcher {
+#endif
+
+public:
+  static const int CHILD_KIND = -1;
+  static const int CHILDREN_KIND = -2;
+  static const int REPEATED_PATTERN_KIND = -3;
+  static const int ALTERNATIVE_PATTERN_KIND = -4;
+  static const int OPTIONAL_PATTERN_KIND = -5;
+  static const int REFERENCE_PATTERN_KIND = -6;
+  static const int VALUE_PATTERN_KIND = -99;
+
+private:
+  const jint *program;
+  const jbyte *predicates;
+  int valueCount;
+
+  const jint *kinds;
+  const jint *childStart;
+  const jint *children;
+  const jint *valueIds;
+
+  std::vector<jint> bindings;
+
+  int kind(int p) const { return program[p]; }
+  int name(int p) const { return program[p + 1]; }
+  int operand(int p) const { return program[p + 2]; }
+  int patternChildCount(int p) const { return program[p + 3]; }
+  int patternChild(int p, int j) const { return program[p + 4 + j]; }
+
+  int childCount(int n) const { return childStart[n + 1] - childStart[n]; }
+  int child(int n, int i) const { return children[childStart[n] + i]; }
+
+  void bind(int p, int n);
+
+  bool match(int p, int n);
+
+  bool tryMatch(int p, int n);
+
+  bool matchChildren(int n, int i, int p, int j);
+
+  bool tryMatchChildren(int n, int i, int p, int j);
+
+public:
+
+  CAstPatternMatcher(const jint *program,
+		     const jbyte *predicates,
+		     int valueCount,
+		     const jint *kinds,
+		     const jint *childStart,
+		     const jint *children,
+		     const jint *valueIds);
+
+  /**
+   *  Match the pattern at offset start against each of the roots,
+   * appending a record to results for each one that matches.
+   */
+  void findAll(int start, const jint *roots, int rootCount, std::vector<jint> &results);
+};
+
+#endif
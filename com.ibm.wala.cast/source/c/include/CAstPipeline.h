@@ -0,0 +1,300 @@
+#ifndef _CAST_PIPELINE_H
+#define _CAST_PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CAstWrapper.h"
+
+/**
+ *  A producer/consumer pipeline for building CAst trees.  Parser
+ * threads record node construction as commands on a Producer, which
+ * never touches JNI; the commands are handed over in batches through
+ * a lock-free single-producer/single-consumer queue per producer.
+ * The one thread that owns the JNIEnv calls drain(), which replays
+ * the batches through a CAstWrapper as they arrive, so parsing on
+ * the producer threads overlaps with Java object creation.
+ *
+ *  Nodes are named by Handles that the producers hand out as they
+ * record commands.  A handle may be used by any producer once the
+ * producer that created it has flushed it; handles are turned into
+ * real CAst nodes with resolve() on the consuming thread.  Entities
+ * passed to the producers must be global references, since they are
+ * only dereferenced on the consuming thread.  The nodes built are
+ * kept as global references, however many there are, and deleted
+ * with the pipeline.
+ *
+ *  The producer threads are started by the pipeline, so that it can
+ * stop and join them however the consuming thread leaves it: when the
+ * pipeline is destroyed, and when a THROW unwinds past it, which skips
+ * its destructor.
+ */
+#if __WIN32__
+class DLLEXPORT CAstPipeline {
+#else
+class CAstPipeline {
+#endif
+
+public:
+  typedef jlong Handle;
+
+private:
+  enum Op {
+    NODE,
+    CONSTANT_BOOL,
+    CONSTANT_CHAR,
+    CONSTANT_SHORT,
+    CONSTANT_INT,
+    CONSTANT_LONG,
+    CONSTANT_DOUBLE,
+    CONSTANT_FLOAT,
+    CONSTANT_STRING,
+    CONSTANT_OBJECT,
+    REFERENCE,
+    LOCATION,
+    NODE_LOCATION,
+    GOTO
+  };
+
+  struct Command {
+    Op op;
+    int kind;
+    int first;
+    int count;
+    jobject entity;
+    union {
+      jlong l;
+      jdouble d;
+      jfloat f;
+      jobject o;
+      int pos[4];
+    } value;
+  };
+
+  struct Batch {
+    std::vector<Command> commands;
+    std::vector<Handle> operands;
+    std::vector<char> strings;
+
+    void clear() {
+      commands.clear();
+      operands.clear();
+      strings.clear();
+    }
+  };
+
+  /**
+   *  A bounded single-producer/single-consumer ring of batches.  The
+   * producer only writes tail and the consumer only writes head, so
+   * no locks are needed.
+   */
+  class BatchQueue {
+    static const unsigned CAPACITY = 64;
+    Batch *slots[CAPACITY];
+    std::atomic<unsigned> head;
+    std::atomic<unsigned> tail;
+
+  public:
+    BatchQueue() : head(0), tail(0) { }
+
+    bool push(Batch *);
+
+    Batch *pop();
+  };
+
+  /**
+   *  Lets the consumer wait for batches, and producers for room in
+   * their queues, without spinning.  Every push, pop, close and the
+   * cancellation bump the count; a waiter reads the count before it
+   * looks at the queues, and then waits for it to change.
+   */
+  class Signal {
+    std::mutex lock;
+    std::condition_variable changed;
+    unsigned long count;
+
+  public:
+    Signal() : count(0) { }
+
+    unsigned long current();
+
+    void notify();
+
+    void wait(unsigned long seen);
+  };
+
+public:
+
+  /**
+   *  The recording side of the pipeline; each parser thread owns
+   * exactly one Producer.  Nothing recorded is visible to the
+   * consumer until it is flushed, which happens automatically every
+   * BATCH_SIZE commands and explicitly through flush() and close().
+   */
+#if __WIN32__
+  class DLLEXPORT Producer {
+#else
+  class Producer {
+#endif
+    friend class CAstPipeline;
+
+    static const unsigned BATCH_SIZE = 1024;
+
+    int id;
+    jlong nextHandle;
+    Batch *current;
+    BatchQueue full;
+    BatchQueue empty;
+    std::atomic<bool> closed;
+    const std::atomic<bool> &cancelled;
+    Signal &signal;
+
+    Producer(int id, const std::atomic<bool> &cancelled, Signal &signal);
+
+    ~Producer();
+
+    Handle emit(Command &, bool);
+
+    Handle record(Op, int, int, const Handle *);
+
+    Handle constant(Op, jlong);
+
+  public:
+
+    Handle makeNode(int);
+
+    Handle makeNode(int, Handle);
+
+    Handle makeNode(int, Handle, Handle);
+
+    Handle makeNode(int, Handle, Handle, Handle);
+
+    Handle makeNode(int, Handle, Handle, Handle, Handle);
+
+    Handle makeNode(int, int, const Handle[]);
+
+    Handle makeConstant(bool);
+
+    Handle makeConstant(char);
+
+    Handle makeConstant(short);
+
+    Handle makeConstant(int);
+
+    Handle makeConstant(long);
+
+    Handle makeConstant(double);
+
+    Handle makeConstant(float);
+
+    Handle makeConstant(jobject);
+
+    Handle makeConstant(const char *);
+
+    Handle makeConstant(const char *, int);
+
+    /**
+     *  A handle for an existing global reference, such as one of the
+     * operators, that is to be used as a node as is.
+     */
+    Handle makeReference(jobject);
+
+    Handle makeLocation(int, int, int, int);
+
+    void setAstNodeLocation(jobject, Handle, Handle);
+
+    void setGotoTarget(jobject, Handle, Handle);
+
+    void flush();
+
+    void close();
+
+    /**
+     *  Whether the pipeline has been given up on, e.g. because the
+     * consuming thread threw; everything recorded from then on is
+     * dropped, so producers should stop as soon as they notice.
+     */
+    bool isCancelled() const;
+  };
+
+private:
+  /**
+   *  Stops and joins the producer threads when a THROW leaves the
+   * pipeline behind.
+   */
+  class Unwinder : public Exceptions::Guard {
+    CAstPipeline &pipeline;
+
+  public:
+    Unwinder(Exceptions &ex, CAstPipeline &pipeline)
+      : Guard(ex), pipeline(pipeline) { }
+
+  protected:
+    virtual void unwind();
+  };
+
+  CAstWrapper &CAst;
+  std::vector<Producer *> producers;
+  std::vector< std::vector<jobject> > materialized;
+
+  /**
+   *  The batch of each producer being replayed, if any, and the
+   * children of its current node; members rather than locals of
+   * execute, so that shutdown can free them after a THROW.
+   */
+  std::vector<Batch *> replaying;
+  std::vector< std::vector<jobject> > children;
+  std::vector<std::thread> workers;
+  std::atomic<bool> cancelled;
+  Signal signal;
+  Unwinder unwinder;
+
+  void keep(int, jobject);
+
+  jobject resolve(int, Handle);
+
+  bool drain(int);
+
+  void execute(int, Batch *);
+
+  /**
+   *  Cancel and join the producer threads, free the producers and
+   * delete the nodes built; nothing can be drained or resolved
+   * afterwards.
+   */
+  void shutdown();
+
+public:
+
+  CAstPipeline(CAstWrapper &CAst, int producerCount);
+
+  ~CAstPipeline();
+
+  /**
+   *  Run body as the given producer on a thread of its own, which
+   * closes the producer when body returns.  Each producer is run once.
+   */
+  void start(int, std::function<void (Producer &)> body);
+
+  /**
+   *  Replay batches on the calling thread, which must own the
+   * JNIEnv of the wrapper, until every producer has been closed and
+   * all of its commands have been executed.
+   */
+  void drain();
+
+  /**
+   *  The CAst node for a handle; only valid on the consuming thread.
+   * It is a global reference owned by the pipeline, which the caller
+   * must not delete and cannot use once the pipeline is gone.
+   * Resolving a handle may replay batches of the producer that made
+   * it, but never those of a producer whose batch is being replayed
+   * already, since that would put its nodes out of order: handles that
+   * two producers wait on from each other are an error.
+   */
+  jobject resolve(Handle);
+};
+#endif
@@ -0,0 +1,95 @@
+#ifndef _CAST_PROFILER_H
+#define _CAST_PROFILER_H
+
+#include <stdio.h>
+#include "jni.h"
+
+/**
+ *  Attributes the Java allocations and garbage collections of native
+ * translation to the CAstWrapper API that caused them, per translated
+ * file.  libcast doubles as a JVMTI agent: load it with
+ *
+ *    -agentpath:/path/to/libcast.so=file=<report>,interval=<bytes>
+ *
+ * on the java command line, or through CAST_JVM_OPTIONS for VMs made
+ * by launch_jvm.  The report is written when the VM dies, to stderr
+ * if no file is given.
+ *
+ *  CAstWrapper marks each of its APIs with a Section.  Objects that
+ * JNI functions allocate, such as NewStringUTF, NewObject and arrays,
+ * are counted exactly.  Objects allocated by Java code running under
+ * the APIs, such as CAstImpl.makeNode, are sampled every interval
+ * bytes (512k by default), but only when libcast is compiled with
+ * CAST_PROFILE_SAMPLING against a JDK 11 or later.  Garbage collection
+ * runs on threads of its own, so its time goes to whichever section
+ * any translating thread entered last.
+ *
+ *  Without the agent, marking a section costs one test of a flag.
+ */
+#if __WIN32__
+class DLLEXPORT CAstProfiler {
+#else
+class CAstProfiler {
+#endif
+
+public:
+  enum Section {
+    OTHER,
+    MAKE_NODE,
+    MAKE_CONSTANT,
+    MAKE_LOCATION,
+    MAKE_COLLECTION,
+    MAKE_SYMBOL,
+    ENTITIES,
+    SIDE_TABLES,
+    SECTION_COUNT
+  };
+
+  static bool enabled;
+
+  /**
+   *  Marks the extent of a section on the current thread.  Sections
+   * entered within another are ignored, so everything is charged to
+   * the API that the front end called.  A THROW skips the destructor,
+   * so CAstWrapper ends the file, and with it the section, when it is
+   * unwound.
+   */
+  class Scope {
+    int saved;
+
+  public:
+    Scope(Section s) : saved(-1) {
+      if (enabled) saved = enter(s);
+    }
+
+    ~Scope() {
+      if (saved >= 0) leave(saved);
+    }
+  };
+
+  /**
+   *  Charge what the current thread does from now on to a file.  Any
+   * section still marked on the thread, as when a THROW has jumped
+   * past its Scope, is forgotten.
+   */
+  static void beginFile(const char *);
+
+  static void endFile();
+
+  /**
+   *  Write the counters of every file so far; this is what the agent
+   * writes when the VM dies.
+   */
+  static void report(FILE *);
+
+  static const char *sectionName(int);
+
+  static jint load(JavaVM *, char *, bool);
+
+private:
+  static int enter(Section);
+
+  static void leave(int);
+};
+
+#endif
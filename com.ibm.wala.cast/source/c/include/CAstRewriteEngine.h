@@ -0,0 +1,79 @@
+#ifndef _CAST_REWRITE_ENGINE_H
+#define _CAST_REWRITE_ENGINE_H
+
+#include <vector>
+#include "jni.h"
+
+/**
+ *  Drives a copy-on-write rewrite of a tree flattened by CAstFlatTree,
+ * for the Java class CAstFlatRewriter.  The tree is walked bottom up
+ * over its int arrays, and the rewriter is called back only for nodes
+ * of the kinds it registered, and for nodes some of whose children
+ * were replaced; every other node, and so every subtree that nothing
+ * touched, is kept as it is and shared with the new tree.  Nodes that
+ * are shared within the tree are visited once.
+ *
+ *  The callback is given the node and the ids of its children in the
+ * new tree, and answers the id of the node to use in its place, which
+ * may be the node itself, or -1 to abandon the rewrite, typically for
+ * a pending Java exception.  New nodes get ids past those the engine
+ * was given, so it never looks at them.
+ */
+#if __WIN32__
+class DLLEXPORT CAstRewriteEngine {
+#else
+class CAstRewriteEngine {
+#endif
+
+public:
+  class Callback {
+  public:
+    virtual ~Callback() { }
+
+    virtual int rebuild(int node, const jint *children, int childCount) = 0;
+  };
+
+private:
+  struct Frame {
+    int node;
+    int nextChild;
+  };
+
+  const jbyte *registered;
+  int kindCount;
+
+  const jint *kinds;
+  const jint *childStart;
+  const jint *children;
+  int nodeCount;
+
+  std::vector<jint> replacement;
+  std::vector<Frame> stack;
+  std::vector<jint> newChildren;
+
+  int childCount(int n) const { return childStart[n + 1] - childStart[n]; }
+  int child(int n, int i) const { return children[childStart[n] + i]; }
+
+  bool isRegistered(int n) const {
+    return kinds[n] >= 0 && kinds[n] < kindCount && registered[kinds[n]] != 0;
+  }
+
+  int finish(int n, Callback &);
+
+public:
+
+  CAstRewriteEngine(const jbyte *registered,
+		    int kindCount,
+		    const jint *kinds,
+		    const jint *childStart,
+		    const jint *children,
+		    int nodeCount);
+
+  /**
+   *  Rewrite the tree under root, answering the id of its replacement,
+   * or -1 if the callback abandoned the rewrite.
+   */
+  int rewrite(int root, Callback &);
+};
+
+#endif
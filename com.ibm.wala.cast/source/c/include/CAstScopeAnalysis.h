@@ -0,0 +1,114 @@
+#ifndef _CAST_SCOPE_ANALYSIS_H
+#define _CAST_SCOPE_ANALYSIS_H
+
+#include <map>
+#include <vector>
+#include "CAstWrapper.h"
+
+/**
+ *  Works out which names of each code entity are exposed, i.e. read
+ * or written by nested functions, as a front end builds the entities,
+ * so that ExposedNamesCollector need not walk the finished trees.
+ *
+ *  The front end opens a scope with beginScope when it starts on a
+ * function or script, and reports every declaration in it, including
+ * arguments and the names of function statements, and every read or
+ * write of a VAR.  endScope closes the scope and names the entity it
+ * became.  Every code entity must have a scope of its own, nested the
+ * way the entities are.
+ *
+ *  As in ExposedNamesCollector, a use only sees the declarations
+ * reported before it, so everything must be reported in the order in
+ * which that visitor meets it: arguments first, a DECL_STMT after its
+ * initializer, and the name of a FUNCTION_STMT before the scope of the
+ * function, which is visited after the statement.
+ *
+ *  When the outermost scope closes, the exposed names of all entities
+ * under it are attached to them in a single call.  Names are interned
+ * in the arena of the wrapper, so each distinct name is copied once.
+ */
+#if __WIN32__
+class DLLEXPORT CAstScopeAnalysis {
+#else
+class CAstScopeAnalysis {
+#endif
+
+private:
+  /** a name, and when it was reported */
+  struct Event {
+    int name;
+    int time;
+
+    bool operator<(const Event &other) const {
+      return name < other.name || (name == other.name && time < other.time);
+    }
+  };
+
+  typedef CAstArenaVector<Event> Events;
+
+  struct Scope {
+    Events declared;
+    Events read;
+    Events written;
+    Events childReads;
+    Events childWrites;
+
+    Scope(CAstArena &);
+  };
+
+  struct Closed {
+    jobject entity;
+    int readCount;
+    int *reads;
+    int writeCount;
+    int *writes;
+  };
+
+  struct KeyLess {
+    bool operator()(const char *a, const char *b) const {
+      return strcmp(a, b) < 0;
+    }
+  };
+
+  typedef std::map<const char *, int, KeyLess, CAstArenaAllocator<std::pair<const char * const, int> > > NameIds;
+
+  CAstWrapper &CAst;
+  NameIds nameIds;
+  CAstArenaVector<const char *> names;
+  std::vector<Scope> scopes;
+  CAstArenaVector<Closed> closed;
+  int clock;
+  jmethodID _setExposedNames;
+
+  int intern(const char *);
+
+  Scope &current();
+
+  Event event(const char *);
+
+  static bool declaredBefore(const Events &, const Event &);
+
+  int *resolve(const Events &, const Events &, const Events &, Events *, int *);
+
+  void attach();
+
+public:
+
+  CAstScopeAnalysis(CAstWrapper &CAst);
+
+  void beginScope();
+
+  void declare(const char *name);
+
+  void read(const char *name);
+
+  void write(const char *name);
+
+  /**
+   *  Close the innermost scope, whose code is the given entity; the
+   * entity need not be kept alive by the caller.
+   */
+  void endScope(jobject entity);
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef _CAST_SOURCE_BUFFER_H
+#define _CAST_SOURCE_BUFFER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "jni.h"
+
+/**
+ *  The contents of one source file, read into memory once, together
+ * with the offset at which each of its lines starts.  Native parsers
+ * can scan the contents in place, and Java sees the very same memory
+ * through the direct buffers made by contents() and lineStarts(), so
+ * positions in the file can be sliced out of it without reading the
+ * file again.
+ *
+ *  Offsets and columns are in bytes; lines are numbered from 1 and
+ * columns from 0, as in CAstWrapper::makeLocation.
+ *
+ *  The file is copied rather than mapped, so that another process
+ * truncating it cannot fault a reader, and the copy lives in direct
+ * buffers allocated by Java.  Buffers are shared by path and counted:
+ * acquire() gives its caller a reference, to be given back with
+ * release(), and the table of shared buffers only lists those that
+ * are in use.  Once the last reference goes, the buffer leaves the
+ * table and drops its hold on the Java buffers, whose memory is then
+ * reclaimed when Java no longer uses them either.
+ *
+ *  A file is read afresh unless it is the same file, by device and
+ * inode, with the same size and modification and status change times,
+ * to the nanosecond where the platform keeps them.  The status change
+ * time cannot be set back, unlike the modification time.  A buffer
+ * read within RACY_NANOS of either time may have missed a write in the
+ * same tick of a coarse file system clock, so then the file is read
+ * again and its contents compared, as git does for racily clean files.
+ */
+#if __WIN32__
+class DLLEXPORT CAstSourceBuffer {
+#else
+class CAstSourceBuffer {
+#endif
+
+private:
+  struct Version {
+    long long device;
+    long long inode;
+    long long size;
+    long long modified;
+    long long changed;
+
+    bool operator==(const Version &) const;
+  };
+
+  static const long long RACY_NANOS = 2000000000LL;
+
+  std::string path;
+  Version version;
+  long long readAt;
+  const char *data;
+  size_t length;
+  std::vector<jint> starts;
+  jobject contentsRef;
+  jobject startsRef;
+  int references;
+
+  CAstSourceBuffer(const char *path, const Version &version, long long readAt);
+
+  ~CAstSourceBuffer();
+
+  bool load(JNIEnv *, int fd, size_t length);
+
+  bool isRacy() const;
+
+  bool hasSameContents(const CAstSourceBuffer &) const;
+
+  void indexLines();
+
+  void dispose(JNIEnv *);
+
+public:
+
+  /**
+   *  The shared buffer of the file at path, with a reference for the
+   * caller, or NULL if it cannot be read.  A Java exception may be
+   * pending when NULL is returned.  The file is read without holding
+   * the lock of the table, so threads reading other files, or giving
+   * back buffers, do not wait for it.
+   */
+  static CAstSourceBuffer *acquire(JNIEnv *, const char *path);
+
+  /**
+   *  Take another reference to this buffer.
+   */
+  void retain();
+
+  /**
+   *  Give back a reference; the buffer is deleted with the last one.
+   * This makes no JNI calls but DeleteGlobalRef, so it is safe with
+   * an exception pending.
+   */
+  void release(JNIEnv *);
+
+  const char *getPath() const { return path.c_str(); }
+
+  const char *getData() const { return data; }
+
+  size_t getLength() const { return length; }
+
+  /**
+   *  The number of lines, counting a last line without a line break.
+   */
+  int getLineCount() const { return (int)starts.size(); }
+
+  /**
+   *  The offset at which line starts; one past the last line is the
+   * length of the file.
+   */
+  jint getLineStart(int line) const;
+
+  /**
+   *  The line holding offset, found by binary search.
+   */
+  int getLine(jint offset) const;
+
+  /**
+   *  The offset of a column of a line; a negative column means the
+   * start of the line, and columns past the end of the line are
+   * clipped to it.
+   */
+  jint getOffset(int line, int col) const;
+
+  /**
+   *  A local reference to the direct byte buffer holding the
+   * contents.  Native code reads the same memory, so Java must only
+   * ever use it through asReadOnlyBuffer().
+   */
+  jobject contents(JNIEnv *) const;
+
+  /**
+   *  A local reference to the direct buffer holding the line start
+   * offsets, as native-order jints.
+   */
+  jobject lineStarts(JNIEnv *) const;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _CAST_UTF8_H
+#define _CAST_UTF8_H
+
+#include <vector>
+#include "jni.h"
+
+/**
+ *  Strict UTF-8 to UTF-16, for making Java strings with NewString
+ * rather than NewStringUTF, and back, for reading them with
+ * GetStringChars rather than GetStringUTFChars.  NewStringUTF takes
+ * modified UTF-8, so it mangles or rejects supplementary characters
+ * and stops at NULs, and it scans the bytes again in the VM.  Here
+ * input is standard UTF-8 of a given length: NULs are characters,
+ * supplementary characters become surrogate pairs, and overlong forms,
+ * encoded surrogates, code points past U+10FFFF and truncated
+ * sequences are rejected.  Runs of ASCII, which is most of what front
+ * ends see, are checked and widened a vector at a time: AVX2 when the
+ * library is built with it (see OPTIMIZE in Makefile.configuration),
+ * SSE2 otherwise on x86-64.
+ */
+#if __WIN32__
+class DLLEXPORT CAstUtf8 {
+#else
+class CAstUtf8 {
+#endif
+
+public:
+
+  /**
+   *  Transcode len bytes into out, which must have room for len
+   * chars, as UTF-16 never takes more chars than UTF-8 takes bytes.
+   * Returns the number of chars written, or -1 if the input is not
+   * valid UTF-8.
+   */
+  static int toUtf16(const char *in, int len, jchar *out);
+
+  /**
+   *  Whether len bytes are valid UTF-8.
+   */
+  static bool isValid(const char *in, int len);
+
+  /**
+   *  Encode len chars of UTF-16 into out as standard UTF-8, which must
+   * have room for 3 bytes a char, as no char takes more.  Surrogate
+   * pairs become four byte sequences; a surrogate without its other
+   * half cannot be encoded, and becomes U+FFFD.  Returns the number of
+   * bytes written.
+   */
+  static int fromUtf16(const jchar *in, int len, char *out);
+};
+
+/**
+ *  Many strings packed into one char buffer, so that Java can make
+ * them all from one call (see CAstWrapper::makeStrings) rather than a
+ * JNI call for each.  String i is chars[ends[i-1]] up to chars[ends[i]].
+ */
+#if __WIN32__
+class DLLEXPORT CAstStringBatch {
+#else
+class CAstStringBatch {
+#endif
+
+private:
+  std::vector<jchar> chars;
+  std::vector<jint> ends;
+
+public:
+
+  /**
+   *  Add len bytes of UTF-8, returning the index of the string, or -1
+   * if they are not valid.
+   */
+  int add(const char *, int);
+
+  int add(const char *);
+
+  int size() const { return (int)ends.size(); }
+
+  void clear();
+
+  const std::vector<jchar> &getChars() const { return chars; }
+
+  const std::vector<jint> &getEnds() const { return ends; }
+};
+
+#endif
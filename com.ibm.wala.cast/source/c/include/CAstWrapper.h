@@ -2,12 +2,22 @@
 #define _CAST_WRAPPER_H
 
 #include <list>
+#include <map>
+#include <vector>
+#include <string.h>
 #include "jni.h"
 #include "Exceptions.h"
+#include "CAstArena.h"
+#include "CAstConstantFolder.h"
+#include "CAstDeferredBody.h"
+#include "CAstFingerprint.h"
+#include "CAstUtf8.h"
 #include "launch.h"
 
 using namespace std;
 
+class CAstExporter;
+
 
 #ifdef TRACE_CAST_WRAPPER
 #define LOG(x) log(x);
@@ -36,6 +46,10 @@ class CAstWrapper {
 
 
 protected:
+  friend class CAstExporter;
+  friend class CAstPipeline;
+  friend class CAstScopeAnalysis;
+
   JNIEnv *env;
   Exceptions &java_ex;
   jobject xlator;
@@ -48,8 +62,27 @@ protected:
   jmethodID linkedListAdd;
   jfieldID astField;
   jclass AbstractScriptEntity;
+  CAstArena arena;
 
 private:
+  /**
+   *  Gives back the native resources of the wrapper when a THROW skips
+   * its destructor.
+   */
+  class Unwinder : public Exceptions::Guard {
+    CAstWrapper &wrapper;
+
+  public:
+    Unwinder(Exceptions &ex, CAstWrapper &wrapper) : Guard(ex), wrapper(wrapper) { }
+
+  protected:
+    virtual void unwind();
+  };
+  Unwinder unwinder;
+
+  /** streams trees for log(), keeping the kind names it has looked up */
+  CAstExporter *logger;
+
   jclass CAstNode;
   jclass CAstInterface;
   jclass CAstPrinter;
@@ -62,8 +95,9 @@ private:
   jclass NativeGlobalEntity;
   jclass NativeBridge;
   jclass NativeTranslatorToCAst;
+  jclass PackedStrings;
   jmethodID classEntityInit;
-  jmethodID castPrint;
+  jmethodID castKindAsString;
   jmethodID makeNode0;
   jmethodID makeNode1;
   jmethodID makeNode2;
@@ -98,12 +132,237 @@ private:
   jmethodID fieldEntityInit;
   jmethodID globalEntityInit;
   jmethodID _makeLocation;
+  jmethodID _isCanceled;
+  jmethodID _worked;
+  jmethodID _getCachedEntity;
+  jmethodID _cacheEntity;
+  jmethodID _getDuplicateEntity;
+  jmethodID _recordCanonicalEntity;
+  jmethodID unpackStrings;
+  jmethodID _entityCompleted;
+  jmethodID _deferBody;
+  jmethodID _translationEnded;
   jmethodID setNodePosition;
   jmethodID setNodeType;
   jmethodID setPosition;
   jmethodID codeSetGotoTarget;
   jmethodID codeSetLabelledGotoTarget;
+  jmethodID codeSetGotoTargets;
+  jclass JavaObject;
+  jobject trueLabel;
+  jobject falseLabel;
   jobject callReference;
+  vector<CAstFingerprint, CAstArenaAllocator<CAstFingerprint> > fingerprints;
+
+  jlong subtreeFingerprint(jobject);
+
+  jlong fingerprintNode(int, int, jobject *, jobjectArray);
+
+  void fingerprintObject(jobject, CAstFingerprint &);
+
+  void fingerprintConstant(jobject, CAstFingerprint &);
+
+  void fingerprintBuilt(jobject, jlong);
+
+  /**
+   *  What the wrapper worked out about each node it built while a
+   * fingerprint was open, by node id less nodeInfoBase, so that it
+   * can be used when the node becomes a child.  Node ids are only
+   * unique within a factory, so children are taken to come from Ast;
+   * nodes without an id, i.e. those of factories other than CAstImpl,
+   * are not kept.  The table is on the heap rather than in the arena,
+   * so that it can be freed as soon as no fingerprint or size summary
+   * is open and folding is off.
+   */
+  struct NodeInfo {
+    jlong fingerprint;
+    bool fingerprinted;
+    jint first;
+    jint depth;
+  };
+  vector<NodeInfo> nodeInfo;
+  int nodeInfoBase;
+
+  NodeInfo *getNodeInfo(jobject);
+
+  NodeInfo *makeNodeInfo(jobject);
+
+  void releaseNodeInfo();
+
+  /**
+   *  Dense node ids, which CAstImpl gives every node it makes; the
+   * field is NULL when the factory is not a CAstImpl.
+   */
+  jclass CAstNumberedNodeImpl;
+  jfieldID nodeIdField;
+
+  /**
+   *  Types interned by key, so a front end builds each CAstType once
+   * per translation and then names it by a small id.  The keys live
+   * in the arena.
+   */
+  struct KeyLess {
+    bool operator()(const char *a, const char *b) const {
+      return strcmp(a, b) < 0;
+    }
+  };
+  typedef map<const char *, int, KeyLess, CAstArenaAllocator<pair<const char * const, int> > > TypeIds;
+  TypeIds typeIds;
+  jmethodID _internType;
+
+  /**
+   *  Node types set by id, waiting to be passed to Java together.
+   * The buffer holds references of its own, and is flushed when it
+   * fills up and when types are set for another entity.
+   */
+  static const int NODE_TYPE_BATCH = 256;
+  jobject typedEntity;
+  CAstArenaVector<jobject> typedNodes;
+  CAstArenaVector<jint> typedTypeIds;
+  jmethodID _setNodeTypes;
+
+  /**
+   *  Scoped entities added with addChildEntity, waiting to be passed
+   * to Java together, buffered like node types.
+   */
+  static const int SCOPED_ENTITY_BATCH = 256;
+  CAstArenaVector<jobject> scopedParents;
+  CAstArenaVector<jobject> scopedConstructs;
+  CAstArenaVector<jobject> scopedChildren;
+
+  /**
+   *  Pass the buffered node types or scoped entities to Java, without
+   * throwing: the buffers and their references are released whatever
+   * happens, and false is returned if Java has an exception pending,
+   * before or after.  The flush methods throw that exception; the
+   * destructor, which must not, drops it.
+   */
+  bool passNodeTypes();
+
+  bool passScopedEntities();
+
+  /**
+   *  CALL nodes recorded since each open beginCallSites, innermost
+   * last: callFrames holds where each recording starts in callNodes.
+   * The calls are global references, since a recording may span the
+   * frames of streamed entities.
+   */
+  CAstArenaVector<jobject> callNodes;
+  CAstArenaVector<int> callFrames;
+  jmethodID _setCallSites;
+
+  /** drop the calls of recordings never ended */
+  void forgetCallSites();
+
+  void recordCall(jobject);
+
+  /**
+   *  Size summaries being gathered, innermost last (see
+   * beginSizeSummary).  The depth of each node built meanwhile is kept
+   * in its NodeInfo, to work out the depths of their parents without
+   * asking Java; a child without one counts as a leaf.  Kinds past
+   * SUMMARY_KINDS, i.e. those of sub-languages, are only counted in
+   * the total.
+   */
+  static const int SUMMARY_KINDS = 512;
+  struct SizeSummary {
+    jint kindCounts[SUMMARY_KINDS];
+    jint nodeCount;
+    jint maxDepth;
+    jint gotoEdges;
+  };
+  vector<SizeSummary, CAstArenaAllocator<SizeSummary> > sizeSummaries;
+  jmethodID _setSizeSummary;
+
+  int summaryDepth(jobject);
+
+  void summarize(jobject, int, int);
+
+  void summarizeNode(jobject, int, int, jobject *);
+
+  void summarizeNode(jobject, int, jobject, jobjectArray);
+  jclass CAstEntity;
+  jmethodID _addScopedEntities;
+
+  /**
+   *  Recently used qualifier sets for entity constructors, which copy
+   * them, so that one set serves every entity with the same
+   * qualifiers.  The sets and their elements are global references,
+   * since they outlive streamed frames.
+   */
+  static const int QUALIFIER_SETS = 8;
+  struct QualifierSet {
+    int count;
+    jobject *elts;
+    jobject set;
+  } qualifierSets[QUALIFIER_SETS];
+  int nextQualifierSet;
+
+  void forgetQualifierSets();
+
+  jobject qualifierSet(int, jobject *);
+
+  jobject qualifierSet(list<jobject> *);
+
+  jobject qualifierSet(const CAstArenaVector<jobject> &);
+
+  /**
+   *  The most recently built constants with their native values, for
+   * folding.  Only recent ones are kept, since folding mostly happens
+   * right after the operands are built.  Each is kept as the reference
+   * it was built as, to find it quickly, and as a global reference, to
+   * tell it from a later node given the same reference once the first
+   * was deleted or its frame popped.  The characters of a string
+   * constant are copied into a buffer kept with its slot, which later
+   * constants in the slot reuse.
+   */
+  static const int KNOWN_CONSTANTS = 16;
+  struct KnownConstant {
+    jobject node;
+    jobject ref;
+    CAstConstantValue value;
+    char *chars;
+    int capacity;
+  } knownConstants[KNOWN_CONSTANTS];
+  int nextKnownConstant;
+  CAstConstantEvaluator *evaluator;
+
+  /**
+   *  Folding leaves nodes out of the AST that side tables may mention,
+   * and entities then have Java prune those tables (see setEntityAst).
+   * To tell which entities need it, nodes built while folding is on
+   * are stamped from nodeClock, and the NodeInfo of each keeps the
+   * earliest stamp in its subtree, 0 if that is not known.  lastEntry
+   * is the clock when a side table entry was last made, dropClock the
+   * clock at the last fold that left anything out, and dropFirst the
+   * earliest stamp in anything folding left out.
+   */
+  jint nodeClock;
+  jint lastEntry;
+  jint dropClock;
+  jint dropFirst;
+  jmethodID codeAstFolded;
+
+  void stampNode(jobject, int, jobject *, jobjectArray);
+
+  jint firstStamp(jobject);
+
+  void noteEntry();
+
+  void noteDropped(jobject);
+
+  void rememberConstant(jobject, const CAstConstantValue &);
+
+  void forgetConstants();
+
+  jobject fold(int, int, jobject *);
+
+  /**
+   *  The string as NUL-terminated standard UTF-8 in the arena, read
+   * with GetStringChars, as GetStringUTFChars would give modified
+   * UTF-8; NULL for a null string.
+   */
+  const char *copyString(jstring);
 
   static bool initialized;
   static void initialize(JNIEnv *java_env);
@@ -116,6 +375,18 @@ public:
 #define _INCLUDE_OPERATORS 
 #include "cast_operators.h"
 
+  enum OperatorIndex {
+#define _ENUM_OPERATORS
+#include "cast_operators.h"
+    OPERATOR_COUNT
+  };
+
+  /**
+   *  The OperatorIndex of an operator passed as is, or -1 for any
+   * other node.
+   */
+  static int operatorIndex(jobject);
+
 #define _INCLUDE_QUALIFIERS
 #include "cast_qualifiers.h"
 
@@ -126,7 +397,25 @@ public:
 
   CAstWrapper(JNIEnv *env, Exceptions &ex, jobject Ast);
 
-  virtual ~CAstWrapper() { }
+  virtual ~CAstWrapper();
+
+  /**
+   *  The arena holding native memory for the lifetime of this wrapper,
+   * i.e. of one translation; front ends should build their lists of
+   * children, modifiers and the like in it too.
+   */
+  CAstArena &getArena();
+
+  /**
+   *  The Exceptions of the entry point this wrapper was made in, for
+   * registering Exceptions::Guards.
+   */
+  Exceptions &getExceptions();
+
+  /**
+   *  The dense id of a node, or -1 if it has none.
+   */
+  int getNodeId(jobject);
   
   void assertIsCAstNode(jobject, int);
 
@@ -168,6 +457,19 @@ public:
 
   jobject makeConstant(const char *, int);
 
+  /**
+   *  A Java string of standard UTF-8 (see CAstUtf8), rather than the
+   * modified UTF-8 NewStringUTF takes; throws if it is not valid.
+   */
+  jstring makeString(const char *);
+
+  jstring makeString(const char *, int);
+
+  /**
+   *  All the strings of a batch, from one call into Java.
+   */
+  jobjectArray makeStrings(const CAstStringBatch &);
+
   jobject getNthChild(jobject, int);
 
   int getChildCount(jobject);
@@ -182,6 +484,10 @@ public:
 
   bool isSwitchDefaultConstantValue(jobject);
 
+  /**
+   *  The string as standard UTF-8; the result lives in the arena and
+   * must not be freed.
+   */
   const char *getStringConstantValue(jobject);
 
   jobject getConstantValue(jobject);
@@ -192,6 +498,10 @@ public:
 
   jobjectArray makeArray(jclass, list<jobject> *);
 
+  jobjectArray makeArray(const CAstArenaVector<jobject> &);
+
+  jobjectArray makeArray(jclass, const CAstArenaVector<jobject> &);
+
   jobjectArray makeArray(int, jobject[]);
 
   jobjectArray makeArray(jclass, int, jobject[]);
@@ -200,8 +510,16 @@ public:
 
   jobject makeList(list<jobject> *);
 
+  jobject makeSet(const CAstArenaVector<jobject> &);
+
+  jobject makeList(const CAstArenaVector<jobject> &);
+
   jobject getCallReference();
 
+  /**
+   *  The name as standard UTF-8; the result lives in the arena and
+   * must not be freed.
+   */
   const char *getEntityName(jobject);
 
   jobject makeSymbol(const char *);
@@ -212,36 +530,196 @@ public:
 
   jobject makeSymbol(const char *, bool, bool, jobject);
 
+  /**
+   *  Write a tree to stderr in the format of CAstPrinter, streaming it
+   * with a CAstExporter rather than building it as a String first.
+   */
   void log(jobject);
 
+  /**
+   *  Add a scoped entity under a construct of its parent.  Scoped
+   * entities are passed to Java in batches, so they are recorded by
+   * the next flushScopedEntities at the latest, which endStreamedEntity
+   * and the destructor also do.
+   */
   void addChildEntity(jobject, jobject, jobject);
 
+  void flushScopedEntities();
+
   void setGotoTarget(jobject, jobject, jobject);
   
   void setGotoTarget(jobject, jobject, jobject, bool);
   
   void setGotoTarget(jobject, jobject, jobject, jobject);
+
+  /**
+   *  Record count labelled control flow edges of an entity in one call;
+   * the labels may be NULL.
+   */
+  void setGotoTargets(jobject, int, jobject[], jobject[], jobject[]);
   
   void setAstNodeLocation(jobject, jobject, jobject);
 
   void setAstNodeType(jobject, jobject, jobject);
 
+  /**
+   *  The id of the type interned under a key, interning the given type
+   * under it first if there is none and the type is not NULL; -1
+   * otherwise.  Only the first use of a key calls into Java, so front
+   * ends may look types up by key before deciding to build them.
+   */
+  int internType(const char *, jobject);
+
+  /**
+   *  Set the type of a node of an entity to an interned type.  Types
+   * set this way are passed to Java in batches, so they are recorded
+   * by the next flushNodeTypes at the latest, which endStreamedEntity
+   * and the destructor also do.
+   */
+  void setAstNodeType(jobject, jobject, int);
+
+  void flushNodeTypes();
+
   void setLocation(jobject, jobject);
 
   jobject makeLocation(int, int, int, int);
 
+  bool isCanceled();
+
+  void worked(int);
+
   jobject makeFieldEntity(jobject, jobject, bool, list<jobject> *);
 
+  jobject makeFieldEntity(jobject, jobject, bool, const CAstArenaVector<jobject> &);
+
   jobject makeGlobalEntity(char *, jobject, list<jobject> *);
 
+  jobject makeGlobalEntity(char *, jobject, const CAstArenaVector<jobject> &);
+
   jobject makeClassEntity(jobject);
 
   jobject getEntityAst(jobject);
 
   virtual void setEntityAst(jobject, jobject);
 
+  /**
+   *  Leave the body of a code entity to be built when Java first asks
+   * for it, by the given body, which the translator then owns.
+   */
+  void deferEntityBody(jobject, CAstDeferredBody *);
+
   jobject getEntityType(jobject);
 
+  /**
+   *  Start recording the CALL nodes this wrapper builds, until the
+   * matching endCallSites gives them to an entity as its call site
+   * table (see CallSiteTable in Java).  Recordings nest: each call
+   * goes to the innermost one, so a nested function can be recorded
+   * while its parent is being built.  Calls are recorded as they are
+   * built, i.e. those in the arguments of a call before it, which is
+   * the post-order CallSiteTable.of walks the AST in; calls in code
+   * that folding prunes are dropped from the table on the Java side.
+   */
+  void beginCallSites();
+
+  void endCallSites(jobject);
+
+  /**
+   *  Start summarizing the size of what this wrapper builds, until the
+   * matching endSizeSummary gives the summary to an entity (see
+   * EntitySizeSummary in Java): the number of nodes of each kind, the
+   * depth of the deepest one and the number of goto edges.  Summaries
+   * nest like call site recordings.  Nodes that folding prunes are
+   * counted too, so Java recounts the AST of an entity that was folded.
+   */
+  void beginSizeSummary();
+
+  void endSizeSummary(jobject);
+
+  /**
+   *  Start fingerprinting everything this wrapper builds, until the
+   * matching endFingerprint.  Each node built is fingerprinted by its
+   * kind and the fingerprints of its children, in order, and those are
+   * mixed into the fingerprint in the order the nodes are built.  A
+   * child not built through the wrapper while a fingerprint was open,
+   * or made by a factory that does not number its nodes, makes the
+   * fingerprint one that never repeats, so nothing is reused for it.
+   * Fingerprints nest: the fingerprint of a nested entity is folded
+   * into the enclosing one when it ends.  The locations made meanwhile
+   * are part of the fingerprint.  Such a fingerprint is only known
+   * once the entity has been built, so it keys caches of what is computed from the entity; to skip building
+   * an unchanged entity, fingerprint the front end's own parse tree
+   * with a CAstFingerprint and ask getCachedEntity first.
+   */
+  void beginFingerprint();
+
+  jlong endFingerprint();
+
+  /**
+   *  The fingerprint being computed, for front ends that want to
+   * account for things not built through this wrapper.
+   */
+  CAstFingerprint &currentFingerprint();
+
+  /**
+   *  The entity built by an earlier translation under the given key
+   * with the given fingerprint, or NULL if there is none; front ends
+   * can then skip building the entity at all.
+   */
+  jobject getCachedEntity(const char *, jlong);
+
+  void cacheEntity(const char *, jlong, jobject);
+
+  /**
+   *  A copy of the entity some earlier translation built with the
+   * given fingerprint, wherever it was, named and positioned as given
+   * and sharing everything else with the original; NULL if there is
+   * none, if its source is not the same as that at the position, or if
+   * the translator does not share entities.  The
+   * fingerprint must come from the front end's own parse tree, so that
+   * a copy can be found without building anything, and then given to
+   * recordCanonicalEntity with the entity built for it.
+   */
+  jobject getDuplicateEntity(jlong, const char *, jobject);
+
+  void recordCanonicalEntity(jlong, jobject);
+
+  /**
+   *  Build the next top-level entity in a local reference frame of
+   * its own.  The frame is popped by endStreamedEntity, which releases
+   * every local reference made in between.
+   */
+  void beginStreamedEntity(int);
+
+  /**
+   *  Hand a completed top-level entity to the entity stream of the
+   * translator, if it has one, and pop the frame of the matching
+   * beginStreamedEntity.  Returns the entity, as a reference in the
+   * enclosing frame, if there is no stream and the caller should keep
+   * it, and NULL if it has been streamed.
+   */
+  jobject endStreamedEntity(jobject);
+
+  /**
+   *  Fold BINARY_EXPR nodes over known constants, and IF_EXPR and
+   * IF_STMT nodes with constant conditions, as they are built, so that
+   * the folded nodes are never created in Java; a front end that does
+   * this needs no ConstantFoldingRewriter pass.  NULL, the default,
+   * turns folding off.  The evaluator is not owned by the wrapper.
+   * Positions, types, gotos and scoped entities given for nodes that
+   * folding then leaves out are dropped by entities whose AST is set
+   * through setEntityAst.
+   */
+  void setConstantEvaluator(CAstConstantEvaluator *);
+
+  /**
+   *  The native value of n, if it is one of the constants built most
+   * recently through this wrapper while folding is on, or NULL.
+   */
+  const CAstConstantValue *getKnownConstant(jobject n);
+
+  jobject makeConstant(const CAstConstantValue &);
+
   void die(const char *);
 };
 #endif
@@ -21,7 +21,9 @@
  *  The implementation does the obvious dance with setjmp and longjmp, which
  * is one reason it is rather shaky.  For instance, TRY has to be a macro,
  * because otherwise the jump buffer would be invalidated when the TRY function
- * returned.
+ * returned.  Nor are C++ destructors run for the frames a THROW leaves,
+ * so native state that has to be released even then is kept with an
+ * Exceptions::Guard.
  */
 
 #include <jni.h>
@@ -69,12 +71,47 @@ class DLLEXPORT Exceptions {
 class Exceptions {
 #endif
 
+public:
+  /**
+   *  Cleanup that must happen however control leaves the code that
+   * needs it.  Destructors are not enough, since the longjmp of a THROW
+   * skips them: a Guard registers itself with the Exceptions of its
+   * entry point when it is made, and every THROW runs unwind() on the
+   * guards still registered, innermost first, before it jumps to the
+   * CATCH.  On normal exits the destructor just unregisters the guard.
+   *
+   *  unwind() runs with a Java exception pending, so it may only make
+   * the JNI calls allowed then, such as DeleteLocalRef, DeleteGlobalRef
+   * and PopLocalFrame, and it must not THROW.
+   */
+#if __WIN32__
+  class DLLEXPORT Guard {
+#else
+  class Guard {
+#endif
+    friend class Exceptions;
+
+    Exceptions *owner;
+    Guard *next;
+
+  protected:
+    Guard(Exceptions &);
+
+    virtual void unwind() = 0;
+
+  public:
+    virtual ~Guard();
+  };
+
 private:
   JNIEnv *_java_env;
   jmp_buf& _c_env;
   jclass _jre;
   jmethodID _ctr;
   jmethodID _wrapper_ctr;
+  Guard *_guards;
+
+  void unwindGuards();
 
 public:
   Exceptions(JNIEnv *java_env, jmp_buf& c_env);
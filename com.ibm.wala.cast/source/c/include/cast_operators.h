@@ -4,6 +4,12 @@
 #elif defined( _CPP_OPERATORS )
 #define _CAstOperator( __id )    jobject CAstWrapper::__id;
 
+#elif defined( _LIST_OPERATORS )
+#define _CAstOperator( __id )    CAstWrapper::__id,
+
+#elif defined( _ENUM_OPERATORS )
+#define _CAstOperator( __id )    __id##_INDEX,
+
 #elif defined( _CODE_OPERATORS )
 #define _CAstOperator( __id )						\
 {									\
@@ -45,6 +51,8 @@ _CAstOperator(OP_REL_XOR)
 
 #undef _CODE_OPERATORS
 #undef _CPP_OPERATORS
+#undef _LIST_OPERATORS
+#undef _ENUM_OPERATORS
 #undef _INCLUDE_OPERATORS 
 #undef _CAstOperator
 
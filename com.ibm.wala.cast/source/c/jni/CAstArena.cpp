@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <CAstArena.h>
+
+#define HEADER_SIZE ((sizeof(Block) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+
+char *CAstArena::data(Block *b) {
+  return (char *)b + HEADER_SIZE;
+}
+
+CAstArena::CAstArena(size_t blockSize)
+  : blockSize(blockSize), first(NULL), current(NULL),
+    allocationCount(0), allocatedBytes(0), blockCount(0), scratch(NULL)
+{
+
+}
+
+CAstArena::~CAstArena() {
+  release();
+}
+
+void CAstArena::release() {
+  Block *b = first;
+  while (b != NULL) {
+    Block *next = b->next;
+    free(b);
+    b = next;
+  }
+  first = current = NULL;
+
+  delete scratch;
+  scratch = NULL;
+}
+
+CAstArena &CAstArena::scratchArena() {
+  if (scratch == NULL) {
+    scratch = new CAstArena(blockSize);
+  }
+
+  return *scratch;
+}
+
+CAstArena::Block *CAstArena::newBlock(size_t size) {
+  Block *b = (Block *)malloc(HEADER_SIZE + size);
+  if (b == NULL) {
+    throw std::bad_alloc();
+  }
+
+  b->next = NULL;
+  b->size = size;
+  b->used = 0;
+  blockCount++;
+  return b;
+}
+
+void *CAstArena::allocate(size_t bytes, size_t alignment) {
+  allocationCount++;
+  allocatedBytes += bytes;
+
+  for(;;) {
+    if (current != NULL) {
+      size_t start = (current->used + alignment - 1) & ~(alignment - 1);
+      if (start + bytes <= current->size) {
+	current->used = start + bytes;
+	return data(current) + start;
+      }
+    }
+
+    // move on to a spare block left over from an earlier reset or
+    // scope if it is big enough, otherwise insert a fresh one
+    Block *next = current == NULL ? first : current->next;
+    if (next == NULL || next->size < bytes + alignment) {
+      size_t size = bytes + alignment > blockSize ? bytes + alignment : blockSize;
+      Block *b = newBlock(size);
+      b->next = next;
+      if (current == NULL) {
+	first = b;
+      } else {
+	current->next = b;
+      }
+      next = b;
+    }
+
+    next->used = 0;
+    current = next;
+  }
+}
+
+char *CAstArena::strndup(const char *str, size_t len) {
+  char *copy = (char *)allocate(len + 1, 1);
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+char *CAstArena::strdup(const char *str) {
+  return strndup(str, strlen(str));
+}
+
+void CAstArena::reset() {
+  current = first;
+  if (current != NULL) {
+    current->used = 0;
+  }
+
+  if (scratch != NULL) {
+    scratch->reset();
+  }
+}
+
+CAstArena::Scope::Scope(CAstArena &arena)
+  : scratch(arena.scratchArena()),
+    block(scratch.current),
+    used(scratch.current == NULL ? 0 : scratch.current->used)
+{
+
+}
+
+CAstArena::Scope::~Scope() {
+  if (block == NULL) {
+    scratch.reset();
+  } else {
+    scratch.current = block;
+    block->used = used;
+  }
+}
+
+CAstArena &CAstArena::Scope::getArena() {
+  return scratch;
+}
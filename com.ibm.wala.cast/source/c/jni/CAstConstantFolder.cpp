@@ -0,0 +1,124 @@
+#include <math.h>
+#include <stdint.h>
+#include <CAstWrapper.h>
+
+static bool evalIntegral(int op, jlong l, jlong r, bool isLong, CAstConstantValue &result) {
+  jlong v;
+  bool isBool = false;
+  switch (op) {
+  case CAstWrapper::OP_ADD_INDEX: v = (jlong) ((uint64_t) l + (uint64_t) r); break;
+  case CAstWrapper::OP_SUB_INDEX: v = (jlong) ((uint64_t) l - (uint64_t) r); break;
+  case CAstWrapper::OP_MUL_INDEX: v = (jlong) ((uint64_t) l * (uint64_t) r); break;
+  case CAstWrapper::OP_DIV_INDEX:
+    if (r == 0 || (r == -1 && l == (isLong ? INT64_MIN : INT32_MIN))) return false;
+    v = l / r;
+    break;
+  case CAstWrapper::OP_MOD_INDEX:
+    if (r == 0 || r == -1) return false;
+    v = l % r;
+    break;
+  case CAstWrapper::OP_LSH_INDEX: v = (jlong) ((uint64_t) l << (r & (isLong ? 63 : 31))); break;
+  case CAstWrapper::OP_RSH_INDEX: v = l >> (r & (isLong ? 63 : 31)); break;
+  case CAstWrapper::OP_URSH_INDEX:
+    v = isLong ? (jlong) ((uint64_t) l >> (r & 63)) : (jlong) ((uint32_t) l >> (r & 31));
+    break;
+  case CAstWrapper::OP_BIT_AND_INDEX: v = l & r; break;
+  case CAstWrapper::OP_BIT_OR_INDEX: v = l | r; break;
+  case CAstWrapper::OP_BIT_XOR_INDEX: v = l ^ r; break;
+  case CAstWrapper::OP_EQ_INDEX: v = l == r; isBool = true; break;
+  case CAstWrapper::OP_NE_INDEX: v = l != r; isBool = true; break;
+  case CAstWrapper::OP_LT_INDEX: v = l < r; isBool = true; break;
+  case CAstWrapper::OP_LE_INDEX: v = l <= r; isBool = true; break;
+  case CAstWrapper::OP_GT_INDEX: v = l > r; isBool = true; break;
+  case CAstWrapper::OP_GE_INDEX: v = l >= r; isBool = true; break;
+  default: return false;
+  }
+
+  if (isBool) {
+    result.kind = CAstConstantValue::BOOL_VALUE;
+    result.value.b = v != 0;
+  } else if (isLong) {
+    result.kind = CAstConstantValue::LONG_VALUE;
+    result.value.l = v;
+  } else {
+    result.kind = CAstConstantValue::INT_VALUE;
+    result.value.l = (int32_t) v;
+  }
+  return true;
+}
+
+static bool evalReal(int op, double l, double r, bool isDouble, CAstConstantValue &result) {
+  double v;
+  bool isBool = false;
+  switch (op) {
+  case CAstWrapper::OP_ADD_INDEX: v = l + r; break;
+  case CAstWrapper::OP_SUB_INDEX: v = l - r; break;
+  case CAstWrapper::OP_MUL_INDEX: v = l * r; break;
+  case CAstWrapper::OP_DIV_INDEX: v = l / r; break;
+  case CAstWrapper::OP_MOD_INDEX: v = fmod(l, r); break;
+  case CAstWrapper::OP_EQ_INDEX: v = l == r; isBool = true; break;
+  case CAstWrapper::OP_NE_INDEX: v = l != r; isBool = true; break;
+  case CAstWrapper::OP_LT_INDEX: v = l < r; isBool = true; break;
+  case CAstWrapper::OP_LE_INDEX: v = l <= r; isBool = true; break;
+  case CAstWrapper::OP_GT_INDEX: v = l > r; isBool = true; break;
+  case CAstWrapper::OP_GE_INDEX: v = l >= r; isBool = true; break;
+  default: return false;
+  }
+
+  if (isBool) {
+    result.kind = CAstConstantValue::BOOL_VALUE;
+    result.value.b = v != 0;
+  } else if (isDouble) {
+    result.kind = CAstConstantValue::DOUBLE_VALUE;
+    result.value.d = v;
+  } else {
+    result.kind = CAstConstantValue::FLOAT_VALUE;
+    result.value.d = (float) v;
+  }
+  return true;
+}
+
+static bool evalBool(int op, bool l, bool r, CAstConstantValue &result) {
+  bool v;
+  switch (op) {
+  case CAstWrapper::OP_REL_AND_INDEX:
+  case CAstWrapper::OP_BIT_AND_INDEX: v = l && r; break;
+  case CAstWrapper::OP_REL_OR_INDEX:
+  case CAstWrapper::OP_BIT_OR_INDEX: v = l || r; break;
+  case CAstWrapper::OP_REL_XOR_INDEX:
+  case CAstWrapper::OP_BIT_XOR_INDEX:
+  case CAstWrapper::OP_NE_INDEX: v = l != r; break;
+  case CAstWrapper::OP_EQ_INDEX: v = l == r; break;
+  default: return false;
+  }
+
+  result.kind = CAstConstantValue::BOOL_VALUE;
+  result.value.b = v;
+  return true;
+}
+
+bool CAstArithmeticEvaluator::eval(int op,
+				   const CAstConstantValue &lhs,
+				   const CAstConstantValue &rhs,
+				   CAstConstantValue &result,
+				   CAstArena &arena)
+{
+  if (lhs.isIntegral() && rhs.isIntegral()) {
+    // a shift has the type of its left operand alone, so 1 << 40L is an int
+    bool isShift = op == CAstWrapper::OP_LSH_INDEX || op == CAstWrapper::OP_RSH_INDEX || op == CAstWrapper::OP_URSH_INDEX;
+    bool isLong = lhs.kind == CAstConstantValue::LONG_VALUE || (!isShift && rhs.kind == CAstConstantValue::LONG_VALUE);
+    return evalIntegral(op, lhs.value.l, rhs.value.l, isLong, result);
+
+  } else if ((lhs.isReal() || lhs.isIntegral()) && (rhs.isReal() || rhs.isIntegral())) {
+    bool isDouble = lhs.kind == CAstConstantValue::DOUBLE_VALUE || rhs.kind == CAstConstantValue::DOUBLE_VALUE;
+    double l = lhs.isReal() ? lhs.value.d : (double) lhs.value.l;
+    double r = rhs.isReal() ? rhs.value.d : (double) rhs.value.l;
+    return evalReal(op, l, r, isDouble, result);
+
+  } else if (lhs.kind == CAstConstantValue::BOOL_VALUE && rhs.kind == CAstConstantValue::BOOL_VALUE) {
+    return evalBool(op, lhs.value.b, rhs.value.b, result);
+
+  } else {
+    return false;
+  }
+}
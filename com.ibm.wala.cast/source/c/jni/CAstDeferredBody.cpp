@@ -0,0 +1,26 @@
+#include <CAstDeferredBody.h>
+
+CAstDeferredBody::CAstDeferredBody(CAstSourceBuffer *source, jint begin, jint end)
+  : source(source), begin(begin), end(end)
+{
+
+}
+
+CAstDeferredBody::~CAstDeferredBody() {
+
+}
+
+void CAstDeferredBody::addNested(JNIEnv *env, jobject entity) {
+  jobject ref = env->NewGlobalRef(entity);
+  if (ref != NULL) {
+    nested.push_back(ref);
+  }
+}
+
+void CAstDeferredBody::release(JNIEnv *env) {
+  for(size_t i = 0; i < nested.size(); i++) {
+    env->DeleteGlobalRef(nested[i]);
+  }
+  source->release(env);
+  delete this;
+}
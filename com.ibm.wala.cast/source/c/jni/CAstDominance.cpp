@@ -0,0 +1,187 @@
+#include <CAstDominance.h>
+
+/**
+ *  Lay out pairs (from[i], to[i]) as rows by from, keeping the order
+ * in which they were given within each row.
+ */
+void CAstDominance::rows(int rowCount, const std::vector<jint> &from, const std::vector<jint> &to,
+			 std::vector<jint> &start, std::vector<jint> &result)
+{
+  start.assign(rowCount + 1, 0);
+  for(size_t i = 0; i < from.size(); i++) {
+    start[from[i] + 1]++;
+  }
+  for(int r = 0; r < rowCount; r++) {
+    start[r + 1] += start[r];
+  }
+
+  std::vector<jint> next(start.begin(), start.end() - 1);
+  result.resize(from.size());
+  for(size_t i = 0; i < from.size(); i++) {
+    result[next[from[i]]++] = to[i];
+  }
+}
+
+void CAstDominance::reversePostorder(const jint *succStart, const jint *succs, std::vector<jint> &order) {
+  // an explicit stack of (block, next successor) pairs, since the
+  // graphs this is for are too big to recur over
+  std::vector<jint> stack;
+  std::vector<bool> seen(blockCount, false);
+  order.clear();
+
+  seen[entry] = true;
+  stack.push_back(entry);
+  stack.push_back(succStart[entry]);
+  while (! stack.empty()) {
+    int b = stack[stack.size() - 2];
+    int next = stack[stack.size() - 1];
+    if (next < succStart[b + 1]) {
+      stack.back()++;
+      int s = succs[next];
+      if (! seen[s]) {
+	seen[s] = true;
+	stack.push_back(s);
+	stack.push_back(succStart[s]);
+      }
+    } else {
+      order.push_back(b);
+      stack.pop_back();
+      stack.pop_back();
+    }
+  }
+
+  for(size_t i = 0, j = order.size() - 1; i < j; i++, j--) {
+    jint t = order[i];
+    order[i] = order[j];
+    order[j] = t;
+  }
+}
+
+int CAstDominance::intersect(int a, int b) const {
+  while (a != b) {
+    while (rpoNumber[a] > rpoNumber[b]) a = idom[a];
+    while (rpoNumber[b] > rpoNumber[a]) b = idom[b];
+  }
+  return a;
+}
+
+CAstDominance::CAstDominance(int blockCount, int entry, const jint *succStart, const jint *succs)
+  : blockCount(blockCount), entry(entry),
+    rpoNumber(blockCount, -1), idom(blockCount, -1)
+{
+  std::vector<jint> from, to;
+  for(int b = 0; b < blockCount; b++) {
+    for(int i = succStart[b]; i < succStart[b + 1]; i++) {
+      from.push_back(succs[i]);
+      to.push_back(b);
+    }
+  }
+  rows(blockCount, from, to, predStart, preds);
+
+  std::vector<jint> order;
+  reversePostorder(succStart, succs, order);
+  for(size_t i = 0; i < order.size(); i++) {
+    rpoNumber[order[i]] = (jint)i;
+  }
+
+  // the entry is its own dominator while iterating, as in the paper
+  idom[entry] = entry;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for(size_t i = 1; i < order.size(); i++) {
+      int b = order[i];
+      int newIdom = -1;
+      for(int j = predStart[b]; j < predStart[b + 1]; j++) {
+	int p = preds[j];
+	if (idom[p] != -1) {
+	  newIdom = newIdom == -1? p: intersect(p, newIdom);
+	}
+      }
+      if (idom[b] != newIdom) {
+	idom[b] = newIdom;
+	changed = true;
+      }
+    }
+  }
+  idom[entry] = -1;
+
+  // the dominator tree, with children in ascending order
+  from.clear();
+  to.clear();
+  for(int b = 0; b < blockCount; b++) {
+    if (idom[b] != -1) {
+      from.push_back(idom[b]);
+      to.push_back(b);
+    }
+  }
+  rows(blockCount, from, to, treeStart, tree);
+
+  // frontiers: every join is in the frontier of each block from its
+  // predecessors up to, but not including, its immediate dominator;
+  // for the entry that means all the way up
+  std::vector<jint> last(blockCount, -1);
+  from.clear();
+  to.clear();
+  for(int b = 0; b < blockCount; b++) {
+    if (rpoNumber[b] == -1) continue;
+    for(int j = predStart[b]; j < predStart[b + 1]; j++) {
+      int runner = preds[j];
+      if (rpoNumber[runner] == -1) continue;
+      while (runner != -1 && runner != idom[b]) {
+	if (last[runner] != b) {
+	  last[runner] = b;
+	  from.push_back(runner);
+	  to.push_back(b);
+	}
+	runner = idom[runner];
+      }
+    }
+  }
+  rows(blockCount, from, to, frontierStart, frontier);
+}
+
+void CAstDominance::placePhis(int blockCount,
+			      const jint *frontierStart,
+			      const jint *frontier,
+			      int valueCount,
+			      const jint *defStart,
+			      const jint *defs,
+			      std::vector<jint> &phiStart,
+			      std::vector<jint> &phis)
+{
+  // stamps by value, as in AbstractSSAConversion.placePhiNodes, so
+  // that nothing is cleared between values
+  std::vector<jint> hasAlready(blockCount, -1);
+  std::vector<jint> work(blockCount, -1);
+  std::vector<jint> worklist;
+
+  phiStart.assign(1, 0);
+  phis.clear();
+  for(int v = 0; v < valueCount; v++) {
+    worklist.clear();
+    for(int i = defStart[v]; i < defStart[v + 1]; i++) {
+      if (work[defs[i]] != v) {
+	work[defs[i]] = v;
+	worklist.push_back(defs[i]);
+      }
+    }
+
+    for(size_t w = 0; w < worklist.size(); w++) {
+      int x = worklist[w];
+      for(int i = frontierStart[x]; i < frontierStart[x + 1]; i++) {
+	int y = frontier[i];
+	if (hasAlready[y] != v) {
+	  hasAlready[y] = v;
+	  phis.push_back(y);
+	  if (work[y] != v) {
+	    work[y] = v;
+	    worklist.push_back(y);
+	  }
+	}
+      }
+    }
+
+    phiStart.push_back((jint)phis.size());
+  }
+}
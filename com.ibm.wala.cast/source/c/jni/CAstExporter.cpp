@@ -0,0 +1,231 @@
+#include <CAstExporter.h>
+
+CAstExporter::CAstExporter(CAstWrapper &CAst, FILE *out, Format format)
+  : CAst(CAst), out(out), format(format), nextId(0)
+{
+
+}
+
+const char *CAstExporter::kindName(int kind) {
+  if (kind >= 0 && kind < (int)kindKnown.size() && kindKnown[kind]) {
+    return kindNames[kind].c_str();
+  }
+
+  JNIEnv *env = CAst.env;
+  jstring jstr = (jstring)env->CallStaticObjectMethod(CAst.CAstPrinter, CAst.castKindAsString, kind);
+  THROW_ANY_EXCEPTION(CAst.java_ex);
+  size_t length;
+  const char *cstr = toUtf8(jstr, &length);
+
+  // negative kinds are rare, and are looked up every time
+  std::string *name = &otherKindName;
+  if (kind >= 0) {
+    if (kind >= (int)kindNames.size()) {
+      kindNames.resize(kind + 1);
+      kindKnown.resize(kind + 1, false);
+    }
+    kindKnown[kind] = true;
+    name = &kindNames[kind];
+  }
+  name->assign(cstr, length);
+  env->DeleteLocalRef(jstr);
+
+  return name->c_str();
+}
+
+const char *CAstExporter::toUtf8(jstring jstr, size_t *length) {
+  if (jstr == NULL) {
+    *length = 4;
+    return "null";
+  }
+
+  JNIEnv *env = CAst.env;
+  jsize len = env->GetStringLength(jstr);
+  const jchar *chars = env->GetStringChars(jstr, NULL);
+  THROW_ANY_EXCEPTION(CAst.java_ex);
+  if (chars == NULL) {
+    THROW(CAst.java_ex, "cannot get the chars of a string");
+  }
+
+  utf8.resize(3 * (size_t)len + 1);
+  int n = CAstUtf8::fromUtf16(chars, len, &utf8[0]);
+  env->ReleaseStringChars(jstr, chars);
+  utf8[n] = '\0';
+
+  *length = (size_t)n;
+  return &utf8[0];
+}
+
+void CAstExporter::writeString(const char *s) {
+  fputs(s, out);
+}
+
+void CAstExporter::writeEscaped(const char *s) {
+  writeEscaped(s, strlen(s));
+}
+
+void CAstExporter::writeEscaped(const char *s, size_t length) {
+  if (format == TEXT) {
+    fwrite(s, 1, length, out);
+    return;
+  }
+
+  for(const char *p = s; p < s + length; p++) {
+    unsigned char c = (unsigned char)*p;
+    if (c == '"' || c == '\\') {
+      fputc('\\', out);
+      fputc(c, out);
+    } else if (c == '\n') {
+      fputs("\\n", out);
+    } else if (c < 0x20) {
+      if (format == JSON) {
+	fprintf(out, "\\u%04x", c);
+      } else {
+	fputc(' ', out);
+      }
+    } else {
+      fputc(c, out);
+    }
+  }
+}
+
+void CAstExporter::indent(size_t depth) {
+  for(size_t i = 0; i < depth; i++) {
+    fputs("  ", out);
+  }
+}
+
+bool CAstExporter::enter(jobject node) {
+  JNIEnv *env = CAst.env;
+  size_t depth = stack.size();
+  long id = nextId++;
+
+  if (node == NULL) {
+    switch (format) {
+    case TEXT: indent(depth); writeString("(null)\n"); break;
+    case JSON: writeString("null"); break;
+    case DOT: fprintf(out, "  n%ld [label=\"(null)\"];\n", id); break;
+    }
+    return false;
+  }
+
+  jobject value = CAst.getConstantValue(node);
+  if (value != NULL) {
+    jstring jstr = (jstring)env->CallObjectMethod(value, CAst.toString);
+    THROW_ANY_EXCEPTION(CAst.java_ex);
+    size_t length;
+    const char *cstr = toUtf8(jstr, &length);
+    switch (format) {
+    case TEXT:
+      indent(depth);
+      fputc('"', out);
+      writeEscaped(cstr, length);
+      writeString("\"\n");
+      break;
+    case JSON:
+      writeString("{\"value\":\"");
+      writeEscaped(cstr, length);
+      writeString("\"}");
+      break;
+    case DOT:
+      fprintf(out, "  n%ld [shape=box,label=\"\\\"", id);
+      writeEscaped(cstr, length);
+      writeString("\\\"\"];\n");
+      break;
+    }
+    if (jstr != NULL) {
+      env->DeleteLocalRef(jstr);
+    }
+    env->DeleteLocalRef(value);
+    return false;
+  }
+
+  const char *kind = kindName(CAst.getKind(node));
+  int childCount = CAst.getChildCount(node);
+  switch (format) {
+  case TEXT:
+    indent(depth);
+    writeString(kind);
+    fputc('\n', out);
+    break;
+  case JSON:
+    writeString("{\"kind\":\"");
+    writeEscaped(kind);
+    writeString(childCount > 0 ? "\",\"children\":[" : "\",\"children\":[]}");
+    break;
+  case DOT:
+    fprintf(out, "  n%ld [label=\"", id);
+    writeEscaped(kind);
+    writeString("\"];\n");
+    break;
+  }
+
+  if (childCount == 0) {
+    return false;
+  }
+
+  // every open frame holds one local reference
+  if (stack.size() % 64 == 0) {
+    env->EnsureLocalCapacity((jint)stack.size() + 64 + 16);
+  }
+
+  Frame f;
+  f.node = node;
+  f.childCount = childCount;
+  f.nextChild = 0;
+  f.id = id;
+  stack.push_back(f);
+  return true;
+}
+
+void CAstExporter::leave() {
+  if (format == JSON) {
+    writeString("]}");
+  }
+}
+
+void CAstExporter::exportTree(jobject top) {
+  JNIEnv *env = CAst.env;
+
+  // a THROW may have left the last tree half written
+  stack.clear();
+  nextId = 0;
+
+  if (format == DOT) {
+    writeString("digraph CAst {\n");
+  }
+
+  enter(top);
+  while (! stack.empty()) {
+    Frame &f = stack.back();
+    if (f.nextChild < f.childCount) {
+      if (format == JSON && f.nextChild > 0) {
+	fputc(',', out);
+      }
+      if (format == DOT) {
+	fprintf(out, "  n%ld -> n%ld;\n", f.id, nextId);
+      }
+
+      jobject child = CAst.getNthChild(f.node, f.nextChild++);
+      if (! enter(child) && child != NULL) {
+	env->DeleteLocalRef(child);
+      }
+
+    } else {
+      jobject done = f.node;
+      stack.pop_back();
+      leave();
+      if (done != top) {
+	env->DeleteLocalRef(done);
+      }
+    }
+  }
+
+  switch (format) {
+  case TEXT: break;
+  case JSON: fputc('\n', out); break;
+  case DOT: writeString("}\n"); break;
+  }
+
+  fflush(out);
+}
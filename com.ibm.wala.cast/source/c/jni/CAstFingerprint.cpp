@@ -0,0 +1,90 @@
+#include <string.h>
+#include <CAstFingerprint.h>
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+/* distinct tags keep e.g. a node and an integer constant with the
+   same bits from hashing alike */
+enum {
+  TAG_NODE = 1,
+  TAG_BOOL,
+  TAG_INTEGER,
+  TAG_REAL,
+  TAG_STRING,
+  TAG_ENTITY,
+  TAG_POSITION,
+  TAG_SUBTREE
+};
+
+CAstFingerprint::CAstFingerprint() : hash(FNV_OFFSET_BASIS) { }
+
+void CAstFingerprint::mix(jlong v) {
+  unsigned long long h = hash;
+  for(int i = 0; i < 8; i++) {
+    h ^= (v >> (i * 8)) & 0xff;
+    h *= FNV_PRIME;
+  }
+  hash = h;
+}
+
+void CAstFingerprint::node(int kind, int childCount) {
+  mix(TAG_NODE);
+  mix(((jlong)kind << 32) | (unsigned) childCount);
+}
+
+void CAstFingerprint::constant(bool v) {
+  mix(TAG_BOOL);
+  mix(v);
+}
+
+void CAstFingerprint::constant(jlong v) {
+  mix(TAG_INTEGER);
+  mix(v);
+}
+
+void CAstFingerprint::constant(double v) {
+  jlong bits;
+  memcpy(&bits, &v, sizeof(jlong));
+  mix(TAG_REAL);
+  mix(bits);
+}
+
+void CAstFingerprint::constant(const char *str) {
+  constant(str, strlen(str));
+}
+
+void CAstFingerprint::constant(const char *str, int len) {
+  mix(TAG_STRING);
+  mix(len);
+  unsigned long long h = hash;
+  for(int i = 0; i < len; i++) {
+    h ^= (unsigned char) str[i];
+    h *= FNV_PRIME;
+  }
+  hash = h;
+}
+
+void CAstFingerprint::position(int firstLine, int firstCol, int lastLine, int lastCol) {
+  mix(TAG_POSITION);
+  mix(((jlong)firstLine << 32) | (unsigned) firstCol);
+  mix(((jlong)lastLine << 32) | (unsigned) lastCol);
+}
+
+void CAstFingerprint::subtree(jlong fingerprint) {
+  mix(TAG_SUBTREE);
+  mix(fingerprint);
+}
+
+void CAstFingerprint::entity(const CAstFingerprint &nested) {
+  mix(TAG_ENTITY);
+  mix(nested.value());
+}
+
+jlong CAstFingerprint::value() const {
+  // final avalanche, so that nearby inputs do not give nearby keys
+  unsigned long long z = hash;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return (jlong) (z ^ (z >> 31));
+}
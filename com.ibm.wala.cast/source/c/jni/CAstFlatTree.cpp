@@ -0,0 +1,64 @@
+#include <CAstFlatTree.h>
+
+/** stands in for the addresses of empty buffers */
+static jint none[1];
+
+CAstFlatTree::CAstFlatTree()
+  : nodeCount(0), rootCount(0),
+    kinds(none), childStart(none), children(none), valueIds(none), roots(none)
+{
+
+}
+
+static const jint *buffer(JNIEnv *env, jclass cls, jobject tree, const char *name, jlong *capacity) {
+  jfieldID field = env->GetFieldID(cls, name, "Ljava/nio/IntBuffer;");
+  if (field == NULL) {
+    return NULL;
+  }
+  jobject b = env->GetObjectField(tree, field);
+  if (b == NULL) {
+    return NULL;
+  }
+
+  *capacity = env->GetDirectBufferCapacity(b);
+  void *address = env->GetDirectBufferAddress(b);
+  if (address == NULL && *capacity > 0) {
+    return NULL;
+  }
+  return address == NULL ? none : (const jint *)address;
+}
+
+bool CAstFlatTree::attach(JNIEnv *env, jobject tree) {
+  jclass cls = env->FindClass("com/ibm/wala/cast/util/CAstFlatTree");
+  if (cls == NULL) {
+    return false;
+  }
+  jmethodID count = env->GetMethodID(cls, "getNodeCount", "()I");
+  if (count == NULL) {
+    return false;
+  }
+  nodeCount = env->CallIntMethod(tree, count);
+  if (env->ExceptionCheck()) {
+    return false;
+  }
+
+  jlong capacity;
+  jlong rootCapacity;
+  if ((kinds = buffer(env, cls, tree, "kinds", &capacity)) == NULL ||
+      (childStart = buffer(env, cls, tree, "childStart", &capacity)) == NULL ||
+      (children = buffer(env, cls, tree, "children", &capacity)) == NULL ||
+      (valueIds = buffer(env, cls, tree, "constants", &capacity)) == NULL ||
+      (roots = buffer(env, cls, tree, "roots", &rootCapacity)) == NULL)
+  {
+    if (! env->ExceptionCheck()) {
+      jclass err = env->FindClass("java/lang/IllegalStateException");
+      if (err != NULL) {
+	env->ThrowNew(err, "flat tree is not in direct buffers");
+      }
+    }
+    return false;
+  }
+
+  rootCount = (int)rootCapacity;
+  return true;
+}
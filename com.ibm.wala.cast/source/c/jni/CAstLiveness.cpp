@@ -0,0 +1,187 @@
+#include <string.h>
+#include <CAstLiveness.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+typedef CAstLiveness::word word;
+
+/** to |= from */
+static void unionInto(word *to, const word *from, int words) {
+#if defined(__AVX2__)
+  for(int i = 0; i < words; i += 8) {
+    __m256i t = _mm256_loadu_si256((const __m256i *)(to + i));
+    __m256i f = _mm256_loadu_si256((const __m256i *)(from + i));
+    _mm256_storeu_si256((__m256i *)(to + i), _mm256_or_si256(t, f));
+  }
+#elif defined(__SSE2__)
+  for(int i = 0; i < words; i += 4) {
+    __m128i t = _mm_loadu_si128((const __m128i *)(to + i));
+    __m128i f = _mm_loadu_si128((const __m128i *)(from + i));
+    _mm_storeu_si128((__m128i *)(to + i), _mm_or_si128(t, f));
+  }
+#else
+  for(int i = 0; i < words; i++) {
+    to[i] |= from[i];
+  }
+#endif
+}
+
+/**
+ *  in = gen | (out & ~kill); returns whether in changed
+ */
+static bool transfer(word *in, const word *gen, const word *out, const word *kill, int words) {
+  bool changed = false;
+#if defined(__AVX2__)
+  for(int i = 0; i < words; i += 8) {
+    __m256i g = _mm256_loadu_si256((const __m256i *)(gen + i));
+    __m256i o = _mm256_loadu_si256((const __m256i *)(out + i));
+    __m256i k = _mm256_loadu_si256((const __m256i *)(kill + i));
+    __m256i old = _mm256_loadu_si256((const __m256i *)(in + i));
+    __m256i now = _mm256_or_si256(g, _mm256_andnot_si256(k, o));
+    __m256i diff = _mm256_xor_si256(old, now);
+    if (! _mm256_testz_si256(diff, diff)) {
+      changed = true;
+      _mm256_storeu_si256((__m256i *)(in + i), now);
+    }
+  }
+#elif defined(__SSE2__)
+  for(int i = 0; i < words; i += 4) {
+    __m128i g = _mm_loadu_si128((const __m128i *)(gen + i));
+    __m128i o = _mm_loadu_si128((const __m128i *)(out + i));
+    __m128i k = _mm_loadu_si128((const __m128i *)(kill + i));
+    __m128i old = _mm_loadu_si128((const __m128i *)(in + i));
+    __m128i now = _mm_or_si128(g, _mm_andnot_si128(k, o));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(old, now)) != 0xFFFF) {
+      changed = true;
+      _mm_storeu_si128((__m128i *)(in + i), now);
+    }
+  }
+#else
+  for(int i = 0; i < words; i++) {
+    word now = gen[i] | (out[i] & ~kill[i]);
+    if (now != in[i]) {
+      changed = true;
+      in[i] = now;
+    }
+  }
+#endif
+  return changed;
+}
+
+CAstLiveness::CAstLiveness(int blockCount,
+			   int exit,
+			   int words,
+			   const jint *opStart,
+			   const jint *ops)
+  : blockCount(blockCount), exit(exit), words(words),
+    gen((size_t)blockCount * words, 0),
+    kill((size_t)blockCount * words, 0),
+    liveIn((size_t)blockCount * words, 0),
+    liveOut((size_t)blockCount * words, 0)
+{
+  // applying the ops in order to the values live after a block is the
+  // same as gen | (live & ~kill), where v sets the gen bit, and ~v
+  // clears it and sets the kill bit
+  for(int b = 0; b < blockCount; b++) {
+    word *g = &gen[(size_t)b * words];
+    word *k = &kill[(size_t)b * words];
+    for(int i = opStart[b]; i < opStart[b + 1]; i++) {
+      int v = ops[i];
+      if (v >= 0) {
+	g[v >> 5] |= 1u << (v & 31);
+      } else {
+	v = ~v;
+	g[v >> 5] &= ~(1u << (v & 31));
+	k[v >> 5] |= 1u << (v & 31);
+      }
+    }
+    if (b == exit) {
+      memset(k, 0xFF, words * sizeof(word));
+    }
+  }
+}
+
+void CAstLiveness::postorder(const jint *succStart, const jint *succs, std::vector<jint> &order) {
+  std::vector<jint> stack;
+  std::vector<bool> seen(blockCount, false);
+  order.clear();
+
+  // every block is a root in turn, so that blocks the entry does not
+  // reach are solved too, as the Java solver does
+  for(int root = 0; root < blockCount; root++) {
+    if (seen[root]) continue;
+    seen[root] = true;
+    stack.push_back(root);
+    stack.push_back(succStart[root]);
+    while (! stack.empty()) {
+      int b = stack[stack.size() - 2];
+      int next = stack[stack.size() - 1];
+      if (next < succStart[b + 1]) {
+	stack.back()++;
+	int s = succs[next];
+	if (! seen[s]) {
+	  seen[s] = true;
+	  stack.push_back(s);
+	  stack.push_back(succStart[s]);
+	}
+      } else {
+	order.push_back(b);
+	stack.pop_back();
+	stack.pop_back();
+      }
+    }
+  }
+}
+
+void CAstLiveness::solve(const jint *succStart, const jint *succs) {
+  std::vector<jint> predStart(blockCount + 1, 0);
+  for(int b = 0; b < blockCount; b++) {
+    for(int i = succStart[b]; i < succStart[b + 1]; i++) {
+      predStart[succs[i] + 1]++;
+    }
+  }
+  for(int b = 0; b < blockCount; b++) {
+    predStart[b + 1] += predStart[b];
+  }
+  std::vector<jint> preds(predStart[blockCount]);
+  std::vector<jint> next(predStart.begin(), predStart.end() - 1);
+  for(int b = 0; b < blockCount; b++) {
+    for(int i = succStart[b]; i < succStart[b + 1]; i++) {
+      preds[next[succs[i]]++] = b;
+    }
+  }
+
+  std::vector<jint> order;
+  postorder(succStart, succs, order);
+
+  std::vector<char> dirty(blockCount, 1);
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for(size_t j = 0; j < order.size(); j++) {
+      int b = order[j];
+      if (! dirty[b]) continue;
+      dirty[b] = 0;
+
+      word *out = &liveOut[(size_t)b * words];
+      memset(out, 0, words * sizeof(word));
+      for(int i = succStart[b]; i < succStart[b + 1]; i++) {
+	unionInto(out, &liveIn[(size_t)succs[i] * words], words);
+      }
+
+      if (transfer(&liveIn[(size_t)b * words],
+		   &gen[(size_t)b * words],
+		   out,
+		   &kill[(size_t)b * words],
+		   words))
+      {
+	changed = true;
+	for(int i = predStart[b]; i < predStart[b + 1]; i++) {
+	  dirty[preds[i]] = 1;
+	}
+      }
+    }
+  }
+}
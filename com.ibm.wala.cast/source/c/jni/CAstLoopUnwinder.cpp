@@ -0,0 +1,168 @@
+#include <CAstLoopUnwinder.h>
+
+CAstLoopUnwinder::CAstLoopUnwinder(const jint *kinds,
+				   const jint *childStart,
+				   const jint *children,
+				   const jbyte *pinned,
+				   int nodeCount,
+				   int loopKind,
+				   int unwindFactor)
+  : kinds(kinds), childStart(childStart), children(children), pinned(pinned),
+    loopKind(loopKind), unwindFactor(unwindFactor),
+    state(nodeCount, UNKNOWN), recordCount(0)
+{
+
+}
+
+bool CAstLoopUnwinder::copied(int n) {
+  if (state[n] == UNKNOWN) {
+    Frame top = { n, 0, 0, 0, 0, 0 };
+    std::vector<Frame> pending(1, top);
+    while (! pending.empty()) {
+      Frame &f = pending.back();
+      if (f.step < childCount(f.node)) {
+	// every child is looked at, so that shared subtrees are
+	// decided once
+	int c = child(f.node, f.step++);
+	if (state[c] == UNKNOWN) {
+	  Frame next = { c, 0, 0, 0, 0, 0 };
+	  pending.push_back(next);
+	}
+      } else {
+	int m = f.node;
+	pending.pop_back();
+	bool copy = pinned[m] != 0 || kinds[m] == loopKind;
+	for(int i = 0; i < childCount(m); i++) {
+	  copy |= state[child(m, i)] == COPIED;
+	}
+	state[m] = copy? COPIED: SHARED;
+      }
+    }
+  }
+
+  return state[n] == COPIED;
+}
+
+int CAstLoopUnwinder::key(int iteration, int parent) {
+  keys.push_back(iteration);
+  keys.push_back(parent);
+  return (int)(keys.size() / 2) - 1;
+}
+
+int CAstLoopUnwinder::record(int op, const jint *operands, int count) {
+  records.push_back(op);
+  records.insert(records.end(), operands, operands + count);
+  return ~(recordCount++);
+}
+
+/**
+ *  Start on n under key k; a node outside every loop, which is when k
+ * is -1, that needs no copy is its own reference right away.
+ */
+void CAstLoopUnwinder::push(int n, int k) {
+  if (k < 0 && ! copied(n)) {
+    values.push_back(n);
+  } else {
+    Frame f = { n, k, 0, 0, -1, 0 };
+    stack.push_back(f);
+  }
+}
+
+/**
+ *  Take the innermost node one step further: start on its next child,
+ * or, once the children it needs are done, record it, leaving its
+ * reference on the value stack.
+ */
+void CAstLoopUnwinder::step() {
+  Frame &f = stack.back();
+  int n = f.node;
+  int k = f.key;
+
+  if (kinds[n] == loopKind) {
+    // the same nesting, and the same keys, as AstLoopUnwinder.copyNodes
+    int test = child(n, 0);
+    int body = child(n, 1);
+    switch (f.step) {
+    case 0:
+      f.step = 1;
+      push(test, key(unwindFactor, k));
+      break;
+
+    case 1: {
+      jint last = values.back();
+      values.pop_back();
+      f.code = record(ASSERT_NOT, &last, 1);
+      f.count = unwindFactor;
+      f.step = 2;
+      break;
+    }
+
+    case 2:
+      if (f.count-- > 0) {
+	f.iterationKey = key(f.count, k);
+	f.step = 3;
+	push(test, f.iterationKey);
+      } else {
+	jint code = f.code;
+	stack.pop_back();
+	values.push_back(code);
+      }
+      break;
+
+    case 3:
+      f.step = 4;
+      push(body, f.iterationKey);
+      break;
+
+    default: {
+      jint iteration[3];
+      iteration[1] = values.back();
+      values.pop_back();
+      iteration[0] = values.back();
+      values.pop_back();
+      iteration[2] = f.code;
+      f.code = record(ITERATION, iteration, 3);
+      f.step = 2;
+    }
+    }
+
+  } else if (f.step < childCount(n)) {
+    int c = child(n, f.step++);
+    push(c, k);
+
+  } else {
+    int count = childCount(n);
+    operands.clear();
+    operands.push_back(n);
+    operands.push_back(k);
+    operands.push_back(count);
+    operands.insert(operands.end(), values.end() - count, values.end());
+    values.resize(values.size() - count);
+    stack.pop_back();
+    values.push_back(record(COPY, operands.data(), (int)operands.size()));
+  }
+}
+
+int CAstLoopUnwinder::unwind(int n, int k) {
+  stack.clear();
+  values.clear();
+  push(n, k);
+  while (! stack.empty()) {
+    step();
+  }
+  return values.back();
+}
+
+void CAstLoopUnwinder::unwind(int root, std::vector<jint> &result) {
+  keys.clear();
+  records.clear();
+  recordCount = 0;
+
+  int top = unwind(root, -1);
+
+  result.clear();
+  result.push_back(top);
+  result.push_back((jint)(keys.size() / 2));
+  result.insert(result.end(), keys.begin(), keys.end());
+  result.insert(result.end(), records.begin(), records.end());
+}
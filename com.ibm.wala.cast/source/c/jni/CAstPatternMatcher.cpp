@@ -0,0 +1,161 @@
+#include <CAstPatternMatcher.h>
+
+CAstPatternMatcher::CAstPatternMatcher(const jint *program,
+				       const jbyte *predicates,
+				       int valueCount,
+				       const jint *kinds,
+				       const jint *childStart,
+				       const jint *children,
+				       const jint *valueIds)
+  : program(program), predicates(predicates), valueCount(valueCount),
+    kinds(kinds), childStart(childStart), children(children), valueIds(valueIds)
+{
+
+}
+
+void CAstPatternMatcher::bind(int p, int n) {
+  if (name(p) >= 0) {
+    bindings.push_back(name(p));
+    bindings.push_back(n);
+  }
+}
+
+bool CAstPatternMatcher::tryMatch(int p, int n) {
+  size_t mark = bindings.size();
+  if (match(p, n)) {
+    return true;
+  } else {
+    bindings.resize(mark);
+    return false;
+  }
+}
+
+bool CAstPatternMatcher::tryMatchChildren(int n, int i, int p, int j) {
+  size_t mark = bindings.size();
+  if (matchChildren(n, i, p, j)) {
+    return true;
+  } else {
+    bindings.resize(mark);
+    return false;
+  }
+}
+
+/**
+ *  The tail calls of CAstPattern.matchChildren are iterations here, so
+ * that wide child lists do not deepen the stack; only the backtracking
+ * of ** and optional patterns recurses, and then always on to a later
+ * pattern child, so no deeper than the pattern is wide.
+ */
+bool CAstPatternMatcher::matchChildren(int n, int i, int p, int j) {
+  int count = childCount(n);
+  int patterns = patternChildCount(p);
+  while (true) {
+    if (j >= patterns) {
+      return i >= count;
+    }
+
+    int cp = patternChild(p, j);
+    if (i >= count) {
+      switch (kind(cp)) {
+      case CHILDREN_KIND:
+      case OPTIONAL_PATTERN_KIND:
+      case REPEATED_PATTERN_KIND:
+	j++;
+	continue;
+
+      default:
+	return false;
+      }
+    }
+
+    int c = child(n, i);
+    switch (kind(cp)) {
+    case CHILD_KIND:
+      bind(cp, c);
+      i++;
+      j++;
+      break;
+
+    case CHILDREN_KIND:
+      if (tryMatchChildren(n, i, p, j + 1)) {
+	return true;
+      }
+      bind(cp, c);
+      i++;
+      break;
+
+    case REPEATED_PATTERN_KIND:
+      if (tryMatch(patternChild(cp, 0), c)) {
+	bind(cp, c);
+	i++;
+      } else {
+	j++;
+      }
+      break;
+
+    case OPTIONAL_PATTERN_KIND:
+      if (tryMatchChildren(n, i, p, j + 1)) {
+	return true;
+      } else if (tryMatch(patternChild(cp, 0), c)) {
+	i++;
+	j++;
+      } else {
+	return false;
+      }
+      break;
+
+    default:
+      if (! match(cp, c)) {
+	return false;
+      }
+      i++;
+      j++;
+    }
+  }
+}
+
+bool CAstPatternMatcher::match(int p, int n) {
+  switch (kind(p)) {
+  case REFERENCE_PATTERN_KIND:
+    return operand(p) >= 0 && match(operand(p), n);
+
+  case ALTERNATIVE_PATTERN_KIND:
+    for(int j = 0; j < patternChildCount(p); j++) {
+      if (tryMatch(patternChild(p, j), n)) {
+	bind(p, n);
+	return true;
+      }
+    }
+    return false;
+
+  case VALUE_PATTERN_KIND:
+    if (valueIds[n] < 0 || ! predicates[operand(p) * valueCount + valueIds[n]]) {
+      return false;
+    }
+    break;
+
+  default:
+    if (kinds[n] != kind(p)) {
+      return false;
+    }
+  }
+
+  bind(p, n);
+
+  if (patternChildCount(p) == 0) {
+    return childCount(n) == 0;
+  } else {
+    return matchChildren(n, 0, p, 0);
+  }
+}
+
+void CAstPatternMatcher::findAll(int start, const jint *roots, int rootCount, std::vector<jint> &results) {
+  for(int r = 0; r < rootCount; r++) {
+    bindings.clear();
+    if (match(start, roots[r])) {
+      results.push_back(roots[r]);
+      results.push_back((jint)(bindings.size() / 2));
+      results.insert(results.end(), bindings.begin(), bindings.end());
+    }
+  }
+}
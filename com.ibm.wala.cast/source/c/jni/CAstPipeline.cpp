@@ -0,0 +1,489 @@
+#include <string.h>
+#include <CAstPipeline.h>
+
+#define HANDLE_OWNER(h) ((int) ((h) >> 32))
+#define HANDLE_INDEX(h) ((size_t) ((h) & 0xffffffffLL))
+
+bool CAstPipeline::BatchQueue::push(Batch *batch) {
+  unsigned t = tail.load(std::memory_order_relaxed);
+  if (t - head.load(std::memory_order_acquire) == CAPACITY) {
+    return false;
+  }
+
+  slots[t % CAPACITY] = batch;
+  tail.store(t + 1, std::memory_order_release);
+  return true;
+}
+
+CAstPipeline::Batch *CAstPipeline::BatchQueue::pop() {
+  unsigned h = head.load(std::memory_order_relaxed);
+  if (h == tail.load(std::memory_order_acquire)) {
+    return NULL;
+  }
+
+  Batch *batch = slots[h % CAPACITY];
+  head.store(h + 1, std::memory_order_release);
+  return batch;
+}
+
+unsigned long CAstPipeline::Signal::current() {
+  std::lock_guard<std::mutex> guard(lock);
+  return count;
+}
+
+void CAstPipeline::Signal::notify() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    count++;
+  }
+  changed.notify_all();
+}
+
+void CAstPipeline::Signal::wait(unsigned long seen) {
+  std::unique_lock<std::mutex> guard(lock);
+  while (count == seen) {
+    changed.wait(guard);
+  }
+}
+
+CAstPipeline::Producer::Producer(int id, const std::atomic<bool> &cancelled, Signal &signal)
+  : id(id), nextHandle(0), current(new Batch()), closed(false), cancelled(cancelled), signal(signal)
+{
+  current->commands.reserve(BATCH_SIZE);
+}
+
+CAstPipeline::Producer::~Producer() {
+  delete current;
+  while (Batch *b = full.pop()) delete b;
+  while (Batch *b = empty.pop()) delete b;
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::emit(Command &c, bool hasValue) {
+  current->commands.push_back(c);
+
+  Handle h = hasValue? ((jlong)id << 32) | nextHandle++: -1;
+  if (current->commands.size() >= BATCH_SIZE) {
+    flush();
+  }
+
+  return h;
+}
+
+CAstPipeline::Handle
+  CAstPipeline::Producer::record(Op op, int kind, int count, const Handle *operands)
+{
+  Command c;
+  memset(&c, 0, sizeof(Command));
+  c.op = op;
+  c.kind = kind;
+  c.first = current->operands.size();
+  c.count = count;
+  current->operands.insert(current->operands.end(), operands, operands + count);
+  return emit(c, true);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::constant(Op op, jlong value) {
+  Command c;
+  memset(&c, 0, sizeof(Command));
+  c.op = op;
+  c.value.l = value;
+  return emit(c, true);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeNode(int kind) {
+  return record(NODE, kind, 0, NULL);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeNode(int kind, Handle c1) {
+  Handle cs[] = { c1 };
+  return record(NODE, kind, 1, cs);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeNode(int kind, Handle c1, Handle c2) {
+  Handle cs[] = { c1, c2 };
+  return record(NODE, kind, 2, cs);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeNode(int kind, Handle c1, Handle c2, Handle c3) {
+  Handle cs[] = { c1, c2, c3 };
+  return record(NODE, kind, 3, cs);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeNode(int kind, Handle c1, Handle c2, Handle c3, Handle c4) {
+  Handle cs[] = { c1, c2, c3, c4 };
+  return record(NODE, kind, 4, cs);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeNode(int kind, int count, const Handle cs[]) {
+  return record(NODE, kind, count, cs);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeConstant(bool val) {
+  return constant(CONSTANT_BOOL, val);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeConstant(char val) {
+  return constant(CONSTANT_CHAR, val);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeConstant(short val) {
+  return constant(CONSTANT_SHORT, val);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeConstant(int val) {
+  return constant(CONSTANT_INT, val);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeConstant(long val) {
+  return constant(CONSTANT_LONG, val);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeConstant(double val) {
+  Command c;
+  memset(&c, 0, sizeof(Command));
+  c.op = CONSTANT_DOUBLE;
+  c.value.d = val;
+  return emit(c, true);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeConstant(float val) {
+  Command c;
+  memset(&c, 0, sizeof(Command));
+  c.op = CONSTANT_FLOAT;
+  c.value.f = val;
+  return emit(c, true);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeConstant(jobject val) {
+  Command c;
+  memset(&c, 0, sizeof(Command));
+  c.op = CONSTANT_OBJECT;
+  c.value.o = val;
+  return emit(c, true);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeReference(jobject val) {
+  Command c;
+  memset(&c, 0, sizeof(Command));
+  c.op = REFERENCE;
+  c.value.o = val;
+  return emit(c, true);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeConstant(const char *strData) {
+  return makeConstant(strData, strlen(strData));
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeConstant(const char *strData, int strLen) {
+  Command c;
+  memset(&c, 0, sizeof(Command));
+  c.op = CONSTANT_STRING;
+  c.first = current->strings.size();
+  c.count = strLen;
+  current->strings.insert(current->strings.end(), strData, strData + strLen);
+  return emit(c, true);
+}
+
+CAstPipeline::Handle CAstPipeline::Producer::makeLocation(int fl, int fc, int ll, int lc) {
+  Command c;
+  memset(&c, 0, sizeof(Command));
+  c.op = LOCATION;
+  c.value.pos[0] = fl;
+  c.value.pos[1] = fc;
+  c.value.pos[2] = ll;
+  c.value.pos[3] = lc;
+  return emit(c, true);
+}
+
+void CAstPipeline::Producer::setAstNodeLocation(jobject entity, Handle node, Handle loc) {
+  Handle args[] = { node, loc };
+  Command c;
+  memset(&c, 0, sizeof(Command));
+  c.op = NODE_LOCATION;
+  c.entity = entity;
+  c.first = current->operands.size();
+  c.count = 2;
+  current->operands.insert(current->operands.end(), args, args + 2);
+  emit(c, false);
+}
+
+void CAstPipeline::Producer::setGotoTarget(jobject entity, Handle from, Handle to) {
+  Handle args[] = { from, to };
+  Command c;
+  memset(&c, 0, sizeof(Command));
+  c.op = GOTO;
+  c.entity = entity;
+  c.first = current->operands.size();
+  c.count = 2;
+  current->operands.insert(current->operands.end(), args, args + 2);
+  emit(c, false);
+}
+
+void CAstPipeline::Producer::flush() {
+  if (current->commands.empty()) {
+    return;
+  }
+
+  // nobody drains a cancelled pipeline, so its batches are dropped
+  for(;;) {
+    unsigned long seen = signal.current();
+    if (full.push(current)) {
+      break;
+    }
+    if (isCancelled()) {
+      current->clear();
+      return;
+    }
+    signal.wait(seen);
+  }
+  signal.notify();
+
+  current = empty.pop();
+  if (current == NULL) {
+    current = new Batch();
+    current->commands.reserve(BATCH_SIZE);
+  }
+}
+
+void CAstPipeline::Producer::close() {
+  flush();
+  closed.store(true, std::memory_order_release);
+  signal.notify();
+}
+
+bool CAstPipeline::Producer::isCancelled() const {
+  return cancelled.load(std::memory_order_acquire);
+}
+
+void CAstPipeline::Unwinder::unwind() {
+  pipeline.shutdown();
+}
+
+CAstPipeline::CAstPipeline(CAstWrapper &CAst, int producerCount)
+  : CAst(CAst),
+    materialized(producerCount),
+    replaying(producerCount, NULL),
+    children(producerCount),
+    workers(producerCount),
+    cancelled(false),
+    unwinder(CAst.getExceptions(), *this)
+{
+  for(int i = 0; i < producerCount; i++) {
+    producers.push_back(new Producer(i, cancelled, signal));
+  }
+}
+
+CAstPipeline::~CAstPipeline() {
+  shutdown();
+}
+
+void CAstPipeline::shutdown() {
+  cancelled.store(true, std::memory_order_release);
+  signal.notify();
+  for(size_t i = 0; i < workers.size(); i++) {
+    if (workers[i].joinable()) {
+      workers[i].join();
+    }
+  }
+
+  for(size_t i = 0; i < producers.size(); i++) {
+    delete producers[i];
+    delete replaying[i];
+  }
+
+  for(size_t i = 0; i < materialized.size(); i++) {
+    for(size_t j = 0; j < materialized[i].size(); j++) {
+      if (materialized[i][j] != NULL) {
+	CAst.env->DeleteGlobalRef(materialized[i][j]);
+      }
+    }
+  }
+
+  // a THROW skips the destructor, so the memory goes now
+  std::vector<Producer *>().swap(producers);
+  std::vector< std::vector<jobject> >().swap(materialized);
+  std::vector<Batch *>().swap(replaying);
+  std::vector< std::vector<jobject> >().swap(children);
+  std::vector<std::thread>().swap(workers);
+}
+
+static void runProducer(CAstPipeline::Producer *producer, std::function<void (CAstPipeline::Producer &)> body) {
+  body(*producer);
+  producer->close();
+}
+
+void CAstPipeline::start(int p, std::function<void (Producer &)> body) {
+  if (p < 0 || p >= (int)producers.size() || workers[p].joinable()) {
+    CAst.die("bad or already started pipeline producer");
+  }
+
+  workers[p] = std::thread(runProducer, producers[p], body);
+}
+
+bool CAstPipeline::drain(int p) {
+  Batch *batch = producers[p]->full.pop();
+  if (batch == NULL) {
+    return false;
+  }
+
+  // the producer may be waiting for the slot just freed
+  signal.notify();
+
+  replaying[p] = batch;
+  execute(p, batch);
+  replaying[p] = NULL;
+
+  batch->clear();
+  if (! producers[p]->empty.push(batch)) {
+    delete batch;
+  }
+
+  return true;
+}
+
+void CAstPipeline::drain() {
+  for(;;) {
+    unsigned long seen = signal.current();
+    bool progress = false;
+    bool open = false;
+    for(size_t p = 0; p < producers.size(); p++) {
+      // read closed before popping, so that no batch pushed before
+      // the producer was closed can be missed.
+      if (! producers[p]->closed.load(std::memory_order_acquire)) {
+	if (! workers[p].joinable()) {
+	  CAst.die("pipeline producer was never started");
+	}
+	open = true;
+      }
+      while (drain(p)) {
+	progress = true;
+      }
+    }
+
+    if (! open) {
+      return;
+    }
+
+    if (! progress) {
+      signal.wait(seen);
+    }
+  }
+}
+
+jobject CAstPipeline::resolve(Handle h) {
+  return resolve(-1, h);
+}
+
+jobject CAstPipeline::resolve(int current, Handle h) {
+  int owner = HANDLE_OWNER(h);
+  size_t index = HANDLE_INDEX(h);
+  if (owner < 0 || owner >= (int)producers.size()) {
+    CAst.die("bad pipeline handle");
+  }
+
+  while (materialized[owner].size() <= index) {
+    if (owner == current) {
+      CAst.die("pipeline handle used before it was created");
+    }
+
+    // replaying a batch of owner now would interleave it with the one
+    // that is being replayed further up the stack
+    if (replaying[owner] != NULL) {
+      CAst.die("pipeline producers wait on each other's handles");
+    }
+
+    unsigned long seen = signal.current();
+    bool wasClosed = producers[owner]->closed.load(std::memory_order_acquire);
+    if (! drain(owner)) {
+      if (wasClosed) {
+	CAst.die("pipeline handle was never flushed");
+      }
+      signal.wait(seen);
+    }
+  }
+
+  return materialized[owner][index];
+}
+
+/**
+ *  Results are kept as global references, so that building a large
+ * tree does not run out of local ones.
+ */
+void CAstPipeline::keep(int p, jobject local) {
+  JNIEnv *env = CAst.env;
+  materialized[p].push_back(local == NULL ? NULL : env->NewGlobalRef(local));
+  if (local != NULL) {
+    env->DeleteLocalRef(local);
+  }
+}
+
+void CAstPipeline::execute(int p, Batch *batch) {
+  std::vector<jobject> &cs = children[p];
+  for(size_t i = 0; i < batch->commands.size(); i++) {
+    Command &c = batch->commands[i];
+    const Handle *operands = batch->operands.data() + c.first;
+    switch (c.op) {
+    case NODE: {
+      cs.resize(c.count);
+      for(int j = 0; j < c.count; j++) {
+	cs[j] = resolve(p, operands[j]);
+      }
+      switch (c.count) {
+      case 0: keep(p, CAst.makeNode(c.kind)); break;
+      case 1: keep(p, CAst.makeNode(c.kind, cs[0])); break;
+      case 2: keep(p, CAst.makeNode(c.kind, cs[0], cs[1])); break;
+      case 3: keep(p, CAst.makeNode(c.kind, cs[0], cs[1], cs[2])); break;
+      case 4: keep(p, CAst.makeNode(c.kind, cs[0], cs[1], cs[2], cs[3])); break;
+      case 5: keep(p, CAst.makeNode(c.kind, cs[0], cs[1], cs[2], cs[3], cs[4])); break;
+      case 6: keep(p, CAst.makeNode(c.kind, cs[0], cs[1], cs[2], cs[3], cs[4], cs[5])); break;
+      default: {
+	jobjectArray array = CAst.makeArray(c.count, cs.data());
+	keep(p, CAst.makeNode(c.kind, array));
+	CAst.env->DeleteLocalRef(array);
+      }
+      }
+      break;
+    }
+    case CONSTANT_BOOL:
+      keep(p, CAst.makeConstant((bool) c.value.l));
+      break;
+    case CONSTANT_CHAR:
+      keep(p, CAst.makeConstant((char) c.value.l));
+      break;
+    case CONSTANT_SHORT:
+      keep(p, CAst.makeConstant((short) c.value.l));
+      break;
+    case CONSTANT_INT:
+      keep(p, CAst.makeConstant((int) c.value.l));
+      break;
+    case CONSTANT_LONG:
+      keep(p, CAst.makeConstant((long) c.value.l));
+      break;
+    case CONSTANT_DOUBLE:
+      keep(p, CAst.makeConstant(c.value.d));
+      break;
+    case CONSTANT_FLOAT:
+      keep(p, CAst.makeConstant(c.value.f));
+      break;
+    case CONSTANT_OBJECT:
+      keep(p, CAst.makeConstant(c.value.o));
+      break;
+    case REFERENCE:
+      // the reference belongs to the caller, so the pipeline takes its own
+      keep(p, CAst.env->NewLocalRef(c.value.o));
+      break;
+    case CONSTANT_STRING:
+      keep(p, CAst.makeConstant(batch->strings.data() + c.first, c.count));
+      break;
+    case LOCATION:
+      keep(p, CAst.makeLocation(c.value.pos[0], c.value.pos[1], c.value.pos[2], c.value.pos[3]));
+      break;
+    case NODE_LOCATION:
+      CAst.setAstNodeLocation(c.entity, resolve(p, operands[0]), resolve(p, operands[1]));
+      break;
+    case GOTO:
+      CAst.setGotoTarget(c.entity, resolve(p, operands[0]), resolve(p, operands[1]));
+      break;
+    }
+  }
+}
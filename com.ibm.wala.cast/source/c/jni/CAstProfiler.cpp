@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <jvmti.h>
+#include <CAstProfiler.h>
+
+bool CAstProfiler::enabled = false;
+
+namespace {
+
+struct Counters {
+  std::atomic<long> calls;
+  std::atomic<long> jniObjects;
+  std::atomic<long> jniBytes;
+  std::atomic<long> samples;
+  std::atomic<long> collections;
+  std::atomic<long> gcNanos;
+
+  Counters()
+    : calls(0), jniObjects(0), jniBytes(0), samples(0), collections(0), gcNanos(0)
+  {
+
+  }
+};
+
+/**
+ *  The counters of a file, one set per section; files are never
+ * freed, so threads may hold on to them without locking.
+ */
+struct File {
+  std::string name;
+  Counters sections[CAstProfiler::SECTION_COUNT];
+
+  File(const std::string &name) : name(name) { }
+};
+
+thread_local File *currentFile = NULL;
+thread_local int currentSection = CAstProfiler::OTHER;
+
+std::atomic<File *> lastFile(NULL);
+std::atomic<int> lastSection(CAstProfiler::OTHER);
+
+std::mutex filesLock;
+std::vector<File *> files;
+std::map<std::string, File *> fileIndex;
+
+std::string reportPath;
+jint samplingInterval = 512 * 1024;
+std::atomic<long> gcStart(0);
+
+long now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void JNICALL vmObjectAlloc(jvmtiEnv *, JNIEnv *, jthread, jobject, jclass, jlong size) {
+  File *f = currentFile;
+  if (f != NULL) {
+    Counters &c = f->sections[currentSection];
+    c.jniObjects++;
+    c.jniBytes += (long) size;
+  }
+}
+
+#ifdef CAST_PROFILE_SAMPLING
+void JNICALL sampledObjectAlloc(jvmtiEnv *, JNIEnv *, jthread, jobject, jclass, jlong) {
+  File *f = currentFile;
+  if (f != NULL) {
+    f->sections[currentSection].samples++;
+  }
+}
+#endif
+
+void JNICALL garbageCollectionStart(jvmtiEnv *) {
+  gcStart = now();
+}
+
+void JNICALL garbageCollectionFinish(jvmtiEnv *) {
+  File *f = lastFile;
+  if (f != NULL) {
+    Counters &c = f->sections[lastSection];
+    c.collections++;
+    c.gcNanos += now() - gcStart;
+  }
+}
+
+void JNICALL vmDeath(jvmtiEnv *, JNIEnv *) {
+  FILE *out = reportPath.empty() ? stderr : fopen(reportPath.c_str(), "w");
+  if (out == NULL) {
+    fprintf(stderr, "CAst profiler: cannot write %s\n", reportPath.c_str());
+    out = stderr;
+  }
+
+  CAstProfiler::report(out);
+
+  if (out != stderr) fclose(out);
+}
+
+/**
+ *  Options are comma-separated key=value pairs.
+ */
+void parseOptions(const char *options) {
+  if (options == NULL) return;
+
+  std::string rest(options);
+  while (! rest.empty()) {
+    size_t comma = rest.find(',');
+    std::string option = rest.substr(0, comma);
+    rest = comma == std::string::npos ? "" : rest.substr(comma + 1);
+
+    if (option.compare(0, 5, "file=") == 0) {
+      reportPath = option.substr(5);
+    } else if (option.compare(0, 9, "interval=") == 0) {
+      samplingInterval = atoi(option.c_str() + 9);
+    } else if (! option.empty()) {
+      fprintf(stderr, "CAst profiler: unknown option %s\n", option.c_str());
+    }
+  }
+}
+
+}
+
+int CAstProfiler::enter(Section s) {
+  // APIs called by other APIs are charged to the outer one
+  if (currentSection != OTHER) {
+    return -1;
+  }
+
+  int saved = currentSection;
+  currentSection = s;
+
+  File *f = currentFile;
+  if (f != NULL) {
+    f->sections[s].calls++;
+    lastFile = f;
+    lastSection = s;
+  }
+
+  return saved;
+}
+
+void CAstProfiler::leave(int saved) {
+  currentSection = saved;
+  if (currentFile != NULL) {
+    lastSection = saved;
+  }
+}
+
+void CAstProfiler::beginFile(const char *name) {
+  // a section left by a jump past its Scope must not swallow this file's
+  currentSection = OTHER;
+
+  if (! enabled) return;
+
+  std::lock_guard<std::mutex> lock(filesLock);
+  std::map<std::string, File *>::iterator known = fileIndex.find(name);
+  if (known != fileIndex.end()) {
+    currentFile = known->second;
+  } else {
+    File *f = new File(name);
+    files.push_back(f);
+    fileIndex[name] = f;
+    currentFile = f;
+  }
+}
+
+void CAstProfiler::endFile() {
+  // later collections are no longer this file's doing
+  File *f = currentFile;
+  lastFile.compare_exchange_strong(f, NULL);
+
+  currentFile = NULL;
+  currentSection = OTHER;
+}
+
+void CAstProfiler::report(FILE *out) {
+  std::lock_guard<std::mutex> lock(filesLock);
+  for(std::vector<File *>::iterator f = files.begin(); f != files.end(); f++) {
+    fprintf(out, "CAst profile of %s\n", (*f)->name.c_str());
+    fprintf(out, "  %-16s %10s %12s %14s %10s %14s %11s %10s\n",
+	    "section", "calls", "jni objects", "jni bytes", "samples", "sampled bytes", "collections", "gc ms");
+    for(int s = 0; s < SECTION_COUNT; s++) {
+      Counters &c = (*f)->sections[s];
+      if (c.calls == 0 && c.jniObjects == 0 && c.samples == 0 && c.collections == 0) continue;
+      fprintf(out, "  %-16s %10ld %12ld %14ld %10ld %14ld %11ld %10.1f\n",
+	      sectionName(s),
+	      (long) c.calls, (long) c.jniObjects, (long) c.jniBytes,
+	      (long) c.samples, (long) c.samples * samplingInterval,
+	      (long) c.collections, c.gcNanos / 1000000.0);
+    }
+  }
+}
+
+const char *CAstProfiler::sectionName(int s) {
+  switch (s) {
+  case MAKE_NODE: return "makeNode";
+  case MAKE_CONSTANT: return "makeConstant";
+  case MAKE_LOCATION: return "makeLocation";
+  case MAKE_COLLECTION: return "makeSet/List";
+  case MAKE_SYMBOL: return "makeSymbol";
+  case ENTITIES: return "entities";
+  case SIDE_TABLES: return "side tables";
+  default: return "other";
+  }
+}
+
+jint CAstProfiler::load(JavaVM *vm, char *options, bool live) {
+  jvmtiEnv *jvmti;
+  if (vm->GetEnv((void **)&jvmti, JVMTI_VERSION_1_2) != JNI_OK) {
+    fprintf(stderr, "CAst profiler: JVMTI is not available\n");
+    return JNI_ERR;
+  }
+
+  parseOptions(options);
+
+  jvmtiCapabilities potential;
+  memset(&potential, 0, sizeof(potential));
+  jvmti->GetPotentialCapabilities(&potential);
+
+  jvmtiCapabilities caps;
+  memset(&caps, 0, sizeof(caps));
+  caps.can_generate_vm_object_alloc_events = potential.can_generate_vm_object_alloc_events;
+  caps.can_generate_garbage_collection_events = potential.can_generate_garbage_collection_events;
+#ifdef CAST_PROFILE_SAMPLING
+  caps.can_generate_sampled_object_alloc_events = potential.can_generate_sampled_object_alloc_events;
+#endif
+  if (jvmti->AddCapabilities(&caps) != JVMTI_ERROR_NONE) {
+    fprintf(stderr, "CAst profiler: cannot add capabilities%s\n", live ? " after startup" : "");
+    return JNI_ERR;
+  }
+
+  jvmtiEventCallbacks callbacks;
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.VMDeath = &vmDeath;
+  callbacks.VMObjectAlloc = &vmObjectAlloc;
+  callbacks.GarbageCollectionStart = &garbageCollectionStart;
+  callbacks.GarbageCollectionFinish = &garbageCollectionFinish;
+#ifdef CAST_PROFILE_SAMPLING
+  callbacks.SampledObjectAlloc = &sampledObjectAlloc;
+#endif
+  jvmti->SetEventCallbacks(&callbacks, sizeof(callbacks));
+
+  jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_VM_DEATH, NULL);
+  if (caps.can_generate_vm_object_alloc_events) {
+    jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_VM_OBJECT_ALLOC, NULL);
+  }
+  if (caps.can_generate_garbage_collection_events) {
+    jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_GARBAGE_COLLECTION_START, NULL);
+    jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_GARBAGE_COLLECTION_FINISH, NULL);
+  }
+#ifdef CAST_PROFILE_SAMPLING
+  if (caps.can_generate_sampled_object_alloc_events) {
+    jvmti->SetHeapSamplingInterval(samplingInterval);
+    jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_SAMPLED_OBJECT_ALLOC, NULL);
+  }
+#endif
+
+  enabled = true;
+  return JNI_OK;
+}
+
+extern "C" JNIEXPORT jint JNICALL Agent_OnLoad(JavaVM *vm, char *options, void *) {
+  return CAstProfiler::load(vm, options, false);
+}
+
+extern "C" JNIEXPORT jint JNICALL Agent_OnAttach(JavaVM *vm, char *options, void *) {
+  return CAstProfiler::load(vm, options, true);
+}
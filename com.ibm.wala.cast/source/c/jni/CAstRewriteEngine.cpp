@@ -0,0 +1,65 @@
+#include <CAstRewriteEngine.h>
+
+CAstRewriteEngine::CAstRewriteEngine(const jbyte *registered,
+				     int kindCount,
+				     const jint *kinds,
+				     const jint *childStart,
+				     const jint *children,
+				     int nodeCount)
+  : registered(registered), kindCount(kindCount),
+    kinds(kinds), childStart(childStart), children(children), nodeCount(nodeCount),
+    replacement(nodeCount, -1)
+{
+
+}
+
+/**
+ *  All children of n have been rewritten; decide whether n itself
+ * needs the callback.
+ */
+int CAstRewriteEngine::finish(int n, Callback &callback) {
+  bool changed = false;
+  newChildren.clear();
+  for(int i = 0; i < childCount(n); i++) {
+    int c = replacement[child(n, i)];
+    changed |= c != child(n, i);
+    newChildren.push_back(c);
+  }
+
+  if (changed || isRegistered(n)) {
+    return callback.rebuild(n, newChildren.data(), (int)newChildren.size());
+  } else {
+    return n;
+  }
+}
+
+int CAstRewriteEngine::rewrite(int root, Callback &callback) {
+  if (root < 0 || root >= nodeCount) {
+    return root;
+  }
+
+  // an explicit stack, since trees of millions of nodes can be deep
+  stack.clear();
+  Frame top = { root, 0 };
+  stack.push_back(top);
+  while (! stack.empty()) {
+    Frame &f = stack.back();
+    if (f.nextChild < childCount(f.node)) {
+      int c = child(f.node, f.nextChild++);
+      if (replacement[c] == -1) {
+	Frame next = { c, 0 };
+	stack.push_back(next);
+      }
+    } else {
+      int n = f.node;
+      stack.pop_back();
+      int r = finish(n, callback);
+      if (r < 0) {
+	return -1;
+      }
+      replacement[n] = r;
+    }
+  }
+
+  return replacement[root];
+}
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <CAstScopeAnalysis.h>
+
+CAstScopeAnalysis::Scope::Scope(CAstArena &arena)
+  : declared(CAstArenaAllocator<Event>(arena)),
+    read(CAstArenaAllocator<Event>(arena)),
+    written(CAstArenaAllocator<Event>(arena)),
+    childReads(CAstArenaAllocator<Event>(arena)),
+    childWrites(CAstArenaAllocator<Event>(arena))
+{
+
+}
+
+CAstScopeAnalysis::CAstScopeAnalysis(CAstWrapper &CAst)
+  : CAst(CAst),
+    nameIds(KeyLess(), CAstArenaAllocator<std::pair<const char * const, int> >(CAst.getArena())),
+    names(CAstArenaAllocator<const char *>(CAst.getArena())),
+    closed(CAstArenaAllocator<Closed>(CAst.getArena())),
+    clock(0)
+{
+  JNIEnv *env = CAst.env;
+  jclass xlatorCls = env->GetObjectClass(CAst.xlator);
+  THROW_ANY_EXCEPTION(CAst.java_ex);
+  _setExposedNames = env->GetMethodID(xlatorCls, "setExposedNames", "([Lcom/ibm/wala/cast/ir/translator/AbstractEntity;[Ljava/lang/String;[I)V");
+  THROW_ANY_EXCEPTION(CAst.java_ex);
+  env->DeleteLocalRef(xlatorCls);
+}
+
+int CAstScopeAnalysis::intern(const char *name) {
+  NameIds::iterator known = nameIds.find(name);
+  if (known != nameIds.end()) {
+    return known->second;
+  }
+
+  const char *copy = CAst.getArena().strdup(name);
+  int id = names.size();
+  names.push_back(copy);
+  nameIds[copy] = id;
+  return id;
+}
+
+CAstScopeAnalysis::Scope &CAstScopeAnalysis::current() {
+  if (scopes.empty()) {
+    THROW(CAst.java_ex, "name reported outside of any scope");
+  }
+  return scopes.back();
+}
+
+void CAstScopeAnalysis::beginScope() {
+  scopes.push_back(Scope(CAst.getArena()));
+}
+
+CAstScopeAnalysis::Event CAstScopeAnalysis::event(const char *name) {
+  Event e;
+  e.name = intern(name);
+  e.time = clock++;
+  return e;
+}
+
+void CAstScopeAnalysis::declare(const char *name) {
+  Scope &s = current();
+  s.declared.push_back(event(name));
+}
+
+void CAstScopeAnalysis::read(const char *name) {
+  Scope &s = current();
+  s.read.push_back(event(name));
+}
+
+void CAstScopeAnalysis::write(const char *name) {
+  Scope &s = current();
+  s.written.push_back(event(name));
+}
+
+/**
+ *  Whether the name of a use was declared before it, in declarations
+ * sorted by name and then time.
+ */
+bool CAstScopeAnalysis::declaredBefore(const Events &declared, const Event &use) {
+  Event first;
+  first.name = use.name;
+  first.time = -1;
+  Events::const_iterator d = std::lower_bound(declared.begin(), declared.end(), first);
+  return d != declared.end() && d->name == use.name && d->time < use.time;
+}
+
+/**
+ *  Sort out the uses of a scope against its sorted declarations: those
+ * of nested functions that find their declaration here are exposed,
+ * and their distinct names are written to an array in the arena, with
+ * their number in count; all other uses, its own included, are added
+ * to up, since the parent scope may declare them.
+ */
+int *CAstScopeAnalysis::resolve(const Events &declared, const Events &own, const Events &nested, Events *up, int *count) {
+  int *result = (int *)CAst.getArena().allocate(sizeof(int) * (nested.size() + 1), sizeof(int));
+  *count = 0;
+
+  for(Events::const_iterator u = own.begin(); u != own.end(); u++) {
+    if (up != NULL && !declaredBefore(declared, *u)) up->push_back(*u);
+  }
+  for(Events::const_iterator u = nested.begin(); u != nested.end(); u++) {
+    if (declaredBefore(declared, *u)) {
+      result[(*count)++] = u->name;
+    } else if (up != NULL) {
+      up->push_back(*u);
+    }
+  }
+
+  std::sort(result, result + *count);
+  *count = std::unique(result, result + *count) - result;
+  return result;
+}
+
+void CAstScopeAnalysis::endScope(jobject entity) {
+  if (scopes.empty()) {
+    THROW(CAst.java_ex, "endScope without beginScope");
+  }
+
+  Scope &s = scopes.back();
+  std::sort(s.declared.begin(), s.declared.end());
+
+  // a use declared here before it is local if made here, and exposed if
+  // made by a nested function; every other use is free here, and so a
+  // use by a nested function from the point of view of the parent
+  Scope *parent = scopes.size() > 1 ? &scopes[scopes.size() - 2] : NULL;
+  Closed c;
+  c.entity = CAst.env->NewLocalRef(entity);
+  c.reads = resolve(s.declared, s.read, s.childReads, parent == NULL ? NULL : &parent->childReads, &c.readCount);
+  c.writes = resolve(s.declared, s.written, s.childWrites, parent == NULL ? NULL : &parent->childWrites, &c.writeCount);
+  closed.push_back(c);
+
+  scopes.pop_back();
+
+  if (scopes.empty()) {
+    attach();
+  }
+}
+
+/**
+ *  Pass the exposed names of every closed entity to Java as an array
+ * of the entities, an array of the names used, and, per entity, the
+ * number of exposed reads, their name indices, and the same for writes.
+ */
+void CAstScopeAnalysis::attach() {
+  JNIEnv *env = CAst.env;
+  CAstArena::Scope scope(CAst.getArena());
+  CAstArena &temporaries = scope.getArena();
+
+  int *remap = (int *)temporaries.allocate(sizeof(int) * (names.size() + 1), sizeof(int));
+  std::fill(remap, remap + names.size(), -1);
+
+  CAstArenaVector<jobject> entities((CAstArenaAllocator<jobject>(temporaries)));
+  CAstStringBatch used;
+  CAstArenaVector<jint> exposed((CAstArenaAllocator<jint>(temporaries)));
+  for(CAstArenaVector<Closed>::iterator c = closed.begin(); c != closed.end(); c++) {
+    entities.push_back(c->entity);
+    for(int pass = 0; pass < 2; pass++) {
+      int count = pass == 0 ? c->readCount : c->writeCount;
+      int *ids = pass == 0 ? c->reads : c->writes;
+      exposed.push_back(count);
+      for(int i = 0; i < count; i++) {
+	if (remap[ids[i]] < 0) {
+	  remap[ids[i]] = used.size();
+	  if (used.add(names[ids[i]]) < 0) {
+	    THROW(CAst.java_ex, "invalid UTF-8 in name");
+	  }
+	}
+	exposed.push_back(remap[ids[i]]);
+      }
+    }
+  }
+
+  jobjectArray jentities = CAst.makeArray(CAst.NativeEntity, entities);
+  jobjectArray jnames = CAst.makeStrings(used);
+  jintArray jexposed = env->NewIntArray(exposed.size());
+  THROW_ANY_EXCEPTION(CAst.java_ex);
+  env->SetIntArrayRegion(jexposed, 0, exposed.size(), exposed.data());
+
+  env->CallVoidMethod(CAst.xlator, _setExposedNames, jentities, jnames, jexposed);
+  THROW_ANY_EXCEPTION(CAst.java_ex);
+
+  env->DeleteLocalRef(jentities);
+  env->DeleteLocalRef(jnames);
+  env->DeleteLocalRef(jexposed);
+  for(CAstArenaVector<Closed>::iterator c = closed.begin(); c != closed.end(); c++) {
+    env->DeleteLocalRef(c->entity);
+  }
+  closed.clear();
+}
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#if __WIN32__
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <CAstSourceBuffer.h>
+
+static std::mutex buffersLock;
+static std::map<std::string, CAstSourceBuffer *> buffers;
+
+/** stands in for the contents of empty files */
+static char empty[1];
+
+bool CAstSourceBuffer::Version::operator==(const Version &other) const {
+  return device == other.device && inode == other.inode && size == other.size &&
+    modified == other.modified && changed == other.changed;
+}
+
+CAstSourceBuffer::CAstSourceBuffer(const char *path, const Version &version, long long readAt)
+  : path(path), version(version), readAt(readAt), data(empty), length(0),
+    contentsRef(NULL), startsRef(NULL), references(1)
+{
+
+}
+
+CAstSourceBuffer::~CAstSourceBuffer() {
+
+}
+
+void CAstSourceBuffer::indexLines() {
+  starts.reserve(length / 32 + 1);
+
+  const char *p = data;
+  const char *end = data + length;
+  if (length > 0) {
+    starts.push_back(0);
+  }
+  while ((p = (const char *)memchr(p, '\n', end - p)) != NULL) {
+    if (++p == end) {
+      break;
+    }
+    starts.push_back((jint)(p - data));
+  }
+}
+
+/**
+ *  A global reference to a new direct buffer of size bytes, or NULL
+ * with an exception pending.
+ */
+static jobject allocateDirect(JNIEnv *env, size_t size) {
+  jclass bufferCls = env->FindClass("java/nio/ByteBuffer");
+  if (bufferCls == NULL) {
+    return NULL;
+  }
+  jmethodID allocate =
+    env->GetStaticMethodID(bufferCls, "allocateDirect", "(I)Ljava/nio/ByteBuffer;");
+  if (allocate == NULL) {
+    return NULL;
+  }
+  jobject local = env->CallStaticObjectMethod(bufferCls, allocate, (jint)size);
+  if (local == NULL) {
+    return NULL;
+  }
+  jobject global = env->NewGlobalRef(local);
+  env->DeleteLocalRef(local);
+  return global;
+}
+
+bool CAstSourceBuffer::load(JNIEnv *env, int fd, size_t size) {
+  contentsRef = allocateDirect(env, size);
+  if (contentsRef == NULL) {
+    return false;
+  }
+
+  char *copy = (char *)env->GetDirectBufferAddress(contentsRef);
+  if (copy == NULL && size > 0) {
+    return false;
+  }
+
+  // a file that shrinks while it is read is taken as far as it goes
+  size_t done = 0;
+  while (done < size) {
+#if __WIN32__
+    int n = _read(fd, copy + done, (unsigned)(size - done));
+#else
+    ssize_t n = read(fd, copy + done, size - done);
+#endif
+    if (n < 0) {
+      return false;
+    } else if (n == 0) {
+      break;
+    }
+    done += n;
+  }
+
+  // Java takes the length from the capacity, so a short copy is moved
+  // into a buffer of its own size
+  if (done < size) {
+    jobject shorter = allocateDirect(env, done);
+    if (shorter == NULL) {
+      return false;
+    }
+    char *moved = (char *)env->GetDirectBufferAddress(shorter);
+    if (done > 0) {
+      if (moved == NULL) {
+        env->DeleteGlobalRef(shorter);
+        return false;
+      }
+      memcpy(moved, copy, done);
+    }
+    env->DeleteGlobalRef(contentsRef);
+    contentsRef = shorter;
+    copy = moved;
+  }
+
+  data = done > 0 ? copy : empty;
+  length = done;
+  indexLines();
+
+  startsRef = allocateDirect(env, starts.size() * sizeof(jint));
+  if (startsRef == NULL) {
+    return false;
+  }
+  if (! starts.empty()) {
+    void *address = env->GetDirectBufferAddress(startsRef);
+    if (address == NULL) {
+      return false;
+    }
+    memcpy(address, starts.data(), starts.size() * sizeof(jint));
+  }
+
+  return true;
+}
+
+/** a time of a file in nanoseconds, as finely as the platform keeps it */
+#if __WIN32__
+#define FILE_NANOS(info, field) ((long long)(info).st_##field##time * 1000000000LL)
+#elif defined(__APPLE__)
+#define FILE_NANOS(info, field) \
+  ((info).st_##field##timespec.tv_sec * 1000000000LL + (info).st_##field##timespec.tv_nsec)
+#else
+#define FILE_NANOS(info, field) \
+  ((info).st_##field##tim.tv_sec * 1000000000LL + (info).st_##field##tim.tv_nsec)
+#endif
+
+bool CAstSourceBuffer::isRacy() const {
+  return version.modified + RACY_NANOS > readAt || version.changed + RACY_NANOS > readAt;
+}
+
+bool CAstSourceBuffer::hasSameContents(const CAstSourceBuffer &other) const {
+  return length == other.length && memcmp(data, other.data, length) == 0;
+}
+
+CAstSourceBuffer *CAstSourceBuffer::acquire(JNIEnv *env, const char *path) {
+  long long readAt =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+
+#if __WIN32__
+  int fd = _open(path, _O_RDONLY | _O_BINARY);
+#else
+  int fd = open(path, O_RDONLY);
+#endif
+  if (fd < 0) {
+    return NULL;
+  }
+
+  // offsets are jints, so larger files are not read
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size > 0x7fffffffLL) {
+    close(fd);
+    return NULL;
+  }
+
+  Version version;
+  version.device = (long long)info.st_dev;
+  version.inode = (long long)info.st_ino;
+  version.size = (long long)info.st_size;
+  version.modified = FILE_NANOS(info, m);
+  version.changed = FILE_NANOS(info, c);
+
+  {
+    std::lock_guard<std::mutex> guard(buffersLock);
+    std::map<std::string, CAstSourceBuffer *>::iterator known = buffers.find(path);
+    if (known != buffers.end() && known->second->version == version && ! known->second->isRacy()) {
+      close(fd);
+      known->second->references++;
+      return known->second;
+    }
+  }
+
+  CAstSourceBuffer *buffer = new CAstSourceBuffer(path, version, readAt);
+  bool loaded = buffer->load(env, fd, (size_t)info.st_size);
+  close(fd);
+  if (! loaded) {
+    buffer->dispose(env);
+    return NULL;
+  }
+
+  // another thread may have read the same file meanwhile, and a racy
+  // buffer that turns out to be current is known to be so from now on.
+  // A buffer the new one replaces lives on for whatever still refers
+  // to it.
+  CAstSourceBuffer *shared = NULL;
+  {
+    std::lock_guard<std::mutex> guard(buffersLock);
+    std::map<std::string, CAstSourceBuffer *>::iterator known = buffers.find(path);
+    if (known != buffers.end() && known->second->version == version && known->second->hasSameContents(*buffer)) {
+      shared = known->second;
+      shared->readAt = std::max(shared->readAt, readAt);
+      shared->references++;
+    } else {
+      buffers[path] = buffer;
+    }
+  }
+
+  if (shared != NULL) {
+    buffer->dispose(env);
+    return shared;
+  }
+
+  return buffer;
+}
+
+void CAstSourceBuffer::retain() {
+  std::lock_guard<std::mutex> guard(buffersLock);
+  references++;
+}
+
+void CAstSourceBuffer::release(JNIEnv *env) {
+  {
+    std::lock_guard<std::mutex> guard(buffersLock);
+    if (--references > 0) {
+      return;
+    }
+
+    std::map<std::string, CAstSourceBuffer *>::iterator known = buffers.find(path);
+    if (known != buffers.end() && known->second == this) {
+      buffers.erase(known);
+    }
+  }
+
+  dispose(env);
+}
+
+void CAstSourceBuffer::dispose(JNIEnv *env) {
+  if (contentsRef != NULL) {
+    env->DeleteGlobalRef(contentsRef);
+  }
+  if (startsRef != NULL) {
+    env->DeleteGlobalRef(startsRef);
+  }
+  delete this;
+}
+
+jint CAstSourceBuffer::getLineStart(int line) const {
+  if (line < 1) {
+    return 0;
+  } else if (line > (int)starts.size()) {
+    return (jint)length;
+  } else {
+    return starts[line - 1];
+  }
+}
+
+int CAstSourceBuffer::getLine(jint offset) const {
+  std::vector<jint>::const_iterator i = std::upper_bound(starts.begin(), starts.end(), offset);
+  return i == starts.begin() ? 1 : (int)(i - starts.begin());
+}
+
+jint CAstSourceBuffer::getOffset(int line, int col) const {
+  jint start = getLineStart(line);
+  if (col < 0) {
+    return start;
+  }
+
+  jint end = getLineStart(line + 1);
+  return start + col < end ? start + col : end;
+}
+
+jobject CAstSourceBuffer::contents(JNIEnv *env) const {
+  return env->NewLocalRef(contentsRef);
+}
+
+jobject CAstSourceBuffer::lineStarts(JNIEnv *env) const {
+  return env->NewLocalRef(startsRef);
+}
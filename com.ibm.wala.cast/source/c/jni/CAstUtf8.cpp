@@ -0,0 +1,180 @@
+#include <string.h>
+#include <CAstUtf8.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+static inline bool continuation(unsigned char c) {
+  return (c & 0xC0) == 0x80;
+}
+
+/**
+ *  The number of ASCII bytes at the start of in[0..len), checking a
+ * vector at a time and widening what it checks into out when writing;
+ * out must have room for len chars, so whole vectors can be stored
+ * even when only part of one is ASCII.
+ */
+template<bool write>
+static int ascii(const unsigned char *in, int len, jchar *out) {
+  // do not spend a vector on text that is not ASCII to begin with
+  if (len == 0 || in[0] >= 0x80) {
+    return 0;
+  }
+
+  int i = 0;
+#if defined(__AVX2__)
+  for(; i + 32 <= len; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+    unsigned int high = (unsigned int)_mm256_movemask_epi8(v);
+    if (write) {
+      _mm256_storeu_si256((__m256i *)(out + i), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+      _mm256_storeu_si256((__m256i *)(out + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+    }
+    if (high != 0) {
+      return i + __builtin_ctz(high);
+    }
+  }
+#elif defined(__SSE2__)
+  __m128i zero = _mm_setzero_si128();
+  for(; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+    unsigned int high = (unsigned int)_mm_movemask_epi8(v);
+    if (write) {
+      _mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi8(v, zero));
+      _mm_storeu_si128((__m128i *)(out + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+    if (high != 0) {
+      return i + __builtin_ctz(high);
+    }
+  }
+#endif
+  for(; i < len && in[i] < 0x80; i++) {
+    if (write) out[i] = in[i];
+  }
+  return i;
+}
+
+/**
+ *  Decode in[0..len) into out, or just check it if not writing;
+ * returns the number of chars, or -1 if the input is not valid.
+ * The bounds on the second byte of three and four byte sequences are
+ * those of the Unicode table of well-formed UTF-8, which rule out
+ * overlong forms, surrogates and code points past U+10FFFF.
+ */
+template<bool write>
+static int decode(const unsigned char *in, int len, jchar *out) {
+  int i = 0, n = 0;
+  while (i < len) {
+    int run = ascii<write>(in + i, len - i, write ? out + n : NULL);
+    i += run;
+    n += run;
+    if (i == len) {
+      break;
+    }
+
+    unsigned int c = in[i];
+    if (c < 0xC2) {
+      return -1;
+
+    } else if (c < 0xE0) {
+      if (i + 1 >= len || !continuation(in[i+1])) return -1;
+      if (write) out[n] = (jchar)(((c & 0x1F) << 6) | (in[i+1] & 0x3F));
+      i += 2;
+      n += 1;
+
+    } else if (c < 0xF0) {
+      if (i + 2 >= len) return -1;
+      unsigned int c1 = in[i+1];
+      unsigned int lo = c == 0xE0 ? 0xA0 : 0x80;
+      unsigned int hi = c == 0xED ? 0x9F : 0xBF;
+      if (c1 < lo || c1 > hi || !continuation(in[i+2])) return -1;
+      if (write) out[n] = (jchar)(((c & 0x0F) << 12) | ((c1 & 0x3F) << 6) | (in[i+2] & 0x3F));
+      i += 3;
+      n += 1;
+
+    } else if (c < 0xF5) {
+      if (i + 3 >= len) return -1;
+      unsigned int c1 = in[i+1];
+      unsigned int lo = c == 0xF0 ? 0x90 : 0x80;
+      unsigned int hi = c == 0xF4 ? 0x8F : 0xBF;
+      if (c1 < lo || c1 > hi || !continuation(in[i+2]) || !continuation(in[i+3])) return -1;
+      if (write) {
+	unsigned int cp = ((c & 0x07) << 18) | ((c1 & 0x3F) << 12) | ((in[i+2] & 0x3F) << 6) | (in[i+3] & 0x3F);
+	cp -= 0x10000;
+	out[n] = (jchar)(0xD800 | (cp >> 10));
+	out[n+1] = (jchar)(0xDC00 | (cp & 0x3FF));
+      }
+      i += 4;
+      n += 2;
+
+    } else {
+      return -1;
+    }
+  }
+
+  return n;
+}
+
+int CAstUtf8::toUtf16(const char *in, int len, jchar *out) {
+  return decode<true>((const unsigned char *)in, len, out);
+}
+
+bool CAstUtf8::isValid(const char *in, int len) {
+  return decode<false>((const unsigned char *)in, len, NULL) >= 0;
+}
+
+int CAstUtf8::fromUtf16(const jchar *in, int len, char *out) {
+  unsigned char *o = (unsigned char *)out;
+  int n = 0;
+  for(int i = 0; i < len; i++) {
+    unsigned int c = in[i];
+    if (c < 0x80) {
+      o[n++] = (unsigned char)c;
+
+    } else if (c < 0x800) {
+      o[n++] = (unsigned char)(0xC0 | (c >> 6));
+      o[n++] = (unsigned char)(0x80 | (c & 0x3F));
+
+    } else if (c >= 0xD800 && c < 0xDC00 && i + 1 < len && in[i+1] >= 0xDC00 && in[i+1] < 0xE000) {
+      unsigned int cp = 0x10000 + (((c & 0x3FF) << 10) | (in[++i] & 0x3FF));
+      o[n++] = (unsigned char)(0xF0 | (cp >> 18));
+      o[n++] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+      o[n++] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+      o[n++] = (unsigned char)(0x80 | (cp & 0x3F));
+
+    } else {
+      if (c >= 0xD800 && c < 0xE000) {
+	c = 0xFFFD;
+      }
+      o[n++] = (unsigned char)(0xE0 | (c >> 12));
+      o[n++] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+      o[n++] = (unsigned char)(0x80 | (c & 0x3F));
+    }
+  }
+
+  return n;
+}
+
+int CAstStringBatch::add(const char *str, int len) {
+  size_t start = chars.size();
+  chars.resize(start + len);
+  int n = CAstUtf8::toUtf16(str, len, chars.data() + start);
+  if (n < 0) {
+    chars.resize(start);
+    return -1;
+  }
+
+  chars.resize(start + n);
+  ends.push_back((jint)chars.size());
+  return (int)ends.size() - 1;
+}
+
+int CAstStringBatch::add(const char *str) {
+  return add(str, strlen(str));
+}
+
+void CAstStringBatch::clear() {
+  chars.clear();
+  ends.clear();
+}
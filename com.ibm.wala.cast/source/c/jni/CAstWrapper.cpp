@@ -1,14 +1,17 @@
 #include <jni.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iterator>
 
+#include <limits.h>
 #include <stdarg.h>
 #include <string.h>
 #include <CAstWrapper.h>
+#include <CAstExporter.h>
+#include <CAstProfiler.h>
 
-#if defined(__MINGW32__) || defined(_MSC_VER) || defined(__APPLE__)
-#define strndup(s,n) strdup(s)
-#endif
+#define PROFILE(section) CAstProfiler::Scope _profile(CAstProfiler::section)
 
 #define __SIG( __nm ) "L" __nm ";"
 
@@ -67,8 +70,27 @@ static const char *FieldCls = XLATOR_PKG "AbstractFieldEntity";
 static const char *GlobalCls = XLATOR_PKG "AbstractGlobalEntity";
 
 CAstWrapper::CAstWrapper(JNIEnv *env, Exceptions &ex, jobject xlator) 
-  : java_ex(ex), env(env), xlator(xlator)
+  : env(env), java_ex(ex), xlator(xlator), unwinder(ex, *this), logger(NULL),
+    fingerprints(CAstArenaAllocator<CAstFingerprint>(arena)),
+    nodeInfoBase(-1),
+    nodeIdField(NULL),
+    typeIds(KeyLess(), CAstArenaAllocator<pair<const char * const, int> >(arena)),
+    typedEntity(NULL),
+    typedNodes(CAstArenaAllocator<jobject>(arena)),
+    typedTypeIds(CAstArenaAllocator<jint>(arena)),
+    scopedParents(CAstArenaAllocator<jobject>(arena)),
+    scopedConstructs(CAstArenaAllocator<jobject>(arena)),
+    scopedChildren(CAstArenaAllocator<jobject>(arena)),
+    callNodes(CAstArenaAllocator<jobject>(arena)),
+    callFrames(CAstArenaAllocator<int>(arena)),
+    sizeSummaries(CAstArenaAllocator<SizeSummary>(arena)),
+    nextQualifierSet(0),
+    nextKnownConstant(0), evaluator(NULL),
+    nodeClock(0), lastEntry(-1), dropClock(-1), dropFirst(INT_MAX)
 {
+  memset(knownConstants, 0, sizeof(knownConstants));
+  memset(qualifierSets, 0, sizeof(qualifierSets));
+
   if (!initialized) {
     initialized = true;
     initialize(env);
@@ -83,16 +105,70 @@ CAstWrapper::CAstWrapper(JNIEnv *env, Exceptions &ex, jobject xlator)
   this->NativeTranslatorToCAst =
     env->FindClass("com/ibm/wala/cast/ir/translator/NativeTranslatorToCAst");
   THROW_ANY_EXCEPTION(java_ex);
+  this->PackedStrings = env->FindClass("com/ibm/wala/cast/util/PackedStrings");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->unpackStrings = env->GetStaticMethodID(PackedStrings, "unpack", "([C[I)[Ljava/lang/String;");
+  THROW_ANY_EXCEPTION(java_ex);
 
   jfieldID castFieldID = env->GetFieldID(NativeBridge, "Ast", "Lcom/ibm/wala/cast/tree/CAst;");
   THROW_ANY_EXCEPTION(java_ex);
   this->Ast = env->GetObjectField(xlator, castFieldID);
   THROW_ANY_EXCEPTION(java_ex);
 
+  jclass castImpl = env->FindClass("com/ibm/wala/cast/tree/impl/CAstImpl");
+  THROW_ANY_EXCEPTION(java_ex);
+  if (env->IsInstanceOf(Ast, castImpl)) {
+    this->CAstNumberedNodeImpl = env->FindClass("com/ibm/wala/cast/tree/impl/CAstImpl$CAstNumberedNodeImpl");
+    THROW_ANY_EXCEPTION(java_ex);
+    this->nodeIdField = env->GetFieldID(CAstNumberedNodeImpl, "id", "I");
+    THROW_ANY_EXCEPTION(java_ex);
+  }
+
   jclass xlatorCls = env->FindClass( XlatorCls );
   THROW_ANY_EXCEPTION(java_ex);
   this->_makeLocation = env->GetMethodID(xlatorCls, "makeLocation", "(IIII)Lcom/ibm/wala/cast/tree/CAstSourcePositionMap$Position;");
   THROW_ANY_EXCEPTION(java_ex);
+  this->_isCanceled = env->GetMethodID(xlatorCls, "isCanceled", "()Z");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_worked = env->GetMethodID(xlatorCls, "worked", "(I)V");
+  THROW_ANY_EXCEPTION(java_ex);
+
+  if (CAstProfiler::enabled) {
+    jmethodID getLocalFile = env->GetMethodID(xlatorCls, "getLocalFile", "()Ljava/lang/String;");
+    THROW_ANY_EXCEPTION(java_ex);
+    jstring file = (jstring)env->CallObjectMethod(xlator, getLocalFile);
+    THROW_ANY_EXCEPTION(java_ex);
+    const char *cfile = file == NULL ? NULL : env->GetStringUTFChars(file, NULL);
+    CAstProfiler::beginFile(cfile == NULL ? "<unknown>" : cfile);
+    if (cfile != NULL) env->ReleaseStringUTFChars(file, cfile);
+    env->DeleteLocalRef(file);
+  }
+  this->_getCachedEntity = env->GetMethodID(xlatorCls, "getCachedEntity", "(Ljava/lang/String;J)" __CES);
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_cacheEntity = env->GetMethodID(xlatorCls, "cacheEntity", "(Ljava/lang/String;J" __CES ")V");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_getDuplicateEntity = env->GetMethodID(xlatorCls, "getDuplicateEntity", "(JLjava/lang/String;Lcom/ibm/wala/cast/tree/CAstSourcePositionMap$Position;)" __CES);
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_recordCanonicalEntity = env->GetMethodID(xlatorCls, "recordCanonicalEntity", "(J" __CES ")V");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_entityCompleted = env->GetMethodID(xlatorCls, "entityCompleted", "(" __CES ")Z");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_deferBody = env->GetMethodID(xlatorCls, "deferBody", "(L" XLATOR_PKG "AbstractCodeEntity;J)V");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_translationEnded = env->GetMethodID(xlatorCls, "translationEnded", "()V");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_internType = env->GetMethodID(xlatorCls, "internType", "(Ljava/lang/String;Lcom/ibm/wala/cast/tree/CAstType;)I");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_setCallSites = env->GetMethodID(xlatorCls, "setCallSites", "(L" XLATOR_PKG "AbstractCodeEntity;[Lcom/ibm/wala/cast/tree/CAstNode;)V");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_setSizeSummary = env->GetMethodID(xlatorCls, "setSizeSummary", "(L" XLATOR_PKG "AbstractCodeEntity;[IIII)V");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_setNodeTypes = env->GetMethodID(xlatorCls, "setNodeTypes", "(L" XLATOR_PKG "AbstractCodeEntity;[Lcom/ibm/wala/cast/tree/CAstNode;[II)V");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->_addScopedEntities = env->GetMethodID(xlatorCls, "addScopedEntities", "([L" XLATOR_PKG "AbstractEntity;[Lcom/ibm/wala/cast/tree/CAstNode;[" __CES "I)V");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->CAstEntity = env->FindClass("com/ibm/wala/cast/tree/CAstEntity");
+  THROW_ANY_EXCEPTION(java_ex);
 
   this->NativeEntity = env->FindClass(EntityCls);
   THROW_ANY_EXCEPTION(java_ex);
@@ -115,6 +191,23 @@ CAstWrapper::CAstWrapper(JNIEnv *env, Exceptions &ex, jobject xlator)
   THROW_ANY_EXCEPTION(java_ex);
   this->codeSetLabelledGotoTarget = env->GetMethodID(NativeCodeEntity, "setLabelledGotoTarget", "(Lcom/ibm/wala/cast/tree/CAstNode;Lcom/ibm/wala/cast/tree/CAstNode;Ljava/lang/Object;)V");
   THROW_ANY_EXCEPTION(java_ex);
+  this->codeSetGotoTargets = env->GetMethodID(NativeCodeEntity, "setGotoTargets", "([Lcom/ibm/wala/cast/tree/CAstNode;[Lcom/ibm/wala/cast/tree/CAstNode;[Ljava/lang/Object;)V");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->codeAstFolded = env->GetMethodID(NativeCodeEntity, "astFolded", "()V");
+  THROW_ANY_EXCEPTION(java_ex);
+
+  // the labels of conditional branches are interned once
+  this->JavaObject = env->FindClass("java/lang/Object");
+  THROW_ANY_EXCEPTION(java_ex);
+  jclass boolean = env->FindClass("java/lang/Boolean");
+  THROW_ANY_EXCEPTION(java_ex);
+  jfieldID trueId = env->GetStaticFieldID(boolean, "TRUE", "Ljava/lang/Boolean;");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->trueLabel = env->GetStaticObjectField(boolean, trueId);
+  jfieldID falseId = env->GetStaticFieldID(boolean, "FALSE", "Ljava/lang/Boolean;");
+  THROW_ANY_EXCEPTION(java_ex);
+  this->falseLabel = env->GetStaticObjectField(boolean, falseId);
+  THROW_ANY_EXCEPTION(java_ex);
   this->setNodePosition = env->GetMethodID(NativeCodeEntity, "setNodePosition", "(Lcom/ibm/wala/cast/tree/CAstNode;Lcom/ibm/wala/cast/tree/CAstSourcePositionMap$Position;)V");
   THROW_ANY_EXCEPTION(java_ex);
   this->setNodeType = env->GetMethodID(NativeCodeEntity, "setNodeType", "(Lcom/ibm/wala/cast/tree/CAstNode;Lcom/ibm/wala/cast/tree/CAstType;)V");
@@ -189,7 +282,7 @@ CAstWrapper::CAstWrapper(JNIEnv *env, Exceptions &ex, jobject xlator)
 
   this->CAstPrinter = env->FindClass("com/ibm/wala/cast/util/CAstPrinter");
   THROW_ANY_EXCEPTION(java_ex);
-  this->castPrint = env->GetStaticMethodID(CAstPrinter, "print", "(Lcom/ibm/wala/cast/tree/CAstNode;)Ljava/lang/String;");
+  this->castKindAsString = env->GetStaticMethodID(CAstPrinter, "kindAsString", "(I)Ljava/lang/String;");
   THROW_ANY_EXCEPTION(java_ex);
 
   this->hashSetInit = env->GetMethodID(HashSet, "<init>", "()V");
@@ -235,6 +328,55 @@ CAstWrapper::CAstWrapper(JNIEnv *env, Exceptions &ex, jobject xlator)
   THROW_ANY_EXCEPTION(java_ex);
 }
 
+CAstWrapper::~CAstWrapper() {
+  // what is still buffered is passed on unless Java is unwinding already;
+  // a THROW from here would jump out of the destructor, so any exception
+  // is left pending for the caller
+  passNodeTypes();
+  passScopedEntities();
+  if (! env->ExceptionCheck()) {
+    env->CallVoidMethod(xlator, _translationEnded);
+  }
+
+  forgetQualifierSets();
+  forgetConstants();
+  forgetCallSites();
+
+  delete logger;
+
+  CAstProfiler::endFile();
+
+#ifdef TRACE_CAST_WRAPPER
+  fprintf(stderr, "arena: %lu allocations, %lu bytes, %lu blocks\n",
+	  (unsigned long) arena.allocations(),
+	  (unsigned long) arena.bytes(),
+	  (unsigned long) arena.blocks());
+#endif
+}
+
+void CAstWrapper::Unwinder::unwind() {
+  // the global references go before the arena holding the lists of them
+  wrapper.forgetQualifierSets();
+  wrapper.forgetConstants();
+  wrapper.forgetCallSites();
+  vector<NodeInfo>().swap(wrapper.nodeInfo);
+  wrapper.nodeInfoBase = -1;
+  wrapper.arena.release();
+  delete wrapper.logger;
+  wrapper.logger = NULL;
+
+  // the Scope of the section being thrown out of is skipped too
+  CAstProfiler::endFile();
+}
+
+CAstArena &CAstWrapper::getArena() {
+  return arena;
+}
+
+Exceptions &CAstWrapper::getExceptions() {
+  return java_ex;
+}
+
 #define _CPP_CONSTANTS 
 #include "cast_constants.h"
 
@@ -247,12 +389,333 @@ CAstWrapper::CAstWrapper(JNIEnv *env, Exceptions &ex, jobject xlator)
 #define _CPP_CFM
 #include "cast_control_flow_map.h"
 
-void CAstWrapper::log(jobject castTree) {
-  jstring jstr = (jstring)env->CallStaticObjectMethod(CAstPrinter, castPrint, castTree);
-  const char *cstr = env->GetStringUTFChars(jstr, NULL);
-  fprintf(stderr, "%s\n", cstr); 
-  env->ReleaseStringUTFChars(jstr, cstr);
+int CAstWrapper::operatorIndex(jobject n) {
+  jobject operators[] = {
+#define _LIST_OPERATORS
+#include "cast_operators.h"
+  };
+
+  for(unsigned i = 0; i < sizeof(operators)/sizeof(jobject); i++) {
+    if (operators[i] == n) return i;
+  }
+
+  return -1;
+}
+
+/**
+ *  Operators are shared global references rather than nodes built
+ * through the wrapper, so they are recognized by identity.  A child
+ * the wrapper knows nothing about gets a fingerprint of its own that
+ * no other subtree shares, so that the enclosing fingerprints never
+ * match anything and no stale entity can be reused for them.
+ */
+jlong CAstWrapper::subtreeFingerprint(jobject child) {
+  static std::atomic<jlong> unknown(0);
+
+  CAstFingerprint fp;
+  if (child == NULL) {
+    fp.node(-1, 0);
+    return fp.value();
+  }
+
+  int op = operatorIndex(child);
+  if (op >= 0) {
+    fp.constant((jlong) op);
+    fp.node(OPERATOR, 0);
+    return fp.value();
+  }
+
+  NodeInfo *info = getNodeInfo(child);
+  if (info != NULL && info->fingerprinted) {
+    return info->fingerprint;
+  }
+
+  fp.constant(unknown++);
+  return fp.value();
+}
+
+/**
+ *  The fingerprint of a node of the given kind, with the first n
+ * children in cs and the rest, if any, in the array rest.
+ */
+jlong CAstWrapper::fingerprintNode(int kind, int n, jobject *cs, jobjectArray rest) {
+  CAstFingerprint fp;
+  for(int i = 0; i < n; i++) {
+    fp.subtree(subtreeFingerprint(cs[i]));
+  }
+
+  int count = n;
+  if (rest != NULL) {
+    int len = env->GetArrayLength(rest);
+    for(int i = 0; i < len; i++) {
+      jobject c = env->GetObjectArrayElement(rest, i);
+      THROW_ANY_EXCEPTION(java_ex);
+      fp.subtree(subtreeFingerprint(c));
+      env->DeleteLocalRef(c);
+    }
+    count += len;
+  }
+
+  fp.node(kind, count);
+  return fp.value();
+}
+
+/**
+ *  Object constants are opaque here, so they are fingerprinted by
+ * their class and printed form; that is their value for strings and
+ * boxed primitives, and includes the identity hash code for objects
+ * that do not override toString, which then only match themselves.
+ */
+void CAstWrapper::fingerprintObject(jobject val, CAstFingerprint &fp) {
+  if (val == NULL) {
+    return;
+  }
+
+  jobject cls = env->CallObjectMethod(val, getClass);
+  THROW_ANY_EXCEPTION(java_ex);
+  jstring clsName = (jstring)env->CallObjectMethod(cls, toString);
   THROW_ANY_EXCEPTION(java_ex);
+  jstring text = (jstring)env->CallObjectMethod(val, toString);
+  THROW_ANY_EXCEPTION(java_ex);
+
+  jstring strs[] = { clsName, text };
+  for(int i = 0; i < 2; i++) {
+    if (strs[i] == NULL) {
+      fp.constant(false);
+      continue;
+    }
+
+    const char *chars = env->GetStringUTFChars(strs[i], NULL);
+    THROW_ANY_EXCEPTION(java_ex);
+    fp.constant(chars, env->GetStringUTFLength(strs[i]));
+    env->ReleaseStringUTFChars(strs[i], chars);
+  }
+
+  env->DeleteLocalRef(text);
+  env->DeleteLocalRef(clsName);
+  env->DeleteLocalRef(cls);
+}
+
+/**
+ *  fp holds the value of the constant node just built.
+ */
+void CAstWrapper::fingerprintConstant(jobject node, CAstFingerprint &fp) {
+  fp.node(CONSTANT, 0);
+  fingerprintBuilt(node, fp.value());
+}
+
+/**
+ *  Mix the fingerprint of a node just built into the open fingerprint,
+ * and keep it for when the node is used as a child.
+ */
+void CAstWrapper::fingerprintBuilt(jobject node, jlong fingerprint) {
+  fingerprints.back().subtree(fingerprint);
+
+  NodeInfo *info = makeNodeInfo(node);
+  if (info != NULL) {
+    info->fingerprint = fingerprint;
+    info->fingerprinted = true;
+  }
+}
+
+CAstWrapper::NodeInfo *CAstWrapper::getNodeInfo(jobject node) {
+  int id = getNodeId(node);
+  if (id < 0 || nodeInfoBase < 0 || id < nodeInfoBase || id - nodeInfoBase >= (int)nodeInfo.size()) {
+    return NULL;
+  }
+
+  return &nodeInfo[id - nodeInfoBase];
+}
+
+CAstWrapper::NodeInfo *CAstWrapper::makeNodeInfo(jobject node) {
+  int id = getNodeId(node);
+  if (id < 0) {
+    return NULL;
+  }
+
+  if (nodeInfoBase < 0) {
+    nodeInfoBase = id;
+  } else if (id < nodeInfoBase) {
+    return NULL;
+  }
+
+  if (id - nodeInfoBase >= (int)nodeInfo.size()) {
+    nodeInfo.resize(id - nodeInfoBase + 1);
+  }
+
+  return &nodeInfo[id - nodeInfoBase];
+}
+
+/**
+ *  The node table is only needed while a fingerprint or a size summary
+ * is open, or folding is on.
+ */
+void CAstWrapper::releaseNodeInfo() {
+  if (fingerprints.empty() && sizeSummaries.empty() && evaluator == NULL) {
+    vector<NodeInfo>().swap(nodeInfo);
+    nodeInfoBase = -1;
+  }
+}
+
+void CAstWrapper::beginFingerprint() {
+  fingerprints.push_back(CAstFingerprint());
+}
+
+jlong CAstWrapper::endFingerprint() {
+  if (fingerprints.empty()) {
+    die("endFingerprint without beginFingerprint");
+  }
+
+  CAstFingerprint fp = fingerprints.back();
+  fingerprints.pop_back();
+  if (! fingerprints.empty()) {
+    fingerprints.back().entity(fp);
+  }
+
+  releaseNodeInfo();
+  return fp.value();
+}
+
+CAstFingerprint &CAstWrapper::currentFingerprint() {
+  if (fingerprints.empty()) {
+    die("no fingerprint in progress");
+  }
+
+  return fingerprints.back();
+}
+
+void CAstWrapper::recordCall(jobject call) {
+  noteEntry();
+  callNodes.push_back(env->NewGlobalRef(call));
+}
+
+void CAstWrapper::beginCallSites() {
+  callFrames.push_back(callNodes.size());
+}
+
+void CAstWrapper::endCallSites(jobject entity) {
+  PROFILE(SIDE_TABLES);
+  if (callFrames.empty()) {
+    die("endCallSites without beginCallSites");
+  }
+
+  int start = callFrames.back();
+  int count = callNodes.size() - start;
+  callFrames.pop_back();
+
+  jobjectArray calls = makeArray(CAstNode, count, callNodes.data() + start);
+  env->CallVoidMethod(xlator, _setCallSites, entity, calls);
+  THROW_ANY_EXCEPTION(java_ex);
+
+  env->DeleteLocalRef(calls);
+  for(int i = start; i < start + count; i++) {
+    env->DeleteGlobalRef(callNodes[i]);
+  }
+  callNodes.resize(start);
+}
+
+void CAstWrapper::forgetCallSites() {
+  for(CAstArenaVector<jobject>::iterator c = callNodes.begin(); c != callNodes.end(); c++) {
+    env->DeleteGlobalRef(*c);
+  }
+  callNodes.clear();
+  callFrames.clear();
+}
+
+int CAstWrapper::summaryDepth(jobject node) {
+  NodeInfo *info = getNodeInfo(node);
+  return info == NULL || info->depth == 0 ? 1 : info->depth;
+}
+
+void CAstWrapper::summarize(jobject node, int kind, int depth) {
+  SizeSummary &s = sizeSummaries.back();
+  if (kind >= 0 && kind < SUMMARY_KINDS) s.kindCounts[kind]++;
+  s.nodeCount++;
+  if (depth > s.maxDepth) s.maxDepth = depth;
+
+  NodeInfo *info = makeNodeInfo(node);
+  if (info != NULL) {
+    info->depth = depth;
+  }
+}
+
+void CAstWrapper::summarizeNode(jobject node, int kind, int childCount, jobject *children) {
+  int depth = 0;
+  for(int i = 0; i < childCount; i++) {
+    depth = std::max(depth, summaryDepth(children[i]));
+  }
+  summarize(node, kind, depth + 1);
+}
+
+void CAstWrapper::summarizeNode(jobject node, int kind, jobject first, jobjectArray rest) {
+  int depth = first == NULL ? 0 : summaryDepth(first);
+  int len = env->GetArrayLength(rest);
+  for(int i = 0; i < len; i++) {
+    jobject c = env->GetObjectArrayElement(rest, i);
+    THROW_ANY_EXCEPTION(java_ex);
+    depth = std::max(depth, summaryDepth(c));
+    env->DeleteLocalRef(c);
+  }
+  summarize(node, kind, depth + 1);
+}
+
+void CAstWrapper::beginSizeSummary() {
+  SizeSummary s;
+  memset(&s, 0, sizeof(s));
+  sizeSummaries.push_back(s);
+}
+
+void CAstWrapper::endSizeSummary(jobject entity) {
+  PROFILE(SIDE_TABLES);
+  if (sizeSummaries.empty()) {
+    die("endSizeSummary without beginSizeSummary");
+  }
+
+  SizeSummary s = sizeSummaries.back();
+  sizeSummaries.pop_back();
+  releaseNodeInfo();
+
+  jintArray counts = env->NewIntArray(SUMMARY_KINDS);
+  THROW_ANY_EXCEPTION(java_ex);
+  env->SetIntArrayRegion(counts, 0, SUMMARY_KINDS, s.kindCounts);
+  env->CallVoidMethod(xlator, _setSizeSummary, entity, counts, s.nodeCount, s.maxDepth, s.gotoEdges);
+  THROW_ANY_EXCEPTION(java_ex);
+  env->DeleteLocalRef(counts);
+}
+
+jobject CAstWrapper::getCachedEntity(const char *key, jlong fingerprint) {
+  jstring jkey = makeString(key);
+  THROW_ANY_EXCEPTION(java_ex);
+  jobject entity = env->CallObjectMethod(xlator, _getCachedEntity, jkey, fingerprint);
+  THROW_ANY_EXCEPTION(java_ex);
+  return entity;
+}
+
+void CAstWrapper::cacheEntity(const char *key, jlong fingerprint, jobject entity) {
+  jstring jkey = makeString(key);
+  THROW_ANY_EXCEPTION(java_ex);
+  env->CallVoidMethod(xlator, _cacheEntity, jkey, fingerprint, entity);
+  THROW_ANY_EXCEPTION(java_ex);
+}
+
+jobject CAstWrapper::getDuplicateEntity(jlong fingerprint, const char *name, jobject position) {
+  jstring jname = name == NULL ? NULL : makeString(name);
+  THROW_ANY_EXCEPTION(java_ex);
+  jobject entity = env->CallObjectMethod(xlator, _getDuplicateEntity, fingerprint, jname, position);
+  THROW_ANY_EXCEPTION(java_ex);
+  return entity;
+}
+
+void CAstWrapper::recordCanonicalEntity(jlong fingerprint, jobject entity) {
+  env->CallVoidMethod(xlator, _recordCanonicalEntity, fingerprint, entity);
+  THROW_ANY_EXCEPTION(java_ex);
+}
+
+void CAstWrapper::log(jobject castTree) {
+  if (logger == NULL) {
+    logger = new CAstExporter(*this, stderr, CAstExporter::TEXT);
+  }
+  logger->exportTree(castTree);
 }
 
 void CAstWrapper::assertIsCAstNode(jobject obj, int n) {
@@ -264,11 +727,7 @@ void CAstWrapper::assertIsCAstNode(jobject obj, int n) {
     jstring jclsstr = (jstring)env->CallObjectMethod(cls, toString);
     const char *cclsstr = env->GetStringUTFChars(jclsstr, NULL);
 
-#if defined(_MSC_VER)
-	char* buf = (char*)_alloca(strlen(cstr) + strlen(cclsstr) + 100);
-#else
-    char buf[ strlen(cstr) + strlen(cclsstr) + 100 ];
-#endif
+    char *buf = (char *)arena.allocate(strlen(cstr) + strlen(cclsstr) + 100, 1);
     sprintf(buf, "argument %d (%s of type %s) is not a CAstNode\n", n, cstr, cclsstr); 
 
     env->ReleaseStringUTFChars(jstr, cstr);
@@ -277,160 +736,575 @@ void CAstWrapper::assertIsCAstNode(jobject obj, int n) {
   }
 }
   
+int CAstWrapper::getNodeId(jobject node) {
+  if (node == NULL || nodeIdField == NULL || !env->IsInstanceOf(node, CAstNumberedNodeImpl)) {
+    return -1;
+  }
+
+  return env->GetIntField(node, nodeIdField);
+}
+
 jobject CAstWrapper::makeNode(int kind) {
+  PROFILE(MAKE_NODE);
+  jlong fingerprint = fingerprints.empty() ? 0 : fingerprintNode(kind, 0, NULL, NULL);
   jobject r = env->CallObjectMethod(Ast, makeNode0, (jint) kind);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) fingerprintBuilt(r, fingerprint);
+  if (evaluator != NULL) stampNode(r, 0, NULL, NULL);
+  if (! sizeSummaries.empty()) summarizeNode(r, kind, 0, NULL);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeNode(int kind, jobject c1) {
+  PROFILE(MAKE_NODE);
   assertIsCAstNode(c1, 1);
+  jobject cs[] = { c1 };
+  jlong fingerprint = fingerprints.empty() ? 0 : fingerprintNode(kind, 1, cs, NULL);
   jobject r = env->CallObjectMethod(Ast, makeNode1, (jint) kind, c1);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) fingerprintBuilt(r, fingerprint);
+  if (evaluator != NULL) stampNode(r, 1, cs, NULL);
+  if (! sizeSummaries.empty()) summarizeNode(r, kind, 1, cs);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeNode(int kind, jobject c1, jobject c2) {
+  PROFILE(MAKE_NODE);
   assertIsCAstNode(c1, 1);
   assertIsCAstNode(c2, 2);
+  jobject cs[] = { c1, c2 };
+  jlong fingerprint = fingerprints.empty() ? 0 : fingerprintNode(kind, 2, cs, NULL);
+  if (evaluator != NULL) {
+    jobject replacement = fold(kind, 2, cs);
+    if (replacement != NULL) {
+      if (! fingerprints.empty()) fingerprintBuilt(replacement, fingerprint);
+      return replacement;
+    }
+  }
   jobject r = env->CallObjectMethod(Ast, makeNode2, (jint) kind, c1, c2);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) fingerprintBuilt(r, fingerprint);
+  if (evaluator != NULL) stampNode(r, 2, cs, NULL);
+  if (! sizeSummaries.empty()) summarizeNode(r, kind, 2, cs);
+  if (kind == CALL && ! callFrames.empty()) recordCall(r);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeNode(int kind, jobject c1, jobject c2, jobject c3) {
+  PROFILE(MAKE_NODE);
   assertIsCAstNode(c1, 1);
   assertIsCAstNode(c2, 2);
   assertIsCAstNode(c3, 3);
+  jobject cs[] = { c1, c2, c3 };
+  jlong fingerprint = fingerprints.empty() ? 0 : fingerprintNode(kind, 3, cs, NULL);
+  if (evaluator != NULL) {
+    jobject replacement = fold(kind, 3, cs);
+    if (replacement != NULL) {
+      if (! fingerprints.empty()) fingerprintBuilt(replacement, fingerprint);
+      return replacement;
+    }
+  }
   jobject r = env->CallObjectMethod(Ast, makeNode3, (jint) kind, c1, c2, c3);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) fingerprintBuilt(r, fingerprint);
+  if (evaluator != NULL) stampNode(r, 3, cs, NULL);
+  if (! sizeSummaries.empty()) summarizeNode(r, kind, 3, cs);
+  if (kind == CALL && ! callFrames.empty()) recordCall(r);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeNode(int kind, jobject c1, jobject c2, jobject c3, jobject c4) {
+  PROFILE(MAKE_NODE);
   assertIsCAstNode(c1, 1);
   assertIsCAstNode(c2, 2);
   assertIsCAstNode(c3, 3);
   assertIsCAstNode(c4, 4);
+  jobject cs[] = { c1, c2, c3, c4 };
+  jlong fingerprint = fingerprints.empty() ? 0 : fingerprintNode(kind, 4, cs, NULL);
   jobject r = env->CallObjectMethod(Ast, makeNode4, (jint) kind, c1, c2, c3, c4);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) fingerprintBuilt(r, fingerprint);
+  if (evaluator != NULL) stampNode(r, 4, cs, NULL);
+  if (! sizeSummaries.empty()) summarizeNode(r, kind, 4, cs);
+  if (kind == CALL && ! callFrames.empty()) recordCall(r);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeNode(int kind, jobject c1, jobject c2, jobject c3, jobject c4, jobject c5) {
+  PROFILE(MAKE_NODE);
   assertIsCAstNode(c1, 1);
   assertIsCAstNode(c2, 2);
   assertIsCAstNode(c3, 3);
   assertIsCAstNode(c4, 4);
   assertIsCAstNode(c5, 5);
+  jobject cs[] = { c1, c2, c3, c4, c5 };
+  jlong fingerprint = fingerprints.empty() ? 0 : fingerprintNode(kind, 5, cs, NULL);
   jobject r = env->CallObjectMethod(Ast, makeNode5, (jint) kind, c1, c2, c3, c4, c5);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) fingerprintBuilt(r, fingerprint);
+  if (evaluator != NULL) stampNode(r, 5, cs, NULL);
+  if (! sizeSummaries.empty()) summarizeNode(r, kind, 5, cs);
+  if (kind == CALL && ! callFrames.empty()) recordCall(r);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeNode(int kind, jobject c1, jobject c2, jobject c3, jobject c4, jobject c5, jobject c6) {
+  PROFILE(MAKE_NODE);
   assertIsCAstNode(c1, 1);
   assertIsCAstNode(c2, 2);
   assertIsCAstNode(c3, 3);
   assertIsCAstNode(c4, 4);
   assertIsCAstNode(c5, 5);
   assertIsCAstNode(c6, 6);
+  jobject cs[] = { c1, c2, c3, c4, c5, c6 };
+  jlong fingerprint = fingerprints.empty() ? 0 : fingerprintNode(kind, 6, cs, NULL);
   jobject r = env->CallObjectMethod(Ast, makeNode6, (jint) kind, c1, c2, c3, c4, c5, c6);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) fingerprintBuilt(r, fingerprint);
+  if (evaluator != NULL) stampNode(r, 6, cs, NULL);
+  if (! sizeSummaries.empty()) summarizeNode(r, kind, 6, cs);
+  if (kind == CALL && ! callFrames.empty()) recordCall(r);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeNode(int kind, jobjectArray cs) {
+  PROFILE(MAKE_NODE);
+  jlong fingerprint = fingerprints.empty() ? 0 : fingerprintNode(kind, 0, NULL, cs);
   jobject r = env->CallObjectMethod(Ast, makeNodeNary, (jint) kind, cs);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) fingerprintBuilt(r, fingerprint);
+  if (evaluator != NULL) stampNode(r, 0, NULL, cs);
+  if (! sizeSummaries.empty()) summarizeNode(r, kind, NULL, cs);
+  if (kind == CALL && ! callFrames.empty()) recordCall(r);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeNode(int kind, jobject n, jobjectArray cs) {
+  PROFILE(MAKE_NODE);
+  jlong fingerprint = fingerprints.empty() ? 0 : fingerprintNode(kind, 1, &n, cs);
   jobject r = env->CallObjectMethod(Ast, makeNode1Nary, (jint) kind, n, cs);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) fingerprintBuilt(r, fingerprint);
+  if (evaluator != NULL) stampNode(r, 1, &n, cs);
+  if (! sizeSummaries.empty()) summarizeNode(r, kind, n, cs);
+  if (kind == CALL && ! callFrames.empty()) recordCall(r);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeConstant(bool val) {
+  PROFILE(MAKE_CONSTANT);
   jobject r = env->CallObjectMethod(Ast, makeBool, (jboolean)val);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) {
+    CAstFingerprint fp;
+    fp.constant(val);
+    fingerprintConstant(r, fp);
+  }
+  if (evaluator != NULL) {
+    stampNode(r, 0, NULL, NULL);
+    CAstConstantValue v;
+    v.kind = CAstConstantValue::BOOL_VALUE;
+    v.value.b = val;
+    rememberConstant(r, v);
+  }
+  if (! sizeSummaries.empty()) summarizeNode(r, CONSTANT, 0, NULL);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeConstant(char val) {
+  PROFILE(MAKE_CONSTANT);
   jobject r = env->CallObjectMethod(Ast, makeChar, (jchar)val);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) {
+    CAstFingerprint fp;
+    fp.constant((jlong)val);
+    fingerprintConstant(r, fp);
+  }
+  if (evaluator != NULL) {
+    stampNode(r, 0, NULL, NULL);
+    CAstConstantValue v;
+    v.kind = CAstConstantValue::CHAR_VALUE;
+    v.value.l = val;
+    rememberConstant(r, v);
+  }
+  if (! sizeSummaries.empty()) summarizeNode(r, CONSTANT, 0, NULL);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeConstant(short val) {
+  PROFILE(MAKE_CONSTANT);
   jobject r = env->CallObjectMethod(Ast, makeShort, (jshort)val);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) {
+    CAstFingerprint fp;
+    fp.constant((jlong)val);
+    fingerprintConstant(r, fp);
+  }
+  if (evaluator != NULL) {
+    stampNode(r, 0, NULL, NULL);
+    CAstConstantValue v;
+    v.kind = CAstConstantValue::SHORT_VALUE;
+    v.value.l = val;
+    rememberConstant(r, v);
+  }
+  if (! sizeSummaries.empty()) summarizeNode(r, CONSTANT, 0, NULL);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeConstant(int val) {
+  PROFILE(MAKE_CONSTANT);
   jobject r = env->CallObjectMethod(Ast, makeInt, (jint)val);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) {
+    CAstFingerprint fp;
+    fp.constant((jlong)val);
+    fingerprintConstant(r, fp);
+  }
+  if (evaluator != NULL) {
+    stampNode(r, 0, NULL, NULL);
+    CAstConstantValue v;
+    v.kind = CAstConstantValue::INT_VALUE;
+    v.value.l = val;
+    rememberConstant(r, v);
+  }
+  if (! sizeSummaries.empty()) summarizeNode(r, CONSTANT, 0, NULL);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeConstant(long val) {
+  PROFILE(MAKE_CONSTANT);
   jobject r = env->CallObjectMethod(Ast, makeLong, (jlong)val);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) {
+    CAstFingerprint fp;
+    fp.constant((jlong)val);
+    fingerprintConstant(r, fp);
+  }
+  if (evaluator != NULL) {
+    stampNode(r, 0, NULL, NULL);
+    CAstConstantValue v;
+    v.kind = CAstConstantValue::LONG_VALUE;
+    v.value.l = val;
+    rememberConstant(r, v);
+  }
+  if (! sizeSummaries.empty()) summarizeNode(r, CONSTANT, 0, NULL);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeConstant(double val) {
+  PROFILE(MAKE_CONSTANT);
   jobject r = env->CallObjectMethod(Ast, makeDouble, (jdouble)val);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) {
+    CAstFingerprint fp;
+    fp.constant(val);
+    fingerprintConstant(r, fp);
+  }
+  if (evaluator != NULL) {
+    stampNode(r, 0, NULL, NULL);
+    CAstConstantValue v;
+    v.kind = CAstConstantValue::DOUBLE_VALUE;
+    v.value.d = val;
+    rememberConstant(r, v);
+  }
+  if (! sizeSummaries.empty()) summarizeNode(r, CONSTANT, 0, NULL);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeConstant(float val) {
+  PROFILE(MAKE_CONSTANT);
   jobject r = env->CallObjectMethod(Ast, makeFloat, (jfloat)val);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) {
+    CAstFingerprint fp;
+    fp.constant((double)val);
+    fingerprintConstant(r, fp);
+  }
+  if (evaluator != NULL) {
+    stampNode(r, 0, NULL, NULL);
+    CAstConstantValue v;
+    v.kind = CAstConstantValue::FLOAT_VALUE;
+    v.value.d = val;
+    rememberConstant(r, v);
+  }
+  if (! sizeSummaries.empty()) summarizeNode(r, CONSTANT, 0, NULL);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeConstant(jobject val) {
+  PROFILE(MAKE_CONSTANT);
   jobject r = env->CallObjectMethod(Ast, makeObject, val);
   THROW_ANY_EXCEPTION(java_ex);
+  if (! fingerprints.empty()) {
+    CAstFingerprint fp;
+    fingerprintObject(val, fp);
+    fingerprintConstant(r, fp);
+  }
+  if (evaluator != NULL) stampNode(r, 0, NULL, NULL);
+  if (! sizeSummaries.empty()) summarizeNode(r, CONSTANT, 0, NULL);
   LOG(r);
   return r;
 }
 
 jobject CAstWrapper::makeConstant(const char *strData) {
+  PROFILE(MAKE_CONSTANT);
   return makeConstant(strData, strlen(strData));
 }
 
 jobject CAstWrapper::makeConstant(const char *strData, int strLen) {
-  char *safeData = strndup(strData, strLen);
-  jobject val = env->NewStringUTF( safeData );
-  delete safeData;
+  PROFILE(MAKE_CONSTANT);
+  jobject val = makeString(strData, strLen);
   jobject r = env->CallObjectMethod(Ast, makeObject, val);
   THROW_ANY_EXCEPTION(java_ex);
+  env->DeleteLocalRef(val);
+  if (! fingerprints.empty()) {
+    CAstFingerprint fp;
+    fp.constant(strData, strLen);
+    fingerprintConstant(r, fp);
+  }
+  if (evaluator != NULL) {
+    stampNode(r, 0, NULL, NULL);
+    CAstConstantValue v;
+    v.kind = CAstConstantValue::STRING_VALUE;
+    v.value.s.chars = strData;
+    v.value.s.length = strLen;
+    rememberConstant(r, v);
+  }
+  if (! sizeSummaries.empty()) summarizeNode(r, CONSTANT, 0, NULL);
   LOG(r);
   return r;
 }
 
+jstring CAstWrapper::makeString(const char *str) {
+  return makeString(str, strlen(str));
+}
+
+jstring CAstWrapper::makeString(const char *str, int len) {
+  jstring result = NULL;
+  int n;
+  {
+    jchar buffer[256];
+    CAstArena::Scope scope(arena);
+    jchar *chars = len <= 256? buffer: (jchar *)scope.getArena().allocate(len * sizeof(jchar), alignof(jchar));
+    n = CAstUtf8::toUtf16(str, len, chars);
+    if (n >= 0) result = env->NewString(chars, n);
+  }
+  if (n < 0) {
+    THROW(java_ex, "invalid UTF-8 in string");
+  }
+  THROW_ANY_EXCEPTION(java_ex);
+  return result;
+}
+
+jobjectArray CAstWrapper::makeStrings(const CAstStringBatch &batch) {
+  const vector<jchar> &chars = batch.getChars();
+  const vector<jint> &ends = batch.getEnds();
+
+  jcharArray jchars = env->NewCharArray(chars.size());
+  THROW_ANY_EXCEPTION(java_ex);
+  env->SetCharArrayRegion(jchars, 0, chars.size(), chars.data());
+  jintArray jends = env->NewIntArray(ends.size());
+  THROW_ANY_EXCEPTION(java_ex);
+  env->SetIntArrayRegion(jends, 0, ends.size(), ends.data());
+
+  jobjectArray result = (jobjectArray)env->CallStaticObjectMethod(PackedStrings, unpackStrings, jchars, jends);
+  THROW_ANY_EXCEPTION(java_ex);
+
+  env->DeleteLocalRef(jchars);
+  env->DeleteLocalRef(jends);
+  return result;
+}
+
+jobject CAstWrapper::makeConstant(const CAstConstantValue &v) {
+  PROFILE(MAKE_CONSTANT);
+  switch (v.kind) {
+  case CAstConstantValue::BOOL_VALUE: return makeConstant(v.value.b);
+  case CAstConstantValue::CHAR_VALUE: return makeConstant((char) v.value.l);
+  case CAstConstantValue::SHORT_VALUE: return makeConstant((short) v.value.l);
+  case CAstConstantValue::INT_VALUE: return makeConstant((int) v.value.l);
+  case CAstConstantValue::LONG_VALUE: return makeConstant((long) v.value.l);
+  case CAstConstantValue::FLOAT_VALUE: return makeConstant((float) v.value.d);
+  case CAstConstantValue::DOUBLE_VALUE: return makeConstant(v.value.d);
+  case CAstConstantValue::STRING_VALUE: return makeConstant(v.value.s.chars, v.value.s.length);
+  }
+
+  die("bad constant kind");
+  return NULL;
+}
+
+void CAstWrapper::setConstantEvaluator(CAstConstantEvaluator *evaluator) {
+  this->evaluator = evaluator;
+  forgetConstants();
+  releaseNodeInfo();
+}
+
+/**
+ *  The characters of v, if it is a string, may be those of the slot
+ * being reused, e.g. when the evaluator returns an operand unchanged,
+ * so they are copied before the old buffer goes.
+ */
+void CAstWrapper::rememberConstant(jobject n, const CAstConstantValue &v) {
+  KnownConstant &k = knownConstants[nextKnownConstant];
+  if (k.ref != NULL) {
+    env->DeleteGlobalRef(k.ref);
+  }
+  k.node = n;
+  k.ref = env->NewGlobalRef(n);
+  k.value = v;
+  if (v.kind == CAstConstantValue::STRING_VALUE) {
+    if (v.value.s.length > k.capacity) {
+      char *chars = new char[v.value.s.length];
+      memcpy(chars, v.value.s.chars, v.value.s.length);
+      delete[] k.chars;
+      k.chars = chars;
+      k.capacity = v.value.s.length;
+    } else {
+      memmove(k.chars, v.value.s.chars, v.value.s.length);
+    }
+    k.value.value.s.chars = k.chars;
+  }
+  nextKnownConstant = (nextKnownConstant + 1) % KNOWN_CONSTANTS;
+}
+
+void CAstWrapper::forgetConstants() {
+  for(int i = 0; i < KNOWN_CONSTANTS; i++) {
+    if (knownConstants[i].ref != NULL) {
+      env->DeleteGlobalRef(knownConstants[i].ref);
+    }
+    delete[] knownConstants[i].chars;
+  }
+  memset(knownConstants, 0, sizeof(knownConstants));
+  nextKnownConstant = 0;
+}
+
+/**
+ *  A reference equal to that of a known constant may since have been
+ * deleted and reused for another node, so a match is only believed if
+ * the global reference kept with the constant still agrees.
+ */
+const CAstConstantValue *CAstWrapper::getKnownConstant(jobject n) {
+  if (n != NULL) {
+    for(int i = 0; i < KNOWN_CONSTANTS; i++) {
+      KnownConstant &k = knownConstants[i];
+      if (k.node == n) {
+	if (env->IsSameObject(k.ref, n)) {
+	  return &k.value;
+	}
+
+	env->DeleteGlobalRef(k.ref);
+	k.node = NULL;
+	k.ref = NULL;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ *  The folded replacement for a node about to be built, or NULL if it
+ * has to be built after all; mirrors ConstantFoldingRewriter.  A child
+ * kept as the replacement is returned as a new local reference, so the
+ * caller can delete its own as with any built node.
+ */
+jobject CAstWrapper::fold(int kind, int n, jobject *cs) {
+  jobject replacement = NULL;
+  if (kind == BINARY_EXPR && n == 3) {
+    int op = operatorIndex(cs[0]);
+    const CAstConstantValue *lhs = getKnownConstant(cs[1]);
+    const CAstConstantValue *rhs = getKnownConstant(cs[2]);
+    CAstConstantValue result;
+    if (op >= 0 && lhs != NULL && rhs != NULL && evaluator->eval(op, *lhs, *rhs, result, arena)) {
+      replacement = makeConstant(result);
+      noteDropped(cs[1]);
+      noteDropped(cs[2]);
+    }
+
+  } else if (kind == IF_EXPR || kind == IF_STMT) {
+    const CAstConstantValue *cond = getKnownConstant(cs[0]);
+    if (cond != NULL && cond->kind == CAstConstantValue::BOOL_VALUE) {
+      if (cond->value.b) {
+	replacement = env->NewLocalRef(cs[1]);
+	noteDropped(cs[0]);
+	if (n > 2) noteDropped(cs[2]);
+      } else if (n > 2) {
+	replacement = env->NewLocalRef(cs[2]);
+	noteDropped(cs[0]);
+	noteDropped(cs[1]);
+      }
+    }
+  }
+
+  if (replacement != NULL) {
+    // what summaries counted of the dropped nodes is an entry too
+    if (! sizeSummaries.empty()) noteEntry();
+    dropClock = nodeClock;
+  }
+  return replacement;
+}
+
+/**
+ *  Stamp a node just built from the clock, and note the earliest stamp
+ * in its subtree, given the first n children in cs and the rest, if
+ * any, in the array rest.  Operators are shared, so they do not count.
+ */
+void CAstWrapper::stampNode(jobject node, int n, jobject *cs, jobjectArray rest) {
+  jint first = ++nodeClock;
+  for(int i = 0; i < n; i++) {
+    if (cs[i] != NULL && operatorIndex(cs[i]) < 0) {
+      first = min(first, firstStamp(cs[i]));
+    }
+  }
+
+  if (rest != NULL) {
+    int len = env->GetArrayLength(rest);
+    for(int i = 0; i < len; i++) {
+      jobject c = env->GetObjectArrayElement(rest, i);
+      THROW_ANY_EXCEPTION(java_ex);
+      if (c != NULL && operatorIndex(c) < 0) {
+	first = min(first, firstStamp(c));
+      }
+      env->DeleteLocalRef(c);
+    }
+  }
+
+  NodeInfo *info = makeNodeInfo(node);
+  if (info != NULL) {
+    info->first = first;
+  }
+}
+
+jint CAstWrapper::firstStamp(jobject node) {
+  NodeInfo *info = node == NULL ? NULL : getNodeInfo(node);
+  return info == NULL ? 0 : info->first;
+}
+
+void CAstWrapper::noteEntry() {
+  lastEntry = nodeClock;
+}
+
+void CAstWrapper::noteDropped(jobject node) {
+  if (node != NULL) {
+    dropFirst = min(dropFirst, firstStamp(node));
+  }
+}
+
 jobject CAstWrapper::getNthChild(jobject castNode, int index) {
   jobject result = env->CallObjectMethod(castNode, getChild, index);
   THROW_ANY_EXCEPTION(java_ex);
@@ -488,15 +1362,28 @@ bool CAstWrapper::isSwitchDefaultConstantValue(jobject castNode) {
   return env->IsSameObject(jval, SWITCH_DEFAULT);
 }
 
+const char *CAstWrapper::copyString(jstring jstr) {
+  if (jstr == NULL) {
+    return NULL;
+  }
+
+  jsize len = env->GetStringLength(jstr);
+  const jchar *chars = env->GetStringChars(jstr, NULL);
+  THROW_ANY_EXCEPTION(java_ex);
+  char *cstr = (char *)arena.allocate(3 * (size_t)len + 1, 1);
+  int n = CAstUtf8::fromUtf16(chars, len, cstr);
+  cstr[n] = '\0';
+  env->ReleaseStringChars(jstr, chars);
+
+  return cstr;
+}
+
 const char *CAstWrapper::getStringConstantValue(jobject castNode) {
   jstring jstr = (jstring)env->CallObjectMethod(castNode, getValue);
   THROW_ANY_EXCEPTION(java_ex);
-  const char *cstr1 = env->GetStringUTFChars(jstr, NULL);
-  const char *cstr2 = strdup( cstr1 );
-  env->ReleaseStringUTFChars(jstr, cstr1);
-  THROW_ANY_EXCEPTION(java_ex);
-
-  return cstr2;
+  const char *cstr = copyString(jstr);
+  env->DeleteLocalRef(jstr);
+  return cstr;
 }
   
 int CAstWrapper::getIntConstantValue(jobject castNode) {
@@ -515,10 +1402,12 @@ jobject CAstWrapper::getConstantValue(jobject castNode) {
 }
   
 jobjectArray CAstWrapper::makeArray(list<jobject> *elts) {
+  PROFILE(MAKE_COLLECTION);
   return makeArray(CAstNode, elts);
 }
 
 jobjectArray CAstWrapper::makeArray(jclass type, list<jobject> *elts) {
+  PROFILE(MAKE_COLLECTION);
   jobjectArray result = env->NewObjectArray(elts->size(), type, NULL);
   int i = 0;
   for(list<jobject>::iterator it=elts->begin(); it!=elts->end(); it++) {
@@ -529,11 +1418,23 @@ jobjectArray CAstWrapper::makeArray(jclass type, list<jobject> *elts) {
   return result;
 }
 
+jobjectArray CAstWrapper::makeArray(const CAstArenaVector<jobject> &elts) {
+  PROFILE(MAKE_COLLECTION);
+  return makeArray(CAstNode, elts);
+}
+
+jobjectArray CAstWrapper::makeArray(jclass type, const CAstArenaVector<jobject> &elts) {
+  PROFILE(MAKE_COLLECTION);
+  return makeArray(type, elts.size(), (jobject *)elts.data());
+}
+
 jobjectArray CAstWrapper::makeArray(int count, jobject elts[]) {
+  PROFILE(MAKE_COLLECTION);
   return makeArray(CAstNode, count, elts);
 }
 
 jobjectArray CAstWrapper::makeArray(jclass type, int count, jobject elts[]) {
+  PROFILE(MAKE_COLLECTION);
   jobjectArray result = env->NewObjectArray(count, type, NULL);
   THROW_ANY_EXCEPTION(java_ex);
 
@@ -546,6 +1447,7 @@ jobjectArray CAstWrapper::makeArray(jclass type, int count, jobject elts[]) {
 }
 
 jobject CAstWrapper::makeSet(list<jobject> *elts) {
+  PROFILE(MAKE_COLLECTION);
   jobject set = env->NewObject(HashSet, hashSetInit);
   THROW_ANY_EXCEPTION(java_ex);
 
@@ -559,6 +1461,7 @@ jobject CAstWrapper::makeSet(list<jobject> *elts) {
 }
 
 jobject CAstWrapper::makeList(list<jobject> *elts) {
+  PROFILE(MAKE_COLLECTION);
   jobject set = env->NewObject(LinkedList, linkedListInit);
   THROW_ANY_EXCEPTION(java_ex);
 
@@ -571,6 +1474,30 @@ jobject CAstWrapper::makeList(list<jobject> *elts) {
   return set;
 }
 
+jobject CAstWrapper::makeSet(const CAstArenaVector<jobject> &elts) {
+  PROFILE(MAKE_COLLECTION);
+  jobject set = env->NewObject(HashSet, hashSetInit);
+  THROW_ANY_EXCEPTION(java_ex);
+
+  for(CAstArenaVector<jobject>::const_iterator it=elts.begin(); it!=elts.end(); it++) {
+    env->CallBooleanMethod(set, hashSetAdd, *it);
+  }
+  
+  return set;
+}
+
+jobject CAstWrapper::makeList(const CAstArenaVector<jobject> &elts) {
+  PROFILE(MAKE_COLLECTION);
+  jobject set = env->NewObject(LinkedList, linkedListInit);
+  THROW_ANY_EXCEPTION(java_ex);
+
+  for(CAstArenaVector<jobject>::const_iterator it=elts.begin(); it!=elts.end(); it++) {
+    env->CallBooleanMethod(set, linkedListAdd, *it);
+  }
+  
+  return set;
+}
+
 jobject CAstWrapper::getCallReference() {
   return callReference;
 }
@@ -578,19 +1505,14 @@ jobject CAstWrapper::getCallReference() {
 const char *CAstWrapper::getEntityName(jobject entity) {
   jstring jstr = (jstring) env->CallObjectMethod(entity, _getEntityName);
   THROW_ANY_EXCEPTION(java_ex);
-
-  const char *cstr1 = env->GetStringUTFChars(jstr, NULL);
-  const char *cstr2 = strdup( cstr1 );
-  env->ReleaseStringUTFChars(jstr, cstr1);
-  THROW_ANY_EXCEPTION(java_ex);
-
-  return cstr2;
+  const char *cstr = copyString(jstr);
+  env->DeleteLocalRef(jstr);
+  return cstr;
 }
 
 jobject CAstWrapper::makeSymbol(const char *name) {
-  char *safeName = strndup(name, strlen(name)+1);
-  jobject val = env->NewStringUTF( safeName );
-  delete safeName;
+  PROFILE(MAKE_SYMBOL);
+  jobject val = makeString( name );
 
   jobject s = env->NewObject(CAstSymbol, castSymbolInit1, val);
   THROW_ANY_EXCEPTION(java_ex);
@@ -600,9 +1522,8 @@ jobject CAstWrapper::makeSymbol(const char *name) {
 }
 
 jobject CAstWrapper::makeSymbol(const char *name, bool isFinal) {
-  char *safeName = strndup(name, strlen(name)+1);
-  jobject val = env->NewStringUTF( safeName );
-  delete safeName;
+  PROFILE(MAKE_SYMBOL);
+  jobject val = makeString( name );
 
   THROW_ANY_EXCEPTION(java_ex);
 
@@ -614,9 +1535,7 @@ jobject CAstWrapper::makeSymbol(const char *name, bool isFinal) {
 jobject 
   CAstWrapper::makeSymbol(const char *name, bool isFinal, bool isCaseInsensitive) 
 {
-  char *safeName = strndup(name, strlen(name)+1);
-  jobject val = env->NewStringUTF( safeName );
-  delete safeName;
+  jobject val = makeString( name );
 
   jobject s = env->NewObject(CAstSymbol, castSymbolInit3, val, isFinal, isCaseInsensitive);
   THROW_ANY_EXCEPTION(java_ex);
@@ -631,9 +1550,7 @@ jobject
 			  bool isCaseInsensitive, 
 			  jobject defaultValue) 
 {
-  char *safeName = strndup(name, strlen(name)+1);
-  jobject val = env->NewStringUTF( safeName );
-  delete safeName;
+  jobject val = makeString( name );
 
   jobject s = env->NewObject(CAstSymbol, castSymbolInit4, val, isFinal, isCaseInsensitive, defaultValue);
   THROW_ANY_EXCEPTION(java_ex);
@@ -644,57 +1561,296 @@ jobject
 
 void CAstWrapper::addChildEntity(jobject parent, jobject n, jobject child) 
 {
-  env->CallVoidMethod(parent, addScopedEntity, n, child);
+  PROFILE(ENTITIES);
+  noteEntry();
+  scopedParents.push_back(env->NewLocalRef(parent));
+  scopedConstructs.push_back(n == NULL ? NULL : env->NewLocalRef(n));
+  scopedChildren.push_back(env->NewLocalRef(child));
+  if (scopedParents.size() == SCOPED_ENTITY_BATCH) {
+    flushScopedEntities();
+  }
+}
+
+void CAstWrapper::flushScopedEntities() {
+  PROFILE(ENTITIES);
+  passScopedEntities();
+  THROW_ANY_EXCEPTION(java_ex);
+}
+
+bool CAstWrapper::passScopedEntities() {
+  if (scopedParents.empty()) {
+    return !env->ExceptionCheck();
+  }
+
+  int count = scopedParents.size();
+  if (!env->ExceptionCheck()) {
+    jobjectArray parents = env->NewObjectArray(count, NativeEntity, NULL);
+    jobjectArray constructs = parents == NULL ? NULL : env->NewObjectArray(count, CAstNode, NULL);
+    jobjectArray children = constructs == NULL ? NULL : env->NewObjectArray(count, CAstEntity, NULL);
+    if (children != NULL) {
+      for(int i = 0; i < count && !env->ExceptionCheck(); i++) {
+	env->SetObjectArrayElement(parents, i, scopedParents[i]);
+	env->SetObjectArrayElement(constructs, i, scopedConstructs[i]);
+	env->SetObjectArrayElement(children, i, scopedChildren[i]);
+      }
+      if (!env->ExceptionCheck()) {
+	env->CallVoidMethod(xlator, _addScopedEntities, parents, constructs, children, (jint) count);
+      }
+    }
+    if (parents != NULL) env->DeleteLocalRef(parents);
+    if (constructs != NULL) env->DeleteLocalRef(constructs);
+    if (children != NULL) env->DeleteLocalRef(children);
+  }
+
+  for(int i = 0; i < count; i++) {
+    env->DeleteLocalRef(scopedParents[i]);
+    if (scopedConstructs[i] != NULL) env->DeleteLocalRef(scopedConstructs[i]);
+    env->DeleteLocalRef(scopedChildren[i]);
+  }
+  scopedParents.clear();
+  scopedConstructs.clear();
+  scopedChildren.clear();
+  return !env->ExceptionCheck();
 }
 
 void CAstWrapper::setGotoTarget(jobject entity, jobject from, jobject to) {
+  PROFILE(SIDE_TABLES);
+  noteEntry();
+  if (! sizeSummaries.empty()) sizeSummaries.back().gotoEdges++;
   env->CallVoidMethod(entity, codeSetGotoTarget, from, to);
 }
 
 void CAstWrapper::setGotoTarget(jobject entity, jobject from, jobject to, bool label) {
-  jobject javaLabel;
-  jclass boolean = env->FindClass("java/lang/Boolean");
-  if (label) {
-    jfieldID trueId =
-      env->GetStaticFieldID(boolean, "TRUE", "Ljava/lang/Boolean;");
-    javaLabel = env->GetStaticObjectField(boolean, trueId);
-  } else {
-    jfieldID falseId =
-      env->GetStaticFieldID(boolean, "FALSE", "Ljava/lang/Boolean;");
-    javaLabel = env->GetStaticObjectField(boolean, falseId);
-  }
-  setGotoTarget(entity, from, to, javaLabel);
+  PROFILE(SIDE_TABLES);
+  setGotoTarget(entity, from, to, label ? trueLabel : falseLabel);
 }
 
 void CAstWrapper::setGotoTarget(jobject entity, jobject from, jobject to, jobject label) {
+  PROFILE(SIDE_TABLES);
+  noteEntry();
+  if (! sizeSummaries.empty()) sizeSummaries.back().gotoEdges++;
   env->CallVoidMethod(entity, codeSetLabelledGotoTarget, from, to, label);
 }
 
+void CAstWrapper::setGotoTargets(jobject entity, int count, jobject from[], jobject to[], jobject labels[]) {
+  PROFILE(SIDE_TABLES);
+  noteEntry();
+  if (! sizeSummaries.empty()) sizeSummaries.back().gotoEdges += count;
+  jobjectArray jfrom = makeArray(CAstNode, count, from);
+  jobjectArray jto = makeArray(CAstNode, count, to);
+  jobjectArray jlabels = makeArray(JavaObject, count, labels);
+  env->CallVoidMethod(entity, codeSetGotoTargets, jfrom, jto, jlabels);
+  THROW_ANY_EXCEPTION(java_ex);
+  env->DeleteLocalRef(jfrom);
+  env->DeleteLocalRef(jto);
+  env->DeleteLocalRef(jlabels);
+}
+
 void CAstWrapper::setLocation(jobject entity, jobject loc) {
+  PROFILE(SIDE_TABLES);
   env->CallVoidMethod(entity, setPosition, loc);
 }
 
 void CAstWrapper::setAstNodeLocation(jobject entity, jobject astNode, jobject loc) {
+  PROFILE(SIDE_TABLES);
+  noteEntry();
   env->CallVoidMethod(entity, setNodePosition, astNode, loc);
 }
 
 void CAstWrapper::setAstNodeType(jobject entity, jobject astNode, jobject loc) {
+  PROFILE(SIDE_TABLES);
+  noteEntry();
   env->CallVoidMethod(entity, setNodeType, astNode, loc);
 }
 
+int CAstWrapper::internType(const char *key, jobject type) {
+  PROFILE(SIDE_TABLES);
+  TypeIds::iterator known = typeIds.find(key);
+  if (known != typeIds.end()) {
+    return known->second;
+  }
+
+  jstring jkey = makeString(key);
+  THROW_ANY_EXCEPTION(java_ex);
+  jint id = env->CallIntMethod(xlator, _internType, jkey, type);
+  THROW_ANY_EXCEPTION(java_ex);
+  env->DeleteLocalRef(jkey);
+
+  // keys without a type yet are not remembered, so they can be interned later
+  if (id >= 0) {
+    typeIds[arena.strndup(key, strlen(key))] = id;
+  }
+  return id;
+}
+
+void CAstWrapper::setAstNodeType(jobject entity, jobject astNode, int typeId) {
+  PROFILE(SIDE_TABLES);
+  noteEntry();
+  if (typedEntity != NULL && !env->IsSameObject(entity, typedEntity)) {
+    flushNodeTypes();
+  }
+  if (typedEntity == NULL) {
+    typedEntity = env->NewLocalRef(entity);
+  }
+
+  typedNodes.push_back(env->NewLocalRef(astNode));
+  typedTypeIds.push_back((jint) typeId);
+  if (typedNodes.size() == NODE_TYPE_BATCH) {
+    flushNodeTypes();
+  }
+}
+
+void CAstWrapper::flushNodeTypes() {
+  PROFILE(SIDE_TABLES);
+  passNodeTypes();
+  THROW_ANY_EXCEPTION(java_ex);
+}
+
+bool CAstWrapper::passNodeTypes() {
+  if (typedEntity == NULL) {
+    return !env->ExceptionCheck();
+  }
+
+  int count = typedNodes.size();
+  if (!env->ExceptionCheck()) {
+    jobjectArray nodes = env->NewObjectArray(count, CAstNode, NULL);
+    jintArray ids = nodes == NULL ? NULL : env->NewIntArray(count);
+    if (ids != NULL) {
+      for(int i = 0; i < count && !env->ExceptionCheck(); i++) {
+	env->SetObjectArrayElement(nodes, i, typedNodes[i]);
+      }
+      if (!env->ExceptionCheck()) {
+	env->SetIntArrayRegion(ids, 0, count, typedTypeIds.data());
+	env->CallVoidMethod(xlator, _setNodeTypes, typedEntity, nodes, ids, (jint) count);
+      }
+    }
+    if (nodes != NULL) env->DeleteLocalRef(nodes);
+    if (ids != NULL) env->DeleteLocalRef(ids);
+  }
+
+  for(CAstArenaVector<jobject>::iterator n = typedNodes.begin(); n != typedNodes.end(); n++) {
+    env->DeleteLocalRef(*n);
+  }
+  env->DeleteLocalRef(typedEntity);
+  typedNodes.clear();
+  typedTypeIds.clear();
+  typedEntity = NULL;
+  return !env->ExceptionCheck();
+}
+
 jobject CAstWrapper::makeLocation(int fl, int fc, int ll, int lc) {
+  PROFILE(MAKE_LOCATION);
+  if (! fingerprints.empty()) fingerprints.back().position(fl, fc, ll, lc);
   return env->CallObjectMethod(xlator, _makeLocation, fl, fc, ll, lc);
 }
 
+bool CAstWrapper::isCanceled() {
+  jboolean result = env->CallBooleanMethod(xlator, _isCanceled);
+  THROW_ANY_EXCEPTION(java_ex);
+  return (bool) result;
+}
+
+void CAstWrapper::worked(int units) {
+  env->CallVoidMethod(xlator, _worked, (jint) units);
+  THROW_ANY_EXCEPTION(java_ex);
+}
+
+void CAstWrapper::forgetQualifierSets() {
+  for(int i = 0; i < QUALIFIER_SETS; i++) {
+    QualifierSet &q = qualifierSets[i];
+    if (q.set != NULL) {
+      for(int j = 0; j < q.count; j++) {
+	env->DeleteGlobalRef(q.elts[j]);
+      }
+      env->DeleteGlobalRef(q.set);
+    }
+  }
+  memset(qualifierSets, 0, sizeof(qualifierSets));
+  nextQualifierSet = 0;
+}
+
+jobject CAstWrapper::qualifierSet(int count, jobject *elts) {
+  PROFILE(MAKE_COLLECTION);
+  for(int i = 0; i < QUALIFIER_SETS; i++) {
+    QualifierSet &q = qualifierSets[i];
+    if (q.set == NULL || q.count != count) continue;
+
+    bool same = true;
+    for(int j = 0; same && j < count; j++) {
+      same = env->IsSameObject(q.elts[j], elts[j]);
+    }
+    if (same) return q.set;
+  }
+
+  jobject set = env->NewObject(HashSet, hashSetInit);
+  THROW_ANY_EXCEPTION(java_ex);
+  for(int j = 0; j < count; j++) {
+    env->CallBooleanMethod(set, hashSetAdd, elts[j]);
+    THROW_ANY_EXCEPTION(java_ex);
+  }
+
+  QualifierSet &q = qualifierSets[nextQualifierSet];
+  nextQualifierSet = (nextQualifierSet + 1) % QUALIFIER_SETS;
+  if (q.set != NULL) {
+    for(int j = 0; j < q.count; j++) {
+      env->DeleteGlobalRef(q.elts[j]);
+    }
+    env->DeleteGlobalRef(q.set);
+  }
+  if (q.set == NULL || q.count < count) {
+    q.elts = (jobject *)arena.allocate(sizeof(jobject) * (count + 1), sizeof(jobject));
+  }
+  for(int j = 0; j < count; j++) {
+    q.elts[j] = env->NewGlobalRef(elts[j]);
+  }
+  q.count = count;
+  q.set = env->NewGlobalRef(set);
+  env->DeleteLocalRef(set);
+
+  return q.set;
+}
+
+jobject CAstWrapper::qualifierSet(list<jobject> *elts) {
+  PROFILE(MAKE_COLLECTION);
+  jobject buf[16];
+  if (elts == NULL) {
+    return qualifierSet(0, buf);
+  } else if (elts->size() > 16) {
+    return makeSet(elts);
+  }
+
+  int count = 0;
+  for(list<jobject>::iterator it=elts->begin(); it!=elts->end(); it++) {
+    buf[count++] = *it;
+  }
+  return qualifierSet(count, buf);
+}
+
+jobject CAstWrapper::qualifierSet(const CAstArenaVector<jobject> &elts) {
+  PROFILE(MAKE_COLLECTION);
+  return qualifierSet(elts.size(), const_cast<jobject *>(elts.data()));
+}
+
 jobject CAstWrapper::makeFieldEntity(jobject declaringClass, jobject name, bool isStatic, list<jobject> *modifiers) {
+  PROFILE(ENTITIES);
+
+  jobject entity = env->NewObject(NativeFieldEntity, fieldEntityInit, getConstantValue(name), qualifierSet(modifiers), isStatic, declaringClass);
+
+  THROW_ANY_EXCEPTION(java_ex);
+  return entity;
+}
+
+jobject CAstWrapper::makeFieldEntity(jobject declaringClass, jobject name, bool isStatic, const CAstArenaVector<jobject> &modifiers) {
+  PROFILE(ENTITIES);
 
-  jobject entity = env->NewObject(NativeFieldEntity, fieldEntityInit, getConstantValue(name), makeSet(modifiers), isStatic, declaringClass);
+  jobject entity = env->NewObject(NativeFieldEntity, fieldEntityInit, getConstantValue(name), qualifierSet(modifiers), isStatic, declaringClass);
 
   THROW_ANY_EXCEPTION(java_ex);
   return entity;
 }
 
 jobject CAstWrapper::makeClassEntity(jobject classType) {
+  PROFILE(ENTITIES);
 
   jobject entity = env->NewObject(NativeClassEntity, classEntityInit, classType);
 
@@ -703,12 +1859,22 @@ jobject CAstWrapper::makeClassEntity(jobject classType) {
 }
 
 jobject CAstWrapper::makeGlobalEntity(char *name, jobject type, list<jobject> *modifiers) {
-  char *safeData = strdup(name);
-  jobject val = env->NewStringUTF( safeData );
+  PROFILE(ENTITIES);
+  jobject val = makeString( name );
   THROW_ANY_EXCEPTION(java_ex);
-  delete safeData;
 
-  jobject entity = env->NewObject(NativeGlobalEntity, globalEntityInit, val, type, makeSet(modifiers));
+  jobject entity = env->NewObject(NativeGlobalEntity, globalEntityInit, val, type, qualifierSet(modifiers));
+  THROW_ANY_EXCEPTION(java_ex);
+
+  return entity;
+}
+
+jobject CAstWrapper::makeGlobalEntity(char *name, jobject type, const CAstArenaVector<jobject> &modifiers) {
+  PROFILE(ENTITIES);
+  jobject val = makeString( name );
+  THROW_ANY_EXCEPTION(java_ex);
+
+  jobject entity = env->NewObject(NativeGlobalEntity, globalEntityInit, val, type, qualifierSet(modifiers));
   THROW_ANY_EXCEPTION(java_ex);
 
   return entity;
@@ -724,6 +1890,22 @@ jobject CAstWrapper::getEntityAst(jobject entity) {
 void CAstWrapper::setEntityAst(jobject entity, jobject ast) {
   env->SetObjectField(entity, astField, ast);
   THROW_ANY_EXCEPTION(java_ex);
+
+  // side tables may mention nodes that folding left out of this AST: that
+  // needs a fold since its first node was built, and an entry made since
+  // the first node of something left out was built
+  if (dropClock >= 0 && lastEntry >= dropFirst && dropClock >= firstStamp(ast)) {
+    env->CallVoidMethod(entity, codeAstFolded);
+    THROW_ANY_EXCEPTION(java_ex);
+  }
+}
+
+void CAstWrapper::deferEntityBody(jobject entity, CAstDeferredBody *body) {
+  env->CallVoidMethod(xlator, _deferBody, entity, (jlong)body);
+  if (env->ExceptionCheck()) {
+    body->release(env);
+    THROW_ANY_EXCEPTION(java_ex);
+  }
 }
 
 jobject CAstWrapper::getEntityType(jobject entity) {
@@ -732,6 +1914,26 @@ jobject CAstWrapper::getEntityType(jobject entity) {
   return result;
 }
  
+void CAstWrapper::beginStreamedEntity(int capacity) {
+  if (env->PushLocalFrame(capacity) != JNI_OK) {
+    THROW_ANY_EXCEPTION(java_ex);
+    THROW(java_ex, "cannot push local reference frame");
+  }
+}
+
+jobject CAstWrapper::endStreamedEntity(jobject entity) {
+  PROFILE(ENTITIES);
+  flushNodeTypes();
+  flushScopedEntities();
+  jboolean streamed = env->CallBooleanMethod(xlator, _entityCompleted, entity);
+  THROW_ANY_EXCEPTION(java_ex);
+
+  // no node of the entity can be an operand of a later one
+  forgetConstants();
+
+  return env->PopLocalFrame(streamed ? NULL : entity);
+}
+
 void CAstWrapper::die(const char *message) {
   THROW(java_ex, message);
 }
@@ -1,15 +1,17 @@
 #include <jni.h>
 #include <setjmp.h>
+#include <stdio.h>
 #include <string.h>
 #include "Exceptions.h"
 
-#ifdef _MSC_VER
-#include <malloc.h>
-#endif
+/* longer messages are truncated rather than allocated for, since
+   this is the path taken when things have already gone wrong */
+#define MESSAGE_SIZE 4096
 
 Exceptions::Exceptions(JNIEnv *java_env, jmp_buf& c_env) : 
   _java_env(java_env), 
-  _c_env(c_env) 
+  _c_env(c_env),
+  _guards(NULL)
 {
   _jre = java_env->FindClass("java/lang/RuntimeException");
   _ctr = java_env->GetMethodID(_jre, "<init>", "(Ljava/lang/String;)V");
@@ -19,6 +21,31 @@ Exceptions::Exceptions(JNIEnv *java_env, jmp_buf& c_env) :
 			  "(Ljava/lang/String;Ljava/lang/Throwable;)V");
 }
 
+Exceptions::Guard::Guard(Exceptions &owner) : owner(&owner), next(owner._guards) {
+  owner._guards = this;
+}
+
+Exceptions::Guard::~Guard() {
+  if (owner != NULL) {
+    for(Guard **g = &owner->_guards; *g != NULL; g = &(*g)->next) {
+      if (*g == this) {
+	*g = next;
+	break;
+      }
+    }
+  }
+}
+
+void Exceptions::unwindGuards() {
+  // each guard is unlinked before it runs, so that none runs twice
+  while (_guards != NULL) {
+    Guard *g = _guards;
+    _guards = g->next;
+    g->owner = NULL;
+    g->unwind();
+  }
+}
+
 void Exceptions::throwAnyException(const char *file_name, int line_number) {
   if (_java_env->ExceptionCheck()) throwException(file_name, line_number);
 }
@@ -27,9 +54,8 @@ void Exceptions::throwException(const char *file_name, int line_number) {
   jthrowable real_ex = _java_env->ExceptionOccurred();
   _java_env->ExceptionClear();
 
-  char msg[strlen(file_name) + 1024];
-  memset(msg, 0, strlen(file_name) + 1024);
-  sprintf(msg, "exception at %s:%d", file_name, line_number);
+  char msg[MESSAGE_SIZE];
+  snprintf(msg, MESSAGE_SIZE, "exception at %s:%d", file_name, line_number);
   jstring java_message = _java_env->NewStringUTF(msg);
 
   jthrowable ex = (jthrowable)
@@ -42,18 +68,19 @@ void Exceptions::throwException(const char *file_name, int line_number) {
     _java_env->Throw(ex);
   }
 
+  unwindGuards();
   longjmp( _c_env, -1 );
 }
 
 void 
 Exceptions::throwException(const char *file_name, int line_number, const char *c_message) {
-  char msg[strlen(file_name) + strlen(c_message) + 1024]; 
-  memset(msg, 0, strlen(file_name) + strlen(c_message) + 1024);
-  sprintf(msg, "exception at %s:%d: %s", file_name, line_number, c_message);
+  char msg[MESSAGE_SIZE];
+  snprintf(msg, MESSAGE_SIZE, "exception at %s:%d: %s", file_name, line_number, c_message);
   jstring java_message = _java_env->NewStringUTF(msg);
   jthrowable ex = (jthrowable)_java_env->NewObject(_jre, _ctr, java_message);
   _java_env->Throw(ex);
   
+  unwindGuards();
   longjmp( _c_env, -1 );
 }
 
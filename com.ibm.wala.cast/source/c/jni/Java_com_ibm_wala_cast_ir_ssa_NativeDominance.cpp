@@ -0,0 +1,83 @@
+#include <vector>
+#include <jni.h>
+
+#include "CAstDominance.h"
+#include "CAstJavaArrays.h"
+#include "com_ibm_wala_cast_ir_ssa_NativeDominance.h"
+
+static jobjectArray toJava(JNIEnv *env, const std::vector<jint> **rows, int count) {
+  jclass intArray = env->FindClass("[I");
+  if (intArray == NULL) {
+    return NULL;
+  }
+
+  jobjectArray result = env->NewObjectArray(count, intArray, NULL);
+  for(int i = 0; result != NULL && i < count; i++) {
+    jintArray row = toJavaArray(env, rows[i]->data(), rows[i]->size());
+    if (row == NULL) {
+      return NULL;
+    }
+    env->SetObjectArrayElement(result, i, row);
+    env->DeleteLocalRef(row);
+  }
+  return result;
+}
+
+JNIEXPORT jboolean JNICALL Java_com_ibm_wala_cast_ir_ssa_NativeDominance_linked
+  (JNIEnv *env, jclass cls)
+{
+  return JNI_TRUE;
+}
+
+JNIEXPORT jobjectArray JNICALL Java_com_ibm_wala_cast_ir_ssa_NativeDominance_dominance
+  (JNIEnv *env,
+   jclass cls,
+   jint blockCount,
+   jint entry,
+   jintArray succStart,
+   jintArray succs)
+{
+  std::vector<jint> ss, s;
+  if (! copyJavaArray(env, succStart, ss, blockCount + 1, &JNIEnv::GetIntArrayRegion) ||
+      ! copyJavaArray(env, succs, s, ss.back(), &JNIEnv::GetIntArrayRegion))
+  {
+    return NULL;
+  }
+
+  CAstDominance dominance(blockCount, entry, ss.data(), s.data());
+
+  const std::vector<jint> *rows[] = {
+    &dominance.getIdoms(),
+    &dominance.getTreeStart(),
+    &dominance.getTree(),
+    &dominance.getFrontierStart(),
+    &dominance.getFrontier()
+  };
+  return toJava(env, rows, 5);
+}
+
+JNIEXPORT jobjectArray JNICALL Java_com_ibm_wala_cast_ir_ssa_NativeDominance_placePhis
+  (JNIEnv *env,
+   jclass cls,
+   jint blockCount,
+   jintArray frontierStart,
+   jintArray frontier,
+   jint valueCount,
+   jintArray defStart,
+   jintArray defs)
+{
+  std::vector<jint> fs, f, ds, d;
+  if (! copyJavaArray(env, frontierStart, fs, blockCount + 1, &JNIEnv::GetIntArrayRegion) ||
+      ! copyJavaArray(env, frontier, f, fs.back(), &JNIEnv::GetIntArrayRegion) ||
+      ! copyJavaArray(env, defStart, ds, valueCount + 1, &JNIEnv::GetIntArrayRegion) ||
+      ! copyJavaArray(env, defs, d, ds.back(), &JNIEnv::GetIntArrayRegion))
+  {
+    return NULL;
+  }
+
+  std::vector<jint> phiStart, phis;
+  CAstDominance::placePhis(blockCount, fs.data(), f.data(), valueCount, ds.data(), d.data(), phiStart, phis);
+
+  const std::vector<jint> *rows[] = { &phiStart, &phis };
+  return toJava(env, rows, 2);
+}
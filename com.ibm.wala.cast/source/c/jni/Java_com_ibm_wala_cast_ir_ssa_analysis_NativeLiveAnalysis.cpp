@@ -0,0 +1,54 @@
+#include <vector>
+#include <jni.h>
+
+#include "CAstLiveness.h"
+#include "CAstJavaArrays.h"
+#include "com_ibm_wala_cast_ir_ssa_analysis_NativeLiveAnalysis.h"
+
+static jintArray toJava(JNIEnv *env, const std::vector<CAstLiveness::word> &v) {
+  return toJavaArray(env, (const jint *)v.data(), v.size());
+}
+
+JNIEXPORT jboolean JNICALL Java_com_ibm_wala_cast_ir_ssa_analysis_NativeLiveAnalysis_linked
+  (JNIEnv *env, jclass cls)
+{
+  return JNI_TRUE;
+}
+
+JNIEXPORT jobjectArray JNICALL Java_com_ibm_wala_cast_ir_ssa_analysis_NativeLiveAnalysis_solve
+  (JNIEnv *env,
+   jclass cls,
+   jint blockCount,
+   jint exit,
+   jint words,
+   jintArray succStart,
+   jintArray succs,
+   jintArray opStart,
+   jintArray ops)
+{
+  std::vector<jint> ss, s, os, o;
+  if (! copyJavaArray(env, succStart, ss, blockCount + 1, &JNIEnv::GetIntArrayRegion) ||
+      ! copyJavaArray(env, succs, s, ss.back(), &JNIEnv::GetIntArrayRegion) ||
+      ! copyJavaArray(env, opStart, os, blockCount + 1, &JNIEnv::GetIntArrayRegion) ||
+      ! copyJavaArray(env, ops, o, os.back(), &JNIEnv::GetIntArrayRegion))
+  {
+    return NULL;
+  }
+
+  CAstLiveness liveness(blockCount, exit, words, os.data(), o.data());
+  liveness.solve(ss.data(), s.data());
+
+  jclass intArray = env->FindClass("[I");
+  if (intArray == NULL) {
+    return NULL;
+  }
+  jobjectArray result = env->NewObjectArray(2, intArray, NULL);
+  jintArray in = result == NULL? NULL: toJava(env, liveness.getLiveIn());
+  jintArray out = in == NULL? NULL: toJava(env, liveness.getLiveOut());
+  if (out == NULL) {
+    return NULL;
+  }
+  env->SetObjectArrayElement(result, 0, in);
+  env->SetObjectArrayElement(result, 1, out);
+  return result;
+}
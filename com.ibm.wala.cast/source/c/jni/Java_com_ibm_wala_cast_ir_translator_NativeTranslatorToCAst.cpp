@@ -0,0 +1,181 @@
+#include <future>
+#include <system_error>
+#include <thread>
+#include <jni.h>
+
+#include "Exceptions.h"
+#include "CAstSourceBuffer.h"
+#include "CAstWrapper.h"
+#include "com_ibm_wala_cast_ir_translator_NativeTranslatorToCAst.h"
+
+/**
+ *  Everything the native worker thread started by translateToCAstAsync
+ * needs.  The method ids are looked up on the calling Java thread,
+ * since class lookup on a freshly attached thread only sees the system
+ * class loader; the references are global references owned by the
+ * worker once it has reported through `attached' that it could attach
+ * itself to the VM, and by the calling thread until then.
+ */
+struct AsyncTranslation {
+  JavaVM *vm;
+  jobject xlator;
+  jobject future;
+  jmethodID translateToCAst;
+  jmethodID endTranslation;
+  jmethodID isCancelled;
+  jmethodID complete;
+  jmethodID completeExceptionally;
+  std::promise<bool> *attached;
+};
+
+static void translate(AsyncTranslation job) {
+  JNIEnv *env;
+  JavaVMAttachArgs args;
+  args.version = JNI_VERSION_1_8;
+  args.name = (char *)"WALA native translator";
+  args.group = NULL;
+  if (job.vm->AttachCurrentThreadAsDaemon((void **)&env, &args) != JNI_OK) {
+    job.attached->set_value(false);
+    return;
+  }
+
+  // the starting thread may return, and take the promise with it, now
+  job.attached->set_value(true);
+
+  // a translation cancelled before it started is not run at all
+  jobject entity = NULL;
+  if (! env->CallBooleanMethod(job.future, job.isCancelled)) {
+    entity = env->CallObjectMethod(job.xlator, job.translateToCAst);
+  }
+
+  jthrowable ex = env->ExceptionOccurred();
+  env->ExceptionClear();
+
+  env->CallVoidMethod(job.xlator, job.endTranslation);
+  if (ex == NULL) {
+    ex = env->ExceptionOccurred();
+  }
+  env->ExceptionClear();
+
+  if (ex != NULL) {
+    env->CallBooleanMethod(job.future, job.completeExceptionally, ex);
+  } else {
+    env->CallBooleanMethod(job.future, job.complete, entity);
+  }
+
+  if (env->ExceptionCheck()) {
+    env->ExceptionDescribe();
+    env->ExceptionClear();
+  }
+
+  env->DeleteGlobalRef(job.xlator);
+  env->DeleteGlobalRef(job.future);
+  job.vm->DetachCurrentThread();
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_ir_translator_NativeTranslatorToCAst_startTranslation
+  (JNIEnv *env, jobject self, jobject future)
+{
+  TRY(exp, env)
+
+  AsyncTranslation job;
+  if (env->GetJavaVM(&job.vm) != JNI_OK) {
+    THROW(exp, "cannot find the Java VM");
+  }
+
+  jclass xlatorCls = env->FindClass("com/ibm/wala/cast/ir/translator/NativeTranslatorToCAst");
+  THROW_ANY_EXCEPTION(exp);
+  job.translateToCAst = env->GetMethodID(xlatorCls, "translateToCAst", "()Lcom/ibm/wala/cast/tree/CAstEntity;");
+  THROW_ANY_EXCEPTION(exp);
+  job.endTranslation = env->GetMethodID(xlatorCls, "endTranslation", "()V");
+  THROW_ANY_EXCEPTION(exp);
+
+  jclass futureCls = env->FindClass("java/util/concurrent/CompletableFuture");
+  THROW_ANY_EXCEPTION(exp);
+  job.isCancelled = env->GetMethodID(futureCls, "isCancelled", "()Z");
+  THROW_ANY_EXCEPTION(exp);
+  job.complete = env->GetMethodID(futureCls, "complete", "(Ljava/lang/Object;)Z");
+  THROW_ANY_EXCEPTION(exp);
+  job.completeExceptionally = env->GetMethodID(futureCls, "completeExceptionally", "(Ljava/lang/Throwable;)Z");
+  THROW_ANY_EXCEPTION(exp);
+
+  job.xlator = env->NewGlobalRef(self);
+  job.future = env->NewGlobalRef(future);
+  THROW_ANY_EXCEPTION(exp);
+
+  // wait for the worker to attach, since a worker that cannot attach
+  // has no way to complete the future itself
+  std::promise<bool> attached;
+  job.attached = &attached;
+  bool started;
+  try {
+    std::thread(translate, job).detach();
+    started = attached.get_future().get();
+  } catch (const std::system_error &) {
+    started = false;
+  }
+
+  if (! started) {
+    env->DeleteGlobalRef(job.xlator);
+    env->DeleteGlobalRef(job.future);
+    THROW(exp, "cannot start native translator thread");
+  }
+
+  CATCH()
+}
+
+JNIEXPORT jobjectArray JNICALL Java_com_ibm_wala_cast_ir_translator_NativeTranslatorToCAst_loadSource
+  (JNIEnv *env, jclass cls, jstring fileName)
+{
+  const char *path = env->GetStringUTFChars(fileName, NULL);
+  if (path == NULL) {
+    return NULL;
+  }
+
+  CAstSourceBuffer *buffer = CAstSourceBuffer::acquire(env, path);
+  env->ReleaseStringUTFChars(fileName, path);
+  if (buffer == NULL) {
+    if (! env->ExceptionCheck()) {
+      jclass ioex = env->FindClass("java/io/IOException");
+      if (ioex != NULL) {
+        env->ThrowNew(ioex, "cannot read source file");
+      }
+    }
+    return NULL;
+  }
+
+  // the Java buffers keep the contents alive once given out
+  jobjectArray result = NULL;
+  jclass bufferCls = env->FindClass("java/nio/ByteBuffer");
+  if (bufferCls != NULL) {
+    result = env->NewObjectArray(2, bufferCls, NULL);
+    if (result != NULL) {
+      env->SetObjectArrayElement(result, 0, buffer->contents(env));
+      env->SetObjectArrayElement(result, 1, buffer->lineStarts(env));
+    }
+  }
+
+  buffer->release(env);
+  return result;
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_ir_translator_NativeTranslatorToCAst_buildBody
+  (JNIEnv *env, jobject self, jobject entity, jlong handle)
+{
+  CAstDeferredBody *body = (CAstDeferredBody *)handle;
+
+  TRY(exp, env)
+
+  CAstWrapper cast(env, exp, self);
+  body->build(cast, entity);
+
+  CATCH()
+
+  body->release(env);
+}
+
+JNIEXPORT void JNICALL Java_com_ibm_wala_cast_ir_translator_NativeTranslatorToCAst_releaseBody
+  (JNIEnv *env, jclass cls, jlong handle)
+{
+  ((CAstDeferredBody *)handle)->release(env);
+}
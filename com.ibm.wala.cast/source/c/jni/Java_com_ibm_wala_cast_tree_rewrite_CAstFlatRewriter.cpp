@@ -0,0 +1,82 @@
+#include <vector>
+#include <jni.h>
+
+#include "CAstFlatTree.h"
+#include "CAstJavaArrays.h"
+#include "CAstRewriteEngine.h"
+#include "com_ibm_wala_cast_tree_rewrite_CAstFlatRewriter.h"
+
+/**
+ *  Calls CAstFlatRewriter.rebuild, reusing one Java array for the
+ * children of each arity.
+ */
+class JavaRebuild : public CAstRewriteEngine::Callback {
+private:
+  JNIEnv *env;
+  jobject rewriter;
+  jmethodID rebuildMethod;
+  std::vector<jintArray> arrays;
+
+public:
+  JavaRebuild(JNIEnv *env, jobject rewriter, jmethodID rebuildMethod)
+    : env(env), rewriter(rewriter), rebuildMethod(rebuildMethod)
+  {
+
+  }
+
+  ~JavaRebuild() {
+    for(size_t i = 0; i < arrays.size(); i++) {
+      if (arrays[i] != NULL) env->DeleteLocalRef(arrays[i]);
+    }
+  }
+
+  int rebuild(int node, const jint *children, int childCount) {
+    if ((int)arrays.size() <= childCount) {
+      arrays.resize(childCount + 1, NULL);
+    }
+    if (arrays[childCount] == NULL) {
+      arrays[childCount] = env->NewIntArray(childCount);
+      if (arrays[childCount] == NULL) return -1;
+    }
+    if (childCount > 0) {
+      env->SetIntArrayRegion(arrays[childCount], 0, childCount, children);
+    }
+    jint r = env->CallIntMethod(rewriter, rebuildMethod, (jint)node, arrays[childCount]);
+    return env->ExceptionCheck()? -1: r;
+  }
+};
+
+JNIEXPORT jint JNICALL Java_com_ibm_wala_cast_tree_rewrite_CAstFlatRewriter_rewrite
+  (JNIEnv *env,
+   jobject self,
+   jbyteArray registered,
+   jobject flatTree,
+   jint root)
+{
+  // rebuild is private, so it is looked up in its own class rather
+  // than that of the rewriter
+  jclass rewriterClass = env->FindClass("com/ibm/wala/cast/tree/rewrite/CAstFlatRewriter");
+  if (rewriterClass == NULL) {
+    return -1;
+  }
+  jmethodID rebuild = env->GetMethodID(rewriterClass, "rebuild", "(I[I)I");
+  env->DeleteLocalRef(rewriterClass);
+  if (rebuild == NULL) {
+    return -1;
+  }
+
+  // the tree is read where it is, as it was when attached; the
+  // callback adds nodes past it, which the engine never needs to see
+  CAstFlatTree tree;
+  std::vector<jbyte> r;
+  if (! tree.attach(env, flatTree) ||
+      ! copyJavaArray(env, registered, r, &JNIEnv::GetByteArrayRegion))
+  {
+    return -1;
+  }
+
+  CAstRewriteEngine engine(r.data(), (int)r.size(),
+			   tree.getKinds(), tree.getChildStart(), tree.getChildren(), tree.getNodeCount());
+  JavaRebuild callback(env, self, rebuild);
+  return engine.rewrite(root, callback);
+}
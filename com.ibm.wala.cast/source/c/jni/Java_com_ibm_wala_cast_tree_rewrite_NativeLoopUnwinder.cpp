@@ -0,0 +1,33 @@
+#include <vector>
+#include <jni.h>
+
+#include "CAstFlatTree.h"
+#include "CAstJavaArrays.h"
+#include "CAstLoopUnwinder.h"
+#include "com_ibm_wala_cast_tree_rewrite_NativeLoopUnwinder.h"
+
+JNIEXPORT jintArray JNICALL Java_com_ibm_wala_cast_tree_rewrite_NativeLoopUnwinder_unwind
+  (JNIEnv *env,
+   jclass cls,
+   jobject flatTree,
+   jbyteArray pinned,
+   jint root,
+   jint loopKind,
+   jint unwindFactor)
+{
+  CAstFlatTree tree;
+  std::vector<jbyte> p;
+  if (! tree.attach(env, flatTree) ||
+      ! copyJavaArray(env, pinned, p, tree.getNodeCount(), &JNIEnv::GetByteArrayRegion))
+  {
+    return NULL;
+  }
+
+  CAstLoopUnwinder unwinder(tree.getKinds(), tree.getChildStart(), tree.getChildren(), p.data(),
+			    tree.getNodeCount(), loopKind, unwindFactor);
+
+  std::vector<jint> plan;
+  unwinder.unwind(root, plan);
+
+  return toJavaArray(env, plan.data(), plan.size());
+}
@@ -0,0 +1,43 @@
+#include <vector>
+#include <jni.h>
+
+#include "CAstFlatTree.h"
+#include "CAstJavaArrays.h"
+#include "CAstPatternMatcher.h"
+#include "com_ibm_wala_cast_util_NativeCAstPattern.h"
+
+JNIEXPORT jboolean JNICALL Java_com_ibm_wala_cast_util_NativeCAstPattern_linked
+  (JNIEnv *env, jclass cls)
+{
+  return JNI_TRUE;
+}
+
+JNIEXPORT jintArray JNICALL Java_com_ibm_wala_cast_util_NativeCAstPattern_findAll
+  (JNIEnv *env,
+   jclass cls,
+   jintArray program,
+   jint start,
+   jbyteArray predicates,
+   jint valueCount,
+   jobject flatTree)
+{
+  // the tree is read where it is; only the pattern, which is small,
+  // is copied out
+  CAstFlatTree tree;
+  std::vector<jint> p;
+  std::vector<jbyte> pred;
+  if (! tree.attach(env, flatTree) ||
+      ! copyJavaArray(env, program, p, &JNIEnv::GetIntArrayRegion) ||
+      ! copyJavaArray(env, predicates, pred, &JNIEnv::GetByteArrayRegion))
+  {
+    return NULL;
+  }
+
+  CAstPatternMatcher matcher(p.data(), pred.data(), valueCount,
+			     tree.getKinds(), tree.getChildStart(), tree.getChildren(), tree.getValueIds());
+
+  std::vector<jint> results;
+  matcher.findAll(start, tree.getRoots(), tree.getRootCount(), results);
+
+  return toJavaArray(env, results.data(), results.size());
+}
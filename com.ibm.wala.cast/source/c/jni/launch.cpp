@@ -1,4 +1,5 @@
 #include <jni.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include "Exceptions.h"
@@ -7,8 +8,11 @@
 
 JavaVM *javaVM;
 
+static const int MAX_EXTRA_OPTIONS = 16;
+
 JNIEnv *launch_jvm(char *classpath) {
-   JavaVMOption jvmopt[2];
+   JavaVMOption jvmopt[2 + MAX_EXTRA_OPTIONS];
+   int nOptions = 2;
 
    const char *jcp = "-Djava.class.path=";
    char buf_jcp[ strlen(jcp) + strlen(classpath) + 1 ];
@@ -20,9 +24,20 @@ JNIEnv *launch_jvm(char *classpath) {
    sprintf(buf_jlp, "%s%s", jlp, classpath);
    jvmopt[1].optionString = buf_jlp;
 
+   // extra options, such as -agentpath for the CAst profiler, separated
+   // by spaces
+   const char *extra = getenv("CAST_JVM_OPTIONS");
+   char buf_extra[ extra == NULL ? 1 : strlen(extra) + 1 ];
+   if (extra != NULL) {
+     strcpy(buf_extra, extra);
+     for(char *opt = strtok(buf_extra, " "); opt != NULL && nOptions < 2 + MAX_EXTRA_OPTIONS; opt = strtok(NULL, " ")) {
+       jvmopt[nOptions++].optionString = opt;
+     }
+   }
+
    JavaVMInitArgs vmArgs;
    vmArgs.version = JNI_VERSION_1_8;
-   vmArgs.nOptions = 2;
+   vmArgs.nOptions = nOptions;
    vmArgs.options = jvmopt;
    vmArgs.ignoreUnrecognized = JNI_TRUE;
 
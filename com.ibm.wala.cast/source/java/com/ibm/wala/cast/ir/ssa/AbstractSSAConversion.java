@@ -93,10 +93,16 @@ public abstract class AbstractSSAConversion {
 
   protected final SSACFG CFG;
 
-  protected final DominanceFrontiers<ISSABasicBlock> DF;
+  /**
+   * null until asked for when dominance is computed natively, see
+   * {@link NativeDominance}
+   */
+  private DominanceFrontiers<ISSABasicBlock> DF;
 
   private final Graph<ISSABasicBlock> dominatorTree;
 
+  private final NativeDominance<ISSABasicBlock> nativeDominance;
+
   protected final int[] phiCounts;
 
   protected final SSAInstruction[] instructions;
@@ -117,8 +123,15 @@ public abstract class AbstractSSAConversion {
 
   protected AbstractSSAConversion(IR ir, SSAOptions options) {
     this.CFG = ir.getControlFlowGraph();
-    this.DF = new DominanceFrontiers<>(ir.getControlFlowGraph(), ir.getControlFlowGraph().entry());
-    this.dominatorTree = DF.dominatorTree();
+    if (CFG.getNumberOfNodes() >= NativeDominance.MIN_NODES && NativeDominance.isAvailable()) {
+      this.nativeDominance = new NativeDominance<>(CFG, CFG.entry());
+      this.DF = null;
+      this.dominatorTree = null;
+    } else {
+      this.nativeDominance = null;
+      this.DF = new DominanceFrontiers<>(ir.getControlFlowGraph(), ir.getControlFlowGraph().entry());
+      this.dominatorTree = DF.dominatorTree();
+    }
     this.flags = new int[2 * ir.getControlFlowGraph().getNumberOfNodes()];
     this.instructions = getInstructions(ir);
     this.phiCounts = new int[CFG.getNumberOfNodes()];
@@ -126,6 +139,17 @@ public abstract class AbstractSSAConversion {
     this.defaultValues = options.getDefaultValues();
   }
 
+  /**
+   * the dominance frontiers of the CFG; when dominance is computed natively,
+   * they are built in Java only if a subclass asks for them
+   */
+  protected DominanceFrontiers<ISSABasicBlock> getDominanceFrontiers() {
+    if (DF == null) {
+      DF = new DominanceFrontiers<>(CFG, CFG.entry());
+    }
+    return DF;
+  }
+
   //
   // top-level control
   //  
@@ -183,6 +207,11 @@ public abstract class AbstractSSAConversion {
   // place phi nodes phase of traditional algorithm
   //
   protected void placePhiNodes() {
+    if (nativeDominance != null) {
+      placePhiNodesNatively();
+      return;
+    }
+
     int IterCount = 0;
 
     for (ISSABasicBlock issaBasicBlock : CFG) {
@@ -230,6 +259,40 @@ public abstract class AbstractSSAConversion {
     }
   }
 
+  /**
+   * the same phis as placePhiNodes, with the iterated frontiers of all values
+   * found in one native call
+   */
+  private void placePhiNodesNatively() {
+    int[] defStart = new int[assignmentMap.length + 1];
+    for (int V = 0; V < assignmentMap.length; V++) {
+      boolean defined = assignmentMap[V] != null && !skip(V);
+      defStart[V + 1] = defStart[V] + (defined ? assignmentMap[V].size() : 0);
+    }
+    int[] defs = new int[defStart[assignmentMap.length]];
+    for (int V = 0; V < assignmentMap.length; V++) {
+      if (defStart[V] < defStart[V + 1]) {
+        int i = defStart[V];
+        for (BasicBlock X : assignmentMap[V]) {
+          defs[i++] = X.getGraphNodeId();
+        }
+      }
+    }
+
+    int[][] phis = nativeDominance.placePhis(defStart, defs);
+    int[] phiStart = phis[0];
+    int[] phiBlocks = phis[1];
+    for (int V = 0; V < assignmentMap.length; V++) {
+      for (int i = phiStart[V]; i < phiStart[V + 1]; i++) {
+        SSACFG.BasicBlock Y = CFG.getNode(phiBlocks[i]);
+        if (isLive(Y, V)) {
+          placeNewPhiAt(V, Y);
+          phiCounts[Y.getGraphNodeId()]++;
+        }
+      }
+    }
+  }
+
   private int getWork(SSACFG.BasicBlock BB) {
     return flags[BB.getGraphNodeId() * 2 + 1];
   }
@@ -287,7 +350,7 @@ public abstract class AbstractSSAConversion {
     ArrayList<Frame> stack = new ArrayList<>();
     
     SearchPreRec(X);
-    push(stack, new Frame(X, dominatorTree.getSuccNodes(X)));
+    push(stack, new Frame(X, dominatorTreeChildren(X)));
     
     // invariant: pre-rec phase was performed for elements in the queue. 
     while (!stack.isEmpty()){
@@ -296,7 +359,7 @@ public abstract class AbstractSSAConversion {
         // iterate next child
         BasicBlock next = (BasicBlock) f.i.next();
         SearchPreRec(next);
-        push(stack, new Frame(next, dominatorTree.getSuccNodes(next)));
+        push(stack, new Frame(next, dominatorTreeChildren(next)));
       } else {
         // finished iterating children, time to "return"
         SearchPostRec(f.X);
@@ -305,6 +368,10 @@ public abstract class AbstractSSAConversion {
     }
   }
 
+  private Iterator<ISSABasicBlock> dominatorTreeChildren(SSACFG.BasicBlock X) {
+    return nativeDominance != null ? nativeDominance.getDominatorTreeChildren(X) : dominatorTree.getSuccNodes(X);
+  }
+
    private static <T> void push(ArrayList<T> stack, T elt) {
     stack.add(elt);
   }
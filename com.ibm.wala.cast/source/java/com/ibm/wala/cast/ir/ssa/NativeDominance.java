@@ -0,0 +1,153 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.ir.ssa;
+
+import java.util.Iterator;
+import java.util.NoSuchElementException;
+
+import com.ibm.wala.cast.util.NativeLinkage;
+import com.ibm.wala.util.graph.NumberedGraph;
+import com.ibm.wala.util.graph.dominators.DominanceFrontiers;
+import com.ibm.wala.util.intset.IntIterator;
+import com.ibm.wala.util.intset.IntSet;
+
+/**
+ * dominators and dominance frontiers of a numbered graph, computed natively
+ * by the CAst library (see CAstDominance.h) from the graph laid out as int
+ * arrays.  The answers are those of {@link DominanceFrontiers},
+ * with the children of each node in the dominator tree in the order of their
+ * numbers, as the Java dominator tree has them for graphs that iterate in
+ * that order; and {@link #placePhis} gives the iterated frontiers that
+ * {@link AbstractSSAConversion} places phis in.
+ *
+ * The native library must have been loaded by whoever uses this, usually a
+ * native front end; {@link #isAvailable()} says whether it has been.
+ */
+public class NativeDominance<T> {
+
+  /**
+   * the smallest graph that {@link AbstractSSAConversion} computes dominance
+   * for natively; smaller ones are not worth crossing into native code for
+   */
+  public static final int MIN_NODES = 256;
+
+  private static final NativeLinkage linkage = new NativeLinkage(NativeDominance::linked);
+
+  private final NumberedGraph<T> G;
+
+  private final int nodeCount;
+
+  private final int[] idoms;
+
+  private final int[] treeStart;
+
+  private final int[] tree;
+
+  private final int[] frontierStart;
+
+  private final int[] frontier;
+
+  public NativeDominance(NumberedGraph<T> G, T root) {
+    this.G = G;
+    this.nodeCount = G.getMaxNumber() + 1;
+
+    int[] succStart = new int[nodeCount + 1];
+    for (int n = 0; n < nodeCount; n++) {
+      T node = G.getNode(n);
+      succStart[n + 1] = succStart[n] + (node == null ? 0 : G.getSuccNodeCount(node));
+    }
+    int[] succs = new int[succStart[nodeCount]];
+    for (int n = 0; n < nodeCount; n++) {
+      T node = G.getNode(n);
+      if (node != null) {
+        IntSet ss = G.getSuccNodeNumbers(node);
+        int i = succStart[n];
+        for (IntIterator s = ss.intIterator(); s.hasNext();) {
+          succs[i++] = s.next();
+        }
+      }
+    }
+
+    int[][] result = dominance(nodeCount, G.getNumber(root), succStart, succs);
+    this.idoms = result[0];
+    this.treeStart = result[1];
+    this.tree = result[2];
+    this.frontierStart = result[3];
+    this.frontier = result[4];
+  }
+
+  private Iterator<T> nodes(final int[] row, final int from, final int to) {
+    return new Iterator<T>() {
+      private int i = from;
+
+      @Override
+      public boolean hasNext() {
+        return i < to;
+      }
+
+      @Override
+      public T next() {
+        if (i >= to) {
+          throw new NoSuchElementException();
+        }
+        return G.getNode(row[i++]);
+      }
+
+      @Override
+      public void remove() {
+        throw new UnsupportedOperationException();
+      }
+    };
+  }
+
+  /**
+   * the immediate dominator of n, or null for the root and unreachable nodes
+   */
+  public T getIdom(T n) {
+    int idom = idoms[G.getNumber(n)];
+    return idom < 0 ? null : G.getNode(idom);
+  }
+
+  public Iterator<T> getDominatorTreeChildren(T n) {
+    int id = G.getNumber(n);
+    return nodes(tree, treeStart[id], treeStart[id + 1]);
+  }
+
+  public Iterator<T> getDominanceFrontier(T n) {
+    int id = G.getNumber(n);
+    return nodes(frontier, frontierStart[id], frontierStart[id + 1]);
+  }
+
+  /**
+   * the iterated dominance frontiers of the nodes that define each value,
+   * which are those numbered defs[defStart[v]] up to defs[defStart[v+1]];
+   * the result is a start array and the frontier node numbers, laid out the
+   * same way
+   */
+  public int[][] placePhis(int[] defStart, int[] defs) {
+    return placePhis(nodeCount, frontierStart, frontier, defStart.length - 1, defStart, defs);
+  }
+
+  /**
+   * whether the native kernel has been linked into this VM, see
+   * {@link NativeLinkage}
+   */
+  public static boolean isAvailable() {
+    return linkage.isAvailable();
+  }
+
+  private static native boolean linked();
+
+  private static native int[][] dominance(int nodeCount, int root, int[] succStart, int[] succs);
+
+  private static native int[][] placePhis(int nodeCount, int[] frontierStart, int[] frontier, int valueCount,
+      int[] defStart, int[] defs);
+}
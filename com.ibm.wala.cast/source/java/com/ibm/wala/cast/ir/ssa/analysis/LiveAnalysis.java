@@ -47,6 +47,7 @@ import com.ibm.wala.util.intset.IntSet;
  *
  * - The solver uses node transfer functions only.
  * - Performance: inverts the CFG to traverse backwards (backward analysis).
+ * - Large CFGs are solved natively by {@link NativeLiveAnalysis} when the CAst library is loaded.
  */
 public class LiveAnalysis {
 
@@ -78,6 +79,10 @@ public class LiveAnalysis {
    * todo: used once in {@link com.ibm.wala.cast.ir.ssa.SSAConversion}; Explain better the purpose.
    */
   public static Result perform(final ControlFlowGraph<SSAInstruction, ISSABasicBlock> cfg, final SymbolTable symtab, final BitVector considerLiveAtExit) {
+    if (cfg.getNumberOfNodes() >= NativeLiveAnalysis.MIN_BLOCKS && NativeLiveAnalysis.isAvailable()) {
+      return NativeLiveAnalysis.perform(cfg, symtab, considerLiveAtExit);
+    }
+
     final BitVectorIntSet liveAtExit = new BitVectorIntSet(considerLiveAtExit);
     final SSAInstruction[] instructions = cfg.getInstructions();
 
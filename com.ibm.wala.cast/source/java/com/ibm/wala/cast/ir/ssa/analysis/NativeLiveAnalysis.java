@@ -0,0 +1,211 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.ir.ssa.analysis;
+
+import java.util.Arrays;
+
+import com.ibm.wala.cast.util.NativeLinkage;
+import com.ibm.wala.cfg.ControlFlowGraph;
+import com.ibm.wala.ssa.ISSABasicBlock;
+import com.ibm.wala.ssa.SSAInstruction;
+import com.ibm.wala.ssa.SSAPhiInstruction;
+import com.ibm.wala.ssa.SymbolTable;
+import com.ibm.wala.util.collections.Iterator2Iterable;
+import com.ibm.wala.util.intset.BitVector;
+
+/**
+ * {@link LiveAnalysis} with the fixed point found natively by the CAst library
+ * (see CAstLiveness.h), over dense bit sets rather than
+ * {@link com.ibm.wala.fixpoint.BitVectorVariable}s.  What each block does to
+ * the values live after it is recorded here, in the order the Java transfer
+ * function does it, as a list of values made live or dead; the native solver
+ * folds that into gen and kill sets, and the {@link LiveAnalysis.Result} reads
+ * the live sets it returns directly.
+ *
+ * The native library must have been loaded by whoever uses this, usually a
+ * native front end; {@link #isAvailable()} says whether it has been.
+ */
+public class NativeLiveAnalysis {
+
+  /**
+   * the smallest CFG that {@link LiveAnalysis} solves natively
+   */
+  public static final int MIN_BLOCKS = 256;
+
+  private static final NativeLinkage linkage = new NativeLinkage(NativeLiveAnalysis::linked);
+
+  private int[] ops = new int[64];
+
+  private int size = 0;
+
+  private int width = 0;
+
+  private void add(int op) {
+    if (size == ops.length) {
+      ops = Arrays.copyOf(ops, 2 * size);
+    }
+    ops[size++] = op;
+    width = Math.max(width, (op < 0 ? ~op : op) + 1);
+  }
+
+  private void gen(int v) {
+    if (v >= 0) {
+      add(v);
+    }
+  }
+
+  private void kill(int v) {
+    if (v >= 0) {
+      add(~v);
+    }
+  }
+
+  public static LiveAnalysis.Result perform(final ControlFlowGraph<SSAInstruction, ISSABasicBlock> cfg, final SymbolTable symtab,
+      BitVector considerLiveAtExit) {
+    final SSAInstruction[] instructions = cfg.getInstructions();
+    int blockCount = cfg.getMaxNumber() + 1;
+    int exit = cfg.exit().getNumber();
+
+    int[] succStart = new int[blockCount + 1];
+    int[] opStart = new int[blockCount + 1];
+    NativeLiveAnalysis ops = new NativeLiveAnalysis();
+    for (int b = 0; b < blockCount; b++) {
+      ISSABasicBlock block = cfg.getNode(b);
+      succStart[b + 1] = succStart[b] + cfg.getSuccNodeCount(block);
+
+      if (b == exit) {
+        for (int v = considerLiveAtExit.nextSetBit(0); v >= 0; v = considerLiveAtExit.nextSetBit(v + 1)) {
+          ops.gen(v);
+        }
+      } else {
+        // the same steps as LiveAnalysis.BlockValueGenKillOperator
+        for (ISSABasicBlock succBB : Iterator2Iterable.make(cfg.getSuccNodes(block))) {
+          int rval = com.ibm.wala.cast.ir.cfg.Util.whichPred(cfg, succBB, block);
+          for (SSAPhiInstruction sphi : Iterator2Iterable.make(succBB.iteratePhis())) {
+            ops.gen(sphi.getUse(rval));
+          }
+        }
+        for (int i = block.getLastInstructionIndex(); i >= block.getFirstInstructionIndex(); i--) {
+          SSAInstruction inst = instructions[i];
+          if (inst != null) {
+            for (int j = 0; j < inst.getNumberOfDefs(); j++) {
+              ops.kill(inst.getDef(j));
+            }
+            for (int j = 0; j < inst.getNumberOfUses(); j++) {
+              assert inst.getUse(j) != -1 : inst.toString();
+              if (!symtab.isConstant(inst.getUse(j))) {
+                ops.gen(inst.getUse(j));
+              }
+            }
+          }
+        }
+        for (SSAInstruction S : Iterator2Iterable.make(block.iteratePhis())) {
+          for (int j = 0; j < S.getNumberOfDefs(); j++) {
+            ops.kill(S.getDef(j));
+          }
+        }
+      }
+      opStart[b + 1] = ops.size;
+    }
+
+    int[] succs = new int[succStart[blockCount]];
+    for (int b = 0; b < blockCount; b++) {
+      int i = succStart[b];
+      for (ISSABasicBlock s : Iterator2Iterable.make(cfg.getSuccNodes(cfg.getNode(b)))) {
+        succs[i++] = s.getNumber();
+      }
+    }
+
+    // rows are whole 256-bit vectors
+    final int words = Math.max(1, (ops.width + 255) >>> 8) << 3;
+    int[][] live = solve(blockCount, exit, words, succStart, succs, opStart, ops.ops);
+    final int[] liveIn = live[0];
+    final int[] liveOut = live[1];
+
+    return new LiveAnalysis.Result() {
+
+      private boolean get(int[] rows, ISSABasicBlock bb, int valueNumber) {
+        if (valueNumber < 0 || valueNumber >= words << 5) {
+          return false;
+        }
+        return (rows[bb.getNumber() * words + (valueNumber >> 5)] & (1 << (valueNumber & 31))) != 0;
+      }
+
+      private BitVector row(int[] rows, ISSABasicBlock bb) {
+        BitVector bits = new BitVector();
+        int base = bb.getNumber() * words;
+        for (int w = 0; w < words; w++) {
+          for (int word = rows[base + w]; word != 0; word &= word - 1) {
+            bits.set((w << 5) + Integer.numberOfTrailingZeros(word));
+          }
+        }
+        return bits;
+      }
+
+      @Override
+      public String toString() {
+        StringBuffer s = new StringBuffer();
+        for (int i = 0; i < cfg.getNumberOfNodes(); i++) {
+          ISSABasicBlock bb = cfg.getNode(i);
+          s.append("live entering ").append(bb).append(":").append(row(liveIn, bb)).append("\n");
+          s.append("live exiting ").append(bb).append(":").append(row(liveOut, bb)).append("\n");
+        }
+
+        return s.toString();
+      }
+
+      @Override
+      public boolean isLiveEntry(ISSABasicBlock bb, int valueNumber) {
+        return get(liveIn, bb, valueNumber);
+      }
+
+      @Override
+      public boolean isLiveExit(ISSABasicBlock bb, int valueNumber) {
+        return get(liveOut, bb, valueNumber);
+      }
+
+      @Override
+      public BitVector getLiveBefore(int instr) {
+        ISSABasicBlock bb = cfg.getBlockForInstruction(instr);
+
+        BitVector bits = row(liveOut, bb);
+        for (int i = bb.getLastInstructionIndex(); i >= instr; i--) {
+          SSAInstruction inst = instructions[i];
+          if (inst != null) {
+            for (int j = 0; j < inst.getNumberOfDefs(); j++) {
+              bits.clear(inst.getDef(j));
+            }
+            for (int j = 0; j < inst.getNumberOfUses(); j++) {
+              if (!symtab.isConstant(inst.getUse(j))) {
+                bits.set(inst.getUse(j));
+              }
+            }
+          }
+        }
+
+        return bits;
+      }
+    };
+  }
+
+  /**
+   * whether the native solver has been linked into this VM, see
+   * {@link NativeLinkage}
+   */
+  public static boolean isAvailable() {
+    return linkage.isAvailable();
+  }
+
+  private static native boolean linked();
+
+  private static native int[][] solve(int blockCount, int exit, int words, int[] succStart, int[] succs, int[] opStart,
+      int[] ops);
+}
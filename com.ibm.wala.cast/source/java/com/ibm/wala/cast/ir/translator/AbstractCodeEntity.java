@@ -14,31 +14,153 @@
  */
 package com.ibm.wala.cast.ir.translator;
 
+import java.util.ArrayDeque;
+import java.util.Collection;
+import java.util.Collections;
+import java.util.Deque;
+import java.util.IdentityHashMap;
+import java.util.Iterator;
+import java.util.Map;
+import java.util.Set;
+
 import com.ibm.wala.cast.tree.CAstControlFlowMap;
+import com.ibm.wala.cast.tree.CAstDeferredBodyEntity;
+import com.ibm.wala.cast.tree.CAstEntity;
 import com.ibm.wala.cast.tree.CAstNode;
 import com.ibm.wala.cast.tree.CAstSourcePositionMap.Position;
 import com.ibm.wala.cast.tree.CAstType;
 import com.ibm.wala.cast.tree.impl.CAstControlFlowRecorder;
+import com.ibm.wala.cast.tree.impl.CAstControlFlowTable;
 import com.ibm.wala.cast.tree.impl.CAstNodeTypeMapRecorder;
 import com.ibm.wala.cast.tree.impl.CAstSourcePositionRecorder;
 
-public abstract class AbstractCodeEntity extends AbstractEntity {
+public abstract class AbstractCodeEntity extends AbstractEntity implements CAstDeferredBodyEntity {
   protected final CAstSourcePositionRecorder src = new CAstSourcePositionRecorder();
 
+  /**
+   * control flow edges as recorded by {@link #setLabelledGotoTarget} and
+   * {@link #setGotoTargets}, frozen into a compact table when first asked for
+   * after a change
+   */
+  protected final CAstControlFlowTable.Builder edges = new CAstControlFlowTable.Builder();
+
+  /**
+   * the control flow map for subclasses that record into it directly, as
+   * they did before {@link #edges}; if they do, it is the map returned, with
+   * the edges of {@link #edges} added to it
+   */
   protected final CAstControlFlowRecorder cfg = new CAstControlFlowRecorder(src);
 
+  private CAstControlFlowTable table;
+
   protected final CAstNodeTypeMapRecorder types = new CAstNodeTypeMapRecorder();
 
   protected final CAstType type;
 
   protected CAstNode Ast;
 
+  /**
+   * builds the body of this entity, if that has been put off until it is
+   * first needed
+   */
+  private Runnable deferredBody;
+
+  /**
+   * what building the deferred body threw, if it failed; thrown again on
+   * every later use rather than leaving the entity without a body
+   */
+  private RuntimeException bodyFailure;
+
+  /**
+   * whether native constant folding has left nodes out of the AST that the
+   * side tables of this entity may still mention
+   */
+  private boolean folded;
+
+  /**
+   * the calls of this entity, if a native front end recorded them
+   */
+  private CallSiteTable callSites;
+
+  /**
+   * the size of this entity, if a native front end summarized it
+   */
+  private EntitySizeSummary sizes;
+
   protected AbstractCodeEntity(CAstType type) {
     this.type = type;
   }
 
+  /**
+   * put off building the AST of this entity, and everything that goes with
+   * it, until something asks for one of them
+   */
+  public synchronized void deferBody(Runnable build) {
+    this.deferredBody = build;
+  }
+
+  @Override
+  public synchronized boolean hasDeferredBody() {
+    return deferredBody != null;
+  }
+
+  protected synchronized void ensureBody() {
+    if (bodyFailure != null) {
+      throw bodyFailure;
+    }
+    Runnable build = deferredBody;
+    if (build != null) {
+      try {
+        build.run();
+      } catch (RuntimeException e) {
+        bodyFailure = e;
+        throw e;
+      }
+      deferredBody = null;
+    }
+    if (folded && Ast != null) {
+      folded = false;
+      retainLiveNodes();
+    }
+  }
+
+  /**
+   * called from native code when the AST is set after constant folding has
+   * dropped nodes; the side tables are pruned to the AST when next used
+   */
+  public synchronized void astFolded() {
+    folded = true;
+  }
+
+  private void retainLiveNodes() {
+    Set<CAstNode> live = Collections.newSetFromMap(new IdentityHashMap<CAstNode, Boolean>());
+    Deque<CAstNode> work = new ArrayDeque<>();
+    work.push(Ast);
+    while (!work.isEmpty()) {
+      CAstNode n = work.pop();
+      if (n != null && live.add(n)) {
+        for (int i = 0; i < n.getChildCount(); i++) {
+          work.push(n.getChild(i));
+        }
+      }
+    }
+
+    edges.retainNodes(live);
+    table = null;
+    src.retainNodes(live);
+    types.retainNodes(live);
+    if (callSites != null) {
+      callSites = callSites.retainCalls(live);
+    }
+    if (sizes != null) {
+      sizes = sizes.recount(Ast, edges.size());
+    }
+    retainScopedEntities(live);
+  }
+
   @Override
   public CAstNode getAST() {
+    ensureBody();
     return Ast;
   }
 
@@ -49,31 +171,87 @@ public abstract class AbstractCodeEntity extends AbstractEntity {
 
   @Override
   public CAstControlFlowMap getControlFlow() {
+    ensureBody();
+    if (table == null) {
+      table = edges.build();
+    }
+    if (cfg.getMappedNodes().isEmpty()) {
+      return table;
+    }
+
+    // a subclass has recorded into cfg itself, so the edges join it there
+    if (edges.size() > 0) {
+      cfg.addAll(table);
+      edges.clear();
+      table = null;
+    }
     return cfg;
   }
 
   @Override
   public CAstSourcePositionRecorder getSourceMap() {
+    ensureBody();
     return src;
   }
 
   @Override
   public CAstNodeTypeMapRecorder getNodeTypeMap() {
+    ensureBody();
     return types;
   }
 
+  @Override
+  public Map<CAstNode, Collection<CAstEntity>> getAllScopedEntities() {
+    ensureBody();
+    return super.getAllScopedEntities();
+  }
+
+  @Override
+  public Iterator<CAstEntity> getScopedEntities(CAstNode construct) {
+    ensureBody();
+    return super.getScopedEntities(construct);
+  }
+
+  /**
+   * the calls recorded by a native front end, or null if there were none;
+   * see {@link CallSiteTable#of} for all entities
+   */
+  public CallSiteTable getCallSites() {
+    ensureBody();
+    return callSites;
+  }
+
+  public void setCallSites(CallSiteTable callSites) {
+    this.callSites = callSites;
+  }
+
+  /**
+   * the size summary from a native front end, or null if there was none
+   */
+  public EntitySizeSummary getSizeSummary() {
+    ensureBody();
+    return sizes;
+  }
+
+  public void setSizeSummary(EntitySizeSummary sizes) {
+    this.sizes = sizes;
+  }
+
   public void setGotoTarget(CAstNode from, CAstNode to) {
     setLabelledGotoTarget(from, to, null);
   }
 
   public void setLabelledGotoTarget(CAstNode from, CAstNode to, Object label) {
-    if (!cfg.isMapped(from)) {
-      cfg.map(from, from);
-    }
-    if (!cfg.isMapped(to)) {
-      cfg.map(to, to);
-    }
-    cfg.add(from, to, label);
+    edges.add(from, to, label);
+    table = null;
+  }
+
+  /**
+   * record a batch of control flow edges at once; called from native code
+   */
+  public void setGotoTargets(CAstNode[] from, CAstNode[] to, Object[] labels) {
+    edges.addAll(from, to, labels);
+    table = null;
   }
 
   public void setNodePosition(CAstNode n, Position pos) {
@@ -17,6 +17,7 @@ package com.ibm.wala.cast.ir.translator;
 import java.util.Collection;
 import java.util.Iterator;
 import java.util.Map;
+import java.util.Set;
 
 import com.ibm.wala.cast.tree.CAstAnnotation;
 import com.ibm.wala.cast.tree.CAstEntity;
@@ -32,6 +33,12 @@ public abstract class AbstractEntity implements CAstEntity {
 
   private final Map<CAstNode, Collection<CAstEntity>> scopedEntities = HashMapFactory.make();
 
+  /**
+   * names of this entity read and written by nested functions, if a native
+   * front end has worked them out (see CAstScopeAnalysis.h); null otherwise
+   */
+  private Set<String> exposedReads, exposedWrites;
+
   @Override
   public Map<CAstNode, Collection<CAstEntity>> getAllScopedEntities() {
     return scopedEntities;
@@ -67,11 +74,64 @@ public abstract class AbstractEntity implements CAstEntity {
     }
   }
 
+  public void setExposedNames(Set<String> reads, Set<String> writes) {
+    this.exposedReads = reads;
+    this.exposedWrites = writes;
+  }
+
+  /**
+   * whether the exposed names of this entity are known already; see
+   * {@link ExposedNamesCollector}
+   */
+  public boolean hasExposedNames() {
+    return exposedReads != null;
+  }
+
+  public Set<String> getExposedReads() {
+    return exposedReads;
+  }
+
+  public Set<String> getExposedWrites() {
+    return exposedWrites;
+  }
+
+  /**
+   * forget the scoped entities of constructs not in live; those of the null
+   * construct are kept
+   */
+  protected void retainScopedEntities(Set<CAstNode> live) {
+    for (Iterator<CAstNode> cs = scopedEntities.keySet().iterator(); cs.hasNext();) {
+      CAstNode construct = cs.next();
+      if (construct != null && !live.contains(construct)) {
+        cs.remove();
+      }
+    }
+  }
+
   public void addScopedEntity(CAstNode construct, CAstEntity child) {
-    if (!scopedEntities.containsKey(construct)) {
-      Collection<CAstEntity> set = HashSetFactory.make(1);
+    Collection<CAstEntity> set = scopedEntities.get(construct);
+    if (set == null) {
+      set = HashSetFactory.make(1);
       scopedEntities.put(construct, set);
     }
-    scopedEntities.get(construct).add(child);
+    set.add(child);
+  }
+
+  /**
+   * add children[from] up to children[to] under the matching constructs,
+   * reusing the set of the previous construct for runs of the same one
+   */
+  public void addScopedEntities(CAstNode[] constructs, CAstEntity[] children, int from, int to) {
+    Collection<CAstEntity> set = null;
+    for (int i = from; i < to; i++) {
+      if (set == null || constructs[i] != constructs[i - 1]) {
+        set = scopedEntities.get(constructs[i]);
+        if (set == null) {
+          set = HashSetFactory.make(1);
+          scopedEntities.put(constructs[i], set);
+        }
+      }
+      set.add(children[i]);
+    }
   }
 }
@@ -819,11 +819,11 @@ public abstract class AstTranslator extends CAstVisitor<AstTranslator.WalkContex
 
     private Unwind unwind = null;
 
-    private final List<PreBasicBlock> blocks = new ArrayList<>();
+    private final List<PreBasicBlock> blocks;
 
     private PreBasicBlock entryBlock;
     
-    private final Map<CAstNode, PreBasicBlock> nodeToBlock = new LinkedHashMap<>();
+    private final Map<CAstNode, PreBasicBlock> nodeToBlock;
 
     private final Map<Object, Set<Pair<PreBasicBlock, Boolean>>> delayedEdges = new LinkedHashMap<>();
 
@@ -835,7 +835,7 @@ public abstract class AstTranslator extends CAstVisitor<AstTranslator.WalkContex
 
     private final Set<PreBasicBlock> exceptionalToExit = new LinkedHashSet<>();
 
-    private Position[] linePositions = new Position[10];
+    private Position[] linePositions;
 
     private boolean hasCatchBlock = false;
 
@@ -848,6 +848,26 @@ public abstract class AstTranslator extends CAstVisitor<AstTranslator.WalkContex
 
     private PreBasicBlock currentBlock;
 
+    public IncipientCFG() {
+      this(null);
+    }
+
+    /**
+     * a CFG with room for what an entity of the given size needs, if that is
+     * known
+     */
+    public IncipientCFG(EntitySizeSummary sizes) {
+      if (sizes == null) {
+        blocks = new ArrayList<>();
+        nodeToBlock = new LinkedHashMap<>();
+        linePositions = new Position[10];
+      } else {
+        blocks = new ArrayList<>(sizes.getBlockEstimate());
+        nodeToBlock = new LinkedHashMap<>(EntitySizeSummary.capacity(sizes.getBlockEstimate()));
+        linePositions = new Position[Math.max(10, sizes.getInstructionEstimate() + 1)];
+      }
+    }
+
     public int getCurrentInstruction() {
       return currentInstruction;
     }
@@ -2521,7 +2541,7 @@ public abstract class AstTranslator extends CAstVisitor<AstTranslator.WalkContex
      * maps nodes in the current function to the value number holding their value
      * or, for constants, to their constant value.
      */
-    private final Map<CAstNode, Integer> results = new LinkedHashMap<>();
+    private final Map<CAstNode, Integer> results;
 
     public CodeEntityContext(WalkContext parent, Scope entityScope, CAstEntity s) {
       super(parent, s);
@@ -2531,7 +2551,9 @@ public abstract class AstTranslator extends CAstVisitor<AstTranslator.WalkContex
       this.allEntityScopes = HashSetFactory.make();
       this.allEntityScopes.add(entityScope);
 
-      cfg = new IncipientCFG();
+      EntitySizeSummary sizes = s instanceof AbstractCodeEntity ? ((AbstractCodeEntity) s).getSizeSummary() : null;
+      cfg = new IncipientCFG(sizes);
+      results = sizes == null ? new LinkedHashMap<>() : new LinkedHashMap<>(EntitySizeSummary.capacity(sizes.getNodeCount()));
     }
 
     @Override
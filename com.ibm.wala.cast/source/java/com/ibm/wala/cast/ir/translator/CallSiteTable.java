@@ -0,0 +1,137 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.ir.translator;
+
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.List;
+import java.util.Set;
+
+import com.ibm.wala.cast.tree.CAstEntity;
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap.Position;
+import com.ibm.wala.cast.tree.impl.CAstNumberedNode;
+
+/**
+ * the CALL nodes of one entity, not counting those of entities nested in it,
+ * with the kind of each callee expression and the number of arguments. Native
+ * front ends record these as they build the calls (see
+ * CAstWrapper::beginCallSites), so that clients such as call graph seeding can
+ * go through the calls of an entity without walking its AST; {@link #of}
+ * walks the AST for entities that have no such table. Either way the calls
+ * are in post-order, those in the arguments of a call before it, which is the
+ * order they are built in.
+ */
+public class CallSiteTable {
+
+  private final CAstEntity entity;
+
+  private final CAstNode[] calls;
+
+  public CallSiteTable(CAstEntity entity, CAstNode[] calls) {
+    this.entity = entity;
+    this.calls = calls;
+  }
+
+  /**
+   * the call sites of entity, as recorded natively if they were, and found
+   * by walking its AST otherwise
+   */
+  public static CallSiteTable of(CAstEntity entity) {
+    if (entity instanceof AbstractCodeEntity) {
+      CallSiteTable recorded = ((AbstractCodeEntity) entity).getCallSites();
+      if (recorded != null) {
+        return recorded;
+      }
+    }
+
+    // visiting each node before its children, last child first, gives the
+    // reverse of post-order
+    List<CAstNode> calls = new ArrayList<>();
+    if (entity.getAST() != null) {
+      List<CAstNode> work = new ArrayList<>();
+      work.add(entity.getAST());
+      while (!work.isEmpty()) {
+        CAstNode n = work.remove(work.size() - 1);
+        if (n.getKind() == CAstNode.CALL) {
+          calls.add(n);
+        }
+        for (int i = 0; i < n.getChildCount(); i++) {
+          if (n.getChild(i) != null) {
+            work.add(n.getChild(i));
+          }
+        }
+      }
+    }
+
+    Collections.reverse(calls);
+    return new CallSiteTable(entity, calls.toArray(new CAstNode[calls.size()]));
+  }
+
+  /**
+   * this table without the calls not in live, e.g. those in code that
+   * constant folding pruned
+   */
+  public CallSiteTable retainCalls(Set<CAstNode> live) {
+    List<CAstNode> kept = new ArrayList<>(calls.length);
+    for (CAstNode call : calls) {
+      if (live.contains(call)) {
+        kept.add(call);
+      }
+    }
+    return kept.size() == calls.length ? this : new CallSiteTable(entity, kept.toArray(new CAstNode[kept.size()]));
+  }
+
+  public int size() {
+    return calls.length;
+  }
+
+  public CAstNode getCall(int i) {
+    return calls[i];
+  }
+
+  /**
+   * the id of the call node (see {@link CAstNumberedNode}), or -1 if it has
+   * none
+   */
+  public int getNodeId(int i) {
+    return calls[i] instanceof CAstNumberedNode ? ((CAstNumberedNode) calls[i]).getNodeId() : -1;
+  }
+
+  /**
+   * the kind of the callee expression, e.g. {@link CAstNode#VAR} or
+   * {@link CAstNode#OBJECT_REF}
+   */
+  public int getCalleeKind(int i) {
+    return calls[i].getChild(0).getKind();
+  }
+
+  public int getArgumentCount(int i) {
+    return calls[i].getChildCount() - 2;
+  }
+
+  /**
+   * the value of the second child of the call, which front ends use for the
+   * call reference
+   */
+  public Object getCallReference(int i) {
+    return calls[i].getChild(1).getValue();
+  }
+
+  /**
+   * where the call is, as the source map of the entity has it when asked
+   */
+  public Position getPosition(int i) {
+    CAstSourcePositionMap map = entity.getSourceMap();
+    return map == null ? null : map.getPosition(calls[i]);
+  }
+}
@@ -0,0 +1,339 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.ir.translator;
+
+import java.io.IOException;
+import java.io.Reader;
+import java.lang.ref.ReferenceQueue;
+import java.lang.ref.WeakReference;
+import java.net.URL;
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.Collections;
+import java.util.Iterator;
+import java.util.Map;
+
+import com.ibm.wala.cast.tree.CAstEntity;
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap.Position;
+import com.ibm.wala.cast.tree.impl.AbstractSourcePosition;
+import com.ibm.wala.cast.tree.impl.DelegatingEntity;
+import com.ibm.wala.cast.util.SharedSourceBuffer.SharedPosition;
+import com.ibm.wala.util.collections.HashMapFactory;
+
+/**
+ * Entities shared between identical copies of the same code, e.g. one
+ * library function vendored into several bundles. Native front ends
+ * fingerprint each code entity from their own parse trees before building it
+ * (see CAstFingerprint in libcast, which leaves positions out); the first
+ * entity with a given fingerprint becomes canonical, and a later entity with
+ * the same fingerprint and the same source bytes is a view of it that shares
+ * its AST, control flow, types and nested entities, and has only its own
+ * names and positions. Comparing the bytes keeps a fingerprint collision from
+ * sharing the wrong AST; it also means that copies which differ only in
+ * layout are built anew.
+ *
+ * Each copy maps positions of the shared nodes to its own source file by
+ * their byte offset from the start of the entity, and finds their lines and
+ * columns in that file. Nested entities of a copy are renamed by putting the
+ * name of the copy in place of that of the canonical entity where their
+ * names start with it, as hierarchical names do, and by prefixing it
+ * otherwise.
+ *
+ * Canonical entities are held weakly, so the table does not keep alive
+ * entities that nothing else uses; copies hold on to theirs. Unlike
+ * {@link EntityFingerprintCache}, which matches entities by a key of the
+ * front end's choosing, this matches them by fingerprint and text alone.
+ * {@link #getShared()} is the table for the whole process.
+ */
+public class EntityDeduplicator {
+
+  private static final EntityDeduplicator shared = new EntityDeduplicator();
+
+  public static EntityDeduplicator getShared() {
+    return shared;
+  }
+
+  /**
+   * a canonical entity, held until nothing else holds it
+   */
+  private static class Canonical extends WeakReference<CAstEntity> {
+    private final long fingerprint;
+
+    private Canonical(long fingerprint, CAstEntity entity, ReferenceQueue<CAstEntity> queue) {
+      super(entity, queue);
+      this.fingerprint = fingerprint;
+    }
+  }
+
+  private final Map<Long, Canonical> canonical = HashMapFactory.make();
+
+  private final ReferenceQueue<CAstEntity> collected = new ReferenceQueue<>();
+
+  private int duplicates = 0;
+
+  private long bytesSaved = 0;
+
+  /**
+   * drop the entries of canonical entities that have been collected
+   */
+  private void expunge() {
+    Canonical c;
+    while ((c = (Canonical) collected.poll()) != null) {
+      if (canonical.get(c.fingerprint) == c) {
+        canonical.remove(c.fingerprint);
+      }
+    }
+  }
+
+  /**
+   * a copy of the canonical entity with the given fingerprint, called name
+   * and at position; null if there is none yet, in which case the caller
+   * should build the entity and {@link #record} it, or if the source of the
+   * canonical entity is not the same as that at position
+   */
+  public synchronized CAstEntity lookup(long fingerprint, String name, Position position) {
+    expunge();
+    Canonical c = canonical.get(fingerprint);
+    CAstEntity entity = c == null ? null : c.get();
+    if (entity == null || !(entity.getPosition() instanceof SharedPosition) || !(position instanceof SharedPosition)) {
+      return null;
+    }
+    SharedPosition from = (SharedPosition) entity.getPosition();
+    SharedPosition to = (SharedPosition) position;
+    if (!from.hasSameText(to)) {
+      return null;
+    }
+
+    duplicates++;
+    bytesSaved += to.getLastByteOffset() - to.getFirstByteOffset();
+    return new Copy(entity, name, new Relocation(from, to));
+  }
+
+  /**
+   * make entity the canonical one for fingerprint, unless there is one already
+   */
+  public synchronized void record(long fingerprint, CAstEntity entity) {
+    expunge();
+    Canonical c = canonical.get(fingerprint);
+    if (c == null || c.get() == null) {
+      canonical.put(fingerprint, new Canonical(fingerprint, entity, collected));
+    }
+  }
+
+  public synchronized void clear() {
+    canonical.clear();
+  }
+
+  public synchronized int getCanonicalCount() {
+    expunge();
+    return canonical.size();
+  }
+
+  /**
+   * how many entities were not built because a copy was found
+   */
+  public synchronized int getDuplicateCount() {
+    return duplicates;
+  }
+
+  /**
+   * how many bytes of source those entities spanned
+   */
+  public synchronized long getBytesSaved() {
+    return bytesSaved;
+  }
+
+  @Override
+  public synchronized String toString() {
+    return "entity dedup: " + canonical.size() + " canonical entities, " + duplicates + " duplicates, " + bytesSaved
+        + " bytes saved";
+  }
+
+  /**
+   * maps positions in the canonical entity to the same bytes of one copy
+   */
+  private static class Relocation {
+    private final SharedPosition to;
+
+    private final int delta;
+
+    private final int firstLine;
+
+    private final int lineDelta;
+
+    private final int colDelta;
+
+    private Relocation(SharedPosition from, SharedPosition to) {
+      this.to = to;
+      this.delta = to.getFirstByteOffset() - from.getFirstByteOffset();
+      this.firstLine = from.getFirstLine();
+      this.lineDelta = to.getFirstLine() - from.getFirstLine();
+      this.colDelta = from.getFirstCol() < 0 || to.getFirstCol() < 0 ? 0 : to.getFirstCol() - from.getFirstCol();
+    }
+
+    private Position relocate(final Position p) {
+      if (p == null) {
+        return null;
+      } else if (p instanceof SharedPosition) {
+        SharedPosition m = (SharedPosition) p;
+        return to.getBuffer().makeRangePosition(m.getFirstByteOffset() + delta, m.getLastByteOffset() + delta);
+      }
+
+      // a position a front end made without the source buffer has only
+      // lines and columns to go on, which the copy shares but for where it
+      // starts
+      return new AbstractSourcePosition() {
+        private int line(int line) {
+          return line < 0 ? line : line + lineDelta;
+        }
+
+        private int col(int line, int col) {
+          return col < 0 || line != firstLine ? col : col + colDelta;
+        }
+
+        @Override
+        public int getFirstLine() {
+          return line(p.getFirstLine());
+        }
+
+        @Override
+        public int getLastLine() {
+          return line(p.getLastLine());
+        }
+
+        @Override
+        public int getFirstCol() {
+          return col(p.getFirstLine(), p.getFirstCol());
+        }
+
+        @Override
+        public int getLastCol() {
+          return col(p.getLastLine(), p.getLastCol());
+        }
+
+        @Override
+        public int getFirstOffset() {
+          return -1;
+        }
+
+        @Override
+        public int getLastOffset() {
+          return -1;
+        }
+
+        @Override
+        public URL getURL() {
+          return to.getURL();
+        }
+
+        @Override
+        public Reader getReader() throws IOException {
+          return to.getReader();
+        }
+      };
+    }
+  }
+
+  /**
+   * a copy of a canonical entity, relocated; its nested entities are copies
+   * too, made once each so that they can be told apart by identity
+   */
+  private static class Copy extends DelegatingEntity {
+    private final String name;
+
+    private final Relocation relocation;
+
+    private final Map<CAstEntity, CAstEntity> nested = HashMapFactory.make();
+
+    private Map<CAstNode, Collection<CAstEntity>> allScoped;
+
+    private Copy(CAstEntity base, String name, Relocation relocation) {
+      super(base);
+      this.name = name;
+      this.relocation = relocation;
+    }
+
+    @Override
+    public String getName() {
+      return name == null ? super.getName() : name;
+    }
+
+    @Override
+    public Position getPosition() {
+      return relocation.relocate(super.getPosition());
+    }
+
+    @Override
+    public CAstSourcePositionMap getSourceMap() {
+      final CAstSourcePositionMap map = super.getSourceMap();
+      if (map == null) {
+        return null;
+      }
+
+      return new CAstSourcePositionMap() {
+        @Override
+        public Position getPosition(CAstNode n) {
+          return relocation.relocate(map.getPosition(n));
+        }
+
+        @Override
+        public Iterator<CAstNode> getMappedNodes() {
+          return map.getMappedNodes();
+        }
+      };
+    }
+
+    /**
+     * the name of the copy of a nested entity
+     */
+    private String rename(String nestedName) {
+      String canonicalName = super.getName();
+      if (nestedName == null || name == null || name.equals(canonicalName)) {
+        return nestedName;
+      } else if (canonicalName != null && nestedName.startsWith(canonicalName)) {
+        return name + nestedName.substring(canonicalName.length());
+      } else {
+        return name + "/" + nestedName;
+      }
+    }
+
+    private synchronized CAstEntity copy(CAstEntity e) {
+      CAstEntity c = nested.get(e);
+      if (c == null) {
+        nested.put(e, c = new Copy(e, rename(e.getName()), relocation));
+      }
+      return c;
+    }
+
+    @Override
+    public synchronized Map<CAstNode, Collection<CAstEntity>> getAllScopedEntities() {
+      if (allScoped == null) {
+        allScoped = HashMapFactory.make();
+        for (Map.Entry<CAstNode, Collection<CAstEntity>> es : super.getAllScopedEntities().entrySet()) {
+          Collection<CAstEntity> copies = new ArrayList<>();
+          for (CAstEntity e : es.getValue()) {
+            copies.add(copy(e));
+          }
+          allScoped.put(es.getKey(), copies);
+        }
+      }
+      return allScoped;
+    }
+
+    @Override
+    public Iterator<CAstEntity> getScopedEntities(CAstNode construct) {
+      Collection<CAstEntity> es = getAllScopedEntities().get(construct);
+      return es == null ? Collections.<CAstEntity> emptyIterator() : es.iterator();
+    }
+  }
+}
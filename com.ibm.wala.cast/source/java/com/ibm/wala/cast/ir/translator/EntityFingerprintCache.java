@@ -0,0 +1,105 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.ir.translator;
+
+import java.util.Map;
+
+import com.ibm.wala.cast.tree.CAstEntity;
+import com.ibm.wala.util.collections.HashMapFactory;
+
+/**
+ * Entities built by native front ends, remembered across translations so that
+ * unchanged entities need not be built again. Each entity is recorded under a
+ * key chosen by the front end, e.g. the qualified name of a function, together
+ * with the structural fingerprint computed natively while it was built (see
+ * CAstFingerprint in libcast). A later translation that computes the same
+ * fingerprint for the same key gets back the very same {@link CAstEntity}, so
+ * anything downstream keyed on the entity, or on {@link #getFingerprint}, stays
+ * valid. Since the entity is returned as it was, with its source positions,
+ * fingerprints must cover positions too; those CAstWrapper computes do.
+ * 
+ * One cache is meant to be shared by all the translators of a workspace, e.g.
+ * across re-analyses in a watch mode.
+ */
+public class EntityFingerprintCache {
+
+  private static class Entry {
+    private final long fingerprint;
+
+    private final CAstEntity entity;
+
+    private Entry(long fingerprint, CAstEntity entity) {
+      this.fingerprint = fingerprint;
+      this.entity = entity;
+    }
+  }
+
+  private final Map<String, Entry> entries = HashMapFactory.make();
+
+  private final Map<CAstEntity, Long> fingerprints = HashMapFactory.make();
+
+  private int hits = 0;
+
+  private int misses = 0;
+
+  /**
+   * the entity recorded for key, if its fingerprint is the given one, and null
+   * otherwise
+   */
+  public synchronized CAstEntity lookup(String key, long fingerprint) {
+    Entry e = entries.get(key);
+    if (e != null && e.fingerprint == fingerprint) {
+      hits++;
+      return e.entity;
+    } else {
+      misses++;
+      return null;
+    }
+  }
+
+  /**
+   * remember entity as the current version for key, replacing any older one
+   */
+  public synchronized void record(String key, long fingerprint, CAstEntity entity) {
+    Entry old = entries.put(key, new Entry(fingerprint, entity));
+    if (old != null && old.entity != entity) {
+      fingerprints.remove(old.entity);
+    }
+    fingerprints.put(entity, fingerprint);
+  }
+
+  /**
+   * the fingerprint an entity was recorded with, suitable as a cache key for
+   * whatever is computed from the entity; null if the entity is not in this
+   * cache
+   */
+  public synchronized Long getFingerprint(CAstEntity entity) {
+    return fingerprints.get(entity);
+  }
+
+  public synchronized void clear() {
+    entries.clear();
+    fingerprints.clear();
+  }
+
+  public synchronized int getHits() {
+    return hits;
+  }
+
+  public synchronized int getMisses() {
+    return misses;
+  }
+
+  @Override
+  public synchronized String toString() {
+    return "entity cache: " + entries.size() + " entities, " + hits + " hits, " + misses + " misses";
+  }
+}
@@ -0,0 +1,150 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.ir.translator;
+
+import java.util.ArrayDeque;
+import java.util.Deque;
+import java.util.IdentityHashMap;
+import java.util.Map;
+
+import com.ibm.wala.cast.tree.CAstNode;
+
+/**
+ * how big the AST of one entity is, not counting entities nested in it, as
+ * native front ends work out while building it (see
+ * CAstWrapper::beginSizeSummary); {@link AstTranslator} uses these to size its
+ * tables for the entity up front rather than growing them as it goes. An
+ * entity whose AST constant folding pruned is recounted (see
+ * {@link #recount}), so what was pruned is not counted.
+ */
+public class EntitySizeSummary {
+
+  private final int[] kindCounts;
+
+  private final int nodeCount;
+
+  private final int maxDepth;
+
+  private final int gotoEdgeCount;
+
+  public EntitySizeSummary(int[] kindCounts, int nodeCount, int maxDepth, int gotoEdgeCount) {
+    this.kindCounts = kindCounts;
+    this.nodeCount = nodeCount;
+    this.maxDepth = maxDepth;
+    this.gotoEdgeCount = gotoEdgeCount;
+  }
+
+  /**
+   * this summary for ast instead, with gotoEdgeCount goto edges, as when
+   * constant folding has dropped part of what was counted
+   */
+  public EntitySizeSummary recount(CAstNode ast, int gotoEdgeCount) {
+    int[] counts = new int[kindCounts.length];
+    int nodes = 0;
+    int deepest = 0;
+    Map<CAstNode, Integer> depths = new IdentityHashMap<>();
+    Deque<CAstNode> work = new ArrayDeque<>();
+    work.push(ast);
+    while (!work.isEmpty()) {
+      CAstNode n = work.peek();
+      if (depths.containsKey(n)) {
+        work.pop();
+        continue;
+      }
+
+      // a node is done once its children are, which are then on top of it
+      int depth = 0;
+      boolean ready = true;
+      for (int i = 0; i < n.getChildCount(); i++) {
+        CAstNode c = n.getChild(i);
+        if (c != null) {
+          Integer d = depths.get(c);
+          if (d == null) {
+            ready = false;
+            work.push(c);
+          } else {
+            depth = Math.max(depth, d);
+          }
+        }
+      }
+      if (ready) {
+        work.pop();
+        depths.put(n, depth + 1);
+        deepest = Math.max(deepest, depth + 1);
+        nodes++;
+        if (n.getKind() >= 0 && n.getKind() < counts.length) {
+          counts[n.getKind()]++;
+        }
+      }
+    }
+    return new EntitySizeSummary(counts, nodes, deepest, gotoEdgeCount);
+  }
+
+  public int getNodeCount() {
+    return nodeCount;
+  }
+
+  /**
+   * the number of nodes of kind; sub-language kinds are only counted in
+   * {@link #getNodeCount()}
+   */
+  public int getNodeCount(int kind) {
+    return kind >= 0 && kind < kindCounts.length ? kindCounts[kind] : 0;
+  }
+
+  /**
+   * the depth of the deepest node, counting leaves as 1, or -1 if unknown
+   */
+  public int getMaxDepth() {
+    return maxDepth;
+  }
+
+  public int getDeclarationCount() {
+    return getNodeCount(CAstNode.DECL_STMT);
+  }
+
+  public int getGotoEdgeCount() {
+    return gotoEdgeCount;
+  }
+
+  /**
+   * roughly how many instructions translation makes: about one for each node
+   * that is not a constant
+   */
+  public int getInstructionEstimate() {
+    return nodeCount - getNodeCount(CAstNode.CONSTANT);
+  }
+
+  /**
+   * roughly how many basic blocks translation makes: a couple for each
+   * construct that branches, and one for each goto edge
+   */
+  public int getBlockEstimate() {
+    int branches = getNodeCount(CAstNode.IF_STMT) + getNodeCount(CAstNode.IF_EXPR) + getNodeCount(CAstNode.LOOP)
+        + getNodeCount(CAstNode.SWITCH) + getNodeCount(CAstNode.TRY) + getNodeCount(CAstNode.CATCH)
+        + getNodeCount(CAstNode.ANDOR_EXPR) + getNodeCount(CAstNode.GOTO) + getNodeCount(CAstNode.RETURN)
+        + getNodeCount(CAstNode.THROW);
+    return 2 * branches + gotoEdgeCount + 2;
+  }
+
+  /**
+   * the initial capacity of a hash map that is to hold count entries
+   * without being resized
+   */
+  public static int capacity(int count) {
+    return count < 3 ? 4 : (int) (count / 0.75f) + 1;
+  }
+
+  @Override
+  public String toString() {
+    return nodeCount + " nodes, depth " + maxDepth + ", " + gotoEdgeCount + " goto edges";
+  }
+}
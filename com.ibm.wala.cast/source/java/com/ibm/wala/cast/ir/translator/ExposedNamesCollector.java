@@ -10,9 +10,11 @@
  *******************************************************************************/
 package com.ibm.wala.cast.ir.translator;
 
+import java.util.Collection;
 import java.util.Map;
 import java.util.Set;
 
+import com.ibm.wala.cast.tree.CAstDeferredBodyEntity;
 import com.ibm.wala.cast.tree.CAstEntity;
 import com.ibm.wala.cast.tree.CAstNode;
 import com.ibm.wala.cast.tree.CAstSourcePositionMap;
@@ -23,6 +25,12 @@ import com.ibm.wala.util.collections.MapUtil;
 
 /**
  * discovers which names declared by an {@link CAstEntity entity} are exposed, i.e., accessed by nested functions.  
+ * 
+ * Native front ends may have worked this out while building the entities (see
+ * {@link AbstractEntity#hasExposedNames()}); then the names are only gathered
+ * from the entities rather than found by walking their trees.  If any code
+ * entity in the tree lacks them, has no name, or has a body not yet built,
+ * the whole tree is walked instead.
  */
 public class ExposedNamesCollector extends CAstVisitor<ExposedNamesCollector.EntityContext> {
 
@@ -67,7 +75,61 @@ public class ExposedNamesCollector extends CAstVisitor<ExposedNamesCollector.Ent
    *          the entity
    */
   public void run(CAstEntity N) {
-    visitEntities(N, new EntityContext(N), this);
+    if (isPrecomputed(N)) {
+      collectPrecomputed(N);
+    } else {
+      visitEntities(N, new EntityContext(N), this);
+    }
+  }
+
+  /**
+   * whether the exposed names of n and of all code entities nested in it were
+   * worked out as they were built, so that nothing found by a walk is missed
+   */
+  private static boolean isPrecomputed(CAstEntity n) {
+    switch (n.getKind()) {
+    case CAstEntity.FUNCTION_ENTITY:
+    case CAstEntity.MACRO_ENTITY:
+    case CAstEntity.SCRIPT_ENTITY:
+      if (!(n instanceof AbstractEntity) || !((AbstractEntity) n).hasExposedNames()) {
+        return false;
+      }
+      // an unnamed function cannot have been declared by its parent, and a
+      // deferred body has not been seen at all
+      if (n.getName() == null) {
+        return false;
+      }
+      if (n instanceof CAstDeferredBodyEntity && ((CAstDeferredBodyEntity) n).hasDeferredBody()) {
+        return false;
+      }
+      break;
+    default:
+      break;
+    }
+    for (Collection<CAstEntity> children : n.getAllScopedEntities().values()) {
+      for (CAstEntity child : children) {
+        if (!isPrecomputed(child)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  private void collectPrecomputed(CAstEntity n) {
+    if (n instanceof AbstractEntity && ((AbstractEntity) n).hasExposedNames()) {
+      AbstractEntity e = (AbstractEntity) n;
+      if (!e.getExposedReads().isEmpty() || !e.getExposedWrites().isEmpty()) {
+        Set<String> exposed = MapUtil.findOrCreateSet(entity2ExposedNames, n);
+        exposed.addAll(e.getExposedReads());
+        exposed.addAll(e.getExposedWrites());
+      }
+    }
+    for (Collection<CAstEntity> children : n.getAllScopedEntities().values()) {
+      for (CAstEntity child : children) {
+        collectPrecomputed(child);
+      }
+    }
   }
 
   @Override
@@ -6,12 +6,30 @@ import java.io.IOException;
 import java.io.InputStream;
 import java.io.InputStreamReader;
 import java.io.Reader;
+import java.lang.ref.PhantomReference;
+import java.lang.ref.ReferenceQueue;
 import java.net.URL;
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.Map;
+import java.util.Set;
+import java.util.concurrent.CompletableFuture;
+import java.util.function.Consumer;
 
 import com.ibm.wala.cast.tree.CAst;
 import com.ibm.wala.cast.tree.CAstEntity;
+import com.ibm.wala.cast.tree.CAstNode;
 import com.ibm.wala.cast.tree.CAstSourcePositionMap.Position;
+import com.ibm.wala.cast.tree.CAstType;
+import com.ibm.wala.cast.tree.CAstTypeDictionary;
 import com.ibm.wala.cast.tree.impl.AbstractSourcePosition;
+import com.ibm.wala.cast.tree.impl.CAstTypeDictionaryImpl;
+import com.ibm.wala.cast.util.SharedSourceBuffer;
+import com.ibm.wala.util.MonitorUtil;
+import com.ibm.wala.util.MonitorUtil.IProgressMonitor;
+import com.ibm.wala.util.collections.HashMapFactory;
+import com.ibm.wala.util.collections.HashSetFactory;
 
 /**
  * common functionality for any {@link TranslatorToCAst} making use of native code
@@ -25,12 +43,363 @@ public abstract class NativeTranslatorToCAst
 
   protected final String sourceFileName;
 
+  /**
+   * progress monitor of the asynchronous translation in flight, if any
+   */
+  private volatile IProgressMonitor monitor;
+
+  /**
+   * result of the asynchronous translation in flight, if any
+   */
+  private volatile CompletableFuture<CAstEntity> pending;
+
+  /**
+   * entities of earlier translations that native code may reuse, if any
+   */
+  private EntityFingerprintCache entityCache;
+
+  /**
+   * canonical entities that native code may share copies of, if any
+   */
+  private EntityDeduplicator entityDeduplicator;
+
+  /**
+   * receives each top-level entity as soon as native code completes it, if
+   * streaming is on
+   */
+  private Consumer<CAstEntity> entityStream;
+
+  /**
+   * the source file as read by native code, once it has been
+   */
+  private SharedSourceBuffer sourceBuffer;
+
+  private boolean sourceLoaded;
+
+  /**
+   * the types native code has interned, by the keys it gave them
+   */
+  private final CAstTypeDictionaryImpl<String> typeDictionary = new CAstTypeDictionaryImpl<>();
+
+  /**
+   * the same types, by the ids native code refers to them with
+   */
+  private final List<CAstType> internedTypes = new ArrayList<>();
+
+  private final Map<String, Integer> internedTypeIds = HashMapFactory.make();
+
+  /**
+   * the native bodies of entities that have not been built yet, by handle
+   */
+  private final Map<Long, DeferredBody> deferredBodies = HashMapFactory.make();
+
+  /**
+   * receives the bodies of entities that became unreachable before they were
+   * built
+   */
+  private final ReferenceQueue<AbstractCodeEntity> unreachableBodies = new ReferenceQueue<>();
+
+  /**
+   * the handle of a native body, enqueued once its entity is unreachable so
+   * that the body can be released without ever being built
+   */
+  private static class DeferredBody extends PhantomReference<AbstractCodeEntity> {
+    private final long body;
+
+    private DeferredBody(AbstractCodeEntity entity, long body, ReferenceQueue<AbstractCodeEntity> queue) {
+      super(entity, queue);
+      this.body = body;
+    }
+  }
+
   protected NativeTranslatorToCAst(CAst Ast, URL sourceURL, String sourceFileName) {
     super(Ast);
     this.sourceURL = sourceURL;
     this.sourceFileName = sourceFileName;
   }
 
+  /**
+   * let native code reuse entities of earlier translations whose fingerprints
+   * have not changed; null turns reuse off
+   */
+  public void setEntityCache(EntityFingerprintCache entityCache) {
+    this.entityCache = entityCache;
+  }
+
+  public EntityFingerprintCache getEntityCache() {
+    return entityCache;
+  }
+
+  /**
+   * called from native code through CAstWrapper
+   */
+  protected CAstEntity getCachedEntity(String key, long fingerprint) {
+    return entityCache == null ? null : entityCache.lookup(key, fingerprint);
+  }
+
+  /**
+   * called from native code through CAstWrapper
+   */
+  protected void cacheEntity(String key, long fingerprint, CAstEntity entity) {
+    if (entityCache != null) {
+      entityCache.record(key, fingerprint, entity);
+    }
+  }
+
+  /**
+   * let native code share one entity between identical copies of it, in
+   * this file and in any other translated with the same
+   * deduplicator, e.g. {@link EntityDeduplicator#getShared()}; null turns
+   * sharing off
+   */
+  public void setEntityDeduplicator(EntityDeduplicator entityDeduplicator) {
+    this.entityDeduplicator = entityDeduplicator;
+  }
+
+  public EntityDeduplicator getEntityDeduplicator() {
+    return entityDeduplicator;
+  }
+
+  /**
+   * called from native code through CAstWrapper
+   */
+  protected CAstEntity getDuplicateEntity(long fingerprint, String name, Position position) {
+    return entityDeduplicator == null ? null : entityDeduplicator.lookup(fingerprint, name, position);
+  }
+
+  /**
+   * called from native code through CAstWrapper
+   */
+  protected void recordCanonicalEntity(long fingerprint, CAstEntity entity) {
+    if (entityDeduplicator != null) {
+      entityDeduplicator.record(fingerprint, entity);
+    }
+  }
+
+  /**
+   * turn on streaming: native front ends that build top-level entities one
+   * at a time (see CAstWrapper::beginStreamedEntity) hand each one to stream
+   * as soon as it is complete, and then release everything they held for it
+   * rather than keeping it for the entity returned by
+   * {@link #translateToCAst()}. That bounds the memory of a translation by its
+   * largest top-level entity rather than by the whole file, provided stream
+   * does not itself hold on to the entities. null turns streaming off.
+   */
+  public void setEntityStream(Consumer<CAstEntity> stream) {
+    this.entityStream = stream;
+  }
+
+  /**
+   * called from native code through CAstWrapper
+   * 
+   * @return whether entity was streamed, i.e. native code should not keep it
+   */
+  protected boolean entityCompleted(CAstEntity entity) {
+    if (entityStream == null) {
+      return false;
+    } else {
+      entityStream.accept(entity);
+      return true;
+    }
+  }
+
+  /**
+   * called from native code through CAstWrapper
+   * 
+   * @return the id of the type interned under key, interning type under it
+   *         first if there is none and type is not null; -1 otherwise
+   */
+  protected int internType(String key, CAstType type) {
+    synchronized (internedTypes) {
+      Integer known = internedTypeIds.get(key);
+      if (known != null) {
+        return known;
+      } else if (type == null) {
+        return -1;
+      } else {
+        typeDictionary.map(key, type);
+        internedTypeIds.put(key, internedTypes.size());
+        internedTypes.add(type);
+        return internedTypes.size() - 1;
+      }
+    }
+  }
+
+  /**
+   * called from native code through CAstWrapper, with the types of the first
+   * count nodes given as interned ids
+   */
+  protected void setNodeTypes(AbstractCodeEntity entity, CAstNode[] nodes, int[] typeIds, int count) {
+    CAstType[] types = new CAstType[count];
+    synchronized (internedTypes) {
+      for (int i = 0; i < count; i++) {
+        types[i] = internedTypes.get(typeIds[i]);
+      }
+    }
+    for (int i = 0; i < count; i++) {
+      entity.setNodeType(nodes[i], types[i]);
+    }
+  }
+
+  /**
+   * called from native code through CAstWrapper, with the first count scoped
+   * entities it has added, in order; each run of edges from one parent is
+   * added in one go
+   */
+  protected void addScopedEntities(AbstractEntity[] parents, CAstNode[] constructs, CAstEntity[] children, int count) {
+    int i = 0;
+    while (i < count) {
+      int j = i + 1;
+      while (j < count && parents[j] == parents[i]) {
+        j++;
+      }
+      parents[i].addScopedEntities(constructs, children, i, j);
+      i = j;
+    }
+  }
+
+  /**
+   * called from native code through CAstWrapper, with the exposed names of
+   * each entity given by a count of reads, their indices in names, and the
+   * same for writes
+   */
+  protected void setExposedNames(AbstractEntity[] entities, String[] names, int[] exposed) {
+    int next = 0;
+    for (AbstractEntity entity : entities) {
+      Set<String> reads = HashSetFactory.make(exposed[next]);
+      for (int i = exposed[next++]; i > 0; i--) {
+        reads.add(names[exposed[next++]]);
+      }
+      Set<String> writes = HashSetFactory.make(exposed[next]);
+      for (int i = exposed[next++]; i > 0; i--) {
+        writes.add(names[exposed[next++]]);
+      }
+      entity.setExposedNames(reads, writes);
+    }
+  }
+
+  /**
+   * called from native code through CAstWrapper
+   */
+  protected void setCallSites(AbstractCodeEntity entity, CAstNode[] calls) {
+    entity.setCallSites(new CallSiteTable(entity, calls));
+  }
+
+  /**
+   * called from native code through CAstWrapper
+   */
+  protected void setSizeSummary(AbstractCodeEntity entity, int[] kindCounts, int nodeCount, int maxDepth, int gotoEdges) {
+    entity.setSizeSummary(new EntitySizeSummary(kindCounts, nodeCount, maxDepth, gotoEdges));
+  }
+
+  /**
+   * called from native code through CAstWrapper, with a handle on a native
+   * CAstDeferredBody that builds the body of entity when it is first needed.
+   * 
+   * The body is built on whichever thread first asks for it, perhaps while
+   * this translator is still translating on another; the callbacks it makes
+   * that share state across entities are synchronized for that.
+   */
+  protected void deferBody(final AbstractCodeEntity entity, final long body) {
+    synchronized (deferredBodies) {
+      releaseUnreachableBodies();
+      deferredBodies.put(body, new DeferredBody(entity, body, unreachableBodies));
+    }
+    entity.deferBody(() -> {
+      if (takeDeferredBody(body)) {
+        buildBody(entity, body);
+      }
+    });
+  }
+
+  private boolean takeDeferredBody(long body) {
+    synchronized (deferredBodies) {
+      DeferredBody ref = deferredBodies.remove(body);
+      if (ref == null) {
+        return false;
+      } else {
+        ref.clear();
+        return true;
+      }
+    }
+  }
+
+  /**
+   * free the bodies of entities that nothing can build any more
+   */
+  private void releaseUnreachableBodies() {
+    DeferredBody ref;
+    while ((ref = (DeferredBody) unreachableBodies.poll()) != null) {
+      if (deferredBodies.remove(ref.body) != null) {
+        releaseBody(ref.body);
+      }
+    }
+  }
+
+  /**
+   * called from native code through CAstWrapper when it is done, i.e. at
+   * the end of {@link #translateToCAst()} or of building a deferred body;
+   * the bodies of entities dropped meanwhile are freed then rather than at
+   * the next deferral
+   */
+  protected void translationEnded() {
+    synchronized (deferredBodies) {
+      releaseUnreachableBodies();
+    }
+  }
+
+  /**
+   * the number of entities whose bodies have not been built yet, not
+   * counting those that have become unreachable
+   */
+  public int getDeferredBodyCount() {
+    synchronized (deferredBodies) {
+      releaseUnreachableBodies();
+      return deferredBodies.size();
+    }
+  }
+
+  /**
+   * free the native state kept for bodies that have not been built; those
+   * entities are left without ASTs. Bodies are also freed without this as
+   * their entities become unreachable, and with this translator.
+   */
+  public void releaseDeferredBodies() {
+    synchronized (deferredBodies) {
+      for (long body : deferredBodies.keySet()) {
+        releaseBody(body);
+      }
+      deferredBodies.clear();
+    }
+  }
+
+  /**
+   * the entities whose bodies are still to be built hold on to this
+   * translator, so once it is unreachable none of them can be built
+   */
+  @Override
+  protected void finalize() throws Throwable {
+    try {
+      releaseDeferredBodies();
+    } finally {
+      super.finalize();
+    }
+  }
+
+  /**
+   * build a deferred body and release it
+   */
+  private native void buildBody(AbstractCodeEntity entity, long body);
+
+  private static native void releaseBody(long body);
+
+  /**
+   * the types native code has interned so far
+   */
+  public CAstTypeDictionary getTypeDictionary() {
+    return typeDictionary;
+  }
+
   protected String getLocalFile() {
     return sourceFileName;
   }
@@ -39,7 +408,37 @@ public abstract class NativeTranslatorToCAst
     return sourceURL.getFile();
   }
 
+  /**
+   * the contents of fileName and the start offsets of its lines, as direct
+   * buffers holding the copy native code has read, which it shares with every
+   * translator of the same file while the file is unchanged
+   */
+  private static native ByteBuffer[] loadSource(String fileName) throws IOException;
+
+  /**
+   * the source file, copied into memory once and shared with native code and
+   * with all positions made by {@link #makeLocation}; null if it cannot be
+   * read
+   */
+  protected synchronized SharedSourceBuffer getSourceBuffer() {
+    if (!sourceLoaded) {
+      sourceLoaded = true;
+      try {
+        ByteBuffer[] loaded = loadSource(getLocalFile());
+        sourceBuffer = new SharedSourceBuffer(sourceURL, loaded[0], loaded[1]);
+      } catch (IOException e) {
+        sourceBuffer = null;
+      }
+    }
+    return sourceBuffer;
+  }
+
   protected Position makeLocation(final int fl, final int fc, final int ll, final int lc) {
+    SharedSourceBuffer buffer = getSourceBuffer();
+    if (buffer != null) {
+      return buffer.makePosition(fl, fc, ll, lc);
+    }
+
     return new AbstractSourcePosition() {
       @Override
       public int getFirstLine() {
@@ -100,4 +499,67 @@ public abstract class NativeTranslatorToCAst
   @Override
   public abstract CAstEntity translateToCAst();
 
+  /**
+   * start {@link #translateToCAst()} on a native worker thread attached to
+   * the JVM, and return at once. The returned future is completed from native
+   * code with the entity, or exceptionally with whatever the translation threw;
+   * if the worker cannot be started or attached, it is completed exceptionally
+   * before this method returns.
+   * 
+   * Cancelling the future or the monitor does not interrupt the worker; native
+   * front ends notice it by polling {@link #isCanceled()} through
+   * CAstWrapper, and report progress to the monitor through
+   * {@link #worked(int)}.
+   * 
+   * @param monitor receives progress reports; may be null
+   */
+  public synchronized CompletableFuture<CAstEntity> translateToCAstAsync(IProgressMonitor monitor) {
+    if (pending != null) {
+      throw new IllegalStateException("translation of " + sourceFileName + " already in progress");
+    }
+
+    CompletableFuture<CAstEntity> result = new CompletableFuture<>();
+    this.monitor = monitor;
+    this.pending = result;
+    try {
+      startTranslation(result);
+    } catch (Throwable e) {
+      // no worker will ever complete the future, so do it here
+      endTranslation();
+      result.completeExceptionally(e);
+    }
+    return result;
+  }
+
+  private native void startTranslation(CompletableFuture<CAstEntity> result);
+
+  /**
+   * called by the native worker thread once the translation has finished,
+   * just before it completes the future
+   */
+  private void endTranslation() {
+    monitor = null;
+    pending = null;
+  }
+
+  /**
+   * whether the asynchronous translation in flight has been cancelled, either
+   * through its future or through its progress monitor. Always false for
+   * synchronous translations.
+   */
+  protected boolean isCanceled() {
+    CompletableFuture<CAstEntity> inFlight = pending;
+    return (inFlight != null && inFlight.isCancelled()) || MonitorUtil.isCanceled(monitor);
+  }
+
+  /**
+   * report progress of the asynchronous translation in flight, if any
+   */
+  protected void worked(int units) {
+    IProgressMonitor m = monitor;
+    if (m != null) {
+      m.worked(units);
+    }
+  }
+
 }
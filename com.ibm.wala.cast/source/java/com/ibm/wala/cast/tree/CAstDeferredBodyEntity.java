@@ -0,0 +1,26 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.tree;
+
+/**
+ * an entity that may put off building its body until something asks it for
+ * its AST or side tables, e.g. one whose body a native front end defers.
+ * Clients that only pass the entity along can ask first, and leave the body
+ * unbuilt.
+ */
+public interface CAstDeferredBodyEntity extends CAstEntity {
+
+  /**
+   * whether the body has yet to be built
+   */
+  boolean hasDeferredBody();
+
+}
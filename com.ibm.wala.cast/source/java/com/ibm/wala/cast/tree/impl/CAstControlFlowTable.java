@@ -0,0 +1,362 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.tree.impl;
+
+import java.util.AbstractList;
+import java.util.Arrays;
+import java.util.Collection;
+import java.util.Collections;
+import java.util.List;
+import java.util.Map;
+import java.util.Set;
+
+import com.ibm.wala.cast.tree.CAstControlFlowMap;
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.util.collections.HashMapFactory;
+
+/**
+ * A compact, read-only CAstControlFlowMap for ast nodes mapped to themselves,
+ * as recorded by native front ends. Nodes are numbered densely and found
+ * through an open-addressing identity hash table of ints; labels are interned;
+ * and edges are held in compressed sparse row form, outgoing edges by source
+ * and incoming sources by target, so that no objects are allocated per edge.
+ *
+ * The targets and labels of a node keep the order in which the edges were
+ * added, and a later edge with the same source and label replaces an earlier
+ * one, as with {@link CAstControlFlowRecorder}.
+ */
+public class CAstControlFlowTable implements CAstControlFlowMap {
+
+  /**
+   * accumulates edges in parallel arrays until {@link #build()}
+   */
+  public static class Builder {
+    private CAstNode[] from = new CAstNode[16];
+
+    private CAstNode[] to = new CAstNode[16];
+
+    private Object[] labels = new Object[16];
+
+    private int size = 0;
+
+    public void add(CAstNode src, CAstNode dst, Object label) {
+      assert src != null;
+      assert dst != null;
+      if (size == from.length) {
+        from = Arrays.copyOf(from, 2 * size);
+        to = Arrays.copyOf(to, 2 * size);
+        labels = Arrays.copyOf(labels, 2 * size);
+      }
+      from[size] = src;
+      to[size] = dst;
+      labels[size] = label;
+      size++;
+    }
+
+    public void addAll(CAstNode[] srcs, CAstNode[] dsts, Object[] ls) {
+      for (int i = 0; i < srcs.length; i++) {
+        add(srcs[i], dsts[i], ls[i]);
+      }
+    }
+
+    public int size() {
+      return size;
+    }
+
+    public void clear() {
+      Arrays.fill(from, 0, size, null);
+      Arrays.fill(to, 0, size, null);
+      Arrays.fill(labels, 0, size, null);
+      size = 0;
+    }
+
+    /**
+     * drop the edges from nodes not in live
+     */
+    public void retainNodes(Set<CAstNode> live) {
+      int kept = 0;
+      for (int i = 0; i < size; i++) {
+        if (live.contains(from[i])) {
+          from[kept] = from[i];
+          to[kept] = to[i];
+          labels[kept] = labels[i];
+          kept++;
+        }
+      }
+      Arrays.fill(from, kept, size, null);
+      Arrays.fill(to, kept, size, null);
+      Arrays.fill(labels, kept, size, null);
+      size = kept;
+    }
+
+    public CAstControlFlowTable build() {
+      return new CAstControlFlowTable(from, to, labels, size);
+    }
+  }
+
+  private final CAstNode[] nodes;
+
+  private final int[] slots;
+
+  private final Object[] labels;
+
+  private final Map<Object, Integer> labelIds = HashMapFactory.make();
+
+  private final int[] outStart;
+
+  private final int[] outLabel;
+
+  private final int[] outTarget;
+
+  private final int[] inStart;
+
+  private final int[] inSource;
+
+  private final List<CAstNode> mapped;
+
+  private CAstControlFlowTable(CAstNode[] from, CAstNode[] to, Object[] edgeLabels, int size) {
+    // number the nodes densely
+    int capacity = 16;
+    while (capacity < 4 * size) {
+      capacity <<= 1;
+    }
+    int[] table = new int[capacity];
+    CAstNode[] ns = new CAstNode[2 * size];
+    int nodeCount = 0;
+    int[] src = new int[size];
+    int[] dst = new int[size];
+    int[] lbl = new int[size];
+    Object[] ls = new Object[Math.max(size, 1)];
+    int labelCount = 0;
+    for (int i = 0; i < size; i++) {
+      int s = find(table, ns, from[i]);
+      if (s < 0) {
+        ns[nodeCount] = from[i];
+        table[~s] = ++nodeCount;
+        s = nodeCount - 1;
+      }
+      src[i] = s;
+
+      int d = find(table, ns, to[i]);
+      if (d < 0) {
+        ns[nodeCount] = to[i];
+        table[~d] = ++nodeCount;
+        d = nodeCount - 1;
+      }
+      dst[i] = d;
+
+      Integer l = labelIds.get(edgeLabels[i]);
+      if (l == null) {
+        l = labelCount;
+        labelIds.put(edgeLabels[i], l);
+        ls[labelCount++] = edgeLabels[i];
+      }
+      lbl[i] = l;
+    }
+
+    this.nodes = Arrays.copyOf(ns, nodeCount);
+    this.slots = table;
+    this.labels = Arrays.copyOf(ls, labelCount);
+
+    // outgoing edges by source, stable so that insertion order is kept,
+    // then with duplicate labels collapsed onto the first one
+    int[] order = countingSort(src, size, nodeCount);
+    int[] oStart = new int[nodeCount + 1];
+    int[] oLabel = new int[size];
+    int[] oTarget = new int[size];
+    int next = 0;
+    for (int n = 0, i = 0; n < nodeCount; n++) {
+      oStart[n] = next;
+      for (; i < size && src[order[i]] == n; i++) {
+        int e = order[i];
+        int j = oStart[n];
+        while (j < next && oLabel[j] != lbl[e]) {
+          j++;
+        }
+        if (j == next) {
+          next++;
+        }
+        oLabel[j] = lbl[e];
+        oTarget[j] = dst[e];
+      }
+    }
+    oStart[nodeCount] = next;
+    this.outStart = oStart;
+    this.outLabel = Arrays.copyOf(oLabel, next);
+    this.outTarget = Arrays.copyOf(oTarget, next);
+
+    // distinct sources by target, from every edge recorded, as
+    // CAstControlFlowRecorder keeps the source of an edge whose target was
+    // later replaced
+    order = countingSort(dst, size, nodeCount);
+    int[] iStart = new int[nodeCount + 1];
+    int[] iSource = new int[size];
+    int in = 0;
+    for (int n = 0, i = 0; n < nodeCount; n++) {
+      iStart[n] = in;
+      for (; i < size && dst[order[i]] == n; i++) {
+        int s = src[order[i]];
+        int j = iStart[n];
+        while (j < in && iSource[j] != s) {
+          j++;
+        }
+        if (j == in) {
+          iSource[in++] = s;
+        }
+      }
+    }
+    iStart[nodeCount] = in;
+    this.inStart = iStart;
+    this.inSource = Arrays.copyOf(iSource, in);
+
+    // the ends of the surviving edges; a node that was only ever the target
+    // of a replaced edge is not mapped
+    boolean[] ends = new boolean[nodeCount];
+    int mappedCount = 0;
+    for (int n = 0; n < nodeCount; n++) {
+      for (int j = oStart[n]; j < oStart[n + 1]; j++) {
+        ends[n] = true;
+        ends[oTarget[j]] = true;
+      }
+    }
+    CAstNode[] m = new CAstNode[nodeCount];
+    for (int n = 0; n < nodeCount; n++) {
+      if (ends[n]) {
+        m[mappedCount++] = nodes[n];
+      }
+    }
+    this.mapped = Arrays.asList(Arrays.copyOf(m, mappedCount));
+  }
+
+  /**
+   * the indices 0..size-1 stably sorted by key
+   */
+  private static int[] countingSort(int[] keys, int size, int keyCount) {
+    int[] start = new int[keyCount + 1];
+    for (int i = 0; i < size; i++) {
+      start[keys[i] + 1]++;
+    }
+    for (int k = 0; k < keyCount; k++) {
+      start[k + 1] += start[k];
+    }
+    int[] order = new int[size];
+    for (int i = 0; i < size; i++) {
+      order[start[keys[i]]++] = i;
+    }
+    return order;
+  }
+
+  /**
+   * the id of n, or the bitwise complement of the free slot where it belongs
+   */
+  private static int find(int[] table, CAstNode[] nodes, Object n) {
+    int mask = table.length - 1;
+    int slot = hash(n) & mask;
+    while (table[slot] != 0) {
+      if (nodes[table[slot] - 1] == n) {
+        return table[slot] - 1;
+      }
+      slot = (slot + 1) & mask;
+    }
+    return ~slot;
+  }
+
+  /**
+   * numbered nodes hash by their id, sparing the identity hash
+   */
+  private static int hash(Object n) {
+    if (n instanceof CAstNumberedNode) {
+      int id = ((CAstNumberedNode) n).getNodeId();
+      if (id >= 0) {
+        return id * 0x9E3779B9;
+      }
+    }
+    return System.identityHashCode(n);
+  }
+
+  private int id(Object n) {
+    if (n == null || nodes.length == 0) {
+      return -1;
+    }
+    int id = find(slots, nodes, n);
+    return id < 0 ? -1 : id;
+  }
+
+  @Override
+  public CAstNode getTarget(CAstNode from, Object label) {
+    int n = id(from);
+    Integer l = labelIds.get(label);
+    if (n < 0 || l == null) {
+      return null;
+    }
+    for (int j = outStart[n]; j < outStart[n + 1]; j++) {
+      if (outLabel[j] == l) {
+        return nodes[outTarget[j]];
+      }
+    }
+    return null;
+  }
+
+  @Override
+  public Collection<Object> getTargetLabels(CAstNode from) {
+    final int n = id(from);
+    if (n < 0 || outStart[n] == outStart[n + 1]) {
+      return Collections.emptySet();
+    }
+    return new AbstractList<Object>() {
+      @Override
+      public Object get(int index) {
+        return labels[outLabel[outStart[n] + index]];
+      }
+
+      @Override
+      public int size() {
+        return outStart[n + 1] - outStart[n];
+      }
+    };
+  }
+
+  @Override
+  public Collection<Object> getSourceNodes(CAstNode to) {
+    final int n = id(to);
+    if (n < 0 || inStart[n] == inStart[n + 1]) {
+      return Collections.emptySet();
+    }
+    return new AbstractList<Object>() {
+      @Override
+      public Object get(int index) {
+        return nodes[inSource[inStart[n] + index]];
+      }
+
+      @Override
+      public int size() {
+        return inStart[n + 1] - inStart[n];
+      }
+    };
+  }
+
+  @Override
+  public Collection<CAstNode> getMappedNodes() {
+    return Collections.unmodifiableList(mapped);
+  }
+
+  @Override
+  public String toString() {
+    StringBuffer sb = new StringBuffer("control flow map\n");
+    for (int n = 0; n < nodes.length; n++) {
+      for (int j = outStart[n]; j < outStart[n + 1]; j++) {
+        sb.append(nodes[n]).append(" -- ").append(labels[outLabel[j]]).append(" --> ").append(nodes[outTarget[j]]).append("\n");
+      }
+    }
+    sb.append("\n");
+    return sb.toString();
+  }
+}
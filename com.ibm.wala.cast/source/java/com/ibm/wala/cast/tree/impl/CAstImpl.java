@@ -11,6 +11,7 @@
 package com.ibm.wala.cast.tree.impl;
 
 import java.util.NoSuchElementException;
+import java.util.concurrent.atomic.AtomicInteger;
 
 import com.ibm.wala.cast.tree.CAst;
 import com.ibm.wala.cast.tree.CAstNode;
@@ -27,23 +28,61 @@ import com.ibm.wala.cast.util.CAstPrinter;
 public class CAstImpl implements CAst {
   private int nextID = 0;
 
+  /**
+   * the id of the next node made here; nodes may be made on several threads
+   */
+  private final AtomicInteger nextNodeId = new AtomicInteger();
+
+  /**
+   * whether the fixed-arity makeNode methods may build nodes directly; a
+   * subclass that overrides makeNode(int, CAstNode[]) sees every node
+   * through it, as before
+   */
+  private final boolean fixedNodes = !overrides(getClass(), "makeNode", int.class, CAstNode[].class);
+
+  /**
+   * likewise for the primitive makeConstant methods and makeConstant(Object)
+   */
+  private final boolean packedValues = !overrides(getClass(), "makeConstant", Object.class);
+
+  private static boolean overrides(Class<?> c, String name, Class<?>... parameters) {
+    try {
+      return c.getMethod(name, parameters).getDeclaringClass() != CAstImpl.class;
+    } catch (NoSuchMethodException e) {
+      return true;
+    }
+  }
+
   @Override
   public String makeUnique() {
     return "id" + (nextID++);
   }
 
-  protected static class CAstNodeImpl implements CAstNode {
-    protected final CAstNode[] cs;
+  private <T extends CAstNumberedNodeImpl> T number(T n) {
+    n.id = nextNodeId.getAndIncrement();
+    return n;
+  }
+
+  /**
+   * the id is written only once, by the factory that made the node
+   */
+  protected static abstract class CAstNumberedNodeImpl implements CAstNumberedNode {
+    protected int id = -1;
+
+    @Override
+    public int getNodeId() {
+      return id;
+    }
+  }
 
+  /**
+   * what all nodes with children share, however they hold them
+   */
+  protected static abstract class CAstOperatorNodeImpl extends CAstNumberedNodeImpl {
     protected final int kind;
 
-    protected CAstNodeImpl(int kind, CAstNode[] cs) {
+    protected CAstOperatorNodeImpl(int kind) {
       this.kind = kind;
-      this.cs = cs;
-
-      for (int i = 0; i < cs.length; i++)
-        assert cs[i] != null : "argument " + i + " is null for node kind " + kind + " [" + CAstPrinter.entityKindAsString(kind)
-            + "]";
     }
 
     @Override
@@ -56,18 +95,12 @@ public class CAstImpl implements CAst {
       return null;
     }
 
-    @Override
-    public CAstNode getChild(int n) {
-      try {
-        return cs[n];
-      } catch (ArrayIndexOutOfBoundsException e) {
-        throw new NoSuchElementException(n + " of " + CAstPrinter.print(this));
-      }
+    protected NoSuchElementException noChild(int n) {
+      return new NoSuchElementException(n + " of " + CAstPrinter.print(this));
     }
 
-    @Override
-    public int getChildCount() {
-      return cs.length;
+    protected static void checkChild(CAstNode c, int i, int kind) {
+      assert c != null : "argument " + i + " is null for node kind " + kind + " [" + CAstPrinter.entityKindAsString(kind) + "]";
     }
 
     @Override
@@ -88,9 +121,153 @@ public class CAstImpl implements CAst {
     }
   }
 
+  protected static class CAstNodeImpl extends CAstOperatorNodeImpl {
+    protected final CAstNode[] cs;
+
+    protected CAstNodeImpl(int kind, CAstNode[] cs) {
+      super(kind);
+      this.cs = cs;
+
+      for (int i = 0; i < cs.length; i++)
+        checkChild(cs[i], i, kind);
+    }
+
+    @Override
+    public CAstNode getChild(int n) {
+      try {
+        return cs[n];
+      } catch (ArrayIndexOutOfBoundsException e) {
+        throw noChild(n);
+      }
+    }
+
+    @Override
+    public int getChildCount() {
+      return cs.length;
+    }
+  }
+
+  /*
+   * Nodes with up to three children hold them in fields, which saves the
+   * array, its header and an indirection; most nodes are of this kind.
+   */
+
+  protected static class CAstNode0Impl extends CAstOperatorNodeImpl {
+    protected CAstNode0Impl(int kind) {
+      super(kind);
+    }
+
+    @Override
+    public CAstNode getChild(int n) {
+      throw noChild(n);
+    }
+
+    @Override
+    public int getChildCount() {
+      return 0;
+    }
+  }
+
+  protected static class CAstNode1Impl extends CAstOperatorNodeImpl {
+    protected final CAstNode c1;
+
+    protected CAstNode1Impl(int kind, CAstNode c1) {
+      super(kind);
+      checkChild(c1, 0, kind);
+      this.c1 = c1;
+    }
+
+    @Override
+    public CAstNode getChild(int n) {
+      if (n == 0) {
+        return c1;
+      } else {
+        throw noChild(n);
+      }
+    }
+
+    @Override
+    public int getChildCount() {
+      return 1;
+    }
+  }
+
+  protected static class CAstNode2Impl extends CAstOperatorNodeImpl {
+    protected final CAstNode c1, c2;
+
+    protected CAstNode2Impl(int kind, CAstNode c1, CAstNode c2) {
+      super(kind);
+      checkChild(c1, 0, kind);
+      checkChild(c2, 1, kind);
+      this.c1 = c1;
+      this.c2 = c2;
+    }
+
+    @Override
+    public CAstNode getChild(int n) {
+      switch (n) {
+      case 0:
+        return c1;
+      case 1:
+        return c2;
+      default:
+        throw noChild(n);
+      }
+    }
+
+    @Override
+    public int getChildCount() {
+      return 2;
+    }
+  }
+
+  protected static class CAstNode3Impl extends CAstOperatorNodeImpl {
+    protected final CAstNode c1, c2, c3;
+
+    protected CAstNode3Impl(int kind, CAstNode c1, CAstNode c2, CAstNode c3) {
+      super(kind);
+      checkChild(c1, 0, kind);
+      checkChild(c2, 1, kind);
+      checkChild(c3, 2, kind);
+      this.c1 = c1;
+      this.c2 = c2;
+      this.c3 = c3;
+    }
+
+    @Override
+    public CAstNode getChild(int n) {
+      switch (n) {
+      case 0:
+        return c1;
+      case 1:
+        return c2;
+      case 2:
+        return c3;
+      default:
+        throw noChild(n);
+      }
+    }
+
+    @Override
+    public int getChildCount() {
+      return 3;
+    }
+  }
+
   @Override
   public CAstNode makeNode(final int kind, final CAstNode[] cs) {
-    return new CAstNodeImpl(kind, cs);
+    switch (cs.length) {
+    case 0:
+      return number(new CAstNode0Impl(kind));
+    case 1:
+      return number(new CAstNode1Impl(kind, cs[0]));
+    case 2:
+      return number(new CAstNode2Impl(kind, cs[0], cs[1]));
+    case 3:
+      return number(new CAstNode3Impl(kind, cs[0], cs[1], cs[2]));
+    default:
+      return number(new CAstNodeImpl(kind, cs));
+    }
   }
 
   @Override
@@ -103,22 +280,22 @@ public class CAstImpl implements CAst {
 
   @Override
   public CAstNode makeNode(int kind) {
-    return makeNode(kind, new CAstNode[0]);
+    return fixedNodes ? number(new CAstNode0Impl(kind)) : makeNode(kind, new CAstNode[0]);
   }
 
   @Override
   public CAstNode makeNode(int kind, CAstNode c1) {
-    return makeNode(kind, new CAstNode[] { c1 });
+    return fixedNodes ? number(new CAstNode1Impl(kind, c1)) : makeNode(kind, new CAstNode[] { c1 });
   }
 
   @Override
   public CAstNode makeNode(int kind, CAstNode c1, CAstNode c2) {
-    return makeNode(kind, new CAstNode[] { c1, c2 });
+    return fixedNodes ? number(new CAstNode2Impl(kind, c1, c2)) : makeNode(kind, new CAstNode[] { c1, c2 });
   }
 
   @Override
   public CAstNode makeNode(int kind, CAstNode c1, CAstNode c2, CAstNode c3) {
-    return makeNode(kind, new CAstNode[] { c1, c2, c3 });
+    return fixedNodes ? number(new CAstNode3Impl(kind, c1, c2, c3)) : makeNode(kind, new CAstNode[] { c1, c2, c3 });
   }
 
   @Override
@@ -136,7 +313,7 @@ public class CAstImpl implements CAst {
     return makeNode(kind, new CAstNode[] { c1, c2, c3, c4, c5, c6 });
   }
 
-  protected static class CAstValueImpl implements CAstNode {
+  protected static class CAstValueImpl extends CAstNumberedNodeImpl {
     protected final Object value;
 
     protected CAstValueImpl(Object value) {
@@ -174,9 +351,92 @@ public class CAstImpl implements CAst {
     }
   }
 
+  /**
+   * Numeric constants keep their value unboxed until getValue is first called,
+   * and then keep the box; natively built trees are mostly made of them, and
+   * many are never asked for their value.
+   */
+  protected static abstract class CAstPackedValueImpl extends CAstNumberedNodeImpl {
+    private Object boxed;
+
+    protected abstract Object box();
+
+    @Override
+    public Object getValue() {
+      if (boxed == null) {
+        boxed = box();
+      }
+      return boxed;
+    }
+
+    @Override
+    public int getKind() {
+      return CAstNode.CONSTANT;
+    }
+
+    @Override
+    public CAstNode getChild(int n) {
+      throw new NoSuchElementException();
+    }
+
+    @Override
+    public int getChildCount() {
+      return 0;
+    }
+
+    @Override
+    public String toString() {
+      return "CAstValue: " + getValue();
+    }
+
+    @Override
+    public int hashCode() {
+      return getKind() * toString().hashCode();
+    }
+  }
+
+  protected static class CAstIntValueImpl extends CAstPackedValueImpl {
+    protected final int value;
+
+    protected CAstIntValueImpl(int value) {
+      this.value = value;
+    }
+
+    @Override
+    protected Object box() {
+      return Integer.valueOf(value);
+    }
+  }
+
+  protected static class CAstLongValueImpl extends CAstPackedValueImpl {
+    protected final long value;
+
+    protected CAstLongValueImpl(long value) {
+      this.value = value;
+    }
+
+    @Override
+    protected Object box() {
+      return Long.valueOf(value);
+    }
+  }
+
+  protected static class CAstDoubleValueImpl extends CAstPackedValueImpl {
+    protected final double value;
+
+    protected CAstDoubleValueImpl(double value) {
+      this.value = value;
+    }
+
+    @Override
+    protected Object box() {
+      return Double.valueOf(value);
+    }
+  }
+
   @Override
   public CAstNode makeConstant(final Object value) {
-    return new CAstValueImpl(value);
+    return number(new CAstValueImpl(value));
   }
 
   @Override
@@ -196,12 +456,12 @@ public class CAstImpl implements CAst {
 
   @Override
   public CAstNode makeConstant(int value) {
-    return makeConstant(new Integer(value));
+    return packedValues ? number(new CAstIntValueImpl(value)) : makeConstant(new Integer(value));
   }
 
   @Override
   public CAstNode makeConstant(long value) {
-    return makeConstant(new Long(value));
+    return packedValues ? number(new CAstLongValueImpl(value)) : makeConstant(new Long(value));
   }
 
   @Override
@@ -211,7 +471,7 @@ public class CAstImpl implements CAst {
 
   @Override
   public CAstNode makeConstant(double value) {
-    return makeConstant(new Double(value));
+    return packedValues ? number(new CAstDoubleValueImpl(value)) : makeConstant(new Double(value));
   }
 
 }
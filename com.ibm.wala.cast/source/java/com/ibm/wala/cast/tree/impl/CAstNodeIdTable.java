@@ -0,0 +1,242 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.tree.impl;
+
+import java.util.Iterator;
+import java.util.Map;
+import java.util.NoSuchElementException;
+import java.util.Set;
+
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.util.collections.HashMapFactory;
+
+/**
+ * a map from ast nodes to values for side tables of an entity. Nodes with an
+ * id (see {@link CAstNumberedNode}) are kept in an array covering the window
+ * of ids seen so far, which is contiguous for the nodes a native front end
+ * builds for one entity; other nodes, and ids far outside the window, go to
+ * an ordinary hash map.
+ */
+public class CAstNodeIdTable<T> {
+  private static final int INITIAL_SIZE = 64;
+
+  /**
+   * how much larger than its contents the window may grow
+   */
+  private static final int MAX_SPARSENESS = 8;
+
+  private int base = 0;
+
+  private CAstNode[] keys;
+
+  private Object[] values;
+
+  private int count = 0;
+
+  private final Map<CAstNode, T> others = HashMapFactory.make();
+
+  private static int id(CAstNode n) {
+    return n instanceof CAstNumberedNode ? ((CAstNumberedNode) n).getNodeId() : -1;
+  }
+
+  private int index(CAstNode n) {
+    int id = id(n);
+    if (id < 0 || keys == null) {
+      return -1;
+    }
+    int i = id - base;
+    return i >= 0 && i < keys.length && keys[i] == n ? i : -1;
+  }
+
+  @SuppressWarnings("unchecked")
+  public T get(CAstNode n) {
+    int i = index(n);
+    if (i >= 0) {
+      return (T) values[i];
+    } else if (others.isEmpty()) {
+      return null;
+    } else {
+      return others.get(n);
+    }
+  }
+
+  public boolean containsKey(CAstNode n) {
+    return index(n) >= 0 || others.containsKey(n);
+  }
+
+  public void put(CAstNode n, T value) {
+    int id = id(n);
+    if (id < 0 || !fit(id)) {
+      others.put(n, value);
+      return;
+    }
+
+    int i = id - base;
+    if (keys[i] == null) {
+      // n may have gone to the hash map before the window grew to cover it
+      if (!others.isEmpty()) {
+        others.remove(n);
+      }
+      count++;
+    } else if (keys[i] != n) {
+      // a node of another numbering, which only the hash map can tell apart
+      others.put(n, value);
+      return;
+    }
+    keys[i] = n;
+    values[i] = value;
+  }
+
+  /**
+   * forget the value of n, returning what it was
+   */
+  @SuppressWarnings("unchecked")
+  public T remove(CAstNode n) {
+    int i = index(n);
+    if (i >= 0) {
+      T value = (T) values[i];
+      keys[i] = null;
+      values[i] = null;
+      count--;
+      return value;
+    } else if (others.isEmpty()) {
+      return null;
+    } else {
+      return others.remove(n);
+    }
+  }
+
+  /**
+   * make the window cover id, unless it would become too sparse
+   */
+  private boolean fit(int id) {
+    if (keys == null) {
+      base = id;
+      keys = new CAstNode[INITIAL_SIZE];
+      values = new Object[INITIAL_SIZE];
+      return true;
+    }
+
+    int first = Math.min(base, id);
+    int last = Math.max(base + keys.length, id + 1);
+    if (first == base && last == base + keys.length) {
+      return true;
+    }
+    if (last - first > MAX_SPARSENESS * (count + INITIAL_SIZE)) {
+      return false;
+    }
+
+    int size = Math.max(last - first, 2 * keys.length);
+    if (id < base) {
+      // leave room below as well, for nodes built before those seen so far
+      first = Math.max(0, last - size);
+    }
+    CAstNode[] newKeys = new CAstNode[size];
+    Object[] newValues = new Object[size];
+    System.arraycopy(keys, 0, newKeys, base - first, keys.length);
+    System.arraycopy(values, 0, newValues, base - first, values.length);
+    keys = newKeys;
+    values = newValues;
+    base = first;
+    return true;
+  }
+
+  /**
+   * forget the values of all nodes not in live
+   */
+  public void retainNodes(Set<CAstNode> live) {
+    if (keys != null) {
+      for (int i = 0; i < keys.length; i++) {
+        if (keys[i] != null && !live.contains(keys[i])) {
+          keys[i] = null;
+          values[i] = null;
+          count--;
+        }
+      }
+    }
+    others.keySet().retainAll(live);
+  }
+
+  public int size() {
+    return count + others.size();
+  }
+
+  /**
+   * the mapped nodes, those with ids in id order first; removing one
+   * through the iterator forgets its value
+   */
+  public Iterator<CAstNode> nodes() {
+    final Iterator<CAstNode> rest = others.keySet().iterator();
+    return new Iterator<CAstNode>() {
+      private int next = advance(0);
+
+      private int last = -1;
+
+      private boolean lastInRest = false;
+
+      private int advance(int i) {
+        while (keys != null && i < keys.length && keys[i] == null) {
+          i++;
+        }
+        return i;
+      }
+
+      @Override
+      public boolean hasNext() {
+        return (keys != null && next < keys.length) || rest.hasNext();
+      }
+
+      @Override
+      public CAstNode next() {
+        if (keys != null && next < keys.length) {
+          last = next;
+          CAstNode n = keys[next];
+          next = advance(next + 1);
+          return n;
+        } else if (rest.hasNext()) {
+          last = -1;
+          lastInRest = true;
+          return rest.next();
+        } else {
+          throw new NoSuchElementException();
+        }
+      }
+
+      @Override
+      public void remove() {
+        if (lastInRest) {
+          rest.remove();
+          lastInRest = false;
+        } else if (last >= 0 && keys[last] != null) {
+          keys[last] = null;
+          values[last] = null;
+          count--;
+          last = -1;
+        } else {
+          throw new IllegalStateException();
+        }
+      }
+    };
+  }
+
+  @Override
+  public String toString() {
+    StringBuffer sb = new StringBuffer("{");
+    for (Iterator<CAstNode> ns = nodes(); ns.hasNext();) {
+      CAstNode n = ns.next();
+      sb.append(n).append("=").append(get(n));
+      if (ns.hasNext()) {
+        sb.append(", ");
+      }
+    }
+    return sb.append("}").toString();
+  }
+}
@@ -13,26 +13,49 @@
  */
 package com.ibm.wala.cast.tree.impl;
 
+import java.util.AbstractMap;
+import java.util.AbstractSet;
 import java.util.Collection;
-import java.util.HashMap;
+import java.util.Iterator;
+import java.util.Map;
+import java.util.Set;
 
 import com.ibm.wala.cast.tree.CAstNode;
 import com.ibm.wala.cast.tree.CAstNodeTypeMap;
 import com.ibm.wala.cast.tree.CAstType;
 
-public class CAstNodeTypeMapRecorder 
-    extends HashMap <CAstNode,CAstType>
-    implements CAstNodeTypeMap
-{
-  private static final long serialVersionUID= 7812144102027916961L;
+/**
+ * Types of nodes as recorded by {@link #add}.  They are kept in a
+ * {@link CAstNodeIdTable}, which holds those of numbered nodes (see
+ * {@link CAstNumberedNode}) in an array and those of other nodes in a hash
+ * map.  The recorder is also a {@link Map} from nodes to types, as it was
+ * when it extended HashMap, and the map reads and writes the same table.
+ */
+public class CAstNodeTypeMapRecorder extends AbstractMap<CAstNode, CAstType> implements CAstNodeTypeMap {
+
+  private final CAstNodeIdTable<CAstType> types = new CAstNodeIdTable<>();
+
+  private Set<Map.Entry<CAstNode, CAstType>> entries;
 
   @Override
   public CAstType getNodeType(CAstNode node) {
-    return get(node);
+    return types.get(node);
   }
 
   public void add(CAstNode node, CAstType type) {
-    put(node, type);
+    types.put(node, type);
+  }
+
+  /**
+   * forget the types of all nodes not in live
+   */
+  public void retainNodes(Set<CAstNode> live) {
+    types.retainNodes(live);
+  }
+
+  @Override
+  public int size() {
+    return types.size();
   }
 
   @Override
@@ -42,7 +65,77 @@ public class CAstNodeTypeMapRecorder
 
   public void addAll(CAstNodeTypeMap other) {
     for(CAstNode o : other.getMappedNodes()) {
-      put(o, other.getNodeType(o));
+      add(o, other.getNodeType(o));
     }
   }
+
+  @Override
+  public CAstType get(Object key) {
+    return key instanceof CAstNode ? types.get((CAstNode) key) : null;
+  }
+
+  @Override
+  public boolean containsKey(Object key) {
+    return key instanceof CAstNode && types.containsKey((CAstNode) key);
+  }
+
+  @Override
+  public CAstType put(CAstNode key, CAstType value) {
+    CAstType old = types.get(key);
+    types.put(key, value);
+    return old;
+  }
+
+  @Override
+  public CAstType remove(Object key) {
+    return key instanceof CAstNode ? types.remove((CAstNode) key) : null;
+  }
+
+  @Override
+  public Set<Map.Entry<CAstNode, CAstType>> entrySet() {
+    if (entries == null) {
+      entries = new AbstractSet<Map.Entry<CAstNode, CAstType>>() {
+        @Override
+        public Iterator<Map.Entry<CAstNode, CAstType>> iterator() {
+          final Iterator<CAstNode> nodes = types.nodes();
+          return new Iterator<Map.Entry<CAstNode, CAstType>>() {
+            @Override
+            public boolean hasNext() {
+              return nodes.hasNext();
+            }
+
+            @Override
+            public Map.Entry<CAstNode, CAstType> next() {
+              final CAstNode node = nodes.next();
+              return new SimpleEntry<CAstNode, CAstType>(node, types.get(node)) {
+                private static final long serialVersionUID = 3154802436815239548L;
+
+                @Override
+                public CAstType setValue(CAstType value) {
+                  types.put(node, value);
+                  return super.setValue(value);
+                }
+              };
+            }
+
+            @Override
+            public void remove() {
+              nodes.remove();
+            }
+          };
+        }
+
+        @Override
+        public int size() {
+          return types.size();
+        }
+      };
+    }
+    return entries;
+  }
+
+  @Override
+  public String toString() {
+    return types.toString();
+  }
 }
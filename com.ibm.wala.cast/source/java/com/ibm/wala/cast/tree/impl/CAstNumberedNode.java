@@ -0,0 +1,28 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.tree.impl;
+
+import com.ibm.wala.cast.tree.CAstNode;
+
+/**
+ * an ast node that may carry a dense id, unique among the nodes of one
+ * {@link CAstImpl}, which numbers every node it makes; nodes made by other
+ * factories have no id. Side tables such as {@link CAstNodeIdTable} use
+ * the id as an array index in place of identity hashing.
+ */
+public interface CAstNumberedNode extends CAstNode {
+
+  /**
+   * the id of this node, or -1 if it has none
+   */
+  int getNodeId();
+
+}
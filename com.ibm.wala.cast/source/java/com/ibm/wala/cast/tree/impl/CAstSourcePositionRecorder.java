@@ -15,17 +15,16 @@ import java.io.InputStreamReader;
 import java.io.Reader;
 import java.net.MalformedURLException;
 import java.net.URL;
-import java.util.HashMap;
 import java.util.Iterator;
+import java.util.Set;
 
 import com.ibm.wala.cast.tree.CAstNode;
 import com.ibm.wala.cast.tree.CAstSourcePositionMap;
-import com.ibm.wala.util.collections.HashMapFactory;
 import com.ibm.wala.util.collections.Iterator2Iterable;
 
 public class CAstSourcePositionRecorder implements CAstSourcePositionMap {
  
-  private final HashMap<CAstNode, Position> positions = HashMapFactory.make();
+  private final CAstNodeIdTable<Position> positions = new CAstNodeIdTable<>();
 
   @Override
   public Position getPosition(CAstNode n) {
@@ -34,13 +33,20 @@ public class CAstSourcePositionRecorder implements CAstSourcePositionMap {
 
   @Override
   public Iterator<CAstNode> getMappedNodes() {
-    return positions.keySet().iterator();
+    return positions.nodes();
   }
 
   public void setPosition(CAstNode n, Position p) {
     positions.put(n, p);
   }
 
+  /**
+   * forget the positions of all nodes not in live
+   */
+  public void retainNodes(Set<CAstNode> live) {
+    positions.retainNodes(live);
+  }
+
   public void setPosition(CAstNode n, 
 			  final int fl, 
 			  final int fc, 
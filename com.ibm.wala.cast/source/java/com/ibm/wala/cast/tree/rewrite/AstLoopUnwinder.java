@@ -28,7 +28,7 @@ public class AstLoopUnwinder
     private int iteration;
     private UnwindKey rest;
 			  
-    private UnwindKey(int iteration, UnwindKey rest) {
+    UnwindKey(int iteration, UnwindKey rest) {
       this.rest = rest;
       this.iteration = iteration;
     }
@@ -58,7 +58,7 @@ public class AstLoopUnwinder
 
   // private static final boolean DEBUG = false;
 
-  private final int unwindFactor;
+  protected final int unwindFactor;
 	
   public AstLoopUnwinder(CAst Ast, boolean recursive) {
     this(Ast, recursive, 3);
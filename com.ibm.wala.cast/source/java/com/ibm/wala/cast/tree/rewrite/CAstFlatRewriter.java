@@ -0,0 +1,274 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.tree.rewrite;
+
+import java.util.Collection;
+import java.util.IdentityHashMap;
+import java.util.LinkedHashMap;
+import java.util.LinkedHashSet;
+import java.util.Map;
+import java.util.Map.Entry;
+import java.util.Set;
+
+import com.ibm.wala.cast.tree.CAst;
+import com.ibm.wala.cast.tree.CAstControlFlowMap;
+import com.ibm.wala.cast.tree.CAstEntity;
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.CAstNodeTypeMap;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap.Position;
+import com.ibm.wala.cast.tree.CAstType;
+import com.ibm.wala.cast.tree.impl.CAstControlFlowRecorder;
+import com.ibm.wala.cast.tree.impl.CAstNodeTypeMapRecorder;
+import com.ibm.wala.cast.tree.impl.CAstSourcePositionRecorder;
+import com.ibm.wala.cast.util.CAstFlatTree;
+import com.ibm.wala.util.collections.Pair;
+
+/**
+ * A rewriter whose tree walk runs natively, over a {@link CAstFlatTree}, and
+ * copies on write: {@link #rewrite(CAstNode, CAstNode[])} is called only for
+ * nodes of the kinds given to the constructor, and a node is copied only if
+ * one of its children was replaced.  Everything else is shared with the
+ * original tree, and so are the control-flow, position and type maps for it;
+ * the node map given to {@link #copyNodes} holds only the nodes that were
+ * replaced.
+ *
+ * New nodes are added to the flat tree, so rewriters that share a
+ * {@link Chain} each flatten only what the previous one made.
+ *
+ * The native library must have been loaded by whoever uses this, as for
+ * {@link com.ibm.wala.cast.util.NativeCAstPattern}.
+ */
+public abstract class CAstFlatRewriter extends CAstBasicRewriter {
+
+  /**
+   * the flat trees that rewritten roots live in, for rewriters applied one
+   * after the other
+   */
+  public static class Chain {
+    private final Map<CAstNode, CAstFlatTree> trees = new IdentityHashMap<>();
+
+    CAstFlatTree tree(CAstNode root) {
+      CAstFlatTree t = trees.get(root);
+      if (t == null) {
+        t = new CAstFlatTree(root);
+        trees.put(root, t);
+      }
+      return t;
+    }
+
+    void rewritten(CAstNode oldRoot, CAstNode newRoot, CAstFlatTree t) {
+      trees.remove(oldRoot);
+      trees.put(newRoot, t);
+    }
+  }
+
+  private final byte[] registered;
+
+  private final Chain chain;
+
+  private CAstFlatTree tree;
+
+  private Map<Pair<CAstNode, NoKey>, CAstNode> nodeMap;
+
+  /**
+   * @param chain the flat trees to share with other rewriters, or null
+   * @param kinds the node kinds to call {@link #rewrite(CAstNode, CAstNode[])}
+   *          for
+   */
+  protected CAstFlatRewriter(CAst Ast, boolean recursive, Chain chain, int... kinds) {
+    super(Ast, recursive);
+    this.chain = chain;
+    int max = -1;
+    for (int kind : kinds) {
+      max = Math.max(max, kind);
+    }
+    this.registered = new byte[max + 1];
+    for (int kind : kinds) {
+      if (kind >= 0) {
+        registered[kind] = 1;
+      }
+    }
+  }
+
+  /**
+   * the node to use in place of node, or null to keep it, copied if any of
+   * its children were replaced
+   *
+   * @param children the children of node in the new tree, which are
+   *          node's own children where nothing changed
+   */
+  protected abstract CAstNode rewrite(CAstNode node, CAstNode[] children);
+
+  /**
+   * rewrite the tree in t from root, adding new nodes to t and recording
+   * each replaced node in nodeMap; returns the id of the new root
+   */
+  public int rewrite(CAstFlatTree t, int root, Map<Pair<CAstNode, NoKey>, CAstNode> nodeMap) {
+    assert tree == null : "rewrites do not nest";
+    this.tree = t;
+    this.nodeMap = nodeMap;
+    try {
+      return rewrite(registered, t, root);
+    } finally {
+      this.tree = null;
+      this.nodeMap = null;
+    }
+  }
+
+  /**
+   * called from native code; children is only valid during the call
+   */
+  private int rebuild(int node, int[] children) {
+    CAstNode old = tree.getNode(node);
+    CAstNode[] cs = new CAstNode[children.length];
+    boolean changed = false;
+    for (int i = 0; i < children.length; i++) {
+      cs[i] = tree.getNode(children[i]);
+      changed |= cs[i] != old.getChild(i);
+    }
+
+    CAstNode result = old.getKind() < registered.length && registered[old.getKind()] != 0 ? rewrite(old, cs) : null;
+    if (result == null) {
+      if (!changed) {
+        return node;
+      }
+      result = Ast.makeNode(old.getKind(), cs);
+    } else if (result == old) {
+      return node;
+    }
+
+    nodeMap.put(Pair.make(old, (NoKey) null), result);
+    return tree.add(result);
+  }
+
+  private native int rewrite(byte[] registered, CAstFlatTree t, int root);
+
+  @Override
+  protected CAstNode copyNodes(CAstNode root, CAstControlFlowMap cfg, NonCopyingContext context,
+      Map<Pair<CAstNode, NoKey>, CAstNode> nodeMap) {
+    CAstFlatTree t = chain == null ? new CAstFlatTree(root) : chain.tree(root);
+    CAstNode newRoot = t.getNode(rewrite(t, t.find(root), nodeMap));
+    if (chain != null) {
+      chain.rewritten(root, newRoot, t);
+    }
+    return newRoot;
+  }
+
+  private static Map<CAstNode, CAstNode> replacements(Map<Pair<CAstNode, NoKey>, CAstNode> nodeMap) {
+    Map<CAstNode, CAstNode> result = new IdentityHashMap<>();
+    for (Entry<Pair<CAstNode, NoKey>, CAstNode> entry : nodeMap.entrySet()) {
+      result.put(entry.getKey().fst, entry.getValue());
+    }
+    return result;
+  }
+
+  private static <T> T replace(Map<CAstNode, CAstNode> replacements, T n) {
+    @SuppressWarnings("unchecked")
+    T r = (T) replacements.get(n);
+    return r == null ? n : r;
+  }
+
+  /**
+   * the original edges, with replaced nodes swapped for their replacements
+   */
+  @Override
+  protected CAstControlFlowMap copyFlow(Map<Pair<CAstNode, NoKey>, CAstNode> nodeMap, CAstControlFlowMap orig,
+      CAstSourcePositionMap newSrc) {
+    if (nodeMap.isEmpty() || orig == null) {
+      return orig;
+    }
+
+    Map<CAstNode, CAstNode> replacements = replacements(nodeMap);
+    CAstControlFlowRecorder newMap = new CAstControlFlowRecorder(newSrc);
+    for (CAstNode n : orig.getMappedNodes()) {
+      CAstNode newNode = replace(replacements, n);
+      if (!newMap.isMapped(newNode)) {
+        newMap.map(newNode, newNode);
+      }
+    }
+    for (CAstNode n : orig.getMappedNodes()) {
+      for (Object label : orig.getTargetLabels(n)) {
+        CAstNode target = replace(replacements, orig.getTarget(n, label));
+        if (!newMap.isMapped(target)) {
+          newMap.map(target, target);
+        }
+        newMap.add(replace(replacements, n), target, replace(replacements, label));
+      }
+    }
+    return newMap;
+  }
+
+  /**
+   * the original positions, with those of replaced nodes given to their
+   * replacements
+   */
+  @Override
+  protected CAstSourcePositionMap copySource(Map<Pair<CAstNode, NoKey>, CAstNode> nodeMap, CAstSourcePositionMap orig) {
+    if (nodeMap.isEmpty() || orig == null) {
+      return orig;
+    }
+
+    Map<CAstNode, CAstNode> replacements = replacements(nodeMap);
+    CAstSourcePositionRecorder moved = new CAstSourcePositionRecorder();
+    for (Entry<CAstNode, CAstNode> entry : replacements.entrySet()) {
+      Position p = orig.getPosition(entry.getKey());
+      if (p != null && moved.getPosition(entry.getValue()) == null) {
+        moved.setPosition(entry.getValue(), p);
+      }
+    }
+
+    return SharedNodeMaps.positions(moved, orig, replacements);
+  }
+
+  /**
+   * the original types, with those of replaced nodes given to their
+   * replacements
+   */
+  @Override
+  protected CAstNodeTypeMap copyTypes(Map<Pair<CAstNode, NoKey>, CAstNode> nodeMap, CAstNodeTypeMap orig) {
+    if (nodeMap.isEmpty() || orig == null) {
+      return orig;
+    }
+
+    Map<CAstNode, CAstNode> replacements = replacements(nodeMap);
+    CAstNodeTypeMapRecorder moved = new CAstNodeTypeMapRecorder();
+    for (Entry<CAstNode, CAstNode> entry : replacements.entrySet()) {
+      CAstType type = orig.getNodeType(entry.getKey());
+      if (type != null && moved.getNodeType(entry.getValue()) == null) {
+        moved.add(entry.getValue(), type);
+      }
+    }
+
+    return SharedNodeMaps.types(moved, orig, replacements);
+  }
+
+  /**
+   * the original scoped entities, rewritten, under the replacements of their
+   * constructs; since unchanged parts of the tree are not walked, entities
+   * of constructs that a rewrite drops are kept too
+   */
+  @Override
+  protected Map<CAstNode, Collection<CAstEntity>> copyChildren(CAstNode root, Map<Pair<CAstNode, NoKey>, CAstNode> nodeMap,
+      Map<CAstNode, Collection<CAstEntity>> children) {
+    Map<CAstNode, CAstNode> replacements = replacements(nodeMap);
+    Map<CAstNode, Collection<CAstEntity>> newChildren = new LinkedHashMap<>();
+    for (Entry<CAstNode, Collection<CAstEntity>> entry : children.entrySet()) {
+      CAstNode key = entry.getKey() == null ? null : replace(replacements, entry.getKey());
+      Set<CAstEntity> newEntities = new LinkedHashSet<>();
+      newChildren.put(key, newEntities);
+      for (CAstEntity entity : entry.getValue()) {
+        newEntities.add(rewrite(entity));
+      }
+    }
+    return newChildren;
+  }
+}
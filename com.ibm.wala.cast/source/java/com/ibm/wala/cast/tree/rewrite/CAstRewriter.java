@@ -21,6 +21,7 @@ import java.util.Set;
 
 import com.ibm.wala.cast.tree.CAst;
 import com.ibm.wala.cast.tree.CAstControlFlowMap;
+import com.ibm.wala.cast.tree.CAstDeferredBodyEntity;
 import com.ibm.wala.cast.tree.CAstEntity;
 import com.ibm.wala.cast.tree.CAstNode;
 import com.ibm.wala.cast.tree.CAstNodeTypeMap;
@@ -390,56 +391,96 @@ public abstract class CAstRewriter<C extends CAstRewriter.RewriteContext<K>, K e
   }
 
   /**
-   * perform the rewrite on a {@link CAstEntity}, returning the new
-   * {@link CAstEntity} as the result
+   * the rewrite of an entity with a body, done when first asked for if the
+   * body itself is yet to be built
    */
-  public CAstEntity rewrite(final CAstEntity root) {
+  private class RewrittenEntity extends DelegatingEntity implements CAstDeferredBodyEntity {
+    private final CAstEntity root;
 
-    if (root.getAST() != null) {
-      final Rewrite rewrite = rewrite(root.getAST(), root.getControlFlow(), root.getSourceMap(), root.getNodeTypeMap(),
-          root.getAllScopedEntities());
+    private Rewrite rewrite;
 
-      return new DelegatingEntity(root) {
-        @Override
-        public String toString() {
-          return root.toString() + " (clone)";
-        }
+    private boolean done;
 
-        @Override
-        public Iterator<CAstEntity> getScopedEntities(CAstNode construct) {
-          Map<CAstNode, Collection<CAstEntity>> newChildren = getAllScopedEntities();
-          if (newChildren.containsKey(construct)) {
-            return newChildren.get(construct).iterator();
-          } else {
-            return EmptyIterator.instance();
-          }
-        }
+    private RewrittenEntity(CAstEntity root) {
+      super(root);
+      this.root = root;
+    }
 
-        @Override
-        public Map<CAstNode, Collection<CAstEntity>> getAllScopedEntities() {
-          return rewrite.newChildren();
+    /**
+     * the rewrite of the body, or null if there turned out to be none
+     */
+    private synchronized Rewrite rewrite() {
+      if (!done) {
+        if (root.getAST() != null) {
+          rewrite = CAstRewriter.this.rewrite(root.getAST(), root.getControlFlow(), root.getSourceMap(), root.getNodeTypeMap(),
+              root.getAllScopedEntities());
         }
+        done = true;
+      }
+      return rewrite;
+    }
 
-        @Override
-        public CAstNode getAST() {
-          return rewrite.newRoot();
-        }
+    @Override
+    public synchronized boolean hasDeferredBody() {
+      return !done;
+    }
 
-        @Override
-        public CAstNodeTypeMap getNodeTypeMap() {
-          return rewrite.newTypes();
-        }
+    @Override
+    public String toString() {
+      return root.toString() + " (clone)";
+    }
 
-        @Override
-        public CAstSourcePositionMap getSourceMap() {
-          return rewrite.newPos();
-        }
+    @Override
+    public Iterator<CAstEntity> getScopedEntities(CAstNode construct) {
+      Map<CAstNode, Collection<CAstEntity>> newChildren = getAllScopedEntities();
+      if (newChildren.containsKey(construct)) {
+        return newChildren.get(construct).iterator();
+      } else {
+        return EmptyIterator.instance();
+      }
+    }
 
-        @Override
-        public CAstControlFlowMap getControlFlow() {
-          return rewrite.newCfg();
-        }
-      };
+    @Override
+    public Map<CAstNode, Collection<CAstEntity>> getAllScopedEntities() {
+      return rewrite() == null ? super.getAllScopedEntities() : rewrite().newChildren();
+    }
+
+    @Override
+    public CAstNode getAST() {
+      return rewrite() == null ? null : rewrite().newRoot();
+    }
+
+    @Override
+    public CAstNodeTypeMap getNodeTypeMap() {
+      return rewrite() == null ? super.getNodeTypeMap() : rewrite().newTypes();
+    }
+
+    @Override
+    public CAstSourcePositionMap getSourceMap() {
+      return rewrite() == null ? super.getSourceMap() : rewrite().newPos();
+    }
+
+    @Override
+    public CAstControlFlowMap getControlFlow() {
+      return rewrite() == null ? super.getControlFlow() : rewrite().newCfg();
+    }
+  }
+
+  /**
+   * perform the rewrite on a {@link CAstEntity}, returning the new
+   * {@link CAstEntity} as the result. The body of an entity that a native
+   * front end has put off building is not built by this, but only once
+   * something asks the new entity for its AST.
+   */
+  public CAstEntity rewrite(final CAstEntity root) {
+
+    if (root instanceof CAstDeferredBodyEntity && ((CAstDeferredBodyEntity) root).hasDeferredBody()) {
+      return new RewrittenEntity(root);
+
+    } else if (root.getAST() != null) {
+      RewrittenEntity rewritten = new RewrittenEntity(root);
+      rewritten.rewrite();
+      return rewritten;
 
     } else if (recursive) {
 
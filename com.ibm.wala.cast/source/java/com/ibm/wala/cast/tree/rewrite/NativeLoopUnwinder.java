@@ -0,0 +1,183 @@
+/*******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *******************************************************************************/
+package com.ibm.wala.cast.tree.rewrite;
+
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.IdentityHashMap;
+import java.util.List;
+import java.util.Map;
+
+import com.ibm.wala.cast.tree.CAst;
+import com.ibm.wala.cast.tree.CAstControlFlowMap;
+import com.ibm.wala.cast.tree.CAstEntity;
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.CAstNodeTypeMap;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap;
+import com.ibm.wala.cast.tree.impl.CAstOperator;
+import com.ibm.wala.cast.util.CAstFlatTree;
+import com.ibm.wala.util.collections.Pair;
+
+/**
+ * An {@link AstLoopUnwinder} that plans the unwinding natively, over a
+ * {@link CAstFlatTree} (see CAstLoopUnwinder.h), and then makes the new tree
+ * in one pass over the plan.  The result prints the same as that of
+ * AstLoopUnwinder, and has the same control flow.  Everything in a loop is
+ * copied once per iteration, with each copy in the node map; outside loops,
+ * only the parts of the tree that hold a loop, or a node that the
+ * control-flow map or a scoped entity refers to, are copied, and the rest is
+ * kept as it is.
+ *
+ * The native library must have been loaded by whoever uses this, as for
+ * {@link com.ibm.wala.cast.util.NativeCAstPattern}.
+ */
+public class NativeLoopUnwinder extends AstLoopUnwinder {
+
+  private static final int COPY = 0;
+
+  private static final int ASSERT_NOT = 1;
+
+  private static final int ITERATION = 2;
+
+  private Map<CAstNode, Collection<CAstEntity>> scopedEntities;
+
+  public NativeLoopUnwinder(CAst Ast, boolean recursive) {
+    super(Ast, recursive);
+  }
+
+  public NativeLoopUnwinder(CAst Ast, boolean recursive, int unwindFactor) {
+    super(Ast, recursive, unwindFactor);
+  }
+
+  @Override
+  public Rewrite rewrite(CAstNode root, CAstControlFlowMap cfg, CAstSourcePositionMap pos, CAstNodeTypeMap types,
+      Map<CAstNode, Collection<CAstEntity>> children) {
+    Map<CAstNode, Collection<CAstEntity>> outer = scopedEntities;
+    scopedEntities = children;
+    try {
+      return super.rewrite(root, cfg, pos, types, children);
+    } finally {
+      scopedEntities = outer;
+    }
+  }
+
+  private static void pin(CAstFlatTree t, byte[] pinned, CAstNode n) {
+    int id = t.find(n);
+    if (id >= 0) {
+      pinned[id] = 1;
+    }
+  }
+
+  private static CAstNode node(CAstFlatTree t, List<CAstNode> made, int ref) {
+    return ref < 0 ? made.get(~ref) : t.getNode(ref);
+  }
+
+  @Override
+  protected CAstNode copyNodes(CAstNode n, CAstControlFlowMap cfg, RewriteContext<UnwindKey> c,
+      Map<Pair<CAstNode, UnwindKey>, CAstNode> nodeMap) {
+    CAstFlatTree t = new CAstFlatTree(n);
+    byte[] pinned = new byte[t.getNodeCount()];
+    if (cfg != null) {
+      for (CAstNode m : cfg.getMappedNodes()) {
+        pin(t, pinned, m);
+      }
+    }
+    if (scopedEntities != null) {
+      for (CAstNode m : scopedEntities.keySet()) {
+        if (m != null) {
+          pin(t, pinned, m);
+        }
+      }
+    }
+
+    int[] plan = unwind(t, pinned, t.find(n), CAstNode.LOOP, unwindFactor);
+
+    int i = 1;
+    UnwindKey[] keys = new UnwindKey[plan[i++]];
+    for (int k = 0; k < keys.length; k++, i += 2) {
+      keys[k] = new UnwindKey(plan[i], plan[i + 1] < 0 ? c.key() : keys[plan[i + 1]]);
+    }
+
+    List<CAstNode> made = new ArrayList<>();
+    while (i < plan.length) {
+      switch (plan[i++]) {
+      case COPY: {
+        CAstNode origin = t.getNode(plan[i++]);
+        UnwindKey key = plan[i] < 0 ? c.key() : keys[plan[i]];
+        i++;
+        CAstNode[] cs = new CAstNode[plan[i++]];
+        for (int j = 0; j < cs.length; j++) {
+          cs[j] = node(t, made, plan[i++]);
+        }
+
+        if (origin instanceof CAstOperator) {
+          made.add(origin);
+        } else if (origin.getValue() != null) {
+          made.add(Ast.makeConstant(origin.getValue()));
+        } else {
+          CAstNode copy = Ast.makeNode(origin.getKind(), cs);
+          nodeMap.put(Pair.make(origin, key), copy);
+          made.add(copy);
+        }
+        break;
+      }
+
+      case ASSERT_NOT:
+        made.add(Ast.makeNode(CAstNode.ASSERT,
+            Ast.makeNode(CAstNode.UNARY_EXPR, CAstOperator.OP_NOT, node(t, made, plan[i++])),
+            Ast.makeConstant(false)));
+        break;
+
+      case ITERATION: {
+        CAstNode test = node(t, made, plan[i++]);
+        CAstNode body = node(t, made, plan[i++]);
+        CAstNode rest = node(t, made, plan[i++]);
+        made.add(Ast.makeNode(CAstNode.IF_STMT, test, Ast.makeNode(CAstNode.BLOCK_STMT, body, rest)));
+        break;
+      }
+
+      default:
+        assert false : "bad unwinding plan at " + (i - 1);
+      }
+    }
+
+    return node(t, made, plan[0]);
+  }
+
+  private static Map<CAstNode, Object> copiedNodes(Map<Pair<CAstNode, UnwindKey>, CAstNode> nodeMap) {
+    Map<CAstNode, Object> copied = new IdentityHashMap<>();
+    for (Pair<CAstNode, UnwindKey> key : nodeMap.keySet()) {
+      copied.put(key.fst, key.fst);
+    }
+    return copied;
+  }
+
+  /**
+   * the positions of the copies, and the original ones of shared nodes
+   */
+  @Override
+  protected CAstSourcePositionMap copySource(Map<Pair<CAstNode, UnwindKey>, CAstNode> nodeMap, CAstSourcePositionMap orig) {
+    return SharedNodeMaps.positions(super.copySource(nodeMap, orig), orig, copiedNodes(nodeMap));
+  }
+
+  /**
+   * the types of the copies, and the original ones of shared nodes
+   */
+  @Override
+  protected CAstNodeTypeMap copyTypes(Map<Pair<CAstNode, UnwindKey>, CAstNode> nodeMap, CAstNodeTypeMap orig) {
+    if (orig == null) {
+      return null;
+    }
+    return SharedNodeMaps.types(super.copyTypes(nodeMap, orig), orig, copiedNodes(nodeMap));
+  }
+
+  private static native int[] unwind(CAstFlatTree t, byte[] pinned, int root, int loopKind, int unwindFactor);
+}
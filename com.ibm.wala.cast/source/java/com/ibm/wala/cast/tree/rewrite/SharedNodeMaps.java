@@ -0,0 +1,74 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.tree.rewrite;
+
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.Iterator;
+import java.util.List;
+import java.util.Map;
+
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.CAstNodeTypeMap;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap;
+import com.ibm.wala.cast.tree.CAstType;
+import com.ibm.wala.util.collections.CompoundIterator;
+import com.ibm.wala.util.collections.FilterIterator;
+
+/**
+ * position and type maps for rewrites that share the parts of the tree they
+ * do not change: the entries of the new nodes come first, and the original
+ * map answers for shared nodes.  Original nodes that were replaced are left
+ * out of the mapped nodes.
+ */
+final class SharedNodeMaps {
+
+  private SharedNodeMaps() {
+  }
+
+  static CAstSourcePositionMap positions(final CAstSourcePositionMap copies, final CAstSourcePositionMap orig,
+      final Map<CAstNode, ?> replaced) {
+    return new CAstSourcePositionMap() {
+      @Override
+      public Position getPosition(CAstNode n) {
+        Position p = copies.getPosition(n);
+        return p != null ? p : orig.getPosition(n);
+      }
+
+      @Override
+      public Iterator<CAstNode> getMappedNodes() {
+        return new CompoundIterator<>(copies.getMappedNodes(),
+            new FilterIterator<>(orig.getMappedNodes(), n -> !replaced.containsKey(n)));
+      }
+    };
+  }
+
+  static CAstNodeTypeMap types(final CAstNodeTypeMap copies, final CAstNodeTypeMap orig, final Map<CAstNode, ?> replaced) {
+    return new CAstNodeTypeMap() {
+      @Override
+      public CAstType getNodeType(CAstNode node) {
+        CAstType type = copies.getNodeType(node);
+        return type != null ? type : orig.getNodeType(node);
+      }
+
+      @Override
+      public Collection<CAstNode> getMappedNodes() {
+        List<CAstNode> nodes = new ArrayList<>(copies.getMappedNodes());
+        for (CAstNode n : orig.getMappedNodes()) {
+          if (!replaced.containsKey(n)) {
+            nodes.add(n);
+          }
+        }
+        return nodes;
+      }
+    };
+  }
+}
@@ -0,0 +1,240 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.util;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.IntBuffer;
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.IdentityHashMap;
+import java.util.List;
+import java.util.Map;
+
+import com.ibm.wala.cast.tree.CAstEntity;
+import com.ibm.wala.cast.tree.CAstNode;
+import com.ibm.wala.cast.tree.CAstSourcePositionMap;
+import com.ibm.wala.cast.tree.visit.CAstVisitor;
+import com.ibm.wala.cast.tree.visit.CAstVisitor.Context;
+import com.ibm.wala.util.collections.HashMapFactory;
+
+/**
+ * a CAst tree flattened into int arrays, for running many {@link CAstPattern}s
+ * over the same code natively. Nodes are numbered densely; the children of
+ * node n are children[childStart[n]] up to children[childStart[n+1]], and
+ * each constant has the id of its distinct value, or -1. Shared subtrees are
+ * numbered once.
+ *
+ * The roots are the nodes that {@link CAstPattern#findAll(CAstPattern, CAstEntity)}
+ * would try to match, in visiting order.  The arrays may be longer than the
+ * tree, which can grow through {@link #add}.
+ *
+ * The arrays are direct buffers in native order, so the native matcher and
+ * rewriters read them in place, however often they run over the same tree,
+ * and their memory goes with the tree.  Native code finds them through the
+ * fields of this class (see CAstFlatTree.h); a buffer that growth replaces
+ * stays alive for a native caller that is still reading it through its
+ * local reference.
+ */
+public class CAstFlatTree {
+  private final List<CAstNode> nodes = new ArrayList<>();
+
+  private final Map<CAstNode, Integer> ids = new IdentityHashMap<>();
+
+  private final Map<String, Integer> valueIds = HashMapFactory.make();
+
+  private final List<String> values = new ArrayList<>();
+
+  private final IntBuffer roots;
+
+  private IntBuffer kinds = allocate(0);
+
+  private IntBuffer childStart = allocate(1);
+
+  private IntBuffer children = allocate(0);
+
+  private IntBuffer constants = allocate(0);
+
+  private int childCount = 0;
+
+  /**
+   * the AST of e, rooted at each node a {@link CAstVisitor} leaves, including
+   * those of nested entities
+   */
+  public CAstFlatTree(final CAstEntity e) {
+    final List<CAstNode> visited = new ArrayList<>();
+    CAstVisitor<Context> collector = new CAstVisitor<Context>() {
+      @Override
+      public void leaveNode(CAstNode n, Context c, CAstVisitor<Context> visitor) {
+        visited.add(n);
+      }
+    };
+    collector.visit(e.getAST(), new Context() {
+      @Override
+      public CAstEntity top() {
+        return e;
+      }
+      @Override
+      public CAstSourcePositionMap getSourceMap() {
+        return e.getSourceMap();
+      }
+    }, collector);
+
+    this.roots = flatten(visited);
+  }
+
+  /**
+   * the tree rooted at top, with every one of its nodes as a root
+   */
+  public CAstFlatTree(CAstNode top) {
+    flatten(Collections.singletonList(top));
+
+    this.roots = allocate(nodes.size());
+    for (int i = 0; i < nodes.size(); i++) {
+      roots.put(i, i);
+    }
+  }
+
+  private int index(CAstNode n) {
+    Integer id = ids.get(n);
+    if (id == null) {
+      id = nodes.size();
+      ids.put(n, id);
+      nodes.add(n);
+    }
+    return id;
+  }
+
+  private IntBuffer flatten(List<CAstNode> rootNodes) {
+    IntBuffer rootIds = allocate(rootNodes.size());
+    for (int i = 0; i < rootNodes.size(); i++) {
+      rootIds.put(i, index(rootNodes.get(i)));
+    }
+
+    layout(0);
+
+    return rootIds;
+  }
+
+  /**
+   * lay out the nodes from first on, which have been indexed but not their
+   * children
+   */
+  private void layout(int first) {
+    // index the whole of every subtree first, so that the child lists
+    // can be laid out in node order
+    int count = childCount;
+    for (int i = first; i < nodes.size(); i++) {
+      CAstNode n = nodes.get(i);
+      count += n.getChildCount();
+      for (int j = 0; j < n.getChildCount(); j++) {
+        index(n.getChild(j));
+      }
+    }
+
+    kinds = grow(kinds, nodes.size());
+    childStart = grow(childStart, nodes.size() + 1);
+    children = grow(children, count);
+    constants = grow(constants, nodes.size());
+    int next = childCount;
+    for (int i = first; i < nodes.size(); i++) {
+      CAstNode n = nodes.get(i);
+      kinds.put(i, n.getKind());
+      childStart.put(i, next);
+      for (int j = 0; j < n.getChildCount(); j++) {
+        children.put(next++, ids.get(n.getChild(j)));
+      }
+      constants.put(i, n.getKind() == CAstNode.CONSTANT && n.getValue() != null ? valueId(n.getValue().toString()) : -1);
+    }
+    childStart.put(nodes.size(), next);
+    childCount = next;
+  }
+
+  private static IntBuffer allocate(int size) {
+    return ByteBuffer.allocateDirect(4 * size).order(ByteOrder.nativeOrder()).asIntBuffer();
+  }
+
+  private static IntBuffer grow(IntBuffer a, int size) {
+    if (a.capacity() >= size) {
+      return a;
+    }
+    IntBuffer bigger = allocate(Math.max(size, 2 * a.capacity()));
+    IntBuffer old = a.duplicate();
+    old.clear();
+    bigger.put(old);
+    bigger.clear();
+    return bigger;
+  }
+
+  /**
+   * the id of n, adding it and whichever of its descendants are new; nodes
+   * are only ever added, so rewrites can extend the tree copy-on-write, with
+   * unchanged subtrees keeping their ids.  The roots stay as they were.
+   */
+  public int add(CAstNode n) {
+    int first = nodes.size();
+    int id = index(n);
+    if (nodes.size() > first) {
+      layout(first);
+    }
+    return id;
+  }
+
+  /**
+   * the id of n, or -1 if it is not in this tree
+   */
+  public int find(CAstNode n) {
+    Integer id = ids.get(n);
+    return id == null ? -1 : id;
+  }
+
+  private int valueId(String value) {
+    Integer id = valueIds.get(value);
+    if (id == null) {
+      id = values.size();
+      valueIds.put(value, id);
+      values.add(value);
+    }
+    return id;
+  }
+
+  public int getNodeCount() {
+    return nodes.size();
+  }
+
+  public CAstNode getNode(int id) {
+    return nodes.get(id);
+  }
+
+  public int getRootCount() {
+    return roots.capacity();
+  }
+
+  public int getRoot(int i) {
+    return roots.get(i);
+  }
+
+  public int getKind(int id) {
+    return kinds.get(id);
+  }
+
+  public int getChildCount(int id) {
+    return childStart.get(id + 1) - childStart.get(id);
+  }
+
+  public int getChild(int id, int i) {
+    return children.get(childStart.get(id) + i);
+  }
+
+  List<String> getValues() {
+    return values;
+  }
+}
@@ -97,7 +97,7 @@ public class CAstPattern {
     }
 
     @SuppressWarnings("unchecked")
-    private void add(String name, CAstNode result) {
+    void add(String name, CAstNode result) {
       if (containsKey(name)) {
         Object o = get(name);
         if (o instanceof List) {
@@ -139,6 +139,43 @@ public class CAstPattern {
     this.children = null;
   }
 
+  String getName() {
+    return name;
+  }
+
+  /**
+   * the node kind matched, or one of the pattern kinds for the others; these
+   * are shared with the native matcher
+   */
+  int getKind() {
+    return kind;
+  }
+
+  CAstPattern[] getChildren() {
+    return children;
+  }
+
+  /**
+   * the pattern a reference pattern refers to, or null if this is not one
+   */
+  CAstPattern getReferent() {
+    return kind == REFERENCE_PATTERN_KIND ? references.get(value) : null;
+  }
+
+  /**
+   * whether this pattern matches constants by their value
+   */
+  boolean isValue() {
+    return kind == IGNORE_KIND;
+  }
+
+  /**
+   * whether a constant value matches this value pattern
+   */
+  boolean matchesValue(String v) {
+    return value instanceof Pattern ? ((Pattern)value).matcher(v).matches() : value.equals(v);
+  }
+
   @Override
   public String toString() {
     StringBuffer sb = new StringBuffer();
@@ -393,6 +430,26 @@ public class CAstPattern {
     }, e.getAST());
   }
   
+  /**
+   * like {@link #findAll(CAstPattern, CAstEntity)}, but over an entity that
+   * has already been flattened, so that many patterns can be run over it
+   * cheaply; the patterns run natively if the native matcher is linked in.
+   */
+  public static Collection<Segments> findAll(final CAstPattern p, final CAstFlatTree t) {
+    if (NativeCAstPattern.isAvailable()) {
+      return new NativeCAstPattern(p).findAll(t);
+    } else {
+      Collection<Segments> result = HashSetFactory.make();
+      for (int i = 0; i < t.getRootCount(); i++) {
+        Segments s = match(p, t.getNode(t.getRoot(i)));
+        if (s != null) {
+          result.add(s);
+        }
+      }
+      return result;
+    }
+  }
+
   public class Matcher extends CAstVisitor<Context> {
     private final Collection<Segments> result = HashSetFactory.make();
     
@@ -0,0 +1,142 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.util;
+
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.IdentityHashMap;
+import java.util.List;
+import java.util.Map;
+
+import com.ibm.wala.cast.util.CAstPattern.Segments;
+import com.ibm.wala.util.collections.HashSetFactory;
+
+/**
+ * a {@link CAstPattern} compiled for the native matcher in the CAst library
+ * (see CAstPatternMatcher.h), which runs it over {@link CAstFlatTree}s with the
+ * same results as {@link CAstPattern#findAll}. The pattern is lowered once to
+ * a flat int program; the only objects made per match are its
+ * {@link Segments}.
+ *
+ * The native library must have been loaded by whoever uses this, usually a
+ * native front end; {@link #isAvailable()} says whether it has been.
+ */
+public class NativeCAstPattern {
+  private static final int HEADER_SIZE = 4;
+
+  private static final NativeLinkage linkage = new NativeLinkage(NativeCAstPattern::linked);
+
+  private final List<String> names = new ArrayList<>();
+
+  private final List<CAstPattern> valuePatterns = new ArrayList<>();
+
+  private final Map<CAstPattern, Integer> offsets = new IdentityHashMap<>();
+
+  private final int[] program;
+
+  public NativeCAstPattern(CAstPattern p) {
+    List<CAstPattern> order = new ArrayList<>();
+    int size = layout(p, order, 0);
+
+    program = new int[size];
+    for (CAstPattern q : order) {
+      int offset = offsets.get(q);
+      CAstPattern[] children = q.getChildren();
+      CAstPattern referent = q.getReferent();
+
+      program[offset] = q.getKind();
+      program[offset + 1] = q.getName() == null ? -1 : nameId(q.getName());
+      if (referent != null) {
+        program[offset + 2] = offsets.get(referent);
+      } else if (q.isValue()) {
+        program[offset + 2] = valuePatterns.size();
+        valuePatterns.add(q);
+      } else {
+        program[offset + 2] = -1;
+      }
+      program[offset + 3] = children == null ? 0 : children.length;
+      for (int i = 0; children != null && i < children.length; i++) {
+        program[offset + HEADER_SIZE + i] = offsets.get(children[i]);
+      }
+    }
+  }
+
+  /**
+   * assign offsets to every pattern reachable from p, including through
+   * references, which may be recursive
+   */
+  private int layout(CAstPattern p, List<CAstPattern> order, int size) {
+    if (p == null || offsets.containsKey(p)) {
+      return size;
+    }
+
+    offsets.put(p, size);
+    order.add(p);
+    CAstPattern[] children = p.getChildren();
+    size += HEADER_SIZE + (children == null ? 0 : children.length);
+
+    size = layout(p.getReferent(), order, size);
+    for (int i = 0; children != null && i < children.length; i++) {
+      size = layout(children[i], order, size);
+    }
+    return size;
+  }
+
+  private int nameId(String name) {
+    int id = names.indexOf(name);
+    if (id < 0) {
+      id = names.size();
+      names.add(name);
+    }
+    return id;
+  }
+
+  /**
+   * the same segments as {@link CAstPattern#findAll}, for each root of t
+   */
+  public Collection<Segments> findAll(CAstFlatTree t) {
+    // value tests are decided here, once per distinct value, so that
+    // literals and regular expressions keep their Java meaning
+    List<String> values = t.getValues();
+    byte[] predicates = new byte[valuePatterns.size() * values.size()];
+    for (int i = 0; i < valuePatterns.size(); i++) {
+      for (int j = 0; j < values.size(); j++) {
+        predicates[i * values.size() + j] = (byte) (valuePatterns.get(i).matchesValue(values.get(j)) ? 1 : 0);
+      }
+    }
+
+    int[] matches = findAll(program, 0, predicates, values.size(), t);
+
+    Collection<Segments> result = HashSetFactory.make();
+    for (int i = 0; i < matches.length;) {
+      i++; // the root itself is only bound if the pattern names it
+      int bindings = matches[i++];
+      Segments s = new Segments();
+      for (int j = 0; j < bindings; j++) {
+        s.add(names.get(matches[i++]), t.getNode(matches[i++]));
+      }
+      result.add(s);
+    }
+    return result;
+  }
+
+  /**
+   * whether the native matcher has been linked into this VM, see
+   * {@link NativeLinkage}
+   */
+  public static boolean isAvailable() {
+    return linkage.isAvailable();
+  }
+
+  private static native boolean linked();
+
+  private static native int[] findAll(int[] program, int start, byte[] predicates, int valueCount, CAstFlatTree t);
+}
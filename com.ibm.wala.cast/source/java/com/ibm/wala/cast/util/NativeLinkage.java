@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.util;
+
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.function.BooleanSupplier;
+
+/**
+ * whether the natives of a class with a Java fallback, such as
+ * {@link NativeCAstPattern}, have been linked into this VM. The class passes
+ * a probe that calls one of its natives, which throws UnsatisfiedLinkError
+ * until a library defining it is loaded.
+ *
+ * Both answers are remembered, so asking is a field read after the first
+ * time and no lock is taken. A positive answer is final. A negative one holds
+ * until {@link #libraryLoaded()} is called, since a library may be loaded
+ * after the question was first asked.
+ */
+public final class NativeLinkage {
+
+  /**
+   * bumped by {@link #libraryLoaded()}, so that negative answers from before
+   * are asked again
+   */
+  private static final AtomicInteger loads = new AtomicInteger();
+
+  private final BooleanSupplier probe;
+
+  private volatile boolean linked;
+
+  /**
+   * the value of loads when the probe last failed, or -1
+   */
+  private volatile int missingAt = -1;
+
+  public NativeLinkage(BooleanSupplier probe) {
+    this.probe = probe;
+  }
+
+  public boolean isAvailable() {
+    if (linked) {
+      return true;
+    }
+
+    int now = loads.get();
+    if (missingAt == now) {
+      return false;
+    }
+
+    boolean answer = false;
+    try {
+      answer = probe.getAsBoolean();
+    } catch (UnsatisfiedLinkError e) {
+      // not linked yet
+    }
+    if (answer) {
+      linked = true;
+    } else {
+      missingAt = now;
+    }
+    return answer;
+  }
+
+  /**
+   * to be called after loading a native library, so that classes found
+   * unlinked before look again
+   */
+  public static void libraryLoaded() {
+    loads.incrementAndGet();
+  }
+}
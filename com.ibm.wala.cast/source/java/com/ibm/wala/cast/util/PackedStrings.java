@@ -0,0 +1,36 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.util;
+
+/**
+ * strings that native code transcoded together into one char array (see
+ * CAstStringBatch in libcast), so that making all of them takes one call from
+ * native code rather than one per string
+ */
+public class PackedStrings {
+
+  private PackedStrings() {
+  }
+
+  /**
+   * string i is chars[ends[i-1]] up to chars[ends[i]], with the first
+   * starting at 0; called from native code through CAstWrapper
+   */
+  public static String[] unpack(char[] chars, int[] ends) {
+    String[] result = new String[ends.length];
+    int start = 0;
+    for (int i = 0; i < ends.length; i++) {
+      result[i] = new String(chars, start, ends[i] - start);
+      start = ends[i];
+    }
+    return result;
+  }
+}
@@ -0,0 +1,334 @@
+/******************************************************************************
+ * Copyright (c) 2002 - 2006 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *     IBM Corporation - initial API and implementation
+ *****************************************************************************/
+package com.ibm.wala.cast.util;
+
+import java.io.File;
+import java.io.IOException;
+import java.io.InputStream;
+import java.io.InputStreamReader;
+import java.io.Reader;
+import java.net.URL;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.IntBuffer;
+import java.nio.charset.StandardCharsets;
+
+import com.ibm.wala.cast.tree.impl.AbstractSourcePosition;
+
+/**
+ * the contents of a source file held in memory once, typically read by
+ * native code, together with the offset at which each of its lines starts.
+ * Positions into the file are made with {@link #makePosition}; their text is
+ * sliced out of the buffer, finding lines by binary search, so neither
+ * {@link SourceBuffer} nor {@link SharedPosition#getReader()} read the file again.
+ *
+ * The offsets taken and returned by the buffer itself, and the columns given
+ * by front ends, are in bytes of the file, which is decoded as UTF-8; lines
+ * are numbered from 1 and columns from 0. The offsets of positions, though,
+ * are in chars of the decoded text, as other positions are, and are
+ * converted with {@link #getCharOffset}.
+ */
+public class SharedSourceBuffer {
+  private final URL url;
+
+  private final ByteBuffer contents;
+
+  private final IntBuffer lineStarts;
+
+  /**
+   * the char offset at which each line starts, counted on first use; null
+   * for a file that is all ASCII, where chars and bytes are the same
+   */
+  private volatile int[] lineCharStarts;
+
+  private volatile boolean charsCounted;
+
+  /**
+   * @param contents the file; it is only ever read, through a read-only view
+   * @param lineStarts the start offset of each line, as native-order ints
+   */
+  public SharedSourceBuffer(URL url, ByteBuffer contents, ByteBuffer lineStarts) {
+    this.url = url;
+    this.contents = contents.asReadOnlyBuffer();
+    this.lineStarts = lineStarts.order(ByteOrder.nativeOrder()).asIntBuffer();
+  }
+
+  public URL getURL() {
+    return url;
+  }
+
+  public int getLength() {
+    return contents.capacity();
+  }
+
+  public int getLineCount() {
+    return lineStarts.capacity();
+  }
+
+  /**
+   * the offset at which line starts; one past the last line is the length of
+   * the file
+   */
+  public int getLineStart(int line) {
+    if (line < 1) {
+      return 0;
+    } else if (line > getLineCount()) {
+      return getLength();
+    } else {
+      return lineStarts.get(line - 1);
+    }
+  }
+
+  /**
+   * the line holding offset
+   */
+  public int getLine(int offset) {
+    int lo = 0, hi = getLineCount();
+    while (lo < hi) {
+      int mid = (lo + hi) >>> 1;
+      if (lineStarts.get(mid) <= offset) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return Math.max(lo, 1);
+  }
+
+  /**
+   * the offset of a column of a line; a negative column means the start of the
+   * line, and columns past the end of the line are clipped to it
+   */
+  public int getOffset(int line, int col) {
+    int start = getLineStart(line);
+    if (col < 0) {
+      return start;
+    } else {
+      return Math.min(start + col, getLineStart(line + 1));
+    }
+  }
+
+  /**
+   * the offset in chars of the decoded text, as read from
+   * {@link SharedPosition#getReader()}, of a byte offset
+   */
+  public int getCharOffset(int offset) {
+    if (!charsCounted) {
+      countLineChars();
+    }
+    int[] charStarts = lineCharStarts;
+    if (charStarts == null || getLineCount() == 0) {
+      return offset;
+    }
+    int line = getLine(offset);
+    return charStarts[line - 1] + countChars(getLineStart(line), Math.min(offset, getLength()));
+  }
+
+  private synchronized void countLineChars() {
+    if (charsCounted) {
+      return;
+    }
+    boolean ascii = true;
+    for (int i = 0; i < getLength() && ascii; i++) {
+      ascii = contents.get(i) >= 0;
+    }
+    if (!ascii) {
+      int[] charStarts = new int[getLineCount()];
+      int chars = 0;
+      for (int line = 1; line <= charStarts.length; line++) {
+        charStarts[line - 1] = chars;
+        chars += countChars(getLineStart(line), getLineStart(line + 1));
+      }
+      lineCharStarts = charStarts;
+    }
+    charsCounted = true;
+  }
+
+  /**
+   * the chars that the UTF-8 bytes from first up to last decode to: one for
+   * each byte that starts a character, and two for those beyond the basic
+   * plane, which become surrogate pairs
+   */
+  private int countChars(int first, int last) {
+    int chars = 0;
+    for (int i = first; i < last; i++) {
+      int b = contents.get(i) & 0xff;
+      if ((b & 0xc0) != 0x80) {
+        chars += b >= 0xf0 ? 2 : 1;
+      }
+    }
+    return chars;
+  }
+
+  /**
+   * the text from first up to, but not including, last
+   */
+  public String getText(int first, int last) {
+    ByteBuffer slice = slice(first, last);
+    byte[] bytes = new byte[slice.remaining()];
+    slice.get(bytes);
+    return new String(bytes, StandardCharsets.UTF_8);
+  }
+
+  private ByteBuffer slice(int first, int last) {
+    ByteBuffer slice = contents.duplicate();
+    slice.limit(Math.min(Math.max(last, first), getLength()));
+    slice.position(Math.min(first, getLength()));
+    return slice;
+  }
+
+  /**
+   * the whole file, without copying it
+   */
+  public InputStream getInputStream() {
+    final ByteBuffer in = contents.duplicate();
+    return new InputStream() {
+      @Override
+      public int read() {
+        return in.hasRemaining() ? in.get() & 0xff : -1;
+      }
+
+      @Override
+      public int read(byte[] b, int off, int len) {
+        if (len == 0) {
+          return 0;
+        } else if (!in.hasRemaining()) {
+          return -1;
+        } else {
+          int n = Math.min(len, in.remaining());
+          in.get(b, off, n);
+          return n;
+        }
+      }
+
+      @Override
+      public int available() {
+        return in.remaining();
+      }
+    };
+  }
+
+  /**
+   * a position from line and column pairs, as given by native front ends;
+   * its offsets are computed from the line index
+   */
+  public SharedPosition makePosition(int fl, int fc, int ll, int lc) {
+    return new SharedPosition(fl, fc, ll, lc);
+  }
+
+  /**
+   * a position from the byte offset first up to last
+   */
+  public SharedPosition makeRangePosition(int first, int last) {
+    int fl = getLine(first);
+    int ll = getLine(last);
+    return new SharedPosition(fl, first - getLineStart(fl), ll, last - getLineStart(ll));
+  }
+
+  public class SharedPosition extends AbstractSourcePosition {
+    private final int fl, fc, ll, lc;
+
+    private final int firstOffset, lastOffset;
+
+    private SharedPosition(int fl, int fc, int ll, int lc) {
+      this.fl = fl;
+      this.fc = fc;
+      this.ll = ll;
+      this.lc = lc;
+      this.firstOffset = getOffset(fl, fc);
+      this.lastOffset = lc < 0 ? getLineStart(ll + 1) : Math.max(firstOffset, getOffset(ll, lc));
+    }
+
+    public SharedSourceBuffer getBuffer() {
+      return SharedSourceBuffer.this;
+    }
+
+    /**
+     * the text of this position
+     */
+    public String getText() {
+      return SharedSourceBuffer.this.getText(firstOffset, lastOffset);
+    }
+
+    @Override
+    public int getFirstLine() {
+      return fl;
+    }
+
+    @Override
+    public int getLastLine() {
+      return ll;
+    }
+
+    @Override
+    public int getFirstCol() {
+      return fc;
+    }
+
+    @Override
+    public int getLastCol() {
+      return lc;
+    }
+
+    /**
+     * the offset in chars at which this position starts; the byte offsets
+     * are {@link #getFirstByteOffset()} and {@link #getLastByteOffset()}
+     */
+    @Override
+    public int getFirstOffset() {
+      return getCharOffset(firstOffset);
+    }
+
+    @Override
+    public int getLastOffset() {
+      return getCharOffset(lastOffset);
+    }
+
+    public int getFirstByteOffset() {
+      return firstOffset;
+    }
+
+    public int getLastByteOffset() {
+      return lastOffset;
+    }
+
+    /**
+     * whether other spans the same bytes as this, wherever they are
+     */
+    public boolean hasSameText(SharedPosition other) {
+      return slice(firstOffset, lastOffset).equals(other.getBuffer().slice(other.firstOffset, other.lastOffset));
+    }
+
+    @Override
+    public URL getURL() {
+      return url;
+    }
+
+    public InputStream getInputStream() {
+      return SharedSourceBuffer.this.getInputStream();
+    }
+
+    @Override
+    public Reader getReader() throws IOException {
+      return new InputStreamReader(getInputStream(), StandardCharsets.UTF_8);
+    }
+
+    @Override
+    public String toString() {
+      String urlString = url.toString();
+      if (urlString.lastIndexOf(File.separator) == -1)
+        return "[" + fl + ":" + fc + "]->[" + ll + ":" + lc + "]";
+      else
+        return urlString.substring(urlString.lastIndexOf(File.separator) + 1) + "@[" + fl + ":" + fc + "]->[" + ll + ":" + lc
+            + "]";
+    }
+  }
+}
@@ -27,6 +27,12 @@ public class SourceBuffer {
   public SourceBuffer(Position p) throws IOException {
     this.p = p;
 
+    if (p instanceof SharedSourceBuffer.SharedPosition) {
+      // the text is sliced out of the shared copy rather than read again
+      this.lines = ((SharedSourceBuffer.SharedPosition) p).getText().split("\r?\n", -1);
+      return;
+    }
+
     BufferedReader reader = new BufferedReader(p.getReader());
     
     String currentLine = null;